@@ -11,7 +11,20 @@
 #include "benchmark/benchmark.h"
 #include "tiny_dnn/tiny_dnn.h"
 
+// layer kernels on every backend of the build, and whole models. for
+// machine-readable results, e.g. to track regressions across commits:
+//   ./tiny_dnn_benchmarks --benchmark_format=json > results.json
+// a subset is selected with --benchmark_filter=<regex>, e.g. bm_conv_
+#include "bm_activations.h"
+#include "bm_convolutional.h"
+#include "bm_deconvolutional.h"
+#include "bm_fully_connected.h"
 #include "bm_global_avepool.h"
+#include "bm_models.h"
+#include "bm_normalization.h"
+#include "bm_pooling.h"
+#include "bm_quantized.h"
+#include "bm_recurrent_cell.h"
 using namespace tiny_dnn::benchmarks;
 
 BENCHMARK_MAIN();
@@ -0,0 +1,62 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <memory>
+
+#include "bm_common.h"
+
+namespace tiny_dnn {
+namespace benchmarks {
+
+// {values per sample}
+inline void activation_shapes(benchmark::internal::Benchmark *b) {
+  b->Arg(1024);
+  b->Arg(56 * 56 * 64);
+}
+
+template <typename Activation>
+void bm_activation_forward(benchmark::State &state) {
+  Activation l(static_cast<size_t>(state.range(0)));
+  run_layer(state, l, 8, false);
+}
+
+template <typename Activation>
+void bm_activation_backward(benchmark::State &state) {
+  Activation l(static_cast<size_t>(state.range(0)));
+  run_layer(state, l, 8, true);
+}
+
+#define TINY_DNN_BM_ACTIVATION(Activation)                    \
+  BENCHMARK_TEMPLATE(bm_activation_forward, Activation)       \
+    ->Apply(activation_shapes);                               \
+  BENCHMARK_TEMPLATE(bm_activation_backward, Activation)      \
+    ->Apply(activation_shapes)
+
+TINY_DNN_BM_ACTIVATION(relu_layer);
+TINY_DNN_BM_ACTIVATION(leaky_relu_layer);
+TINY_DNN_BM_ACTIVATION(elu_layer);
+TINY_DNN_BM_ACTIVATION(sigmoid_layer);
+TINY_DNN_BM_ACTIVATION(tanh_layer);
+TINY_DNN_BM_ACTIVATION(softmax_layer);
+
+void bm_dropout_forward(benchmark::State &state) {
+  dropout_layer l(static_cast<size_t>(state.range(0)), 0.5);
+  run_layer(state, l, 8, false);
+}
+
+void bm_dropout_backward(benchmark::State &state) {
+  dropout_layer l(static_cast<size_t>(state.range(0)), 0.5);
+  run_layer(state, l, 8, true);
+}
+
+BENCHMARK(bm_dropout_forward)->Apply(activation_shapes);
+BENCHMARK(bm_dropout_backward)->Apply(activation_shapes);
+
+}  // namespace benchmarks
+}  // namespace tiny_dnn
@@ -0,0 +1,131 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "tiny_dnn/tiny_dnn.h"
+
+namespace tiny_dnn {
+namespace benchmarks {
+
+// register func once for every backend layers can run on in this build,
+// applying the arguments of apply
+#define TINY_DNN_BM_INTERNAL(func, apply) \
+  BENCHMARK_CAPTURE(func, internal, core::backend_t::internal)->Apply(apply)
+
+#ifdef CNN_USE_AVX
+#define TINY_DNN_BM_AVX(func, apply) \
+  BENCHMARK_CAPTURE(func, avx, core::backend_t::avx)->Apply(apply)
+#else
+#define TINY_DNN_BM_AVX(func, apply)
+#endif
+
+#ifdef CNN_USE_NNPACK
+#define TINY_DNN_BM_NNPACK(func, apply) \
+  BENCHMARK_CAPTURE(func, nnpack, core::backend_t::nnpack)->Apply(apply)
+#else
+#define TINY_DNN_BM_NNPACK(func, apply)
+#endif
+
+#define TINY_DNN_BM_BACKENDS(func, apply) \
+  TINY_DNN_BM_INTERNAL(func, apply);      \
+  TINY_DNN_BM_AVX(func, apply);           \
+  TINY_DNN_BM_NNPACK(func, apply)
+
+inline std::vector<tensor_t> random_batch(size_t batch_size, size_t size) {
+  std::vector<tensor_t> batch(1, tensor_t(batch_size, vec_t(size)));
+  for (auto &v : batch[0]) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+  return batch;
+}
+
+/**
+ * time the forward pass of l, or the backward pass if backward, on a batch
+ * of batch_size random samples. throughput is reported in samples/s.
+ **/
+inline void run_layer(benchmark::State &state,
+                      layer &l,
+                      size_t batch_size,
+                      bool backward) {
+  set_random_seed(0);
+  auto in = random_batch(batch_size, l.in_data_shape()[0].size());
+  std::vector<const tensor_t *> out;
+  l.forward(in, out);  // sets up the weights and buffers
+  if (backward) {
+    l.backward(random_batch(batch_size, l.out_data_shape()[0].size()));
+    while (state.KeepRunning()) l.backward();
+  } else {
+    while (state.KeepRunning()) l.forward();
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+  state.SetLabel(l.layer_type() + " " + to_string(l.in_data_shape()[0]) +
+                 " -> " + to_string(l.out_data_shape()[0]));
+}
+
+/**
+ * construct a layer with make() and time it, skipping backends which cannot
+ * run it
+ **/
+inline void run_layer(benchmark::State &state,
+                      const std::function<std::unique_ptr<layer>()> &make,
+                      size_t batch_size,
+                      bool backward) {
+  try {
+    auto l = make();
+    run_layer(state, *l, batch_size, backward);
+  } catch (const nn_error &e) {
+    state.SkipWithError(e.what());
+    while (state.KeepRunning()) {
+    }
+  }
+}
+
+/**
+ * time one training step (forward, backward and weight update) of net on a
+ * batch of batch_size random samples
+ **/
+template <typename Net>
+void run_train_step(benchmark::State &state, Net &net, size_t batch_size) {
+  set_random_seed(0);
+  std::vector<vec_t> in(batch_size, vec_t(net.in_data_size()));
+  std::vector<vec_t> t(batch_size, vec_t(net.out_data_size()));
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+  for (auto &v : t) uniform_rand(v.begin(), v.end(), 0.0, 1.0);
+
+  gradient_descent opt;
+  net.init_weight();
+  net.template fit<mse>(opt, in, t, batch_size, 1);
+  while (state.KeepRunning()) {
+    net.template fit<mse>(opt, in, t, batch_size, 1);
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+/**
+ * time inference of net on batches of batch_size random samples
+ **/
+template <typename Net>
+void run_inference(benchmark::State &state, Net &net, size_t batch_size) {
+  set_random_seed(0);
+  std::vector<vec_t> in(batch_size, vec_t(net.in_data_size()));
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+
+  net.init_weight();
+  net.predict_batch(in, batch_size);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(net.predict_batch(in, batch_size));
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+}  // namespace benchmarks
+}  // namespace tiny_dnn
@@ -0,0 +1,64 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "bm_common.h"
+
+namespace tiny_dnn {
+namespace benchmarks {
+
+// {input size, input channels, output channels, window size, stride}
+inline void conv_shapes(benchmark::internal::Benchmark *b) {
+  b->Args({56, 64, 64, 3, 1});
+  b->Args({28, 128, 128, 3, 1});
+  b->Args({14, 256, 256, 3, 1});
+  b->Args({56, 64, 64, 1, 1});
+  b->Args({28, 32, 64, 5, 1});
+  b->Args({56, 64, 128, 3, 2});
+  b->Args({227, 3, 64, 11, 4});
+}
+
+// the shapes the winograd engine handles
+inline void conv_winograd_shapes(benchmark::internal::Benchmark *b) {
+  b->Args({56, 64, 64, 3, 1});
+  b->Args({28, 128, 128, 3, 1});
+  b->Args({14, 256, 256, 3, 1});
+}
+
+inline std::function<std::unique_ptr<layer>()> make_conv(
+  const benchmark::State &state, core::backend_t backend) {
+  const size_t size = state.range(0), stride = state.range(4);
+  const size_t in_channels = state.range(1), out_channels = state.range(2);
+  const size_t window = state.range(3);
+  return [=]() {
+    return std::unique_ptr<layer>(new convolutional_layer(
+      size, size, window, in_channels, out_channels, padding::valid, true,
+      stride, stride, backend));
+  };
+}
+
+void bm_conv_forward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_conv(state, backend), 4, false);
+}
+
+void bm_conv_backward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_conv(state, backend), 4, true);
+}
+
+TINY_DNN_BM_BACKENDS(bm_conv_forward, conv_shapes);
+TINY_DNN_BM_BACKENDS(bm_conv_backward, conv_shapes);
+BENCHMARK_CAPTURE(bm_conv_forward, winograd, core::backend_t::winograd)
+  ->Apply(conv_winograd_shapes);
+BENCHMARK_CAPTURE(bm_conv_backward, winograd, core::backend_t::winograd)
+  ->Apply(conv_winograd_shapes);
+
+}  // namespace benchmarks
+}  // namespace tiny_dnn
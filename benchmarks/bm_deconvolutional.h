@@ -0,0 +1,46 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "bm_common.h"
+
+namespace tiny_dnn {
+namespace benchmarks {
+
+// {input size, input channels, output channels, window size, stride}
+inline void deconv_shapes(benchmark::internal::Benchmark *b) {
+  b->Args({14, 64, 32, 3, 1});
+  b->Args({28, 32, 16, 5, 1});
+  b->Args({14, 64, 32, 4, 2});
+}
+
+inline std::function<std::unique_ptr<layer>()> make_deconv(
+  const benchmark::State &state, core::backend_t backend) {
+  const size_t size = state.range(0), stride = state.range(4);
+  const size_t in_channels = state.range(1), out_channels = state.range(2);
+  const size_t window = state.range(3);
+  return [=]() {
+    return std::unique_ptr<layer>(new deconvolutional_layer(
+      size, size, window, in_channels, out_channels, padding::valid, true,
+      stride, stride, backend));
+  };
+}
+
+void bm_deconv_forward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_deconv(state, backend), 4, false);
+}
+
+// the backward pass of deconvolutional_layer is not usable on its own yet
+// (see the disabled gradient checks in test_deconvolutional_layer.h)
+TINY_DNN_BM_BACKENDS(bm_deconv_forward, deconv_shapes);
+
+}  // namespace benchmarks
+}  // namespace tiny_dnn
@@ -0,0 +1,46 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "bm_common.h"
+
+namespace tiny_dnn {
+namespace benchmarks {
+
+// {input size, output size}
+inline void fc_shapes(benchmark::internal::Benchmark *b) {
+  b->Args({784, 10});
+  b->Args({1024, 1024});
+  b->Args({4096, 1000});
+}
+
+inline std::function<std::unique_ptr<layer>()> make_fc(
+  const benchmark::State &state, core::backend_t backend) {
+  const size_t in_dim = state.range(0), out_dim = state.range(1);
+  return [=]() {
+    return std::unique_ptr<layer>(
+      new fully_connected_layer(in_dim, out_dim, true, backend));
+  };
+}
+
+void bm_fc_forward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_fc(state, backend), 32, false);
+}
+
+void bm_fc_backward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_fc(state, backend), 32, true);
+}
+
+TINY_DNN_BM_BACKENDS(bm_fc_forward, fc_shapes);
+TINY_DNN_BM_BACKENDS(bm_fc_backward, fc_shapes);
+
+}  // namespace benchmarks
+}  // namespace tiny_dnn
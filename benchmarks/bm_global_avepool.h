@@ -15,13 +15,13 @@
 namespace tiny_dnn {
 namespace benchmarks {
 
-std::tuple<tensor_t, tensor_t, global_avepool_params>
+std::tuple<tensor_t, tensor_t, core::global_avepool_params>
 get_bm_global_avepool_data() {
   vec_t input_one(100 * 100 * 100, 10000);
   vec_t output_one(100, 0);
   tensor_t input_data(1, input_one);
   tensor_t output_data(1, output_one);
-  global_avepool_params params;
+  core::global_avepool_params params;
   params.in  = {100, 100, 100};
   params.out = {100, 1, 1};
   return std::make_tuple(input_data, output_data, params);
@@ -29,7 +29,7 @@ get_bm_global_avepool_data() {
 
 void bm_global_avepool_forward_internal(benchmark::State& state) {
   tensor_t input_data, output_data;
-  global_avepool_params params;
+  core::global_avepool_params params;
   std::tie(input_data, output_data, params) = get_bm_global_avepool_data();
 
   while (state.KeepRunning()) {
@@ -40,7 +40,7 @@ void bm_global_avepool_forward_internal(benchmark::State& state) {
 #ifdef CNN_USE_AVX
 void bm_global_avepool_forward_avx(benchmark::State& state) {
   tensor_t input_data, output_data;
-  global_avepool_params params;
+  core::global_avepool_params params;
   std::tie(input_data, output_data, params) = get_bm_global_avepool_data();
 
   while (state.KeepRunning()) {
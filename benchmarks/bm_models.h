@@ -0,0 +1,132 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include "bm_common.h"
+
+namespace tiny_dnn {
+namespace benchmarks {
+
+// LeNet-5 as in examples/mnist
+inline void construct_lenet(network<sequential> &nn, core::backend_t backend) {
+  nn << convolutional_layer(32, 32, 5, 1, 6, padding::valid, true, 1, 1,
+                            backend)
+     << tanh_layer() << average_pooling_layer(28, 28, 6, 2) << tanh_layer()
+     << convolutional_layer(14, 14, 5, 6, 16, padding::valid, true, 1, 1,
+                            backend)
+     << tanh_layer() << average_pooling_layer(10, 10, 16, 2) << tanh_layer()
+     << convolutional_layer(5, 5, 5, 16, 120, padding::valid, true, 1, 1,
+                            backend)
+     << tanh_layer() << fully_connected_layer(120, 10, true, backend)
+     << tanh_layer();
+}
+
+// the network of examples/cifar10
+inline void construct_cifar10(network<sequential> &nn,
+                              core::backend_t backend) {
+  nn << convolutional_layer(32, 32, 5, 3, 32, padding::same, true, 1, 1,
+                            backend)
+     << max_pooling_layer(32, 32, 32, 2, backend) << relu_layer()
+     << convolutional_layer(16, 16, 5, 32, 32, padding::same, true, 1, 1,
+                            backend)
+     << max_pooling_layer(16, 16, 32, 2, backend) << relu_layer()
+     << convolutional_layer(8, 8, 5, 32, 64, padding::same, true, 1, 1,
+                            backend)
+     << max_pooling_layer(8, 8, 64, 2, backend) << relu_layer()
+     << fully_connected_layer(4 * 4 * 64, 64, true, backend) << relu_layer()
+     << fully_connected_layer(64, 10, true, backend) << softmax_layer(10);
+}
+
+// two branches split off and joined along the channels, as in inception
+// modules. the branches are cheap, so that slicing and concatenating show
+inline void bm_branches(benchmark::State &state, bool train) {
+  auto in     = std::make_shared<input_layer>(shape3d(16, 16, 64));
+  auto slice  = std::make_shared<slice_layer>(shape3d(16, 16, 64),
+                                             slice_type::slice_channels, 2);
+  auto relu_a = std::make_shared<relu_layer>(shape3d(16, 16, 32));
+  auto relu_b = std::make_shared<relu_layer>(shape3d(16, 16, 32));
+  auto concat = std::make_shared<concat_layer>(
+    std::vector<shape3d>{shape3d(16, 16, 32), shape3d(16, 16, 32)});
+  auto out = std::make_shared<relu_layer>(shape3d(16, 16, 64));
+
+  in << slice;
+  connect(slice.get(), relu_a.get(), 0, 0);
+  connect(slice.get(), relu_b.get(), 1, 0);
+  (relu_a, relu_b) << concat << out;
+
+  network<graph> nn;
+  construct_graph(nn, {in}, {out});
+  if (train) {
+    run_train_step(state, nn, state.range(0));
+  } else {
+    run_inference(state, nn, state.range(0));
+  }
+}
+
+void bm_branches_inference(benchmark::State &state) {
+  bm_branches(state, false);
+}
+
+void bm_branches_train_step(benchmark::State &state) {
+  bm_branches(state, true);
+}
+
+void bm_lenet_inference(benchmark::State &state, core::backend_t backend) {
+  network<sequential> nn;
+  construct_lenet(nn, backend);
+  run_inference(state, nn, state.range(0));
+}
+
+void bm_lenet_train_step(benchmark::State &state, core::backend_t backend) {
+  network<sequential> nn;
+  construct_lenet(nn, backend);
+  run_train_step(state, nn, state.range(0));
+}
+
+void bm_cifar10_inference(benchmark::State &state, core::backend_t backend) {
+  network<sequential> nn;
+  construct_cifar10(nn, backend);
+  run_inference(state, nn, state.range(0));
+}
+
+void bm_cifar10_train_step(benchmark::State &state, core::backend_t backend) {
+  network<sequential> nn;
+  construct_cifar10(nn, backend);
+  run_train_step(state, nn, state.range(0));
+}
+
+void bm_alexnet_inference(benchmark::State &state) {
+  models::alexnet nn;
+  run_inference(state, nn, state.range(0));
+}
+
+void bm_alexnet_train_step(benchmark::State &state) {
+  models::alexnet nn;
+  run_train_step(state, nn, state.range(0));
+}
+
+// {batch size}
+inline void small_model_batches(benchmark::internal::Benchmark *b) {
+  b->Arg(1)->Arg(32)->Unit(benchmark::kMillisecond);
+}
+
+inline void large_model_batches(benchmark::internal::Benchmark *b) {
+  b->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond);
+}
+
+TINY_DNN_BM_BACKENDS(bm_lenet_inference, small_model_batches);
+TINY_DNN_BM_BACKENDS(bm_lenet_train_step, small_model_batches);
+TINY_DNN_BM_BACKENDS(bm_cifar10_inference, small_model_batches);
+TINY_DNN_BM_BACKENDS(bm_cifar10_train_step, small_model_batches);
+BENCHMARK(bm_branches_inference)->Apply(small_model_batches);
+BENCHMARK(bm_branches_train_step)->Apply(small_model_batches);
+BENCHMARK(bm_alexnet_inference)->Apply(large_model_batches);
+BENCHMARK(bm_alexnet_train_step)->Apply(large_model_batches);
+
+}  // namespace benchmarks
+}  // namespace tiny_dnn
@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "bm_common.h"
+
+namespace tiny_dnn {
+namespace benchmarks {
+
+// {input size, channels}
+inline void normalization_shapes(benchmark::internal::Benchmark *b) {
+  b->Args({27, 64});
+  b->Args({56, 64});
+  b->Args({13, 256});
+}
+
+// lrn and batch normalization have a single implementation
+inline std::function<std::unique_ptr<layer>()> make_lrn(
+  const benchmark::State &state, core::backend_t) {
+  const size_t size = state.range(0), channels = state.range(1);
+  return [=]() {
+    return std::unique_ptr<layer>(new lrn_layer(size, size, 5, channels));
+  };
+}
+
+inline std::function<std::unique_ptr<layer>()> make_batch_norm(
+  const benchmark::State &state, core::backend_t) {
+  const size_t size = state.range(0), channels = state.range(1);
+  return [=]() {
+    return std::unique_ptr<layer>(
+      new batch_normalization_layer(size * size, channels));
+  };
+}
+
+void bm_lrn_forward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_lrn(state, backend), 8, false);
+}
+
+void bm_batch_norm_forward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_batch_norm(state, backend), 8, false);
+}
+
+void bm_batch_norm_backward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_batch_norm(state, backend), 8, true);
+}
+
+// lrn_layer has no backward pass
+TINY_DNN_BM_INTERNAL(bm_lrn_forward, normalization_shapes);
+TINY_DNN_BM_INTERNAL(bm_batch_norm_forward, normalization_shapes);
+TINY_DNN_BM_INTERNAL(bm_batch_norm_backward, normalization_shapes);
+
+}  // namespace benchmarks
+}  // namespace tiny_dnn
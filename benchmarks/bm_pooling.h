@@ -0,0 +1,75 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "bm_common.h"
+
+namespace tiny_dnn {
+namespace benchmarks {
+
+// {input size, channels, pooling size, stride}
+inline void pooling_shapes(benchmark::internal::Benchmark *b) {
+  b->Args({56, 64, 2, 2});
+  b->Args({55, 96, 3, 2});
+  b->Args({28, 128, 2, 2});
+}
+
+// average pooling needs the input size to be a multiple of the pooling size,
+// and windows covering every input
+inline void ave_pooling_shapes(benchmark::internal::Benchmark *b) {
+  b->Args({56, 64, 2, 2});
+  b->Args({54, 96, 3, 3});
+  b->Args({28, 128, 2, 2});
+}
+
+inline std::function<std::unique_ptr<layer>()> make_max_pool(
+  const benchmark::State &state, core::backend_t backend) {
+  const size_t size = state.range(0), channels = state.range(1);
+  const size_t pool = state.range(2), stride = state.range(3);
+  return [=]() {
+    return std::unique_ptr<layer>(
+      new max_pooling_layer(size, size, channels, pool, stride, backend));
+  };
+}
+
+inline std::function<std::unique_ptr<layer>()> make_ave_pool(
+  const benchmark::State &state, core::backend_t backend) {
+  const size_t size = state.range(0), channels = state.range(1);
+  const size_t pool = state.range(2), stride = state.range(3);
+  return [=]() {
+    return std::unique_ptr<layer>(
+      new average_pooling_layer(size, size, channels, pool, stride, backend));
+  };
+}
+
+void bm_max_pool_forward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_max_pool(state, backend), 8, false);
+}
+
+void bm_max_pool_backward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_max_pool(state, backend), 8, true);
+}
+
+void bm_ave_pool_forward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_ave_pool(state, backend), 8, false);
+}
+
+void bm_ave_pool_backward(benchmark::State &state, core::backend_t backend) {
+  run_layer(state, make_ave_pool(state, backend), 8, true);
+}
+
+TINY_DNN_BM_BACKENDS(bm_max_pool_forward, pooling_shapes);
+TINY_DNN_BM_BACKENDS(bm_max_pool_backward, pooling_shapes);
+TINY_DNN_BM_BACKENDS(bm_ave_pool_forward, ave_pooling_shapes);
+TINY_DNN_BM_BACKENDS(bm_ave_pool_backward, ave_pooling_shapes);
+
+}  // namespace benchmarks
+}  // namespace tiny_dnn
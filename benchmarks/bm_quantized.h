@@ -0,0 +1,122 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "bm_common.h"
+
+namespace tiny_dnn {
+namespace benchmarks {
+
+inline std::function<std::unique_ptr<layer>()> make_quantized_conv(
+  const benchmark::State &state, core::backend_t backend) {
+  const size_t size = state.range(0), stride = state.range(4);
+  const size_t in_channels = state.range(1), out_channels = state.range(2);
+  const size_t window = state.range(3);
+  return [=]() {
+    return std::unique_ptr<layer>(new quantized_convolutional_layer(
+      size, size, window, in_channels, out_channels, padding::valid, true,
+      stride, stride, backend));
+  };
+}
+
+inline std::function<std::unique_ptr<layer>()> make_quantized_deconv(
+  const benchmark::State &state, core::backend_t backend) {
+  const size_t size = state.range(0), stride = state.range(4);
+  const size_t in_channels = state.range(1), out_channels = state.range(2);
+  const size_t window = state.range(3);
+  return [=]() {
+    return std::unique_ptr<layer>(new quantized_deconvolutional_layer(
+      size, size, window, in_channels, out_channels, padding::valid, true,
+      stride, stride, backend));
+  };
+}
+
+inline std::function<std::unique_ptr<layer>()> make_quantized_fc(
+  const benchmark::State &state, core::backend_t backend) {
+  const size_t in_dim = state.range(0), out_dim = state.range(1);
+  return [=]() {
+    return std::unique_ptr<layer>(
+      new quantized_fully_connected_layer(in_dim, out_dim, true, backend));
+  };
+}
+
+void bm_quantized_conv_forward(benchmark::State &state,
+                               core::backend_t backend) {
+  run_layer(state, make_quantized_conv(state, backend), 4, false);
+}
+
+void bm_quantized_deconv_forward(benchmark::State &state,
+                                 core::backend_t backend) {
+  run_layer(state, make_quantized_deconv(state, backend), 4, false);
+}
+
+void bm_quantized_fc_forward(benchmark::State &state,
+                             core::backend_t backend) {
+  run_layer(state, make_quantized_fc(state, backend), 32, false);
+}
+
+// quantized layers run on the internal backend only
+TINY_DNN_BM_INTERNAL(bm_quantized_conv_forward, conv_shapes);
+TINY_DNN_BM_INTERNAL(bm_quantized_deconv_forward, deconv_shapes);
+TINY_DNN_BM_INTERNAL(bm_quantized_fc_forward, fc_shapes);
+
+// {rows, depth, columns}
+inline void quantized_gemm_shapes(benchmark::internal::Benchmark *b) {
+  b->Args({64, 576, 3136});
+  b->Args({256, 2304, 196});
+  b->Args({1000, 4096, 32});
+}
+
+/**
+ * the 8-bit GEMM under the quantized layers, on one instruction set
+ **/
+void bm_quantized_gemm(benchmark::State &state,
+                       core::kernels::quantized_gemm_isa isa) {
+  if (!core::kernels::quantized_gemm_supported(isa)) {
+    state.SkipWithError("instruction set not supported by this processor");
+    while (state.KeepRunning()) {
+    }
+    return;
+  }
+  const size_t rows = state.range(0), depth = state.range(1);
+  const size_t cols = state.range(2);
+  std::vector<int32_t> offsets(rows, 128);
+  core::kernels::packed_quantized_weights a(
+    rows, depth, offsets,
+    [](size_t i, size_t k) { return uint8_t((i * 31 + k * 17) % 256); }, isa);
+  std::vector<uint8_t> b(cols * depth);
+  for (size_t i = 0; i < b.size(); i++) b[i] = uint8_t(i * 13 % 256);
+  std::vector<int32_t> c(rows * cols);
+
+  while (state.KeepRunning()) {
+    core::kernels::quantized_gemm(a, &b[0], cols, depth, 0, &c[0], cols);
+  }
+  // multiply-adds per second
+  state.SetItemsProcessed(state.iterations() * rows * depth * cols);
+}
+
+BENCHMARK_CAPTURE(bm_quantized_gemm,
+                  generic,
+                  core::kernels::quantized_gemm_isa::generic)
+  ->Apply(quantized_gemm_shapes);
+BENCHMARK_CAPTURE(bm_quantized_gemm,
+                  avx2,
+                  core::kernels::quantized_gemm_isa::avx2)
+  ->Apply(quantized_gemm_shapes);
+BENCHMARK_CAPTURE(bm_quantized_gemm,
+                  avx512_vnni,
+                  core::kernels::quantized_gemm_isa::avx512_vnni)
+  ->Apply(quantized_gemm_shapes);
+
+}  // namespace benchmarks
+}  // namespace tiny_dnn
@@ -0,0 +1,47 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "bm_common.h"
+
+namespace tiny_dnn {
+namespace benchmarks {
+
+// {input size, output size}
+inline void recurrent_cell_shapes(benchmark::internal::Benchmark *b) {
+  b->Args({128, 256});
+  b->Args({512, 512});
+}
+
+inline std::function<std::unique_ptr<layer>()> make_recurrent_cell(
+  const benchmark::State &state, core::backend_t backend) {
+  const size_t in_dim = state.range(0), out_dim = state.range(1);
+  return [=]() {
+    return std::unique_ptr<layer>(
+      new recurrent_cell_layer(in_dim, out_dim, true, new tanh_layer, backend));
+  };
+}
+
+void bm_recurrent_cell_forward(benchmark::State &state,
+                               core::backend_t backend) {
+  run_layer(state, make_recurrent_cell(state, backend), 32, false);
+}
+
+void bm_recurrent_cell_backward(benchmark::State &state,
+                                core::backend_t backend) {
+  run_layer(state, make_recurrent_cell(state, backend), 32, true);
+}
+
+TINY_DNN_BM_BACKENDS(bm_recurrent_cell_forward, recurrent_cell_shapes);
+TINY_DNN_BM_BACKENDS(bm_recurrent_cell_backward, recurrent_cell_shapes);
+
+}  // namespace benchmarks
+}  // namespace tiny_dnn
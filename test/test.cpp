@@ -22,9 +22,11 @@ using namespace tiny_dnn::activation;
 #include "test_concat_layer.h"
 #include "test_convolutional_layer.h"
 #include "test_core.h"
+#include "test_dataset.h"
 #include "test_deconvolutional_layer.h"
 #include "test_dropout_layer.h"
 #include "test_fully_connected_layer.h"
+#include "test_gemm.h"
 #include "test_global_average_pooling_layer.h"
 #include "test_integration.h"
 #include "test_large_thread_count.h"
@@ -38,12 +40,16 @@ using namespace tiny_dnn::activation;
 #include "test_quantization.h"
 #include "test_quantized_convolutional_layer.h"
 #include "test_quantized_deconvolutional_layer.h"
+#include "test_random.h"
 #include "test_recurrent_cell_layer.h"
 #include "test_slice_layer.h"
 #include "test_target_cost.h"
 #include "test_tensor.h"
+#include "test_thread_pool.h"
 
 #ifndef CNN_NO_SERIALIZATION
+#include "test_execution_context.h"
+#include "test_post_training_quantizer.h"
 #include "test_serialization.h"
 #endif  // CNN_NO_SERIALIZATION
 
@@ -75,6 +75,81 @@ TEST(ave_pool, forward_stride) {
   }
 }
 
+TEST(ave_pool, strided_windows) {
+  const size_t w = 30, h = 24, depth = 3, n = 2;
+  // {pool size, stride, padding}, with overlapping and uncovered windows
+  const struct {
+    size_t pool, stride;
+    padding pad;
+  } cases[] = {{2, 2, padding::valid},
+               {3, 1, padding::valid},
+               {2, 1, padding::same}};
+  std::vector<core::backend_t> backends = {core::backend_t::internal};
+#ifdef CNN_USE_AVX
+  backends.push_back(core::backend_t::avx);
+#endif
+
+  tensor_t in(n, vec_t(w * h * depth)), out_grad;
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+
+  for (const auto &c : cases) {
+    const size_t pool = c.pool, stride = c.stride;
+    const float_t scale = float_t(1) / float_t(pool * pool);
+    for (auto backend : backends) {
+      average_pooling_layer l(w, h, depth, pool, pool, stride, stride, c.pad,
+                              backend);
+      l.weight_init(weight_init::constant(2.0));
+      l.bias_init(weight_init::constant(0.5));
+      l.init_weight();
+      const shape3d os = l.out_shape()[0];
+      out_grad.assign(n, vec_t(os.size()));
+      for (auto &v : out_grad) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+
+      std::vector<const tensor_t *> out;
+      l.forward({in}, out);
+      std::vector<tensor_t> grads = l.backward(std::vector<tensor_t>{out_grad});
+
+      // windows reaching past the input (padding::same) hold only the bias
+      vec_t expected_dW(depth), expected_db(depth);
+      for (size_t s = 0; s < n; s++) {
+        vec_t expected_grad(in[s].size());
+        for (size_t d = 0; d < depth; d++) {
+          for (size_t oy = 0; oy < os.height_; oy++) {
+            for (size_t ox = 0; ox < os.width_; ox++) {
+              const size_t x0 = ox * stride, y0 = oy * stride;
+              const size_t o  = os.get_index(ox, oy, d);
+              const bool fits = x0 + pool <= w && y0 + pool <= h;
+              float_t sum{0};
+              for (size_t y = y0; fits && y < y0 + pool; y++) {
+                for (size_t x = x0; x < x0 + pool; x++) {
+                  const size_t i = (d * h + y) * w + x;
+                  sum += in[s][i];
+                  expected_grad[i] += 2 * scale * out_grad[s][o];
+                }
+              }
+              EXPECT_NEAR(2 * scale * sum + 0.5, (*out[0])[s][o], 1e-5);
+              expected_dW[d] += scale * sum * out_grad[s][o];
+              expected_db[d] += out_grad[s][o];
+            }
+          }
+        }
+        for (size_t i = 0; i < expected_grad.size(); i++) {
+          EXPECT_NEAR(expected_grad[i], grads[0][s][i], 1e-5);
+        }
+      }
+
+      // dW and db may be split into partial sums
+      for (size_t d = 0; d < depth; d++) {
+        float_t dW{0}, db{0};
+        for (const auto &row : grads[1]) dW += row[d];
+        for (const auto &row : grads[2]) db += row[d];
+        EXPECT_NEAR(expected_dW[d], dW, 1e-4);
+        EXPECT_NEAR(expected_db[d], db, 1e-4);
+      }
+    }
+  }
+}
+
 TEST(ave_pool, read_write) {
   average_pooling_layer l1(100, 100, 5, 2);
   average_pooling_layer l2(100, 100, 5, 2);
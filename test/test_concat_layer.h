@@ -78,4 +78,38 @@ TEST(concat, forward_data) {
   }
 }
 
+TEST(concat, inputs_in_place) {
+  concat_layer cl({shape3d(2, 2, 1), shape3d(2, 2, 3)});
+
+  for (size_t batch : {3, 3, 5, 2}) {
+    tensor_t in0(batch, vec_t(4)), in1(batch, vec_t(12));
+    tensor_t grad(batch, vec_t(16));
+    for (size_t s = 0; s < batch; s++) {
+      uniform_rand(in0[s].begin(), in0[s].end(), -1.0, 1.0);
+      uniform_rand(in1[s].begin(), in1[s].end(), -1.0, 1.0);
+      uniform_rand(grad[s].begin(), grad[s].end(), -1.0, 1.0);
+    }
+
+    std::vector<const tensor_t*> out;
+    cl.forward({in0, in1}, out);
+    auto in_grad = cl.backward({grad});
+
+    const tensor_t& x0 = *cl.inputs()[0]->get_data();
+    const tensor_t& x1 = *cl.inputs()[1]->get_data();
+    for (size_t s = 0; s < batch; s++) {
+      // the inputs are views of the output after the first pass
+      EXPECT_EQ(&x0[s][0], &(*out[0])[s][0]);
+      EXPECT_EQ(&x1[s][0], &(*out[0])[s][4]);
+      for (size_t j = 0; j < 4; j++) {
+        EXPECT_FLOAT_EQ(in0[s][j], (*out[0])[s][j]);
+        EXPECT_FLOAT_EQ(grad[s][j], in_grad[0][s][j]);
+      }
+      for (size_t j = 0; j < 12; j++) {
+        EXPECT_FLOAT_EQ(in1[s][j], (*out[0])[s][4 + j]);
+        EXPECT_FLOAT_EQ(grad[s][4 + j], in_grad[1][s][j]);
+      }
+    }
+  }
+}
+
 }  // namespace tiny_dnn
@@ -451,6 +451,169 @@ TEST(convolutional, bprop_avx_wstride) {
 
 #endif  // CNN_USE_AVX
 
+// run a batch through the internal engine and through the avx engine, which
+// lowers every kernel shape other than 5x5 to im2col + GEMM
+inline void check_conv_gemm(convolutional_layer &l, size_t batch) {
+  const size_t channels = l.in_channels();
+  std::vector<tensor_t> in(channels), grad_ref(channels), grad(channels);
+  for (size_t i = 0; i < channels; i++) {
+    in[i].resize(batch, vec_t(l.in_shape()[i].size()));
+    grad_ref[i].resize(batch, vec_t(l.in_shape()[i].size(), float_t{0}));
+    grad[i] = grad_ref[i];
+    randomize_tensor(in[i]);
+  }
+  tensor_t out_ref(batch, vec_t(l.out_shape()[0].size()));
+  tensor_t out(out_ref), delta(out_ref);
+  randomize_tensor(delta);
+
+  std::vector<tensor_t *> in_ptr, grad_ref_ptr, grad_ptr;
+  for (size_t i = 0; i < channels; i++) {
+    in_ptr.push_back(&in[i]);
+    grad_ref_ptr.push_back(&grad_ref[i]);
+    grad_ptr.push_back(&grad[i]);
+  }
+  std::vector<tensor_t *> out_ref_ptr = {&out_ref}, out_ptr = {&out};
+  std::vector<tensor_t *> delta_ptr   = {&delta};
+
+  l.set_sample_count(batch);
+  l.set_backend_type(core::backend_t::internal);
+  l.forward_propagation(in_ptr, out_ref_ptr);
+  l.back_propagation(in_ptr, out_ref_ptr, delta_ptr, grad_ref_ptr);
+
+  l.set_backend_type(core::backend_t::avx);
+  l.forward_propagation(in_ptr, out_ptr);
+  l.back_propagation(in_ptr, out_ptr, delta_ptr, grad_ptr);
+
+  for (size_t sample = 0; sample < batch; sample++) {
+    for (size_t i = 0; i < out[sample].size(); i++) {
+      EXPECT_NEAR(out_ref[sample][i], out[sample][i], 1E-4);
+    }
+    for (size_t i = 0; i < grad[0][sample].size(); i++) {
+      EXPECT_NEAR(grad_ref[0][sample][i], grad[0][sample][i], 1E-4);
+    }
+  }
+
+  // weight gradients may be accumulated into any sample, compare the sums
+  for (size_t ch = 1; ch < channels; ch++) {
+    vec_t sum_ref(grad[ch][0].size(), float_t{0}), sum(sum_ref);
+    for (size_t sample = 0; sample < batch; sample++) {
+      for (size_t i = 0; i < sum.size(); i++) {
+        sum_ref[i] += grad_ref[ch][sample][i];
+        sum[i] += grad[ch][sample][i];
+      }
+    }
+    for (size_t i = 0; i < sum.size(); i++) {
+      EXPECT_NEAR(sum_ref[i], sum[i], 1E-3);
+    }
+  }
+}
+
+TEST(convolutional, gemm_3x3) {
+  convolutional_layer l(9, 8, 3, 3, 7);
+  check_conv_gemm(l, 3);
+}
+
+TEST(convolutional, gemm_1x1) {
+  convolutional_layer l(6, 6, 1, 8, 20);
+  check_conv_gemm(l, 2);
+}
+
+TEST(convolutional, gemm_padding_and_stride) {
+  convolutional_layer l(11, 9, 3, 2, 4, padding::same, true, 2, 3);
+  check_conv_gemm(l, 4);
+}
+
+TEST(convolutional, gemm_rectangular_kernel) {
+  convolutional_layer l(10, 10, 3, 2, 3, 5, padding::valid, true, 1, 2);
+  check_conv_gemm(l, 1);
+}
+
+TEST(convolutional, gemm_grouped_table) {
+  // block-diagonal table, lowered to one GEMM per group
+  convolutional_layer l(8, 8, 3, 4, 6, core::connection_table(2, 4, 6));
+  check_conv_gemm(l, 2);
+}
+
+TEST(convolutional, gemm_sparse_table) {
+  // LeNet-like table without group structure
+  static const bool tbl[] = {true, false, true, true, true,  false,
+                             true, true,  true, true, false, false};
+  convolutional_layer l(7, 7, 3, 2, 6, core::connection_table(tbl, 2, 6));
+  check_conv_gemm(l, 3);
+}
+
+// forward a batch through the internal and the Winograd engine
+inline void check_conv_winograd(convolutional_layer &l, size_t batch) {
+  std::vector<tensor_t> in(l.in_channels());
+  std::vector<tensor_t *> in_ptr;
+  for (size_t i = 0; i < l.in_channels(); i++) {
+    in[i].resize(batch, vec_t(l.in_shape()[i].size()));
+    randomize_tensor(in[i]);
+    in_ptr.push_back(&in[i]);
+  }
+  tensor_t out_ref(batch, vec_t(l.out_shape()[0].size())), out(out_ref);
+  std::vector<tensor_t *> out_ref_ptr = {&out_ref}, out_ptr = {&out};
+
+  l.set_sample_count(batch);
+  l.set_backend_type(core::backend_t::internal);
+  l.forward_propagation(in_ptr, out_ref_ptr);
+  l.set_backend_type(core::backend_t::winograd);
+  l.forward_propagation(in_ptr, out_ptr);
+
+  for (size_t sample = 0; sample < batch; sample++) {
+    for (size_t i = 0; i < out[sample].size(); i++) {
+      EXPECT_NEAR(out_ref[sample][i], out[sample][i], 1E-4);
+    }
+  }
+}
+
+TEST(convolutional, winograd_default_engine) {
+  convolutional_layer l1(8, 8, 3, 2, 4);
+  EXPECT_EQ(l1.engine(), core::backend_t::winograd);
+
+  // strided and non-3x3 convolutions keep the default engine
+  convolutional_layer l2(8, 8, 3, 2, 4, padding::valid, true, 2, 2);
+  EXPECT_EQ(l2.engine(), core::default_engine());
+  convolutional_layer l3(8, 8, 5, 2, 4);
+  EXPECT_EQ(l3.engine(), core::default_engine());
+
+  // an explicitly requested engine is kept, even the default one
+  for (auto engine : {core::backend_t::internal, core::backend_t::avx,
+                      core::default_engine()}) {
+    convolutional_layer l4(8, 8, 3, 2, 4, padding::valid, true, 1, 1,
+                           engine);
+    EXPECT_EQ(l4.engine(), engine);
+  }
+}
+
+TEST(convolutional, winograd_f4) {
+  // 13x11 output, so the last 4x4 tiles are clipped
+  convolutional_layer l(15, 13, 3, 3, 5);
+  check_conv_winograd(l, 3);
+}
+
+TEST(convolutional, winograd_f2) {
+  convolutional_layer l(5, 4, 3, 4, 2, padding::same);
+  check_conv_winograd(l, 2);
+}
+
+TEST(convolutional, winograd_connection_table) {
+  static const bool tbl[] = {true, false, true, true, true,  false,
+                             true, true,  true, true, false, false};
+  convolutional_layer l(9, 9, 3, 2, 6, core::connection_table(tbl, 2, 6));
+  check_conv_winograd(l, 2);
+}
+
+TEST(convolutional, winograd_filter_cache) {
+  convolutional_layer l(8, 8, 3, 2, 3);
+  check_conv_winograd(l, 1);
+
+  // the transformed filters must follow weight updates
+  vec_t &w = *l.weights()[0];
+  for (auto &x : w) x *= float_t(-2);
+  check_conv_winograd(l, 1);
+}
+
 #ifdef CNN_USE_NNPACK
 TEST(convolutional, fprop_nnp) {
   convolutional_layer<sigmoid> l(5, 5, 3, 1, 2, padding::valid, true, 1, 1,
@@ -0,0 +1,306 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "test/testhelper.h"
+#include "tiny_dnn/tiny_dnn.h"
+
+namespace tiny_dnn {
+
+inline void write_big_endian(std::ofstream &ofs, uint32_t v) {
+  const char b[4] = {char(v >> 24), char(v >> 16), char(v >> 8), char(v)};
+  ofs.write(b, 4);
+}
+
+// n images of rows x cols pixels and their labels, in MNIST format
+inline void write_mnist_files(const std::string &image_file,
+                              const std::string &label_file,
+                              uint32_t n,
+                              uint32_t rows,
+                              uint32_t cols) {
+  std::ofstream images(image_file.c_str(), std::ios::binary);
+  write_big_endian(images, 0x00000803);
+  write_big_endian(images, n);
+  write_big_endian(images, rows);
+  write_big_endian(images, cols);
+  for (uint32_t i = 0; i < n * rows * cols; i++) {
+    images.put(char(i * 7 % 256));
+  }
+
+  std::ofstream labels(label_file.c_str(), std::ios::binary);
+  write_big_endian(labels, 0x00000801);
+  write_big_endian(labels, n);
+  for (uint32_t i = 0; i < n; i++) labels.put(char(i % 10));
+}
+
+inline void write_cifar10_file(const std::string &filename,
+                               int n,
+                               int first_label) {
+  std::ofstream ofs(filename.c_str(), std::ios::binary);
+  for (int i = 0; i < n; i++) {
+    ofs.put(char((first_label + i) % 10));
+    for (int j = 0; j < CIFAR10_IMAGE_SIZE; j++) {
+      ofs.put(char((i + j) * 13 % 256));
+    }
+  }
+}
+
+TEST(dataset, mnist_matches_parser) {
+  const std::string image_file = unique_path();
+  const std::string label_file = unique_path();
+  write_mnist_files(image_file, label_file, 5, 4, 3);
+
+  std::vector<vec_t> images;
+  std::vector<label_t> labels;
+  parse_mnist_images(image_file, &images, -1.0, 1.0, 2, 1);
+  parse_mnist_labels(label_file, &labels);
+
+  {
+    mnist_dataset ds(image_file, label_file, -1.0, 1.0, 2, 1);
+    ASSERT_EQ(images.size(), ds.size());
+    EXPECT_EQ(images[0].size(), ds.sample_size());
+
+    // decoded out of order
+    vec_t sample(ds.sample_size(), float_t(42));
+    for (size_t i = ds.size(); i-- > 0;) {
+      ds.sample(i, &sample[0]);
+      EXPECT_EQ(images[i], sample);
+      EXPECT_EQ(labels[i], ds.label(i));
+    }
+
+    const size_t indices[] = {3, 1};
+    std::vector<vec_t> batch;
+    std::vector<label_t> batch_labels;
+    ds.load(indices, 2, &batch, &batch_labels);
+    EXPECT_EQ(images[3], batch[0]);
+    EXPECT_EQ(images[1], batch[1]);
+    EXPECT_EQ(labels[3], batch_labels[0]);
+    EXPECT_EQ(labels[1], batch_labels[1]);
+  }
+
+  // labels of the wrong count
+  const std::string other_file = unique_path();
+  write_mnist_files(other_file, label_file, 4, 4, 3);
+  EXPECT_THROW(mnist_dataset(image_file, label_file, -1.0, 1.0, 0, 0),
+               nn_error);
+
+  std::remove(other_file.c_str());
+  std::remove(image_file.c_str());
+  std::remove(label_file.c_str());
+}
+
+TEST(dataset, cifar10_matches_parser) {
+  const std::string file1 = unique_path();
+  write_cifar10_file(file1, 3, 0);
+  const std::string file2 = unique_path();
+  write_cifar10_file(file2, 2, 3);
+
+  std::vector<vec_t> images;
+  std::vector<label_t> labels;
+  parse_cifar10(file1, &images, &labels, 0.0, 1.0, 1, 2);
+  parse_cifar10(file2, &images, &labels, 0.0, 1.0, 1, 2);
+
+  {
+    cifar10_dataset ds({file1, file2}, 0.0, 1.0, 1, 2);
+    ASSERT_EQ(size_t(5), ds.size());
+    EXPECT_EQ(images[0].size(), ds.sample_size());
+
+    vec_t sample(ds.sample_size());
+    for (size_t i = 0; i < ds.size(); i++) {
+      ds.sample(i, &sample[0]);
+      EXPECT_EQ(images[i], sample);
+      EXPECT_EQ(labels[i], ds.label(i));
+    }
+  }
+
+  std::remove(file1.c_str());
+  std::remove(file2.c_str());
+}
+
+TEST(dataset, train) {
+  const std::string image_file = unique_path();
+  const std::string label_file = unique_path();
+  write_mnist_files(image_file, label_file, 20, 4, 4);
+
+  {
+    mnist_dataset ds(image_file, label_file, -1.0, 1.0, 0, 0);
+    network<sequential> net;
+    net << layers::fc(16, 10) << activation::softmax();
+    adagrad opt;
+
+    int batches = 0, epochs = 0;
+    EXPECT_TRUE(net.train<cross_entropy>(opt, ds, 6, 2, [&]() { batches++; },
+                                         [&]() { epochs++; }));
+    EXPECT_EQ(8, batches);  // 4 mini-batches per epoch, the last of 2
+    EXPECT_EQ(2, epochs);
+
+    // input size mismatch
+    network<sequential> wrong;
+    wrong << layers::fc(15, 10);
+    EXPECT_THROW(wrong.train<mse>(opt, ds, 4, 1), nn_error);
+
+    // labels out of range
+    network<sequential> narrow;
+    narrow << layers::fc(16, 5);
+    EXPECT_THROW(narrow.train<mse>(opt, ds, 4, 1), nn_error);
+  }
+
+  std::remove(image_file.c_str());
+  std::remove(label_file.c_str());
+}
+
+// the samples of an epoch of batches, in the order they were delivered
+inline std::vector<vec_t> drain_epoch(data_pipeline &batches,
+                                      std::vector<label_t> *labels) {
+  std::vector<vec_t> samples;
+  batches.start_epoch();
+  while (const sample_batch *b = batches.next()) {
+    EXPECT_LE(b->inputs.size(), batches.batch_size());
+    for (size_t i = 0; i < b->inputs.size(); i++) {
+      samples.push_back(b->inputs[i][0]);
+      labels->push_back(b->labels[i]);
+    }
+  }
+  return samples;
+}
+
+TEST(data_pipeline, epochs) {
+  const std::string image_file = unique_path();
+  const std::string label_file = unique_path();
+  write_mnist_files(image_file, label_file, 23, 4, 4);
+
+  {
+    mnist_dataset ds(image_file, label_file, 0.0, 1.0, 0, 0);
+    vec_t mean(1, float_t(0.5));
+
+    std::vector<std::vector<vec_t>> results;
+    for (size_t workers : {0, 1, 3}) {
+      data_pipeline batches(ds, 5, workers, 2);
+      batches.add_transform(transforms::subtract_mean(mean));
+      batches.add_transform(transforms::corrupt(0.25, -1.0));
+
+      set_random_seed(7);
+      std::vector<label_t> labels;
+      std::vector<vec_t> first = drain_epoch(batches, &labels);
+      std::vector<vec_t> second = drain_epoch(batches, &labels);
+      ASSERT_EQ(ds.size(), first.size());
+      ASSERT_EQ(ds.size(), second.size());
+      EXPECT_NE(first, second);
+
+      // every sample once per epoch, with its label
+      std::vector<bool> seen(ds.size());
+      vec_t sample(ds.sample_size());
+      for (size_t i = 0; i < first.size(); i++) {
+        bool found = false;
+        for (size_t j = 0; j < ds.size() && !found; j++) {
+          ds.sample(j, &sample[0]);
+          bool match = ds.label(j) == labels[i];
+          for (size_t k = 0; k < sample.size() && match; k++) {
+            match = first[i][k] == float_t(-1) ||
+                    first[i][k] == sample[k] - mean[0];
+          }
+          if (match && !seen[j]) seen[j] = found = true;
+        }
+        EXPECT_TRUE(found);
+      }
+      results.push_back(first);
+    }
+    // the same batches regardless of the number of workers
+    EXPECT_EQ(results[0], results[1]);
+    EXPECT_EQ(results[0], results[2]);
+  }
+
+  std::remove(image_file.c_str());
+  std::remove(label_file.c_str());
+}
+
+TEST(data_pipeline, restart_and_errors) {
+  const std::string image_file = unique_path();
+  const std::string label_file = unique_path();
+  write_mnist_files(image_file, label_file, 30, 2, 2);
+
+  {
+    mnist_dataset ds(image_file, label_file, 0.0, 1.0, 0, 0);
+    data_pipeline batches(ds, 4, 2, 3);
+    batches.set_shuffle(false);
+    EXPECT_THROW(batches.next(), nn_error);
+
+    // abandon an epoch half way
+    batches.start_epoch();
+    ASSERT_NE(nullptr, batches.next());
+    ASSERT_NE(nullptr, batches.next());
+    batches.start_epoch();
+    size_t count = 0;
+    while (const sample_batch *b = batches.next()) {
+      for (size_t i = 0; i < b->labels.size(); i++) {
+        EXPECT_EQ(ds.label(count++), b->labels[i]);
+      }
+    }
+    EXPECT_EQ(ds.size(), count);
+    EXPECT_THROW(batches.add_transform(transforms::corrupt(0.1, 0.0)),
+                 nn_error);
+
+    data_pipeline failing(ds, 4, 2);
+    failing.add_transform(transforms::subtract_mean(vec_t(3)));
+    failing.start_epoch();
+    EXPECT_THROW(failing.next(), nn_error);
+    EXPECT_THROW(failing.next(), nn_error);
+  }
+
+  std::remove(image_file.c_str());
+  std::remove(label_file.c_str());
+}
+
+#ifdef DNN_USE_IMAGE_API
+TEST(data_pipeline, resize) {
+  std::mt19937 rng;
+  vec_t sample(4 * 4 * 2);
+  for (size_t i = 0; i < sample.size(); i++) sample[i] = i < 16 ? 0.25 : 0.75;
+  transforms::resize(shape3d(4, 4, 2), 2, 3)(sample, rng);
+  ASSERT_EQ(size_t(2 * 3 * 2), sample.size());
+  for (size_t i = 0; i < sample.size(); i++) {
+    EXPECT_NEAR(i < 6 ? 0.25 : 0.75, sample[i], 1e-5);
+  }
+  EXPECT_THROW(transforms::resize(shape3d(3, 3, 1), 2, 2)(sample, rng),
+               nn_error);
+}
+#endif  // DNN_USE_IMAGE_API
+
+TEST(data_pipeline, train) {
+  const std::string image_file = unique_path();
+  const std::string label_file = unique_path();
+  write_mnist_files(image_file, label_file, 20, 4, 4);
+
+  {
+    mnist_dataset ds(image_file, label_file, -1.0, 1.0, 0, 0);
+    data_pipeline batches(ds, 8, 2);
+    batches.add_transform(transforms::corrupt(0.1, -1.0));
+
+    network<sequential> net;
+    net << layers::fc(16, 10) << activation::softmax();
+    adagrad opt;
+
+    int batch_count = 0;
+    EXPECT_TRUE(net.train<cross_entropy>(
+      opt, batches, 3, [&]() { batch_count++; }, []() {}));
+    EXPECT_EQ(9, batch_count);
+  }
+
+  std::remove(image_file.c_str());
+  std::remove(label_file.c_str());
+}
+
+}  // namespace tiny_dnn
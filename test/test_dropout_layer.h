@@ -10,6 +10,7 @@
 #include <gtest/gtest.h>
 
 #include <deque>
+#include <numeric>
 #include <vector>
 
 #include "test/testhelper.h"
@@ -33,15 +34,102 @@ TEST(dropout, randomized) {
   // mask should change for each fprop
   EXPECT_TRUE(is_different_container(mask1, mask2));
 
-  // dropout-rate should be around 0.1
+  // the fraction of dropped units should be around 0.1
   double margin_factor = 0.9;
-  int64_t num_on1      = std::count(mask1.begin(), mask1.end(), 1);
-  int64_t num_on2      = std::count(mask2.begin(), mask2.end(), 1);
+  int64_t num_off1     = std::count(mask1.begin(), mask1.end(), 0);
+  int64_t num_off2     = std::count(mask2.begin(), mask2.end(), 0);
 
-  EXPECT_LE(num_units * dropout_rate * margin_factor, num_on1);
-  EXPECT_GE(num_units * dropout_rate / margin_factor, num_on1);
-  EXPECT_LE(num_units * dropout_rate * margin_factor, num_on2);
-  EXPECT_GE(num_units * dropout_rate / margin_factor, num_on2);
+  EXPECT_LE(num_units * dropout_rate * margin_factor, num_off1);
+  EXPECT_GE(num_units * dropout_rate / margin_factor, num_off1);
+  EXPECT_LE(num_units * dropout_rate * margin_factor, num_off2);
+  EXPECT_GE(num_units * dropout_rate / margin_factor, num_off2);
+}
+
+TEST(dropout, keeps_expected_value) {
+  const size_t num_units = 20000;
+  vec_t v(num_units);
+  uniform_rand(v.begin(), v.end(), 0.5, 1.5);
+  const double in_mean = std::accumulate(v.begin(), v.end(), 0.0) / num_units;
+
+  for (float_t rate : {float_t(0), float_t(0.2), float_t(0.7)}) {
+    dropout_layer l(num_units, rate, net_phase::train);
+    std::vector<const tensor_t*> out;
+    l.forward({{v}}, out);
+
+    // units are kept with probability 1 - rate and scaled by 1 / (1 - rate)
+    const auto mask  = l.get_mask(0);
+    const double kept =
+      double(std::count(mask.begin(), mask.end(), 1)) / num_units;
+    EXPECT_NEAR(1.0 - rate, kept, 0.015);
+
+    const vec_t &y = (*out[0])[0];
+    const double out_mean =
+      std::accumulate(y.begin(), y.end(), 0.0) / num_units;
+    EXPECT_NEAR(in_mean, out_mean, in_mean * 0.05);
+  }
+}
+
+TEST(dropout, reproducible_masks) {
+  const size_t num_units = 300, batch = 250;
+  tensor_t in(batch, vec_t(num_units, 1.0));
+
+  // the same seed gives the same masks, with or without threads
+  set_random_seed(11);
+  dropout_layer l1(num_units, 0.3, net_phase::train);
+  set_random_seed(11);
+  dropout_layer l2(num_units, 0.3, net_phase::train);
+  l2.set_parallelize(false);
+
+  for (int pass = 0; pass < 2; pass++) {
+    std::vector<const tensor_t*> out1, out2;
+    l1.forward({in}, out1);
+    l2.forward({in}, out2);
+    for (size_t s = 0; s < batch; s++) {
+      EXPECT_EQ(l1.get_mask(s), l2.get_mask(s));
+      if (s > 0) {
+        EXPECT_TRUE(is_different_container(l1.get_mask(0), l1.get_mask(s)));
+      }
+    }
+  }
+}
+
+TEST(dropout, applies_mask) {
+  const size_t num_units = 77, batch = 3;
+  const float_t rate = 0.4, scale = float_t(1) / (float_t(1) - rate);
+  std::vector<core::backend_t> backends = {core::backend_t::internal};
+#ifdef CNN_USE_AVX
+  backends.push_back(core::backend_t::avx);
+#endif
+
+  tensor_t in(batch, vec_t(num_units)), out_grad(batch, vec_t(num_units));
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+  for (auto &v : out_grad) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+
+  for (auto backend : backends) {
+    dropout_layer l(num_units, rate, net_phase::train);
+    l.set_backend_type(backend);
+
+    // kept units are scaled on the way forward and back, others are zero
+    std::vector<const tensor_t*> out;
+    l.forward({in}, out);
+    tensor_t in_grad = l.backward(std::vector<tensor_t>{out_grad})[0];
+    for (size_t s = 0; s < batch; s++) {
+      const std::vector<uint8_t> mask = l.get_mask(s);
+      for (size_t i = 0; i < num_units; i++) {
+        EXPECT_FLOAT_EQ(mask[i] ? in[s][i] * scale : 0, (*out[0])[s][i]);
+        EXPECT_FLOAT_EQ(mask[i] ? out_grad[s][i] * scale : 0, in_grad[s][i]);
+      }
+    }
+
+    // out of training, the layer passes everything through
+    l.set_context(net_phase::test);
+    l.forward({in}, out);
+    in_grad = l.backward(std::vector<tensor_t>{out_grad})[0];
+    for (size_t s = 0; s < batch; s++) {
+      EXPECT_EQ(in[s], (*out[0])[s]);
+      EXPECT_EQ(out_grad[s], in_grad[s]);
+    }
+  }
 }
 
 TEST(dropout, read_write) {
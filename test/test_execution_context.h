@@ -0,0 +1,141 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "test/testhelper.h"
+#include "tiny_dnn/tiny_dnn.h"
+
+namespace tiny_dnn {
+
+inline void make_context_test_model(network<sequential> &net) {
+  // 3x3 stride-1 convolution runs on the Winograd engine
+  net << convolutional_layer(8, 8, 3, 2, 4, padding::same) << relu()
+      << batch_normalization_layer(8 * 8, 4) << max_pooling_layer(8, 8, 4, 2)
+      << fully_connected_layer(4 * 4 * 4, 5) << softmax();
+  net.init_weight();
+  net.set_netphase(net_phase::test);
+}
+
+inline std::vector<vec_t> make_context_test_data(size_t count) {
+  std::vector<vec_t> in(count, vec_t(8 * 8 * 2));
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+  return in;
+}
+
+TEST(execution_context, predict) {
+  network<sequential> model;
+  make_context_test_model(model);
+  const auto in = make_context_test_data(10);
+
+  execution_context<sequential> ctx(model);
+  for (const auto &x : in) {
+    const vec_t expected = model.predict(x);
+    const vec_t actual   = ctx.predict(x);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_FLOAT_EQ(expected[i], actual[i]);
+    }
+    EXPECT_EQ(model.predict_label(x), ctx.predict_label(x));
+  }
+}
+
+TEST(execution_context, shares_weights) {
+  network<sequential> model;
+  make_context_test_model(model);
+  const auto in = make_context_test_data(1);
+
+  execution_context<sequential> ctx(model);
+  ctx.predict(in[0]);
+
+  // updates of the model are visible to the context, which does not hold
+  // a copy of the weights (nor of the cached Winograd transform)
+  for (size_t i = 0; i < model.depth(); i++) {
+    for (auto w : model[i]->weights()) {
+      for (auto &x : *w) x *= float_t(0.5);
+    }
+  }
+  const vec_t expected = model.predict(in[0]);
+  const vec_t actual   = ctx.predict(in[0]);
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_FLOAT_EQ(expected[i], actual[i]);
+  }
+}
+
+TEST(execution_context, concurrent_predict) {
+  network<sequential> model;
+  make_context_test_model(model);
+  const auto in = make_context_test_data(40);
+
+  std::vector<vec_t> expected;
+  for (const auto &x : in) expected.push_back(model.predict(x));
+
+  // the contexts share the thread pool for the work inside each layer
+  thread_pool::get_instance().set_num_threads(4);
+
+  const size_t num_threads = 4;
+  std::vector<std::vector<vec_t>> results(num_threads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      execution_context<sequential> ctx(model);
+      for (int iter = 0; iter < 3; iter++) {
+        results[t].clear();
+        for (const auto &x : in) results[t].push_back(ctx.predict(x));
+      }
+    });
+  }
+  for (auto &th : threads) th.join();
+  thread_pool::get_instance().set_num_threads(0);
+
+  for (size_t t = 0; t < num_threads; t++) {
+    ASSERT_EQ(results[t].size(), in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+      for (size_t j = 0; j < expected[i].size(); j++) {
+        EXPECT_FLOAT_EQ(expected[i][j], results[t][i][j]);
+      }
+    }
+  }
+}
+
+TEST(execution_context, graph) {
+  auto in  = std::make_shared<input_layer>(shape3d(4, 1, 1));
+  auto fc0 = std::make_shared<fully_connected_layer>(4, 6);
+  auto fc1 = std::make_shared<fully_connected_layer>(4, 6);
+  auto add = std::make_shared<elementwise_add_layer>(2, 6);
+  auto out = std::make_shared<tanh_layer>(6);
+  in << fc0;
+  in << fc1;
+  (fc0, fc1) << add << out;
+
+  network<graph> model;
+  construct_graph(model, {in}, {out});
+  model.init_weight();
+
+  execution_context<graph> ctx(model);
+  const vec_t x        = {1, -2, 3, 0.5};
+  const vec_t expected = model.predict(x);
+  const vec_t actual   = ctx.predict(x);
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_FLOAT_EQ(expected[i], actual[i]);
+  }
+}
+
+TEST(execution_context, share_weights_mismatch) {
+  fully_connected_layer a(4, 6), b(4, 7);
+  tanh_layer c(6);
+  EXPECT_THROW(b.share_weights(a), nn_error);
+  EXPECT_THROW(c.share_weights(a), nn_error);
+}
+
+}  // namespace tiny_dnn
@@ -104,4 +104,76 @@ TEST(fully_connected, forward_nobias) {
   }
 }
 
+#ifdef CNN_USE_AVX
+inline void check_fully_connected_avx(fully_connected_layer &l, size_t batch) {
+  const size_t channels = l.in_channels();
+  std::vector<tensor_t> in(channels), grad_ref(channels), grad(channels);
+  for (size_t i = 0; i < channels; i++) {
+    in[i].resize(batch, vec_t(l.in_shape()[i].size()));
+    grad_ref[i].resize(batch, vec_t(l.in_shape()[i].size(), float_t{0}));
+    grad[i] = grad_ref[i];
+    for (auto &v : in[i]) uniform_rand(v.begin(), v.end(), -1.0f, 1.0f);
+  }
+  tensor_t out_ref(batch, vec_t(l.out_shape()[0].size()));
+  tensor_t out(out_ref), delta(out_ref);
+  for (auto &v : delta) uniform_rand(v.begin(), v.end(), -1.0f, 1.0f);
+
+  std::vector<tensor_t *> in_ptr, grad_ref_ptr, grad_ptr;
+  for (size_t i = 0; i < channels; i++) {
+    in_ptr.push_back(&in[i]);
+    grad_ref_ptr.push_back(&grad_ref[i]);
+    grad_ptr.push_back(&grad[i]);
+  }
+  std::vector<tensor_t *> out_ref_ptr = {&out_ref}, out_ptr = {&out};
+  std::vector<tensor_t *> delta_ptr   = {&delta};
+
+  l.set_sample_count(batch);
+  l.set_backend_type(core::backend_t::internal);
+  l.forward_propagation(in_ptr, out_ref_ptr);
+  l.back_propagation(in_ptr, out_ref_ptr, delta_ptr, grad_ref_ptr);
+
+  l.set_backend_type(core::backend_t::avx);
+  l.forward_propagation(in_ptr, out_ptr);
+  l.back_propagation(in_ptr, out_ptr, delta_ptr, grad_ptr);
+
+  for (size_t sample = 0; sample < batch; sample++) {
+    for (size_t i = 0; i < out[sample].size(); i++) {
+      EXPECT_NEAR(out_ref[sample][i], out[sample][i], 1E-4);
+    }
+    for (size_t i = 0; i < grad[0][sample].size(); i++) {
+      EXPECT_NEAR(grad_ref[0][sample][i], grad[0][sample][i], 1E-4);
+    }
+  }
+
+  // weight gradients may be accumulated into any sample, compare the sums
+  for (size_t ch = 1; ch < channels; ch++) {
+    vec_t sum_ref(grad[ch][0].size(), float_t{0}), sum(sum_ref);
+    for (size_t sample = 0; sample < batch; sample++) {
+      for (size_t i = 0; i < sum.size(); i++) {
+        sum_ref[i] += grad_ref[ch][sample][i];
+        sum[i] += grad[ch][sample][i];
+      }
+    }
+    for (size_t i = 0; i < sum.size(); i++) {
+      EXPECT_NEAR(sum_ref[i], sum[i], 1E-3);
+    }
+  }
+}
+
+TEST(fully_connected, avx_single_sample) {
+  fully_connected_layer l(37, 21);
+  check_fully_connected_avx(l, 1);
+}
+
+TEST(fully_connected, avx_batched_gemm) {
+  fully_connected_layer l(70, 45);
+  check_fully_connected_avx(l, 13);
+}
+
+TEST(fully_connected, avx_batched_gemm_nobias) {
+  fully_connected_layer l(33, 130, false);
+  check_fully_connected_avx(l, 8);
+}
+#endif  // CNN_USE_AVX
+
 }  // namespace tiny_dnn
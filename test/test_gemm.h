@@ -0,0 +1,92 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <vector>
+
+#include "test/testhelper.h"
+#include "tiny_dnn/tiny_dnn.h"
+
+namespace tiny_dnn {
+
+// C = alpha * op(A) * op(B) + beta * C, computed naively
+inline void gemm_reference(bool trans_a,
+                           bool trans_b,
+                           size_t m,
+                           size_t n,
+                           size_t k,
+                           float_t alpha,
+                           const vec_t &a,
+                           size_t lda,
+                           const vec_t &b,
+                           size_t ldb,
+                           float_t beta,
+                           vec_t &c,
+                           size_t ldc) {
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < n; j++) {
+      float_t sum{0};
+      for (size_t p = 0; p < k; p++) {
+        float_t av = trans_a ? a[p * lda + i] : a[i * lda + p];
+        float_t bv = trans_b ? b[j * ldb + p] : b[p * ldb + j];
+        sum += av * bv;
+      }
+      c[i * ldc + j] = alpha * sum + beta * c[i * ldc + j];
+    }
+  }
+}
+
+TEST(gemm, against_reference) {
+  // sizes straddle the register tile (6x16) and the cache blocks, and
+  // cover matrix-vector products
+  const size_t shapes[][3] = {
+    {1, 1, 1},      {5, 17, 3},   {6, 16, 8}, {13, 35, 300},
+    {100, 300, 20}, {1, 300, 40}, {70, 1, 33}};
+
+  for (auto &shape : shapes) {
+    const size_t m = shape[0], n = shape[1], k = shape[2];
+    for (int trans = 0; trans < 4; trans++) {
+      const bool ta = (trans & 1) != 0;
+      const bool tb = (trans & 2) != 0;
+      // leading dimensions larger than the matrices
+      const size_t lda = (ta ? m : k) + 3;
+      const size_t ldb = (tb ? k : n) + 1;
+      const size_t ldc = n + 2;
+
+      vec_t a((ta ? k : m) * lda), b((tb ? n : k) * ldb), c(m * ldc);
+      uniform_rand(a.begin(), a.end(), -1.0, 1.0);
+      uniform_rand(b.begin(), b.end(), -1.0, 1.0);
+      uniform_rand(c.begin(), c.end(), -1.0, 1.0);
+      vec_t expected = c;
+
+      gemm_reference(ta, tb, m, n, k, float_t(0.5), a, lda, b, ldb,
+                     float_t(2), expected, ldc);
+      kernels::gemm(ta, tb, m, n, k, float_t(0.5), &a[0], lda, &b[0], ldb,
+                    float_t(2), &c[0], ldc);
+
+      for (size_t i = 0; i < c.size(); i++) {
+        EXPECT_NEAR(expected[i], c[i], 1E-4);
+      }
+    }
+  }
+}
+
+TEST(gemm, beta_zero_overwrites) {
+  vec_t a = {1, 2, 3, 4}, b = {1, 0, 0, 1};
+  vec_t c(4, std::numeric_limits<float_t>::quiet_NaN());
+
+  kernels::gemm(false, false, 2, 2, 2, float_t(1), &a[0], 2, &b[0], 2,
+                float_t(0), &c[0], 2);
+
+  for (size_t i = 0; i < 4; i++) EXPECT_FLOAT_EQ(a[i], c[i]);
+}
+
+}  // namespace tiny_dnn
@@ -9,6 +9,8 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -285,6 +287,68 @@ TEST(max_pool, backward) {
   }
 }
 
+TEST(max_pool, strided_windows) {
+  const size_t w = 37, h = 23, depth = 3, n = 2;
+  // {pool size, stride}, with overlapping and clipped windows
+  const size_t cases[][2] = {{2, 2}, {3, 2}, {3, 1}, {4, 3}};
+  std::vector<core::backend_t> backends = {core::backend_t::internal};
+#ifdef CNN_USE_AVX
+  backends.push_back(core::backend_t::avx);
+#endif
+
+  // small integers, so that windows hold ties
+  tensor_t in(n, vec_t(w * h * depth)), out_grad;
+  for (auto &v : in) {
+    for (auto &x : v) x = float_t(uniform_idx(vec_t(10)));
+  }
+
+  for (auto pad : {padding::valid, padding::same}) {
+    for (const auto &c : cases) {
+      const size_t pool = c[0], stride = c[1];
+      for (auto backend : backends) {
+        max_pooling_layer l(w, h, depth, pool, pool, stride, stride, pad,
+                            backend);
+        const shape3d os = l.out_shape()[0];
+        out_grad.assign(n, vec_t(os.size()));
+        for (auto &v : out_grad) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+
+        std::vector<const tensor_t *> out;
+        l.forward({in}, out);
+        tensor_t in_grad = l.backward(std::vector<tensor_t>{out_grad})[0];
+
+        // the first maximum of each clipped window gets the gradient
+        for (size_t s = 0; s < n; s++) {
+          vec_t expected_grad(in[s].size());
+          for (size_t d = 0; d < depth; d++) {
+            for (size_t oy = 0; oy < os.height_; oy++) {
+              for (size_t ox = 0; ox < os.width_; ox++) {
+                const size_t x0 = ox * stride, y0 = oy * stride;
+                size_t argmax   = 0;
+                float_t max     = std::numeric_limits<float_t>::lowest();
+                for (size_t y = y0; y < std::min(h, y0 + pool); y++) {
+                  for (size_t x = x0; x < std::min(w, x0 + pool); x++) {
+                    const size_t i = (d * h + y) * w + x;
+                    if (in[s][i] > max) {
+                      max    = in[s][i];
+                      argmax = i;
+                    }
+                  }
+                }
+                const size_t o = os.get_index(ox, oy, d);
+                EXPECT_EQ(max, (*out[0])[s][o]);
+                expected_grad[argmax] += out_grad[s][o];
+              }
+            }
+          }
+          for (size_t i = 0; i < expected_grad.size(); i++) {
+            EXPECT_NEAR(expected_grad[i], in_grad[s][i], 1e-5);
+          }
+        }
+      }
+    }
+  }
+}
+
 #ifndef CNN_NO_SERIALIZATION
 TEST(max_pool, serialization) {
   max_pooling_layer src(4, 4, 1, 2);
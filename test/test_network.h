@@ -352,8 +352,74 @@ TEST(network, test) {
   }
 }
 
+TEST(network, predict_batch) {
+  network<sequential> net;
+  net << fully_connected_layer(10, 20) << tanh_layer()
+      << fully_connected_layer(20, 3) << softmax();
+  net.init_weight();
+
+  std::vector<vec_t> in(50, vec_t(10));
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+
+  std::vector<vec_t> expected;
+  for (auto &v : in) expected.push_back(net.predict(v));
+
+  for (size_t batch_size : {1u, 7u, 50u, 64u}) {
+    auto out = net.predict_batch(in, batch_size);
+    ASSERT_EQ(out.size(), in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+      for (size_t j = 0; j < 3; j++) {
+        EXPECT_NEAR(out[i][j], expected[i][j], 1e-6);
+      }
+    }
+
+    // samples are passed to the callback in order, one batch at a time
+    size_t next = 0;
+    net.predict_batch(&in[0], in.size(),
+                      [&](size_t first, const tensor_t &y) {
+                        EXPECT_EQ(first, next);
+                        EXPECT_LE(y.size(), batch_size);
+                        next += y.size();
+                      },
+                      batch_size);
+    EXPECT_EQ(next, in.size());
+  }
+
+  EXPECT_TRUE(net.predict_batch(std::vector<vec_t>()).empty());
+  EXPECT_THROW(net.predict_batch({vec_t(9)}), nn_error);
+}
+
 TEST(network, get_loss) {
-  // TODO(nyanp): add unit-test for public api
+  network<sequential> net;
+  net << fully_connected_layer(4, 6) << sigmoid()
+      << fully_connected_layer(6, 2);
+  net.init_weight();
+
+  std::vector<vec_t> in(300, vec_t(4)), t(300, vec_t(2));
+  std::vector<label_t> labels(300);
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i].begin(), in[i].end(), -1.0, 1.0);
+    uniform_rand(t[i].begin(), t[i].end(), -1.0, 1.0);
+    labels[i] = i % 2;
+  }
+
+  float_t expected = 0;
+  size_t success   = 0;
+  for (size_t i = 0; i < in.size(); i++) {
+    const vec_t y = net.predict(in[i]);
+    expected += mse::f(y, t[i]);
+    if (max_index(y) == labels[i]) success++;
+  }
+
+  EXPECT_NEAR(net.get_loss<mse>(in, t), expected, 1e-4);
+
+  std::vector<tensor_t> t_tensor;
+  for (auto &v : t) t_tensor.push_back(tensor_t{v});
+  EXPECT_NEAR(net.get_loss<mse>(in, t_tensor), expected, 1e-4);
+
+  result res = net.test(in, labels);
+  EXPECT_EQ(res.num_total, 300);
+  EXPECT_EQ(res.num_success, static_cast<int>(success));
 }
 
 TEST(network, at) {
@@ -627,6 +693,119 @@ TEST(network, gradient_check11) {  // softsign - mse
 
 #ifndef CNN_NO_SERIALIZATION
 
+TEST(network, gradient_check_per_thread) {  // sigmoid - cross-entropy
+  using loss_func  = cross_entropy;
+  using activation = sigmoid;
+  using network    = network<sequential>;
+
+  network nn;
+  nn << fully_connected_layer(10, 14 * 14 * 3) << activation()
+     << convolutional_layer(14, 14, 5, 3, 6) << activation()
+     << average_pooling_layer(10, 10, 6, 2) << activation()
+     << fully_connected_layer(5 * 5 * 6, 3) << activation();
+  nn.set_grad_accumulation(grad_accumulation::per_thread);
+
+  const auto test_data = generate_gradient_check_data(nn.in_data_size());
+  nn.init_weight();
+  EXPECT_TRUE(nn.gradient_check<loss_func>(
+    test_data.first, test_data.second, epsilon<float_t>(), GRAD_CHECK_RANDOM));
+}
+
+TEST(network, grad_accumulation) {
+  std::vector<vec_t> data;
+  std::vector<label_t> label;
+  for (size_t i = 0; i < 32; i++) {
+    vec_t in(2 * 6 * 6);
+    uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+    data.push_back(in);
+    label.push_back(i % 3);
+  }
+
+  auto train = [&](network<sequential> &net, grad_accumulation mode) {
+    net << convolutional_layer(6, 6, 3, 2, 4) << relu()
+        << average_pooling_layer(4, 4, 4, 2) << relu()
+        << fully_connected_layer(2 * 2 * 4, 3) << softmax();
+    net.set_grad_accumulation(mode);
+    set_random_seed(0);
+    net.init_weight();
+
+    gradient_descent opt;
+    net.train<cross_entropy>(opt, data, label, 16, 2);
+  };
+
+  network<sequential> per_sample, per_thread;
+  train(per_sample, grad_accumulation::per_sample);
+  thread_pool::get_instance().set_num_threads(4);
+  train(per_thread, grad_accumulation::per_thread);
+
+  // the weight gradients hold one partial sum per thread
+  EXPECT_EQ(per_sample[0]->weights_grads()[0]->size(), 16u);
+  EXPECT_EQ(per_thread[0]->weights_grads()[0]->size(),
+            std::min(size_t(16), parallel_concurrency()));
+  thread_pool::get_instance().set_num_threads(0);
+
+  for (size_t i = 0; i < per_sample.depth(); i++) {
+    auto w0 = per_sample[i]->weights();
+    auto w1 = per_thread[i]->weights();
+    ASSERT_EQ(w0.size(), w1.size());
+    for (size_t j = 0; j < w0.size(); j++) {
+      for (size_t k = 0; k < w0[j]->size(); k++) {
+        EXPECT_NEAR((*w0[j])[k], (*w1[j])[k], 1e-5);
+      }
+    }
+  }
+}
+
+#ifndef CNN_NO_SERIALIZATION
+TEST(network, data_parallelism) {
+  std::vector<vec_t> data;
+  std::vector<label_t> label;
+  for (size_t i = 0; i < 48; i++) {
+    vec_t in(2 * 6 * 6);
+    uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+    data.push_back(in);
+    label.push_back(i % 3);
+  }
+
+  auto train = [&](network<sequential> &net, size_t replicas, int threads) {
+    set_random_seed(0);
+    net << convolutional_layer(6, 6, 3, 2, 4) << relu()
+        << average_pooling_layer(4, 4, 4, 2) << relu()
+        << dropout_layer(2 * 2 * 4, 0.25)
+        << fully_connected_layer(2 * 2 * 4, 3) << softmax();
+    net.set_data_parallelism(replicas);
+    net.init_weight();
+
+    adam opt;
+    auto nop = []() {};
+    net.train<cross_entropy>(opt, data, label, 16, 2, nop, nop, false,
+                             threads);
+    // again, on the replicas of the first call
+    net.train<cross_entropy>(opt, data, label, 16, 1, nop, nop, false,
+                             threads);
+  };
+
+  network<sequential> single, sharded, one_task;
+  train(single, 1, CNN_TASK_SIZE);
+  train(sharded, 3, CNN_TASK_SIZE);  // shards of 5, 5 and 6 samples
+  train(one_task, 3, 1);             // a single task trains unsharded
+  EXPECT_EQ(3u, sharded.data_parallelism());
+  EXPECT_TRUE(one_task.has_same_weights(single, 0));
+
+  for (size_t i = 0; i < single.depth(); i++) {
+    auto w0 = single[i]->weights();
+    auto w1 = sharded[i]->weights();
+    ASSERT_EQ(w0.size(), w1.size());
+    for (size_t j = 0; j < w0.size(); j++) {
+      for (size_t k = 0; k < w0[j]->size(); k++) {
+        EXPECT_NEAR((*w0[j])[k], (*w1[j])[k], 1e-4);
+      }
+    }
+  }
+  EXPECT_THROW(sharded.set_data_parallelism(0), nn_error);
+}
+#endif  // CNN_NO_SERIALIZATION
+
 TEST(network, read_write) {
   using loss_func = mse;
   using network   = network<sequential>;
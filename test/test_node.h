@@ -170,4 +170,130 @@ TEST(layer_tuple, chain_operator_layer_tuple2) {
   EXPECT_EQ(slice->next_nodes()[1], relu.get());
   EXPECT_EQ(slice->next_nodes()[2], elu.get());
 }
+
+TEST(edge, batch_view_roundtrip) {
+  edge e(nullptr, shape3d(3, 1, 1), vector_type::data);
+  tensor_t &t = *e.get_data();
+  t           = tensor_t{{1, 2, 3}, {4, 5, 6}};
+
+  batch_view<float_t> v = e.batch_data();
+  ASSERT_EQ(v.sample_count(), 2u);
+  ASSERT_EQ(v.sample_size(), 3u);
+  EXPECT_TRUE(v.contiguous());
+  EXPECT_EQ(v[1], v[0] + 3);
+  EXPECT_FLOAT_EQ(v[1][2], float_t{6});
+
+  // writes through the view are visible in the tensor_t representation
+  v[0][1] = float_t{-1};
+  EXPECT_FLOAT_EQ((*e.get_data())[0][1], float_t{-1});
+  EXPECT_FLOAT_EQ((*e.get_data())[1][0], float_t{4});
+}
+
+TEST(edge, contiguous_resize_and_clear) {
+  edge e(nullptr, shape3d(2, 1, 1), vector_type::data);
+  batch_view<float_t> g = e.reset_batch_gradient(4);
+  for (size_t i = 0; i < g.size(); i++) g.data()[i] = float_t(i + 1);
+
+  e.resize_gradient(2);
+  EXPECT_EQ(e.batch_gradient().sample_count(), 2u);
+
+  vec_t merged;
+  e.merge_grads(&merged);
+  EXPECT_FLOAT_EQ(merged[0], float_t(1 + 3) / 2);
+  EXPECT_FLOAT_EQ(merged[1], float_t(2 + 4) / 2);
+
+  e.clear_grads();
+  for (auto &g : *e.get_gradient()) {
+    for (auto x : g) EXPECT_FLOAT_EQ(x, float_t{0});
+  }
+}
+
+TEST(edge, contiguous_rows_alias_buffer) {
+  edge e(nullptr, shape3d(3, 1, 1), vector_type::data);
+  *e.get_data() = tensor_t{{1, 2, 3}, {4, 5, 6}};
+  e.set_storage(edge_storage::contiguous);
+
+  batch_view<float_t> v = as_batch_view(*e.get_data());
+  ASSERT_FALSE(v.empty());
+  EXPECT_TRUE(v.contiguous());
+  EXPECT_EQ(v.data(), e.batch_data().data());
+  EXPECT_FLOAT_EQ(v[1][0], float_t{4});
+
+  // growing the batch keeps the samples and lays the new ones out behind
+  e.resize_data(5);
+  const tensor_t &t = *e.get_data();
+  ASSERT_EQ(t.size(), 5u);
+  EXPECT_EQ(&t[4][0], &t[0][0] + 4 * 3);
+  EXPECT_FLOAT_EQ(t[1][2], float_t{6});
+  EXPECT_FLOAT_EQ(t[4][0], float_t{0});
+  EXPECT_EQ(&t[0][0], e.batch_data().data());
+
+  // per-sample storage gives every sample memory of its own again
+  e.set_storage(edge_storage::per_sample);
+  for (auto &row : *e.get_data()) {
+    EXPECT_FALSE(row.get_allocator().external());
+  }
+  EXPECT_FLOAT_EQ((*e.get_data())[1][2], float_t{6});
+}
+
+TEST(edge, contiguous_storage_network) {
+  network<sequential> net1, net2;
+  net1 << fully_connected_layer(4, 6) << tanh_layer()
+       << fully_connected_layer(6, 2);
+  net2 << fully_connected_layer(4, 6) << tanh_layer()
+       << fully_connected_layer(6, 2);
+  net1.init_weight();
+  net2.init_weight();
+  for (size_t i = 0; i < net1.depth(); i++) {
+    auto w1 = net1[i]->weights();
+    auto w2 = net2[i]->weights();
+    for (size_t j = 0; j < w1.size(); j++) *w2[j] = *w1[j];
+  }
+  net2.set_edge_storage(edge_storage::contiguous);
+
+  // large enough batches for the fully-connected layers to run as one GEMM
+  // reading and writing the contiguous edges in place
+  std::vector<vec_t> in, t;
+  for (size_t i = 0; i < 24; i++) {
+    in.push_back(vec_t(4));
+    t.push_back(vec_t(2));
+    uniform_rand(in.back().begin(), in.back().end(), -2.0, 2.0);
+    uniform_rand(t.back().begin(), t.back().end(), 0.0, 1.0);
+  }
+
+  adagrad opt1, opt2;
+  net1.fit<mse>(opt1, in, t, 12, 2);
+  net2.fit<mse>(opt2, in, t, 12, 2);
+
+  EXPECT_TRUE(net1.has_same_weights(net2, 1e-6));
+  for (auto &x : in) {
+    EXPECT_TRUE(is_near_container(net1.predict(x), net2.predict(x), 1e-6));
+  }
+}
+TEST(edge, weights_version) {
+  fully_connected_layer l(4, 3);
+  l.init_weight();
+  std::vector<tensor_t *> in_data;
+  for (auto e : l.inputs()) in_data.push_back(e->get_data());
+
+  // reading the weights leaves the stamp as it is
+  const uint64_t v0 = l.weights_version();
+  const layer &cl   = l;
+  EXPECT_NE(v0, 0u);
+  EXPECT_EQ(cl.weights().size(), 2u);
+  EXPECT_EQ(l.weights_version(), v0);
+  EXPECT_EQ(l.weights_version(in_data), v0);
+
+  // weights passed in by the caller have no stamp
+  tensor_t other(*in_data[1]);
+  EXPECT_EQ(l.weights_version({in_data[0], &other, in_data[2]}), 0u);
+
+  // mutable access and optimizer steps renew it
+  l.weights();
+  const uint64_t v1 = l.weights_version();
+  EXPECT_GT(v1, v0);
+  adagrad opt;
+  l.update_weight(&opt);
+  EXPECT_GT(l.weights_version(), v1);
+}
 }  // namespace tiny_dnn
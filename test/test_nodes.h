@@ -85,4 +85,380 @@ TEST(nodes, graph_branch2) {
   EXPECT_FLOAT_EQ(static_cast<float_t>(res[2]), static_cast<float_t>(0.0));
 }
 
+TEST(nodes, graph_parallel_branches) {
+  // in -> fc0 -> {tower a, tower b} -> add -> fc
+  auto train = [](size_t num_threads) {
+    thread_pool::get_instance().set_num_threads(num_threads);
+    set_random_seed(3);
+
+    input_layer in(shape3d(4, 1, 1));
+    fully_connected_layer fc0(4, 8);
+    fully_connected_layer fc_a(8, 6);
+    tanh_layer tanh_a(6);
+    fully_connected_layer fc_b(8, 6);
+    relu_layer relu_b(6);
+    layers::add added(2, 6);
+    fully_connected_layer out(6, 2);
+
+    in << fc0 << fc_a << tanh_a;
+    fc0 << fc_b << relu_b;
+    (tanh_a, relu_b) << added << out;
+
+    network<graph> net;
+    construct_graph(net, {&in}, {&out});
+
+    std::vector<vec_t> x = {{0, 1, 2, 3}, {1, -1, 0, 2}, {-2, 1, 1, 0}};
+    std::vector<vec_t> t = {{1, 0}, {0, 1}, {1, 1}};
+    gradient_descent opt;
+    net.train<mse>(opt, x, t, 3, 5);
+
+    std::vector<vec_t> weights;
+    for (size_t i = 0; i < net.depth(); i++) {
+      for (auto w : net[i]->weights()) weights.push_back(*w);
+    }
+    weights.push_back(net.predict(x[0]));
+    return weights;
+  };
+
+  auto serial   = train(1);
+  auto parallel = train(4);
+  thread_pool::get_instance().set_num_threads(0);
+
+  ASSERT_EQ(serial.size(), parallel.size());
+  for (size_t i = 0; i < serial.size(); i++) {
+    ASSERT_EQ(serial[i].size(), parallel[i].size());
+    for (size_t j = 0; j < serial[i].size(); j++) {
+      EXPECT_EQ(serial[i][j], parallel[i][j]);
+    }
+  }
+}
+
+TEST(memory_planner, chain) {
+  // 0 -> a -> 1 -> b -> 2 -> c -> 3
+  memory_planner p(4);
+  size_t a = p.add_buffer(0, 100);
+  p.add_reader(a, 1);
+  size_t b = p.add_buffer(1, 50);
+  p.add_reader(b, 2);
+  size_t c = p.add_buffer(2, 80);
+  p.add_reader(c, 3);
+  p.plan();
+
+  EXPECT_EQ(p.num_slots(), 2u);
+  EXPECT_EQ(p.slot(a), p.slot(c));
+  EXPECT_NE(p.slot(a), p.slot(b));
+  EXPECT_EQ(p.slot_size(p.slot(a)), 100u);
+  EXPECT_EQ(p.total_size(), 150u);
+}
+
+TEST(memory_planner, branches) {
+  // 0 -> {1, 2} -> 3; 1 and 2 may run concurrently
+  memory_planner p(4);
+  p.add_dependency(0, 1);
+  p.add_dependency(0, 2);
+  p.add_dependency(1, 3);
+  p.add_dependency(2, 3);
+  size_t in = p.add_buffer(0, 10);
+  p.add_reader(in, 1);
+  p.add_reader(in, 2);
+  size_t a = p.add_buffer(1, 10);
+  p.add_reader(a, 3);
+  size_t b = p.add_buffer(2, 10);
+  p.add_reader(b, 3);
+  p.plan();
+
+  // a and b are written while the other branch may still read in
+  EXPECT_EQ(p.num_slots(), 3u);
+  EXPECT_NE(p.slot(a), p.slot(b));
+  EXPECT_NE(p.slot(in), p.slot(a));
+  EXPECT_NE(p.slot(in), p.slot(b));
+}
+
+TEST(memory_planner, unread_buffer_is_kept) {
+  memory_planner p(3);
+  size_t a = p.add_buffer(0, 10);
+  size_t b = p.add_buffer(1, 10);
+  p.add_reader(b, 2);
+  size_t c = p.add_buffer(2, 10);
+  p.plan();
+
+  EXPECT_NE(p.slot(a), p.slot(b));
+  EXPECT_NE(p.slot(a), p.slot(c));
+  EXPECT_THROW(p.add_reader(a, 0), nn_error);
+  EXPECT_THROW(p.add_dependency(2, 1), nn_error);
+}
+
+TEST(nodes, memory_planning_alexnet) {
+  models::alexnet net;
+  const size_t unplanned = net.activation_memory_size();
+
+  net.set_memory_planning(true);
+
+  // the output of the first convolution and its relu are the largest
+  EXPECT_EQ(net.activation_memory_size(), 2u * 54 * 54 * 64);
+  EXPECT_GT(unplanned, 3 * net.activation_memory_size());
+}
+
+TEST(nodes, memory_planning_sequential) {
+  network<sequential> net;
+  net << convolutional_layer(8, 8, 3, 1, 4) << relu()
+      << max_pooling_layer(6, 6, 4, 2) << fully_connected_layer(36, 16)
+      << tanh_layer() << fully_connected_layer(16, 3) << softmax();
+
+  std::vector<vec_t> in;
+  for (size_t i = 0; i < 5; i++) {
+    in.emplace_back(64);
+    uniform_rand(in.back().begin(), in.back().end(), -1.0, 1.0);
+  }
+  std::vector<vec_t> expected = net.predict_batch(in, 2);
+
+  net.set_memory_planning(true);
+  for (int run = 0; run < 2; run++) {
+    std::vector<vec_t> actual = net.predict_batch(in, 2);
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < in.size(); i++) {
+      for (size_t j = 0; j < 3; j++) {
+        EXPECT_FLOAT_EQ(expected[i][j], actual[i][j]);
+      }
+    }
+  }
+  EXPECT_EQ(net.activation_memory_size(), 2u * 6 * 6 * 4);
+}
+
+TEST(nodes, memory_planning_graph) {
+  thread_pool::get_instance().set_num_threads(4);
+
+  input_layer in(shape3d(4, 1, 1));
+  fully_connected_layer fc0(4, 8);
+  fully_connected_layer fc_a(8, 6);
+  tanh_layer tanh_a(6);
+  fully_connected_layer fc_b(8, 6);
+  relu_layer relu_b(6);
+  layers::add added(2, 6);
+  fully_connected_layer out(6, 2);
+
+  in << fc0 << fc_a << tanh_a;
+  fc0 << fc_b << relu_b;
+  (tanh_a, relu_b) << added << out;
+
+  network<graph> net;
+  construct_graph(net, {&in}, {&out});
+
+  std::vector<vec_t> x = {{0, 1, 2, 3}, {1, -1, 0, 2}, {-2, 1, 1, 0}};
+  std::vector<vec_t> expected = net.predict_batch(x, 3);
+
+  net.set_memory_planning(true);
+  for (int run = 0; run < 3; run++) {
+    std::vector<vec_t> actual = net.predict_batch(x, 3);
+    for (size_t i = 0; i < x.size(); i++) {
+      for (size_t j = 0; j < 2; j++) {
+        EXPECT_FLOAT_EQ(expected[i][j], actual[i][j]);
+      }
+    }
+  }
+  EXPECT_LT(net.activation_memory_size(), 8u + 5 * 6);
+
+  thread_pool::get_instance().set_num_threads(0);
+}
+
+TEST(nodes, slice_concat_in_place) {
+  input_layer in(shape3d(6, 1, 1));
+  fully_connected_layer fc0(6, 8);
+  slice_layer slice(shape3d(1, 1, 8), slice_type::slice_channels, 2);
+  tanh_layer tanh_a(4);
+  fully_connected_layer fc_b(4, 4);
+  concat_layer concat({shape3d(1, 1, 4), shape3d(1, 1, 4)});
+  fully_connected_layer out(8, 2);
+
+  // the branches write into the output of concat, and read the output of
+  // fc0 through the slice
+  in << fc0 << slice;
+  connect(&slice, &tanh_a, 0, 0);
+  connect(&slice, &fc_b, 1, 0);
+  (tanh_a, fc_b) << concat << out;
+
+  network<graph> net;
+  construct_graph(net, {&in}, {&out});
+
+  const auto test_data = generate_gradient_check_data(6);
+  net.init_weight();
+  EXPECT_TRUE(net.gradient_check<mse>(test_data.first, test_data.second,
+                                      epsilon<float_t>(), GRAD_CHECK_ALL));
+  EXPECT_EQ(&(*fc0.outputs()[0]->get_data())[0][4],
+            &(*fc_b.inputs()[0]->get_data())[0][0]);
+  EXPECT_EQ(&(*concat.outputs()[0]->get_data())[0][4],
+            &(*fc_b.outputs()[0]->get_data())[0][0]);
+
+  // the views are given up for memory planning
+  std::vector<vec_t> x = {{0, 1, 2, 3, 4, 5}, {1, -1, 0, 2, 0, 1}};
+  std::vector<vec_t> expected = net.predict_batch(x, 2);
+  net.set_memory_planning(true);
+  for (int run = 0; run < 2; run++) {
+    std::vector<vec_t> actual = net.predict_batch(x, 2);
+    for (size_t i = 0; i < x.size(); i++) {
+      for (size_t j = 0; j < 2; j++) {
+        EXPECT_FLOAT_EQ(expected[i][j], actual[i][j]);
+      }
+    }
+  }
+}
+
+TEST(nodes, memory_planning_fit) {
+  network<sequential> net;
+  net << fully_connected_layer(3, 8) << tanh_layer()
+      << fully_connected_layer(8, 2);
+
+  std::vector<vec_t> x = {{0, 1, 2}, {1, -1, 0}, {-2, 1, 1}};
+  std::vector<vec_t> t = {{1, 0}, {0, 1}, {1, 1}};
+
+  net.set_memory_planning(true);
+  vec_t before = net.predict(x[0]);
+
+  // fit trains without planning and restores it afterwards
+  gradient_descent opt;
+  EXPECT_TRUE(net.fit<mse>(opt, x, t, 3, 2));
+  vec_t planned = net.predict(x[0]);
+  EXPECT_NE(before[0], planned[0]);
+
+  net.set_memory_planning(false);
+  vec_t unplanned = net.predict(x[0]);
+  EXPECT_FLOAT_EQ(planned[0], unplanned[0]);
+  EXPECT_FLOAT_EQ(planned[1], unplanned[1]);
+}
+
+// statistics of a trained batch normalization
+inline void set_random_statistics(batch_normalization_layer &bn) {
+  vec_t mean(bn.in_shape()[0].depth_), variance(mean.size());
+  uniform_rand(mean.begin(), mean.end(), -1.0, 1.0);
+  uniform_rand(variance.begin(), variance.end(), 0.5, 2.0);
+  bn.set_mean(mean);
+  bn.set_variance(variance);
+}
+
+TEST(nodes, fuse_layers_sequential) {
+  network<sequential> net;
+  convolutional_layer conv(8, 8, 3, 2, 4);
+  batch_normalization_layer bn1(conv);
+  fully_connected_layer fc1(3 * 3 * 4, 16);
+  batch_normalization_layer bn2(1, 16);
+  net << conv << bn1 << relu() << max_pooling_layer(6, 6, 4, 2)
+      << dropout_layer(3 * 3 * 4, 0.5) << fc1 << bn2 << tanh_layer()
+      << dropout_layer(16, 0.25) << fully_connected_layer(16, 3) << softmax();
+  set_random_statistics(bn1);
+  set_random_statistics(bn2);
+  net.set_netphase(net_phase::test);
+
+  std::vector<vec_t> in;
+  for (size_t i = 0; i < 4; i++) {
+    in.emplace_back(128);
+    uniform_rand(in.back().begin(), in.back().end(), -1.0, 1.0);
+  }
+  std::vector<vec_t> expected = net.predict_batch(in, 4);
+
+  EXPECT_EQ(net.fuse_layers(), 7u);
+  EXPECT_EQ(net.depth(), 4u);
+  EXPECT_NE(net[0]->fused_activation(), nullptr);
+  EXPECT_EQ(net[1]->fused_activation(), nullptr);
+  EXPECT_NE(net[2]->fused_activation(), nullptr);
+  EXPECT_EQ(net.fuse_layers(), 0u);
+
+  std::vector<vec_t> actual = net.predict_batch(in, 4);
+  for (size_t i = 0; i < in.size(); i++) {
+    for (size_t j = 0; j < 3; j++) {
+      EXPECT_NEAR(expected[i][j], actual[i][j], 1e-5);
+    }
+  }
+}
+
+TEST(nodes, fuse_layers_engines) {
+  // the kernels of every engine apply the activation to the samples they
+  // write, batches of 9 run the fully-connected layers as one GEMM
+  std::vector<core::backend_t> engines = {core::backend_t::internal,
+                                          core::backend_t::winograd};
+#ifdef CNN_USE_AVX
+  engines.push_back(core::backend_t::avx);
+#endif
+  for (auto engine : engines) {
+    const core::backend_t fc_engine = engine == core::backend_t::winograd
+                                        ? core::backend_t::internal
+                                        : engine;
+    network<sequential> net;
+    net << convolutional_layer(8, 8, 3, 2, 4, padding::valid, true, 1, 1,
+                               engine)
+        << elu() << fully_connected_layer(6 * 6 * 4, 5, true, fc_engine)
+        << tanh_layer();
+    net.init_weight();
+
+    std::vector<vec_t> in;
+    for (size_t i = 0; i < 9; i++) {
+      in.emplace_back(128);
+      uniform_rand(in.back().begin(), in.back().end(), -1.0, 1.0);
+    }
+    std::vector<vec_t> expected = net.predict_batch(in, 9);
+
+    EXPECT_EQ(net.fuse_layers(), 2u);
+    std::vector<vec_t> actual = net.predict_batch(in, 9);
+    for (size_t i = 0; i < in.size(); i++) {
+      for (size_t j = 0; j < 5; j++) {
+        EXPECT_NEAR(expected[i][j], actual[i][j], 1e-5);
+      }
+    }
+  }
+}
+
+TEST(nodes, fuse_layers_graph) {
+  input_layer in(shape3d(4, 1, 1));
+  fully_connected_layer fc0(4, 8);
+  batch_normalization_layer bn0(1, 8);
+  relu_layer relu0(8);
+  fully_connected_layer fc_a(8, 6);
+  tanh_layer tanh_a(6);
+  fully_connected_layer fc_b(8, 6, false);
+  batch_normalization_layer bn_b(1, 6);
+  layers::add added(2, 6);
+  fully_connected_layer out(6, 2);
+  sigmoid_layer out_act(2);
+
+  // bn_b cannot be folded into fc_b, which has no bias
+  in << fc0 << bn0 << relu0 << fc_a << tanh_a;
+  relu0 << fc_b << bn_b;
+  (tanh_a, bn_b) << added << out << out_act;
+
+  network<graph> net;
+  construct_graph(net, {&in}, {&out_act});
+  set_random_statistics(bn0);
+  set_random_statistics(bn_b);
+  net.set_netphase(net_phase::test);
+
+  std::vector<vec_t> x = {{0, 1, 2, 3}, {1, -1, 0, 2}, {-2, 1, 1, 0}};
+  std::vector<vec_t> expected = net.predict_batch(x, 3);
+
+  EXPECT_EQ(net.fuse_layers(), 4u);
+  EXPECT_EQ(net.depth(), 7u);
+  // out applies a copy of out_act, which the caller owns
+  ASSERT_NE(out.fused_activation(), nullptr);
+  EXPECT_NE(out.fused_activation(), &out_act);
+  EXPECT_EQ(out.fused_activation()->layer_type(), out_act.layer_type());
+
+  thread_pool::get_instance().set_num_threads(4);
+  std::vector<vec_t> actual = net.predict_batch(x, 3);
+  thread_pool::get_instance().set_num_threads(0);
+  for (size_t i = 0; i < x.size(); i++) {
+    for (size_t j = 0; j < 2; j++) {
+      EXPECT_NEAR(expected[i][j], actual[i][j], 1e-5);
+    }
+  }
+}
+
+TEST(nodes, fuse_layers_inference_only) {
+  network<sequential> net;
+  net << fully_connected_layer(3, 4) << relu() << fully_connected_layer(4, 2);
+  EXPECT_EQ(net.fuse_layers(), 1u);
+
+  std::vector<vec_t> x = {{0, 1, 2}};
+  std::vector<vec_t> t = {{1, 0}};
+  gradient_descent opt;
+  EXPECT_THROW(net.fit<mse>(opt, x, t, 1, 1), nn_error);
+}
+
 }  // namespace tiny_dnn
@@ -8,6 +8,8 @@
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include "tiny_dnn/tiny_dnn.h"
 
 namespace tiny_dnn {
@@ -194,4 +196,91 @@ TEST(optimizers, nesterov_momentum_update) {
   }
 }
 
+// a step over several parameters updates each of them as an optimizer of
+// its own would
+template <typename Optimizer>
+void check_step_matches_update() {
+  const size_t sizes[] = {5, 37, 1000};
+  std::vector<vec_t> W, dW;
+  for (size_t size : sizes) {
+    W.push_back(vec_t(size));
+    dW.push_back(vec_t(size));
+    uniform_rand(W.back().begin(), W.back().end(), -1.0, 1.0);
+    uniform_rand(dW.back().begin(), dW.back().end(), -1.0, 1.0);
+  }
+  std::vector<vec_t> expected = W;
+
+  Optimizer stepped;
+  std::vector<const vec_t *> grads;
+  std::vector<vec_t *> weights;
+  for (size_t i = 0; i < W.size(); i++) {
+    grads.push_back(&dW[i]);
+    weights.push_back(&W[i]);
+  }
+  for (int t = 0; t < 3; t++) stepped.step(grads, weights);
+
+  for (size_t i = 0; i < W.size(); i++) {
+    Optimizer single;
+    for (int t = 0; t < 3; t++) single.update(dW[i], expected[i], i == 2);
+    for (size_t j = 0; j < W[i].size(); j++) {
+      EXPECT_NEAR(expected[i][j], W[i][j], 1e-5);
+    }
+  }
+}
+
+TEST(optimizers, step_matches_update) {
+  check_step_matches_update<adagrad>();
+  check_step_matches_update<RMSprop>();
+  check_step_matches_update<adam>();
+  check_step_matches_update<adamax>();
+  check_step_matches_update<gradient_descent>();
+  check_step_matches_update<momentum>();
+  check_step_matches_update<nesterov_momentum>();
+}
+
+TEST(optimizers, fused_kernels_match_reference) {
+  // lengths with and without a remainder after the vector loop
+  for (size_t n : {1u, 8u, 13u, 100u}) {
+    vec_t dW(n), W(n), m(n), v(n);
+    uniform_rand(dW.begin(), dW.end(), -1.0, 1.0);
+    uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+    vec_t W2 = W, m2 = m, v2 = v;
+
+    const float_t a = float_t(0.01), b1 = float_t(0.9), b2 = float_t(0.999);
+    const float_t c1 = float_t(0.1), c2 = float_t(0.001), e = float_t(1e-8);
+    kernels::adam_update(n, a, b1, b2, c1, c2, e, &dW[0], &W[0], &m[0], &v[0]);
+    kernels::adam_update<float_t>(n, a, b1, b2, c1, c2, e, &dW[0], &W2[0],
+                                  &m2[0], &v2[0]);
+    kernels::momentum_update(n, a, b2, b1, true, &dW[0], &W[0], &m[0]);
+    kernels::momentum_update<float_t>(n, a, b2, b1, true, &dW[0], &W2[0],
+                                      &m2[0]);
+    kernels::adamax_update(n, a, b1, b2, e, &dW[0], &W[0], &m[0], &v[0]);
+    kernels::adamax_update<float_t>(n, a, b1, b2, e, &dW[0], &W2[0], &m2[0],
+                                    &v2[0]);
+    for (size_t i = 0; i < n; i++) {
+      EXPECT_NEAR(W2[i], W[i], 1e-6);
+      EXPECT_NEAR(m2[i], m[i], 1e-6);
+      EXPECT_NEAR(v2[i], v[i], 1e-6);
+    }
+  }
+}
+
+TEST(optimizers, reset_clears_state) {
+  momentum optimizer;
+  const vec_t initial = {0.1, 0.2, 0.3};
+  vec_t gradients     = {1.0, -2.0, 0.5};
+
+  vec_t W = initial;
+  optimizer.update(gradients, W, false);
+  const vec_t first = W;
+
+  // the next update of W starts from zero momentum again
+  optimizer.reset();
+  W = initial;
+  optimizer.update(gradients, W, false);
+  for (size_t i = 0; i < W.size(); i++) {
+    EXPECT_FLOAT_EQ(first[i], W[i]);
+  }
+}
+
 }  // namespace tiny_dnn
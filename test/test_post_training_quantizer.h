@@ -0,0 +1,157 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "test/testhelper.h"
+#include "tiny_dnn/tiny_dnn.h"
+
+namespace tiny_dnn {
+
+TEST(activation_histogram, min_max_and_percentile) {
+  activation_histogram h;
+  vec_t v(1000);
+  for (size_t i = 0; i < v.size(); i++) v[i] = float_t(i) / 1000;
+  h.add(v);
+  h.add(vec_t{float_t(100)});  // outlier, grows the range
+
+  EXPECT_EQ(h.count(), 1001u);
+  auto r = h.range(calibration_method::min_max);
+  EXPECT_FLOAT_EQ(r.first, 0);
+  EXPECT_FLOAT_EQ(r.second, 100);
+
+  r = h.range(calibration_method::percentile, float_t(99.5));
+  EXPECT_FLOAT_EQ(r.first, 0);
+  EXPECT_GT(r.second, float_t(0.9));
+  EXPECT_LT(r.second, float_t(1.5));
+}
+
+TEST(activation_histogram, kl_divergence_clips_outliers) {
+  activation_histogram h;
+  vec_t v(10000);
+  for (auto &x : v) {
+    // triangular distribution over [-1, 1]
+    x = uniform_rand(float_t(-0.5), float_t(0.5)) +
+        uniform_rand(float_t(-0.5), float_t(0.5));
+  }
+  v[0] = float_t(-50);
+  v[1] = float_t(50);
+  h.add(v);
+
+  auto r = h.range(calibration_method::kl_divergence);
+  EXPECT_LT(r.first, float_t(-0.5));
+  EXPECT_GT(r.first, float_t(-10));
+  EXPECT_GT(r.second, float_t(0.5));
+  EXPECT_LT(r.second, float_t(10));
+}
+
+TEST(post_training_quantizer, matches_float_network) {
+  network<sequential> net;
+  net << convolutional_layer(8, 8, 3, 2, 4, padding::same) << relu()
+      << convolutional_layer(8, 8, 3, 4, 4) << relu()
+      << max_pooling_layer(6, 6, 4, 2) << fully_connected_layer(3 * 3 * 4, 5)
+      << softmax();
+  net.init_weight();
+
+  std::vector<vec_t> in(100, vec_t(8 * 8 * 2));
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+  const std::vector<vec_t> expected = net.predict_batch(in);
+  std::vector<label_t> labels;
+  for (const auto &y : expected) {
+    labels.push_back(static_cast<label_t>(
+      std::max_element(y.begin(), y.end()) - y.begin()));
+  }
+
+  post_training_quantizer<sequential> quantizer(net);
+  quantizer.calibrate(std::vector<vec_t>(in.begin(), in.begin() + 50));
+
+  network<sequential> qnet;
+  quantizer.quantize(qnet);
+  ASSERT_EQ(qnet.depth(), net.depth());
+  EXPECT_EQ(qnet[0]->layer_type(), "q_conv");
+  EXPECT_EQ(qnet[1]->layer_type(), "relu-activation");
+  EXPECT_EQ(qnet[2]->layer_type(), "q_conv");
+  EXPECT_EQ(qnet[5]->layer_type(), "q_fully-connected");
+
+  // the float network is left as it was
+  const std::vector<vec_t> unchanged = net.predict_batch(in);
+  for (size_t i = 0; i < in.size(); i++) {
+    EXPECT_TRUE(is_near_container(unchanged[i], expected[i], float_t(1e-6)));
+  }
+
+  // the calibrated ranges are saved with the model
+  network<sequential> loaded;
+  loaded.from_json(qnet.to_json(content_type::weights_and_model),
+                   content_type::weights_and_model);
+  const auto &q = loaded.at<quantized_convolutional_layer>(2).quantization();
+  EXPECT_FLOAT_EQ(q.min_input, 0);
+  EXPECT_GT(q.max_input, 0);
+  EXPECT_TRUE(q.per_channel);
+  const std::vector<vec_t> reloaded = loaded.predict_batch(in);
+  const std::vector<vec_t> quantized = qnet.predict_batch(in);
+  for (size_t i = 0; i < in.size(); i++) {
+    EXPECT_TRUE(is_near_container(reloaded[i], quantized[i], float_t(1e-6)));
+  }
+
+  quantization_report r = quantizer.evaluate(qnet, in, labels);
+  ASSERT_EQ(r.layers.size(), 3u);
+  EXPECT_EQ(r.layers[0].index, 0u);
+  EXPECT_EQ(r.layers[1].index, 2u);
+  EXPECT_EQ(r.layers[2].index, 5u);
+  EXPECT_FLOAT_EQ(r.layers[1].input.first, 0);  // relu output
+  EXPECT_EQ(r.samples, in.size());
+  EXPECT_FLOAT_EQ(r.float_accuracy, 100);
+  EXPECT_GE(r.quantized_accuracy, 90);
+  EXPECT_LT(r.max_output_error, float_t(0.1));
+}
+
+TEST(post_training_quantizer, per_channel_weights) {
+  network<sequential> net;
+  net << fully_connected_layer(16, 4);
+  net.init_weight();
+  vec_t &W = *net[0]->weights()[0];
+  uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+  W[0] = float_t(20);  // input 0 to output 0, input 0 is always small
+
+  std::vector<vec_t> in(50, vec_t(16));
+  for (auto &v : in) {
+    uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+    v[0] *= float_t(0.01);
+  }
+  const std::vector<vec_t> expected = net.predict_batch(in);
+
+  // largest error of the outputs whose weights don't include the outlier
+  auto error = [&](bool per_channel) {
+    quantization_options options;
+    options.method      = calibration_method::min_max;
+    options.per_channel = per_channel;
+    post_training_quantizer<sequential> quantizer(net, options);
+    quantizer.calibrate(in);
+    network<sequential> qnet;
+    quantizer.quantize(qnet);
+    const std::vector<vec_t> actual = qnet.predict_batch(in);
+    float_t e = 0;
+    for (size_t i = 0; i < in.size(); i++) {
+      for (size_t o = 1; o < 4; o++) {
+        e = std::max(e, std::abs(actual[i][o] - expected[i][o]));
+      }
+    }
+    return e;
+  };
+
+  const float_t per_tensor  = error(false);
+  const float_t per_channel = error(true);
+  EXPECT_LT(per_channel, per_tensor / 2);
+  EXPECT_LT(per_channel, float_t(0.1));
+}
+
+}  // namespace tiny_dnn
@@ -283,4 +283,88 @@ TEST(quantization_utils, quantize_down_and_shrink_range) {
   EXPECT_NEAR(1.0f, output_max, 1E-5);
 }
 
+// every instruction set quantized_gemm can run on here
+inline std::vector<core::kernels::quantized_gemm_isa> quantized_gemm_isas() {
+  using core::kernels::quantized_gemm_isa;
+  std::vector<quantized_gemm_isa> isas;
+  for (auto isa : {quantized_gemm_isa::generic, quantized_gemm_isa::avx2,
+                   quantized_gemm_isa::avx512_vnni}) {
+    if (core::kernels::quantized_gemm_supported(isa)) isas.push_back(isa);
+  }
+  return isas;
+}
+
+TEST(quantized_gemm, against_reference) {
+  // sizes straddle the register tiles (8 or 16 rows, 8 columns, and the
+  // narrow 1, 2 and 4 columns), the groups of 4 codes and the column blocks
+  // of the tasks
+  const size_t shapes[][3] = {
+    {1, 1, 1},    {3, 5, 7},     {8, 8, 4},   {17, 9, 13}, {40, 70, 300},
+    {100, 1, 33}, {16, 130, 64}, {20, 2, 37}, {33, 3, 50}, {9, 66, 21}};
+
+  for (auto isa : quantized_gemm_isas()) {
+    for (auto &shape : shapes) {
+      const size_t m = shape[0], n = shape[1], k = shape[2];
+      const size_t ldb = k + 3;
+      std::vector<uint8_t> a(m * k), b(n * ldb);
+      std::vector<int32_t> offsets(m), offsets_b(n);
+      for (auto &v : a) v = static_cast<uint8_t>(uniform_rand(0, 255));
+      for (auto &v : b) v = static_cast<uint8_t>(uniform_rand(0, 255));
+      for (auto &v : offsets) v = uniform_rand(0, 255);
+      for (auto &v : offsets_b) v = uniform_rand(0, 255);
+
+      core::kernels::packed_quantized_weights packed(
+        m, k, offsets, [&](size_t i, size_t p) { return a[i * k + p]; }, isa);
+      std::vector<int32_t> c(m * n);
+      core::kernels::quantized_gemm(packed, &b[0], n, ldb, &offsets_b[0],
+                                    &c[0], n);
+
+      for (size_t i = 0; i < m; i++) {
+        for (size_t j = 0; j < n; j++) {
+          int32_t expected = 0;
+          for (size_t p = 0; p < k; p++) {
+            expected +=
+              (a[i * k + p] - offsets[i]) * (b[j * ldb + p] - offsets_b[j]);
+          }
+          ASSERT_EQ(expected, c[i * n + j]);
+        }
+      }
+    }
+  }
+}
+
+TEST(quantized_gemm, extreme_codes_do_not_saturate) {
+  // pairs of 255 * -128 overflow the 16-bit sums of a plain vpmaddubsw
+  const size_t m = 16, n = 8, k = 64;
+  std::vector<uint8_t> b(n * k, 255);
+  for (auto isa : quantized_gemm_isas()) {
+    for (uint8_t code : {uint8_t(0), uint8_t(255)}) {
+      core::kernels::packed_quantized_weights packed(
+        m, k, std::vector<int32_t>(m, 128),
+        [&](size_t, size_t) { return code; }, isa);
+      std::vector<int32_t> c(m * n);
+      core::kernels::quantized_gemm(packed, &b[0], n, k, 0, &c[0], n);
+      for (auto v : c) EXPECT_EQ(int32_t(k) * 255 * (code - 128), v);
+    }
+  }
+}
+
+TEST(quantized_fully_connected, batch_matches_samples) {
+  // the batch runs through one GEMM, every sample keeping its own range
+  network<sequential> net;
+  net << quantized_fully_connected_layer(20, 12);
+  net.init_weight();
+
+  std::vector<vec_t> in(11, vec_t(20));
+  for (size_t i = 0; i < in.size(); i++) {
+    const float_t r = float_t(0.5) * (i + 1);
+    uniform_rand(in[i].begin(), in[i].end(), -r, r);
+  }
+
+  std::vector<vec_t> batched = net.predict_batch(in, in.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    EXPECT_TRUE(is_near_container(net.predict(in[i]), batched[i], 1e-6));
+  }
+}
+
 }  // namespace tiny_dnn
@@ -93,24 +93,24 @@ TEST(quantized_convolutional, fprop) {
     {
         l.forward_propagation(in_data, out_data);
 
-        EXPECT_NEAR(-0.043426, out[0], 2e-2);
-        EXPECT_NEAR(1.6769816, out[1], 2e-2);
-        EXPECT_NEAR(1.4731820, out[2], 2e-2);
-        EXPECT_NEAR(1.0822733, out[3], 2e-2);
-        EXPECT_NEAR(0.0415336, out[4], 2e-2);
-        EXPECT_NEAR(-1.997466, out[5], 2e-2);
-        EXPECT_NEAR(0.4238461, out[6], 2e-2);
-        EXPECT_NEAR(1.1756143, out[7], 2e-2);
-        EXPECT_NEAR(0.8273983, out[8], 2e-2);
-        EXPECT_NEAR(-0.192101, out[9], 2e-2);
-        EXPECT_NEAR(1.2309504, out[10], 2e-2);
-        EXPECT_NEAR(2.2292108, out[11], 2e-2);
-        EXPECT_NEAR(0.5300441, out[12], 2e-2);
-        EXPECT_NEAR(1.7407004, out[13], 2e-2);
-        EXPECT_NEAR(1.6345025, out[14], 2e-2);
-        EXPECT_NEAR(0.6362420, out[15], 2e-2);
-        EXPECT_NEAR(3.4186277, out[16], 2e-2);
-        EXPECT_NEAR(-0.489455, out[17], 2e-2);
+        EXPECT_NEAR(-0.05, out[0], 2e-2);
+        EXPECT_NEAR(1.65, out[1], 2e-2);
+        EXPECT_NEAR(1.45, out[2], 2e-2);
+        EXPECT_NEAR(1.05, out[3], 2e-2);
+        EXPECT_NEAR(0.00, out[4], 2e-2);
+        EXPECT_NEAR(-2.00, out[5], 2e-2);
+        EXPECT_NEAR(0.40, out[6], 2e-2);
+        EXPECT_NEAR(1.15, out[7], 2e-2);
+        EXPECT_NEAR(0.80, out[8], 2e-2);
+        EXPECT_NEAR(-0.80, out[9], 2e-2);
+        EXPECT_NEAR(1.10, out[10], 2e-2);
+        EXPECT_NEAR(2.10, out[11], 2e-2);
+        EXPECT_NEAR(0.60, out[12], 2e-2);
+        EXPECT_NEAR(1.50, out[13], 2e-2);
+        EXPECT_NEAR(0.70, out[14], 2e-2);
+        EXPECT_NEAR(0.40, out[15], 2e-2);
+        EXPECT_NEAR(3.30, out[16], 2e-2);
+        EXPECT_NEAR(-1.00, out[17], 2e-2);
     }
   // clang-format on
 }
@@ -196,6 +196,48 @@ TEST(quantized_convolutional, fprop_npp) {
 }
 #endif
 
+TEST(quantized_convolutional, consecutive_layers) {
+  // the second layer takes the 8-bit output of the first one; both keep
+  // their weights quantized between calls
+  network<sequential> qnet, fnet;
+  qnet << quantized_convolutional_layer(8, 8, 3, 2, 4, padding::same)
+       << quantized_convolutional_layer(8, 8, 3, 4, 2);
+  fnet << convolutional_layer(8, 8, 3, 2, 4, padding::same)
+       << convolutional_layer(8, 8, 3, 4, 2);
+
+  qnet.init_weight();
+  fnet.init_weight();
+  for (size_t i = 0; i < qnet.depth(); i++) {
+    for (size_t j = 0; j < qnet[i]->weights().size(); j++) {
+      vec_t &b = *qnet[i]->weights()[j];
+      uniform_rand(b.begin(), b.end(), -0.5, 0.5);
+      *fnet[i]->weights()[j] = b;
+    }
+  }
+
+  vec_t in(8 * 8 * 2);
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+
+  vec_t expected = fnet.predict(in);
+  vec_t actual   = qnet.predict(in);
+  float_t scale  = 0;
+  for (float_t v : expected) scale = std::max(scale, std::abs(v));
+
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_NEAR(expected[i], actual[i], scale * 0.05);
+  }
+
+  // changed weights are quantized again
+  for (auto w : qnet[1]->weights()) {
+    for (auto &v : *w) v *= 2;
+  }
+  vec_t doubled = qnet.predict(in);
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_NEAR(2 * actual[i], doubled[i], scale * 0.05);
+  }
+}
+
 /*
 TEST(quantized_convolutional, gradient_check) { // tanh - mse
     network<sequential> nn;
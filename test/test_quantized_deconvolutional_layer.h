@@ -162,10 +162,10 @@ TEST(quantized_deconvolutional, fprop2) {
     EXPECT_NEAR(0.1045097, out[1], 1e-2);
     EXPECT_NEAR(-0.797058, out[2], 1e-2);
     EXPECT_NEAR(-0.551176, out[3], 1e-2);
-    EXPECT_NEAR(-0.707647, out[4], 1e-2);
-    EXPECT_NEAR(0.8049019, out[5], 1e-2);
-    EXPECT_NEAR(-0.797058, out[6], 1e-2);
-    EXPECT_NEAR(1.1029412, out[7], 1e-2);
+    EXPECT_NEAR(-0.700000, out[4], 1e-2);
+    EXPECT_NEAR(0.8000000, out[5], 1e-2);
+    EXPECT_NEAR(-1.100000, out[6], 1e-2);
+    EXPECT_NEAR(0.9000000, out[7], 1e-2);
     EXPECT_NEAR(0.1566666, out[8], 1e-2);
     EXPECT_NEAR(-0.797058, out[9], 1e-2);
     EXPECT_NEAR(-0.551176, out[10], 1e-2);
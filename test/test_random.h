@@ -0,0 +1,65 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "test/testhelper.h"
+#include "tiny_dnn/tiny_dnn.h"
+
+namespace tiny_dnn {
+
+TEST(random, philox4x32_known_answers) {
+  // test vectors of the Random123 reference implementation
+  typedef philox4x32::counter_type ctr;
+  EXPECT_EQ(philox4x32(0)({{0, 0, 0, 0}}),
+            ctr({{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}}));
+  EXPECT_EQ(philox4x32(0xffffffffffffffffull)(
+              {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}}),
+            ctr({{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}}));
+  EXPECT_EQ(philox4x32(0x299f31d0a4093822ull)(
+              {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}}),
+            ctr({{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}}));
+}
+
+TEST(random, philox4x32_generate_seeks) {
+  const philox4x32 gen(0x0123456789abcdefull);
+
+  // any run of words equals the words of their counters, whichever path
+  // (vectorized or not) produced them
+  for (size_t first : {0u, 4u, 36u}) {
+    for (size_t n = 0; n < 70; n++) {
+      std::vector<uint32_t> words(n);
+      gen.generate(7, 1, 2, first, words.data(), n);
+      for (size_t i = 0; i < n; i++) {
+        const uint32_t block = static_cast<uint32_t>((first + i) / 4);
+        EXPECT_EQ(gen({{block, 7, 1, 2}})[(first + i) % 4], words[i]);
+      }
+    }
+  }
+}
+
+TEST(random, philox4x32_bernoulli) {
+  const philox4x32 gen(42);
+
+  for (uint32_t threshold : {0u, 0x40000000u, 0x80000001u, 0xffffffffu}) {
+    for (size_t n : {1u, 15u, 16u, 33u, 200u}) {
+      std::vector<uint32_t> words(n), bits((n + 31) / 32, 0xffffffff);
+      gen.generate(3, 0, 9, 8, words.data(), n);
+      gen.bernoulli(3, 0, 9, 8, threshold, bits.data(), n);
+      for (size_t i = 0; i < bits.size() * 32; i++) {
+        const bool expected = i < n && words[i] < threshold;
+        EXPECT_EQ(expected, ((bits[i / 32] >> (i % 32)) & 1) != 0);
+      }
+    }
+  }
+}
+
+}  // namespace tiny_dnn
@@ -1034,4 +1034,164 @@ TEST(serialization, graph_model_and_weights) {
   std::remove(path.c_str());
 }
 
+TEST(serialization, mapped_weights_and_model) {
+  network<sequential> net1, net2;
+  net1 << convolutional_layer(8, 8, 3, 2, 4, padding::same) << relu()
+       << max_pooling_layer(8, 8, 4, 2) << fully_connected_layer(4 * 4 * 4, 3)
+       << softmax();
+  net1.init_weight();
+
+  auto path = unique_path();
+  net1.save(path, content_type::weights_and_model, file_format::mapped);
+  net2.load(path, content_type::weights_and_model, file_format::mapped);
+
+  ASSERT_EQ(net1.layer_size(), net2.layer_size());
+  EXPECT_TRUE(net1.has_same_weights(net2, 0));
+  vec_t in(8 * 8 * 2);
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+  vec_t expected = net1.predict(in);
+  vec_t actual   = net2.predict(in);
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_FLOAT_EQ(expected[i], actual[i]);
+  }
+
+  // the weights lie in the mapped file, copies of them don't
+  const vec_t &W = *net2[0]->weights()[0];
+  EXPECT_EQ(W.get_allocator().external(), &W[0]);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(&W[0]) % 64, 0u);
+  vec_t copy = W;
+  EXPECT_EQ(copy.get_allocator().external(), nullptr);
+
+  // training modifies a private copy of the pages, not the file
+  std::vector<vec_t> batch(1, in);
+  std::vector<label_t> labels(1, 0);
+  adagrad opt;
+  net2.train<cross_entropy_multiclass>(opt, batch, labels, 1, 1);
+  EXPECT_FALSE(net1.has_same_weights(net2, 0));
+
+  network<sequential> net3;
+  net3 << convolutional_layer(8, 8, 3, 2, 4, padding::same) << relu()
+       << max_pooling_layer(8, 8, 4, 2) << fully_connected_layer(4 * 4 * 4, 3)
+       << softmax();
+  net3.load(path, content_type::weights, file_format::mapped);
+  EXPECT_TRUE(net1.has_same_weights(net3, 0));
+
+  std::remove(path.c_str());
+}
+
+TEST(serialization, mapped_rejects_other_files) {
+  network<sequential> net1, net2;
+  net1 << fully_connected_layer(4, 3) << fully_connected_layer(3, 2);
+  net1.init_weight();
+
+  auto path = unique_path();
+  net1.save(path);  // cereal archive
+  EXPECT_THROW(net2.load(path, content_type::weights_and_model,
+                         file_format::mapped),
+               nn_error);
+
+  // weights of a different architecture
+  net1.save(path, content_type::weights_and_model, file_format::mapped);
+  network<sequential> net3;
+  net3 << fully_connected_layer(4, 2);
+  EXPECT_THROW(net3.load(path, content_type::weights, file_format::mapped),
+               nn_error);
+  std::remove(path.c_str());
+}
+
+TEST(serialization, fused_activations) {
+  network<sequential> net1;
+  net1 << convolutional_layer(8, 8, 3, 2, 4) << elu()
+       << fully_connected_layer(6 * 6 * 4, 3) << tanh_layer();
+  net1.init_weight();
+  EXPECT_EQ(net1.fuse_layers(), 2u);
+
+  vec_t in(8 * 8 * 2);
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+  const vec_t expected = net1.predict(in);
+  auto check = [&](network<sequential> &net) {
+    ASSERT_EQ(net.depth(), 2u);
+    ASSERT_NE(net[0]->fused_activation(), nullptr);
+    ASSERT_NE(net[1]->fused_activation(), nullptr);
+    EXPECT_EQ(net[0]->fused_activation()->layer_type(), "elu-activation");
+    EXPECT_EQ(net[1]->fused_activation()->layer_type(), "tanh-activation");
+    const vec_t actual = net.predict(in);
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_FLOAT_EQ(expected[i], actual[i]);
+    }
+  };
+
+  auto path = unique_path();
+  network<sequential> net2;
+  net1.save(path, content_type::weights_and_model, file_format::json);
+  net2.load(path, content_type::weights_and_model, file_format::json);
+  check(net2);
+  std::remove(path.c_str());
+
+  network<sequential> net3;
+  net1.save(path, content_type::weights_and_model, file_format::binary);
+  net3.load(path, content_type::weights_and_model, file_format::binary);
+  check(net3);
+  std::remove(path.c_str());
+
+  network<sequential> net4;
+  net1.save(path, content_type::weights_and_model, file_format::mapped);
+  net4.load(path, content_type::weights_and_model, file_format::mapped);
+  check(net4);
+  std::remove(path.c_str());
+
+  execution_context<sequential> ctx(net1);
+  const vec_t actual = ctx.predict(in);
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_FLOAT_EQ(expected[i], actual[i]);
+  }
+}
+
+TEST(serialization, quantized_binary_versions) {
+  core::quantization_params q;
+  q.min_input   = -1;
+  q.max_input   = 2;
+  q.per_channel = true;
+  network<sequential> net1;
+  quantized_fully_connected_layer fc(4, 3);
+  fc.set_quantization(q);
+  net1 << fc;
+
+  // binary models keep the quantization parameters
+  std::stringstream ss;
+  {
+    cereal::BinaryOutputArchive oa(ss);
+    net1.to_archive(oa, content_type::model);
+  }
+  network<sequential> net2;
+  {
+    cereal::BinaryInputArchive ia(ss);
+    net2.from_archive(ia, content_type::model);
+  }
+  const auto &q2 = net2.at<quantized_fully_connected_layer>(0).quantization();
+  EXPECT_FLOAT_EQ(q2.min_input, -1);
+  EXPECT_FLOAT_EQ(q2.max_input, 2);
+  EXPECT_TRUE(q2.per_channel);
+
+  // binary models written before the layer records had a version hold a
+  // plain layer count and no quantization parameters
+  std::stringstream old;
+  {
+    cereal::BinaryOutputArchive oa(old);
+    oa(cereal::make_size_tag(cereal::size_type(1)));
+    oa(std::string("q_fully_connected"), uint64_t(4), uint64_t(3), true);
+  }
+  network<sequential> net3;
+  {
+    cereal::BinaryInputArchive ia(old);
+    net3.from_archive(ia, content_type::model);
+  }
+  ASSERT_EQ(net3.depth(), 1u);
+  EXPECT_EQ(net3[0]->in_shape()[0].size(), 4u);
+  EXPECT_EQ(net3[0]->out_shape()[0].size(), 3u);
+  const auto &q3 = net3.at<quantized_fully_connected_layer>(0).quantization();
+  EXPECT_FALSE(q3.static_input());
+  EXPECT_FALSE(q3.per_channel);
+}
+
 }  // namespace tiny_dnn
@@ -121,4 +121,37 @@ TEST(slice, forward_channels) {
   }
 }
 
+TEST(slice, channels_in_place) {
+  slice_layer sl(shape3d(2, 2, 5), slice_type::slice_channels, 2);
+
+  for (size_t batch : {3, 3, 5, 2}) {
+    tensor_t in(batch, vec_t(20));
+    tensor_t grad0(batch, vec_t(8)), grad1(batch, vec_t(12));
+    for (size_t s = 0; s < batch; s++) {
+      uniform_rand(in[s].begin(), in[s].end(), -1.0, 1.0);
+      uniform_rand(grad0[s].begin(), grad0[s].end(), -1.0, 1.0);
+      uniform_rand(grad1[s].begin(), grad1[s].end(), -1.0, 1.0);
+    }
+
+    std::vector<const tensor_t*> out;
+    sl.forward({in}, out);
+    auto in_grad = sl.backward({grad0, grad1});
+
+    const tensor_t& x = *sl.inputs()[0]->get_data();
+    for (size_t s = 0; s < batch; s++) {
+      // the outputs are views of the input
+      EXPECT_EQ(&(*out[0])[s][0], &x[s][0]);
+      EXPECT_EQ(&(*out[1])[s][0], &x[s][8]);
+      for (size_t j = 0; j < 8; j++) {
+        EXPECT_FLOAT_EQ(in[s][j], (*out[0])[s][j]);
+        EXPECT_FLOAT_EQ(grad0[s][j], in_grad[0][s][j]);
+      }
+      for (size_t j = 0; j < 12; j++) {
+        EXPECT_FLOAT_EQ(in[s][8 + j], (*out[1])[s][j]);
+        EXPECT_FLOAT_EQ(grad1[s][j], in_grad[0][s][8 + j]);
+      }
+    }
+  }
+}
+
 }  // namespace tiny_dnn
@@ -0,0 +1,176 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "test/testhelper.h"
+#include "tiny_dnn/tiny_dnn.h"
+
+namespace tiny_dnn {
+
+TEST(thread_pool, parallel_for_covers_range) {
+  thread_pool pool(4);
+  EXPECT_EQ(pool.num_threads(), 4u);
+
+  for (size_t grain : {0u, 1u, 7u, 100u}) {
+    std::vector<std::atomic<int>> hits(1000);
+    for (auto &h : hits) h = 0;
+
+    pool.parallel_for(0, hits.size(), grain, [&](size_t begin, size_t end) {
+      // chunks are split down to the grainsize, but not further
+      if (grain == 100) {
+        EXPECT_LE(end - begin, grain);
+        EXPECT_GE(end - begin, grain / 2);
+      }
+      for (size_t i = begin; i < end; i++) hits[i]++;
+    });
+
+    for (auto &h : hits) EXPECT_EQ(h.load(), 1);
+  }
+}
+
+TEST(thread_pool, nested_parallel_for) {
+  thread_pool pool(3);
+  std::atomic<size_t> sum(0);
+
+  pool.parallel_for(0, 16, 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      pool.parallel_for(0, 100, 1, [&](size_t b, size_t e) {
+        for (size_t j = b; j < e; j++) sum += j;
+      });
+    }
+  });
+
+  EXPECT_EQ(sum.load(), 16u * 4950u);
+}
+
+TEST(thread_pool, task_group) {
+  thread_pool pool(2);
+  task_group group;
+  std::atomic<int> count(0);
+
+  for (int i = 0; i < 50; i++) {
+    pool.run(group, [&] { count++; });
+  }
+  pool.wait(group);
+
+  EXPECT_TRUE(group.done());
+  EXPECT_EQ(count.load(), 50);
+}
+
+TEST(thread_pool, exception) {
+  thread_pool pool(4);
+
+  EXPECT_THROW(pool.parallel_for(0, 100, 1,
+                                 [](size_t begin, size_t end) {
+                                   if (begin <= 50 && 50 < end) {
+                                     throw nn_error("fail");
+                                   }
+                                 }),
+               nn_error);
+
+  // the pool is still usable afterwards
+  std::atomic<size_t> count(0);
+  pool.parallel_for(0, 100, 1, [&](size_t begin, size_t end) {
+    count += end - begin;
+  });
+  EXPECT_EQ(count.load(), 100u);
+}
+
+TEST(thread_pool, set_num_threads) {
+  thread_pool pool(2);
+  pool.set_num_threads(5);
+  EXPECT_EQ(pool.num_threads(), 5u);
+  pool.set_num_threads(1);
+  EXPECT_EQ(pool.num_threads(), 1u);
+
+  // single thread runs everything on the caller
+  std::atomic<size_t> count(0);
+  pool.parallel_for(0, 10, 1, [&](size_t begin, size_t end) {
+    count += end - begin;
+  });
+  EXPECT_EQ(count.load(), 10u);
+}
+
+TEST(thread_pool, affinity) {
+  thread_pool pool(2);
+#if defined(__linux__)
+  EXPECT_TRUE(pool.set_affinity({0}));
+#endif
+  EXPECT_TRUE(pool.set_affinity({}));
+}
+
+TEST(thread_pool, for_partials) {
+  for (size_t samples : {1u, 5u, 16u, 37u}) {
+    for (size_t partials = 1; partials <= samples; partials += 3) {
+      std::vector<size_t> owner(samples, partials);
+      for_partials(true, samples, partials, [&](size_t partial, size_t i) {
+        owner[i] = partial;
+      });
+      for (size_t i = 0; i < samples; i++) {
+        EXPECT_EQ(owner[i], partial_index(i, samples, partials));
+        // chunks are contiguous
+        if (i > 0) {
+          EXPECT_LE(owner[i - 1], owner[i]);
+        }
+      }
+    }
+  }
+}
+
+TEST(task_graph, respects_dependencies) {
+  thread_pool pool(4);
+
+  // diamond 0 -> {1, 2, 3} -> 4, plus chain 5 -> 6
+  task_graph g(7);
+  for (size_t i = 1; i <= 3; i++) {
+    g.add_dependency(0, i);
+    g.add_dependency(i, 4);
+  }
+  g.add_dependency(5, 6);
+  g.add_dependency(5, 6);  // duplicates are ignored
+  EXPECT_EQ(g.successors(5).size(), 1u);
+
+  for (int iter = 0; iter < 20; iter++) {
+    std::atomic<size_t> clock(0);
+    std::vector<std::atomic<size_t>> finished(g.size());
+    g.run(pool, [&](size_t task) { finished[task] = ++clock; });
+
+    for (size_t i = 1; i <= 3; i++) {
+      EXPECT_LT(finished[0].load(), finished[i].load());
+      EXPECT_LT(finished[i].load(), finished[4].load());
+    }
+    EXPECT_LT(finished[5].load(), finished[6].load());
+    EXPECT_EQ(clock.load(), g.size());
+  }
+}
+
+TEST(task_graph, exception) {
+  thread_pool pool(4);
+  task_graph g(3);
+  g.add_dependency(0, 1);
+  g.add_dependency(1, 2);
+
+  std::atomic<bool> reached(false);
+  EXPECT_THROW(g.run(pool,
+                     [&](size_t task) {
+                       if (task == 1) throw nn_error("fail");
+                       if (task == 2) reached = true;
+                     }),
+               nn_error);
+  EXPECT_FALSE(reached.load());
+
+  EXPECT_THROW(g.add_dependency(0, 3), nn_error);
+}
+
+}  // namespace tiny_dnn
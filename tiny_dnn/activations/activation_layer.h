@@ -102,6 +102,14 @@ class activation_layer : public layer {
    **/
   virtual void forward_activation(const vec_t &x, vec_t &y) = 0;
 
+  /**
+   * y = f(y) for one sample, for layers whose kernels apply this activation
+   * to each output sample they write (see layer::fuse)
+   **/
+  core::sample_epilogue epilogue() {
+    return [this](vec_t &y) { forward_activation(y, y); };
+  }
+
   /**
    * Populate vec_t of elements 'dx' according to gradient of activation.
    *
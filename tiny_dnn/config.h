@@ -79,6 +79,12 @@
 #define CNN_TASK_SIZE 8
 #endif
 
+/**
+ * number of samples forwarded at once by network::predict_batch
+ * (and network::test / network::get_loss built on it)
+ */
+#define CNN_PREDICT_BATCH_SIZE 256
+
 namespace tiny_dnn {
 
 /**
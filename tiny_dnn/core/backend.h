@@ -9,6 +9,7 @@
 
 #include <vector>
 
+#include "tiny_dnn/core/kernels/conv2d_op_winograd.h"
 #include "tiny_dnn/core/params/conv_params.h"
 #include "tiny_dnn/core/params/deconv_params.h"
 #include "tiny_dnn/core/params/fully_params.h"
@@ -27,7 +28,19 @@ namespace core {
 // TODO(edgar): remove this
 class context;
 
-enum class backend_t { internal, nnpack, libdnn, avx, opencl };
+/**
+ * engines of the layers. automatic is not an engine of its own: it lets a
+ * layer pick one from its parameters, see default_engine(const conv_params &)
+ **/
+enum class backend_t {
+  internal,
+  nnpack,
+  libdnn,
+  avx,
+  opencl,
+  winograd,
+  automatic
+};
 
 inline std::ostream &operator<<(std::ostream &os, backend_t type) {
   switch (type) {
@@ -36,6 +49,8 @@ inline std::ostream &operator<<(std::ostream &os, backend_t type) {
     case backend_t::libdnn: os << "LibDNN"; break;
     case backend_t::avx: os << "AVX"; break;
     case backend_t::opencl: os << "OpenCL"; break;
+    case backend_t::winograd: os << "Winograd"; break;
+    case backend_t::automatic: os << "Automatic"; break;
     default: throw nn_error("Not supported ostream enum."); break;
   }
   return os;
@@ -53,6 +68,15 @@ inline backend_t default_engine() {
 #endif
 }
 
+/**
+ * engine for a convolution with the given parameters: stride-1 3x3
+ * convolutions use the Winograd engine, others default_engine()
+ **/
+inline backend_t default_engine(const conv_params &params) {
+  return kernels::conv2d_winograd_supported(params) ? backend_t::winograd
+                                                    : default_engine();
+}
+
 #ifdef CNN_USE_NNPACK
 // Singleton to keep a global state whether NNPACK is initialized.
 // Before using the API an initialization is required. For this reason
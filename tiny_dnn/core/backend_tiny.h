@@ -16,10 +16,9 @@
 #include "tiny_dnn/core/kernels/tiny_deconv2d_kernel.h"
 #include "tiny_dnn/core/kernels/tiny_quantized_conv2d_kernel.h"
 #include "tiny_dnn/core/kernels/tiny_quantized_deconv2d_kernel.h"
-
-#ifdef CNN_USE_GEMMLOWP
 #include "tiny_dnn/core/kernels/tiny_quantized_fully_connected_kernel.h"
-#endif  // CNN_USE_GEMMLOWP
+#include "tiny_dnn/core/kernels/tiny_quantized_weights.h"
+#include "tiny_dnn/core/params/quantization_params.h"
 
 namespace tiny_dnn {
 namespace core {
@@ -75,20 +74,20 @@ class tiny_backend : public backend {
       backward_activation(f3) {}
 
   // fully_connected
-  explicit tiny_backend(fully_params *params)
-#if 0
-    : params_f_(params)
-#endif
-  {
-    CNN_UNREFERENCED_PARAMETER(params);
-  }
+  explicit tiny_backend(fully_params *params) : params_f_(params) {}
 
   // quantized fully_connected
   tiny_backend(
     fully_params *params,
     std::function<void(const tensor_t &, const tensor_t &, tensor_t &)> f)
-    : /*params_f_(params),*/ backward_activation(f) {
-    CNN_UNREFERENCED_PARAMETER(params);
+    : params_f_(params), backward_activation(f) {}
+
+  /**
+   * calibrated ranges and weight scales of a quantized layer, owned by the
+   * layer. without them the ranges are measured on every call.
+   **/
+  void set_quantization_params(const quantization_params *params) {
+    qparams_ = params;
   }
 
   // core math functions
@@ -97,18 +96,36 @@ class tiny_backend : public backend {
   void conv2d_q(const std::vector<tensor_t *> &in_data,
                 std::vector<tensor_t *> &out_data) override {
     copy_and_pad_input(*in_data[0]);
-    const vec_t &W    = (*in_data[1])[0];
-    const vec_t &bias = (*in_data[2])[0];
-    tensor_t &out     = *out_data[0];
+    const size_t block = params_c_->in.depth_ * params_c_->weight.area();
+    const auto w       = cached_weights(in_data, params_c_->out.depth_, block);
+    const vec_t *b     = params_c_->has_bias ? &(*in_data[2])[0] : nullptr;
+    tensor_t &out      = *out_data[0];
     const std::vector<const vec_t *> &in =
       (*conv_layer_worker_storage_).prev_out_padded_;  // input // NOLINT
+    const kernels::quantized_activations *in_q = quantized_input(*in_data[0]);
+    const bool same = params_c_->pad_type == padding::same;
 
-    fill_tensor(out, float_t{0});
-
+    begin_quantized_output(in.size());
     for (size_t i = 0; i < in.size(); i++) {
-      kernels::tiny_quantized_conv2d_kernel(*params_c_, *in[i], W, bias, out[i],
-                                            layer_->parallelize());
+      float_t min_input, max_input;
+      const std::vector<uint8_t> *in_quantized = &input_buf_;
+      if (same && in_q &&
+          kernels::pad_quantized_input(*params_c_, in_q->codes[i],
+                                       in_q->min[i], in_q->max[i],
+                                       input_buf_)) {
+        min_input = in_q->min[i];
+        max_input = in_q->max[i];
+      } else {
+        in_quantized = &quantize_input(same ? nullptr : in_q, i, *in[i],
+                                       &min_input, &max_input);
+      }
+      kernels::tiny_quantized_conv2d_kernel(
+        *params_c_, *in_quantized, min_input, max_input, *w, b,
+        quantized_out_.codes[i], &quantized_out_.min[i],
+        &quantized_out_.max[i], layer_->parallelize());
+      dequantize_output(i, out[i]);
     }
+    quantized_out_.publish(out);
   }
 
   // efficient quantization without abundant quantization/dequantization
@@ -158,8 +175,9 @@ class tiny_backend : public backend {
     fill_tensor(*prev_delta, float_t{0});
 
     for (size_t i = 0; i < prev_out.size(); i++) {
+      const size_t p = partial_index(i, prev_out.size(), dW.size());
       kernels::tiny_quantized_conv2d_back_kernel(*params_c_, *prev_out[i], W,
-                                                 dW[i], db[i], curr_delta[i],
+                                                 dW[p], db[p], curr_delta[i],
                                                  &(*prev_delta)[i]);
     }
 
@@ -192,21 +210,29 @@ class tiny_backend : public backend {
                   std::vector<tensor_t *> &out_data) override {
     (*deconv_layer_worker_storage_).prev_out_ = in_data[0];
     const tensor_t &in                        = *in_data[0];  // input
-    const vec_t &W                            = (*in_data[1])[0];
-    const vec_t &bias                         = (*in_data[2])[0];
-    tensor_t &out                             = *out_data[0];
-
-    fill_tensor(
-      out, float_t{0},
-      params_d_->out.size());  // deconv2d-kernel requires padded size buffer
+    const size_t block = params_d_->in.depth_ * params_d_->weight.area();
+    const auto w       = cached_weights(in_data, params_d_->out.depth_, block);
+    const vec_t *b     = params_d_->has_bias ? &(*in_data[2])[0] : nullptr;
+    tensor_t &out      = *out_data[0];
+    const kernels::quantized_activations *in_q = quantized_input(in);
 
+    out.resize(in.size());
+    begin_quantized_output(in.size());
     for (size_t i = 0; i < in.size(); i++) {
-      kernels::tiny_quantized_deconv2d_kernel(*params_d_, in[i], W, bias,
-                                              out[i], layer_->parallelize());
+      float_t min_input, max_input;
+      const std::vector<uint8_t> &in_quantized =
+        quantize_input(in_q, i, in[i], &min_input, &max_input);
+      kernels::tiny_quantized_deconv2d_kernel(
+        *params_d_, in_quantized, min_input, max_input, *w, b,
+        quantized_out_.codes[i], &quantized_out_.min[i],
+        &quantized_out_.max[i], layer_->parallelize());
+      dequantize_output(i, out[i]);  // padded size
     }
 
     copy_and_unpad_output(out);
     out = *(*deconv_layer_worker_storage_).curr_out_unpadded_;
+    // the codes cover the padded output only
+    if (params_d_->pad_type == padding::valid) quantized_out_.publish(out);
   }
 
   // efficient quantization without abundant quantization/dequantization
@@ -291,31 +317,40 @@ class tiny_backend : public backend {
     fill_tensor(*prev_delta, float_t{0});
 
     for (size_t i = 0; i < prev_out.size(); i++) {
+      const size_t p = partial_index(i, prev_out.size(), dW.size());
       kernels::tiny_quantized_deconv2d_back_kernel(*params_d_, prev_out[i], W,
-                                                   dW[i], db[i], curr_delta[i],
+                                                   dW[p], db[p], curr_delta[i],
                                                    &(*prev_delta)[i]);
     }
   }
 
   void fully_q(const std::vector<tensor_t *> &in_data,
                std::vector<tensor_t *> &out_data) override {
-#ifdef CNN_USE_GEMMLOWP
     const tensor_t &in = *in_data[0];
-    const vec_t &W     = (*in_data[1])[0];
+    const auto w       = cached_weights(in_data, params_f_->out_size_, 1);
+    const vec_t *b     = params_f_->has_bias_ ? &(*in_data[2])[0] : nullptr;
     tensor_t &out      = *out_data[0];
+    const kernels::quantized_activations *in_q = quantized_input(in);
 
+    // the whole batch goes through one 8-bit GEMM, each sample keeping its
+    // own input range
+    const size_t in_size = params_f_->in_size_;
+    std::vector<float_t> min_input(in.size()), max_input(in.size());
+    batch_buf_.resize(in.size() * in_size);
     for (size_t i = 0; i < in.size(); i++) {
-      kernels::tiny_quantized_fully_connected_kernel(
-        *params_f_, in[i], W, params_f_->has_bias_ ? (*in_data[2])[0] : vec_t(),
-        out[i], layer_->parallelize());
+      const std::vector<uint8_t> &in_quantized =
+        quantize_input(in_q, i, in[i], &min_input[i], &max_input[i]);
+      std::copy(in_quantized.begin(), in_quantized.end(),
+                batch_buf_.begin() + i * in_size);
     }
-#else
-    CNN_UNREFERENCED_PARAMETER(in_data);
-    CNN_UNREFERENCED_PARAMETER(out_data);
-    throw nn_not_implemented_error(
-      "quantized fully op requires gemmlowp "
-      "library. please define CNN_USE_GEMMLOWP");
-#endif
+
+    begin_quantized_output(in.size());
+    kernels::tiny_quantized_fully_connected_kernel(
+      *params_f_, batch_buf_, min_input, max_input, *w, b,
+      quantized_out_.codes, quantized_out_.min, quantized_out_.max,
+      layer_->parallelize());
+    for (size_t i = 0; i < in.size(); i++) dequantize_output(i, out[i]);
+    quantized_out_.publish(out);
   }
 
   void fully_eq(const std::vector<tensor_t *> &in_data,
@@ -359,8 +394,9 @@ class tiny_backend : public backend {
     backward_activation(*out_grad[0], *out_data[0], curr_delta);
 
     for (size_t i = 0; i < prev_out.size(); i++) {
+      const size_t p = partial_index(i, prev_out.size(), dW.size());
       kernels::tiny_quantized_fully_connected_back_kernel(
-        *params_f_, prev_out[i], W, dW[i], prev_delta[i], curr_delta[i], db[i],
+        *params_f_, prev_out[i], W, dW[p], prev_delta[i], curr_delta[i], db[p],
         layer_->parallelize());
     }
 #else
@@ -377,10 +413,87 @@ class tiny_backend : public backend {
   backend_t type() const override { return default_engine(); }
 
  private:
+  // weights of the layer in 8 bit, quantized again only after the weights
+  // version of the layer changed. with per-channel scales, weight k belongs
+  // to channel (k / block) % channels
+  std::shared_ptr<const kernels::quantized_weights> cached_weights(
+    const std::vector<tensor_t *> &in_data, size_t channels, size_t block) {
+    const bool per_channel = qparams_ && qparams_->per_channel;
+    return weight_cache_.get((*in_data[1])[0],
+                             layer_->weights_version(in_data),
+                             per_channel ? channels : 1, block);
+  }
+
+  // the codes of in if it was written by a quantized layer, so that
+  // consecutive quantized layers skip dequantizing and quantizing again
+  const kernels::quantized_activations *quantized_input(
+    const tensor_t &in) const {
+    const edgeptr_t &e = layer_->prev()[0];
+    layer *producer    = e ? dynamic_cast<layer *>(e->prev()) : nullptr;
+    const tiny_backend *b =
+      producer ? dynamic_cast<const tiny_backend *>(producer->backend().get())
+               : nullptr;
+    if (!b || !b->quantized_out_.describes(in)) return nullptr;
+    return &b->quantized_out_;
+  }
+
+  // sample i of the input in 8 bit: the codes of the producer if given,
+  // otherwise in quantized over the calibrated range or its own
+  const std::vector<uint8_t> &quantize_input(
+    const kernels::quantized_activations *in_q,
+    size_t i,
+    const vec_t &in,
+    float_t *min_input,
+    float_t *max_input) {
+    if (in_q) {
+      *min_input = in_q->min[i];
+      *max_input = in_q->max[i];
+      return in_q->codes[i];
+    }
+    if (qparams_ && qparams_->static_input()) {
+      *min_input = qparams_->min_input;
+      *max_input = qparams_->max_input;
+    } else {
+      kernels::quantization_range(in, min_input, max_input);
+    }
+    input_buf_.resize(in.size());
+    kernels::float_tensor_to_quantized_in_place<uint8_t>(in, *min_input,
+                                                         *max_input,
+                                                         &input_buf_);
+    return input_buf_;
+  }
+
+  // an empty output range lets the kernels measure it
+  void begin_quantized_output(size_t sample_count) {
+    const bool fixed = qparams_ && qparams_->static_output();
+    quantized_out_.clear();
+    quantized_out_.codes.resize(sample_count);
+    quantized_out_.min.assign(sample_count,
+                              fixed ? qparams_->min_output : float_t(0));
+    quantized_out_.max.assign(sample_count,
+                              fixed ? qparams_->max_output : float_t(0));
+  }
+
+  void dequantize_output(size_t i, vec_t &out) {
+    out.resize(quantized_out_.codes[i].size());
+    kernels::quantized_tensor_to_float_in_place<uint8_t>(
+      quantized_out_.codes[i], quantized_out_.min[i], quantized_out_.max[i],
+      &out);
+  }
+
   /* Pointer to the convolution parameters */
   conv_params *params_c_;
   deconv_params *params_d_;
-  // fully_params *params_f_;
+  fully_params *params_f_;
+
+  /* Calibration of a quantized layer, if any */
+  const quantization_params *qparams_ = nullptr;
+
+  /* Quantized weights and the 8-bit output of the last forward pass */
+  kernels::quantized_weight_cache weight_cache_;
+  kernels::quantized_activations quantized_out_;
+  std::vector<uint8_t> input_buf_;
+  std::vector<uint8_t> batch_buf_;
 
   /* Pointer to the workers */
   conv_layer_worker_specific_storage *conv_layer_worker_storage_;
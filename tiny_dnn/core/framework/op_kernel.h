@@ -55,6 +55,12 @@ class OpKernelContext {
     bool parallelize = false;
 
     backend_t engine = default_engine();
+
+    // applied to every output sample, e.g. a fused activation
+    sample_epilogue epilogue;
+
+    // stamp of the weights in the inputs, see layer::weights_version()
+    uint64_t weights_version = 0;
   };
 
   OpKernelContext()
@@ -117,6 +123,37 @@ class OpKernelContext {
 
   void setEngine(const backend_t engine) { op_params_->engine = engine; }
 
+  /**
+   * transformation the kernel applies to every output sample it writes,
+   * none if empty
+   **/
+  const sample_epilogue &epilogue() const { return op_params_->epilogue; }
+
+  void setEpilogue(const sample_epilogue &epilogue) {
+    op_params_->epilogue = epilogue;
+  }
+
+  /**
+   * stamp of the weights among the inputs. values the kernel derives from
+   * the weights stay valid as long as the stamp does not change; 0 if it is
+   * unknown and nothing may be cached.
+   **/
+  uint64_t weights_version() const { return op_params_->weights_version; }
+
+  void setWeightsVersion(const uint64_t version) {
+    op_params_->weights_version = version;
+  }
+
+  /**
+   * apply the epilogue to every sample of out, for kernels which cannot
+   * apply it while writing the samples
+   **/
+  void apply_epilogue(tensor_t &out) const {
+    const sample_epilogue &f = epilogue();
+    if (!f) return;
+    for_i(parallelize(), out.size(), [&](size_t sample) { f(out[sample]); });
+  }
+
  private:
   std::vector<tensor_t *> *in_data_;
   std::vector<tensor_t *> *out_data_;
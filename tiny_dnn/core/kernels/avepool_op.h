@@ -0,0 +1,48 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include "tiny_dnn/core/framework/op_kernel.h"
+
+#include "tiny_dnn/core/kernels/avepool_op_avx.h"
+#include "tiny_dnn/core/kernels/avepool_op_internal.h"
+
+namespace tiny_dnn {
+
+class AvePoolOp : public core::OpKernel {
+ public:
+  explicit AvePoolOp(const core::OpKernelConstruction &context)
+    : core::OpKernel(context) {}
+
+  void compute(core::OpKernelContext &context) override {
+    auto &params = OpKernel::params_->avepool();
+
+    // incomimg/outcoming data
+    const tensor_t &in_data = context.input(0);
+    const vec_t &W          = context.input(1)[0];
+    const vec_t &bias       = context.input(2)[0];
+    tensor_t &out_data      = context.output(0);
+
+    // call the algorithm depending on the selected engine type
+
+    const core::backend_t engine = context.engine();
+
+    if (engine == core::backend_t::internal ||
+        engine == core::backend_t::nnpack) {
+      kernels::avepool_op_internal(in_data, W, bias, out_data, params,
+                                   context.parallelize());
+    } else if (engine == core::backend_t::avx) {
+      kernels::avepool_op_avx(in_data, W, bias, out_data, params,
+                              context.parallelize());
+    } else {
+      throw nn_error("Not supported engine: " + to_string(engine));
+    }
+  }
+};
+
+}  // namespace tiny_dnn
@@ -0,0 +1,147 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#ifdef CNN_USE_AVX
+#include <immintrin.h>
+
+#include "tiny_dnn/core/kernels/avx_kernel_common.h"
+#endif
+
+#include "tiny_dnn/core/kernels/avepool_op_internal.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+#ifdef CNN_USE_AVX
+#ifndef CNN_USE_DOUBLE
+
+/**
+ * window sums of a plane, as avepool_window_sums_internal. the rows of the
+ * windows are summed 8 columns at a time, and the columns 8 windows at a
+ * time for 2-wide windows with stride 2.
+ **/
+inline void avepool_window_sums_avx(const core::avepool_params &params,
+                                    const float *in,
+                                    float *sums) {
+  const size_t w         = params.in.width_;
+  const size_t windows_x = params.windows_x();
+  const size_t windows_y = params.windows_y();
+  const bool pairs       = params.pool_size_x == 2 && params.stride_x == 2;
+  std::fill(sums, sums + params.out.area(), 0.0f);
+
+  std::vector<float> col(w);
+  for (size_t oy = 0; oy < windows_y; oy++) {
+    const float *row = in + oy * params.stride_y * w;
+    size_t x         = 0;
+    for (; x + 8 <= w; x += 8) {
+      __m256 s = _mm256_loadu_ps(row + x);
+      for (size_t dy = 1; dy < params.pool_size_y; dy++) {
+        s = _mm256_add_ps(s, _mm256_loadu_ps(row + dy * w + x));
+      }
+      _mm256_storeu_ps(&col[x], s);
+    }
+    for (; x < w; x++) {
+      float s = row[x];
+      for (size_t dy = 1; dy < params.pool_size_y; dy++) s += row[dy * w + x];
+      col[x] = s;
+    }
+
+    float *s  = sums + oy * params.out.width_;
+    size_t ox = 0;
+    if (pairs) {
+      for (; ox + 8 <= windows_x; ox += 8) {
+        __m256 even, odd;
+        deinterleave_ps(&col[2 * ox], &even, &odd);
+        _mm256_storeu_ps(s + ox, _mm256_add_ps(even, odd));
+      }
+    }
+    for (; ox < windows_x; ox++) {
+      const float *p = &col[ox * params.stride_x];
+      for (size_t dx = 0; dx < params.pool_size_x; dx++) s[ox] += p[dx];
+    }
+  }
+}
+
+/**
+ * gradient spread of a plane, as avepool_spread_internal. 2-wide windows
+ * with stride 2 are spread 8 windows at a time.
+ **/
+inline void avepool_spread_avx(const core::avepool_params &params,
+                               const float *g,
+                               float *prev) {
+  const size_t w         = params.in.width_;
+  const size_t windows_x = params.windows_x();
+  const bool pairs       = params.pool_size_x == 2 && params.stride_x == 2;
+
+  for (size_t oy = 0; oy < params.windows_y(); oy++) {
+    const float *go = g + oy * params.out.width_;
+    for (size_t dy = 0; dy < params.pool_size_y; dy++) {
+      float *row = prev + (oy * params.stride_y + dy) * w;
+      size_t ox  = 0;
+      if (pairs) {
+        for (; ox + 8 <= windows_x; ox += 8) {
+          // lo = ( g5, g5, g4, g4, g1, g1, g0, g0 ), hi likewise
+          const __m256 v  = _mm256_loadu_ps(go + ox);
+          const __m256 lo = _mm256_unpacklo_ps(v, v);
+          const __m256 hi = _mm256_unpackhi_ps(v, v);
+          const __m256 g0 = _mm256_permute2f128_ps(lo, hi, 0x20);
+          const __m256 g1 = _mm256_permute2f128_ps(lo, hi, 0x31);
+          float *p        = row + 2 * ox;
+          _mm256_storeu_ps(p, _mm256_add_ps(_mm256_loadu_ps(p), g0));
+          _mm256_storeu_ps(p + 8, _mm256_add_ps(_mm256_loadu_ps(p + 8), g1));
+        }
+      }
+      for (; ox < windows_x; ox++) {
+        float *p = row + ox * params.stride_x;
+        for (size_t dx = 0; dx < params.pool_size_x; dx++) p[dx] += go[ox];
+      }
+    }
+  }
+}
+
+#endif  // CNN_USE_DOUBLE
+#endif  // CNN_USE_AVX
+
+inline void avepool_op_avx(const tensor_t &in_data,
+                           const vec_t &W,
+                           const vec_t &bias,
+                           tensor_t &out_data,
+                           const core::avepool_params &params,
+                           const bool layer_parallelize) {
+#if defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  avepool_op(in_data, W, bias, out_data, params, layer_parallelize,
+             avepool_window_sums_avx);
+#else
+  avepool_op_internal(in_data, W, bias, out_data, params, layer_parallelize);
+#endif
+}
+
+inline void avepool_grad_op_avx(const tensor_t &prev_out,
+                                const vec_t &W,
+                                tensor_t &dW,
+                                tensor_t &db,
+                                const tensor_t &curr_delta,
+                                tensor_t &prev_delta,
+                                const core::avepool_params &params,
+                                const bool layer_parallelize) {
+#if defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  avepool_grad_op(prev_out, W, dW, db, curr_delta, prev_delta, params,
+                  layer_parallelize, avepool_window_sums_avx,
+                  avepool_spread_avx);
+#else
+  avepool_grad_op_internal(prev_out, W, dW, db, curr_delta, prev_delta, params,
+                           layer_parallelize);
+#endif
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
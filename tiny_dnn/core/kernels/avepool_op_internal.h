@@ -0,0 +1,161 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "tiny_dnn/core/params/avepool_params.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * average pooling of planes of params.in into planes of params.out. output
+ * o of channel c is W[c] / (pool_size_x * pool_size_y) times the sum of
+ * its window plus bias[c]. the windows which do not lie within the input
+ * (with padding::same) are empty, their outputs hold only the bias.
+ *
+ * the drivers below walk the batch plane by plane; the per-plane work is
+ * done by the window_sums and spread functions of an engine:
+ *
+ *     window_sums(params, in, sums)  sums[o] = sum of the window of o
+ *     spread(params, g, prev)        prev[i] += g[o] for the windows o of i
+ **/
+template <typename WindowSums>
+inline void avepool_op(const tensor_t &in_data,
+                       const vec_t &W,
+                       const vec_t &bias,
+                       tensor_t &out_data,
+                       const core::avepool_params &params,
+                       const bool parallelize,
+                       WindowSums window_sums) {
+  const size_t in_area  = params.in.area();
+  const size_t out_area = params.out.area();
+  const size_t depth    = params.in.depth_;
+  const float_t scale   = params.scale_factor();
+
+  for_i(parallelize, in_data.size() * depth, [&](size_t i) {
+    const size_t sample = i / depth, c = i % depth;
+    float_t *out        = &out_data[sample][c * out_area];
+    window_sums(params, &in_data[sample][c * in_area], out);
+
+    const float_t weight = W[c] * scale;
+    for (size_t o = 0; o < out_area; o++) out[o] = out[o] * weight + bias[c];
+  });
+}
+
+template <typename WindowSums, typename Spread>
+inline void avepool_grad_op(const tensor_t &prev_out,
+                            const vec_t &W,
+                            tensor_t &dW,
+                            tensor_t &db,
+                            const tensor_t &curr_delta,
+                            tensor_t &prev_delta,
+                            const core::avepool_params &params,
+                            const bool parallelize,
+                            WindowSums window_sums,
+                            Spread spread) {
+  const size_t in_area  = params.in.area();
+  const size_t out_area = params.out.area();
+  const size_t depth    = params.in.depth_;
+  const float_t scale   = params.scale_factor();
+
+  // samples sharing a row of dW and db (partial sums) run on the same task
+  for_partials(parallelize, prev_out.size(), dW.size(), [&](size_t partial,
+                                                            size_t sample) {
+    std::vector<float_t> buf(out_area);
+    for (size_t c = 0; c < depth; c++) {
+      const float_t *curr = &curr_delta[sample][c * out_area];
+
+      // dW[c] sums curr times the window sums, db[c] sums curr
+      window_sums(params, &prev_out[sample][c * in_area], &buf[0]);
+      float_t dw{0}, d{0};
+      for (size_t o = 0; o < out_area; o++) {
+        dw += curr[o] * buf[o];
+        d += curr[o];
+      }
+      dW[partial][c] += dw * scale;
+      db[partial][c] += d;
+
+      const float_t weight = W[c] * scale;
+      for (size_t o = 0; o < out_area; o++) buf[o] = curr[o] * weight;
+      spread(params, &buf[0], &prev_delta[sample][c * in_area]);
+    }
+  });
+}
+
+template <typename T>
+inline void avepool_window_sums_internal(const core::avepool_params &params,
+                                         const T *in,
+                                         T *sums) {
+  const size_t w         = params.in.width_;
+  const size_t windows_x = params.windows_x();
+  const size_t windows_y = params.windows_y();
+  std::fill(sums, sums + params.out.area(), T{0});
+
+  // sum the rows of the windows, then the columns
+  std::vector<T> col(w);
+  for (size_t oy = 0; oy < windows_y; oy++) {
+    const T *row = in + oy * params.stride_y * w;
+    std::copy(row, row + w, col.begin());
+    for (size_t dy = 1; dy < params.pool_size_y; dy++) {
+      row += w;
+      for (size_t x = 0; x < w; x++) col[x] += row[x];
+    }
+
+    T *s = sums + oy * params.out.width_;
+    for (size_t ox = 0; ox < windows_x; ox++) {
+      const T *p = &col[ox * params.stride_x];
+      for (size_t dx = 0; dx < params.pool_size_x; dx++) s[ox] += p[dx];
+    }
+  }
+}
+
+template <typename T>
+inline void avepool_spread_internal(const core::avepool_params &params,
+                                    const T *g,
+                                    T *prev) {
+  const size_t w = params.in.width_;
+  for (size_t oy = 0; oy < params.windows_y(); oy++) {
+    const T *go = g + oy * params.out.width_;
+    for (size_t dy = 0; dy < params.pool_size_y; dy++) {
+      T *row = prev + (oy * params.stride_y + dy) * w;
+      for (size_t ox = 0; ox < params.windows_x(); ox++) {
+        T *p = row + ox * params.stride_x;
+        for (size_t dx = 0; dx < params.pool_size_x; dx++) p[dx] += go[ox];
+      }
+    }
+  }
+}
+
+inline void avepool_op_internal(const tensor_t &in_data,
+                                const vec_t &W,
+                                const vec_t &bias,
+                                tensor_t &out_data,
+                                const core::avepool_params &params,
+                                const bool layer_parallelize) {
+  avepool_op(in_data, W, bias, out_data, params, layer_parallelize,
+             avepool_window_sums_internal<float_t>);
+}
+
+inline void avepool_grad_op_internal(const tensor_t &prev_out,
+                                     const vec_t &W,
+                                     tensor_t &dW,
+                                     tensor_t &db,
+                                     const tensor_t &curr_delta,
+                                     tensor_t &prev_delta,
+                                     const core::avepool_params &params,
+                                     const bool layer_parallelize) {
+  avepool_grad_op(prev_out, W, dW, db, curr_delta, prev_delta, params,
+                  layer_parallelize, avepool_window_sums_internal<float_t>,
+                  avepool_spread_internal<float_t>);
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -56,6 +56,17 @@ inline __m128d madd128_sd(__m128d a, __m128d b, __m128d c) {
 }
 #endif
 
+// split p[0..15] into its even elements ( p14, ..., p2, p0 ) and its odd
+// elements ( p15, ..., p3, p1 )
+inline void deinterleave_ps(const float *p, __m256 *even, __m256 *odd) {
+  const __m256 a  = _mm256_loadu_ps(p);
+  const __m256 b  = _mm256_loadu_ps(p + 8);
+  const __m256 lo = _mm256_permute2f128_ps(a, b, 0x20);
+  const __m256 hi = _mm256_permute2f128_ps(a, b, 0x31);
+  *even           = _mm256_shuffle_ps(lo, hi, 0x88);
+  *odd            = _mm256_shuffle_ps(lo, hi, 0xdd);
+}
+
 // Horizontally add elements of __m256 type argument (sadly, _mm256_hadd_ps
 // isn't good enough)
 // http://stackoverflow.com/a/13222410/4699324
@@ -211,7 +222,7 @@ struct m256_shift_left_impl {};
 
 template <unsigned int N>
 struct m256_shift_left_impl<N, Range<N == 0>> {
-  static __m256 doit(__m256i a) { return a; }
+  static __m256 doit(__m256 a) { return a; }
 };
 
 template <unsigned int N>
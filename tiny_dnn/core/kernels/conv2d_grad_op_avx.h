@@ -8,6 +8,7 @@
 #pragma once
 
 #include <vector>
+#include "tiny_dnn/core/kernels/conv2d_op_gemm.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
 #include "tiny_dnn/core/params/conv_params.h"
 
@@ -868,11 +869,12 @@ void avx_conv2d_5x5_back_kernel(
   std::vector<std::vector<float, Allocator>> &curr_delta,
   std::vector<std::vector<float, Allocator>> &prev_delta,
   bool layer_parallelize) {
-  for_i(layer_parallelize, prev_out.size(), [&](size_t sample) {
-    avx_conv2d_5x5_back_kernel_one(params, prev_out[sample], W, dW[sample],
-                                   db[sample], curr_delta[sample],
-                                   &prev_delta[sample]);
-  });
+  for_partials(layer_parallelize, prev_out.size(), dW.size(),
+               [&](size_t partial, size_t sample) {
+                 avx_conv2d_5x5_back_kernel_one(
+                   params, prev_out[sample], W, dW[partial], db[partial],
+                   curr_delta[sample], &prev_delta[sample]);
+               });
 }
 
 #endif  // CNN_USE_AVX
@@ -893,8 +895,9 @@ inline void conv2d_grad_op_avx(const tensor_t &prev_out,
   }
 #endif
 
-  conv2d_op_internal(prev_out, W, dW, db, curr_delta, prev_delta, params,
-                     layer_parallelize);
+  // other kernel shapes are lowered to matrix products
+  conv2d_grad_op_gemm(prev_out, W, dW, db, curr_delta, prev_delta, params,
+                      layer_parallelize);
 }
 
 }  // namespace kernels
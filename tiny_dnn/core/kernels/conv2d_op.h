@@ -12,6 +12,7 @@
 #include "tiny_dnn/core/kernels/conv2d_op_avx.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
 #include "tiny_dnn/core/kernels/conv2d_op_nnpack.h"
+#include "tiny_dnn/core/kernels/conv2d_op_winograd.h"
 
 namespace tiny_dnn {
 
@@ -20,6 +21,14 @@ class Conv2dOp : public core::OpKernel {
   explicit Conv2dOp(const core::OpKernelConstruction &context)
     : core::OpKernel(context) {}
 
+  /**
+   * share the state derived from the weights (the transformed Winograd
+   * filters) with another kernel reading the same weights
+   **/
+  void share_weight_cache(const Conv2dOp &other) {
+    winograd_filter_.share(other.winograd_filter_);
+  }
+
   void compute(core::OpKernelContext &context) override {
     auto params = OpKernel::params_->conv();
 
@@ -39,16 +48,31 @@ class Conv2dOp : public core::OpKernel {
 
     if (engine == core::backend_t::internal) {
       kernels::conv2d_op_internal(in_data, W[0], bias[0], out_data, params,
-                                  context.parallelize());
+                                  context.parallelize(), context.epilogue());
     } else if (engine == core::backend_t::nnpack) {
       kernels::conv2d_op_nnpack(in_data, W[0], bias[0], out_data, params);
+      context.apply_epilogue(out_data);
     } else if (engine == core::backend_t::avx) {
       kernels::conv2d_op_avx(in_data, W[0], bias[0], out_data, params,
-                             context.parallelize());
+                             context.parallelize(), context.epilogue());
+    } else if (engine == core::backend_t::winograd) {
+      if (kernels::conv2d_winograd_supported(params)) {
+        kernels::conv2d_op_winograd(in_data, W[0], bias[0], out_data, params,
+                                    winograd_filter_,
+                                    context.weights_version(),
+                                    context.parallelize(), context.epilogue());
+      } else {
+        kernels::conv2d_op_gemm(in_data, W[0], bias[0], out_data, params,
+                                context.parallelize(), context.epilogue());
+      }
     } else {
       throw nn_error("Not supported engine: " + to_string(engine));
     }
   }
+
+ private:
+  // transformed filters of the Winograd engine
+  kernels::conv2d_winograd_filter winograd_filter_;
 };
 
 }  // namespace tiny_dnn
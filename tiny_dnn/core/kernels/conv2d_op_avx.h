@@ -8,6 +8,7 @@
 #pragma once
 
 #include <vector>
+#include "tiny_dnn/core/kernels/conv2d_op_gemm.h"
 #include "tiny_dnn/core/kernels/conv2d_op_internal.h"
 #include "tiny_dnn/core/params/conv_params.h"
 
@@ -448,23 +449,28 @@ void avx_conv2d_5x5_kernel(const core::conv_params &params,
 
 #endif  // CNN_USE_AVX
 
-inline void conv2d_op_avx(const tensor_t &in_data,
-                          const vec_t &W,
-                          const vec_t &bias,
-                          tensor_t &out_data,
-                          const core::conv_params &params,
-                          const bool layer_parallelize) {
+inline void conv2d_op_avx(
+  const tensor_t &in_data,
+  const vec_t &W,
+  const vec_t &bias,
+  tensor_t &out_data,
+  const core::conv_params &params,
+  const bool layer_parallelize,
+  const core::sample_epilogue &epilogue = core::sample_epilogue()) {
 #ifdef CNN_USE_AVX
   if (params.weight.height_ == 5 && params.weight.width_ == 5) {
     // @todo consider better parallelization
     for_i(layer_parallelize, in_data.size(), [&](size_t i) {
       avx_conv2d_5x5_kernel(params, in_data[i], W, bias, out_data[i],
                             layer_parallelize);
+      if (epilogue) epilogue(out_data[i]);
     });
     return;
   }
 #endif
-  conv2d_op_internal(in_data, W, bias, out_data, params, layer_parallelize);
+  // other kernel shapes are lowered to matrix products
+  conv2d_op_gemm(in_data, W, bias, out_data, params, layer_parallelize,
+                 epilogue);
 }
 
 }  // namespace kernels
@@ -0,0 +1,377 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "tiny_dnn/core/kernels/gemm.h"
+#include "tiny_dnn/core/params/conv_params.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * shape of a convolution seen as matrix products.
+ *
+ * the weights form a [out.depth_ x in.depth_ * kh * kw] matrix. a
+ * block-diagonal connection_table (e.g. connection_table(ngroups, ...)) is
+ * lowered to one dense GEMM per group, any other sparse table to a single
+ * GEMM over weights whose unconnected blocks are zeroed.
+ **/
+struct conv_gemm_shape {
+  explicit conv_gemm_shape(const core::conv_params &params)
+    : kernel_area(params.weight.width_ * params.weight.height_),
+      in_depth(params.in.depth_),
+      out_depth(params.out.depth_),
+      rows(in_depth * kernel_area),
+      out_area(params.out.area()),
+      groups(1),
+      masked(false) {
+    const auto &tbl = params.tbl;
+    if (tbl.is_empty()) return;
+
+    bool dense = true;
+    for (size_t o = 0; o < out_depth && dense; o++) {
+      for (size_t inc = 0; inc < in_depth && dense; inc++) {
+        dense = tbl.is_connected(o, inc);
+      }
+    }
+    if (dense) return;
+
+    for (size_t g = std::min(in_depth, out_depth); g > 1; g--) {
+      if (in_depth % g == 0 && out_depth % g == 0 && is_grouped(tbl, g)) {
+        groups = g;
+        return;
+      }
+    }
+    masked = true;
+  }
+
+  size_t in_per_group() const { return in_depth / groups; }
+  size_t out_per_group() const { return out_depth / groups; }
+
+  ///< offset of the weights of group g within the weight matrix
+  size_t weight_offset(size_t g) const {
+    return g * out_per_group() * rows + g * in_per_group() * kernel_area;
+  }
+
+  size_t kernel_area;  // kh * kw
+  size_t in_depth;
+  size_t out_depth;
+  size_t rows;      // rows of the lowered input (= columns of the weights)
+  size_t out_area;  // columns of the lowered input per sample
+  size_t groups;
+  bool masked;
+
+ private:
+  bool is_grouped(const core::connection_table &tbl, size_t g) const {
+    const size_t ig = in_depth / g;
+    const size_t og = out_depth / g;
+    for (size_t o = 0; o < out_depth; o++) {
+      for (size_t inc = 0; inc < in_depth; inc++) {
+        if (tbl.is_connected(o, inc) != (o / og == inc / ig)) return false;
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * copy of W where the weights of unconnected channel pairs are zero
+ **/
+inline vec_t conv_gemm_masked_weights(const core::conv_params &params,
+                                      const vec_t &W) {
+  const conv_gemm_shape shape(params);
+  vec_t masked(W);
+  for (size_t o = 0; o < shape.out_depth; o++) {
+    for (size_t inc = 0; inc < shape.in_depth; inc++) {
+      if (params.tbl.is_connected(o, inc)) continue;
+      auto first = masked.begin() + (o * shape.in_depth + inc) *
+                                      shape.kernel_area;
+      std::fill(first, first + shape.kernel_area, float_t{0});
+    }
+  }
+  return masked;
+}
+
+/**
+ * number of samples lowered at once. the lowered input grows with
+ * kh * kw, so the batch is processed in chunks to bound the buffer size.
+ **/
+inline size_t conv_gemm_chunk(const conv_gemm_shape &shape, size_t samples) {
+  const size_t max_elements = size_t(1) << 22;
+  const size_t per_sample   = std::max(shape.rows * shape.out_area, size_t(1));
+  return std::max(size_t(1), std::min(samples, max_elements / per_sample));
+}
+
+/**
+ * im2col: lower one padded input sample into a [rows x out_area] block of
+ * the column buffer col, whose rows are ldcol elements apart
+ **/
+inline void conv_im2col(const core::conv_params &params,
+                        const float_t *in,
+                        float_t *col,
+                        size_t ldcol) {
+  const size_t iw = params.in_padded.width_;
+  const size_t ow = params.out.width_;
+  const size_t oh = params.out.height_;
+  const size_t ws = params.w_stride;
+
+  for (size_t inc = 0; inc < params.in.depth_; inc++) {
+    const float_t *pin = in + params.in_padded.get_index(0, 0, inc);
+    for (size_t ky = 0; ky < params.weight.height_; ky++) {
+      for (size_t kx = 0; kx < params.weight.width_; kx++, col += ldcol) {
+        float_t *dst = col;
+        for (size_t y = 0; y < oh; y++, dst += ow) {
+          const float_t *src = pin + (y * params.h_stride + ky) * iw + kx;
+          if (ws == 1) {
+            std::copy(src, src + ow, dst);
+          } else {
+            for (size_t x = 0; x < ow; x++) dst[x] = src[x * ws];
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * col2im: scatter-add a lowered block back into one padded sample
+ **/
+inline void conv_col2im(const core::conv_params &params,
+                        const float_t *col,
+                        size_t ldcol,
+                        float_t *in) {
+  const size_t iw = params.in_padded.width_;
+  const size_t ow = params.out.width_;
+  const size_t oh = params.out.height_;
+  const size_t ws = params.w_stride;
+
+  for (size_t inc = 0; inc < params.in.depth_; inc++) {
+    float_t *pin = in + params.in_padded.get_index(0, 0, inc);
+    for (size_t ky = 0; ky < params.weight.height_; ky++) {
+      for (size_t kx = 0; kx < params.weight.width_; kx++, col += ldcol) {
+        const float_t *src = col;
+        for (size_t y = 0; y < oh; y++, src += ow) {
+          float_t *dst = pin + (y * params.h_stride + ky) * iw + kx;
+          for (size_t x = 0; x < ow; x++) dst[x * ws] += src[x];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * gather the deltas of samples [first, first + count) into one
+ * [out_depth x count * out_area] matrix
+ **/
+inline void conv_gemm_gather(const conv_gemm_shape &shape,
+                             const tensor_t &delta,
+                             size_t first,
+                             size_t count,
+                             float_t *dst,
+                             bool parallelize) {
+  const size_t n = count * shape.out_area;
+  for_i(parallelize, count,
+        [&](size_t i) {
+          const float_t *src = &delta[first + i][0];
+          for (size_t o = 0; o < shape.out_depth; o++) {
+            std::copy(src + o * shape.out_area, src + (o + 1) * shape.out_area,
+                      dst + o * n + i * shape.out_area);
+          }
+        },
+        1u);
+}
+
+/**
+ * forward convolution: out = W * im2col(in) + bias, one GEMM per chunk of
+ * samples (and per group of a grouped connection_table). epilogue is
+ * applied to each sample as soon as its bias is added.
+ **/
+inline void conv2d_op_gemm(
+  const tensor_t &in_data,
+  const vec_t &W,
+  const vec_t &bias,
+  tensor_t &out_data,
+  const core::conv_params &params,
+  const bool parallelize,
+  const core::sample_epilogue &epilogue = core::sample_epilogue()) {
+  const conv_gemm_shape shape(params);
+  vec_t masked;
+  if (shape.masked) masked = conv_gemm_masked_weights(params, W);
+  const vec_t &w = shape.masked ? masked : W;
+  const size_t ig    = shape.in_per_group() * shape.kernel_area;
+  const size_t og    = shape.out_per_group();
+  const size_t area  = shape.out_area;
+  const size_t chunk = conv_gemm_chunk(shape, in_data.size());
+
+  vec_t col, res;
+  for (size_t first = 0; first < in_data.size(); first += chunk) {
+    const size_t count = std::min(chunk, in_data.size() - first);
+    const size_t n     = count * area;
+
+    col.resize(shape.rows * n);
+    for_i(parallelize, count,
+          [&](size_t i) {
+            conv_im2col(params, &in_data[first + i][0], &col[i * area], n);
+          },
+          1u);
+
+    // a single sample is computed in place
+    if (count > 1) res.resize(shape.out_depth * n);
+    float_t *c = count > 1 ? &res[0] : &out_data[first][0];
+
+    for (size_t g = 0; g < shape.groups; g++) {
+      gemm(false, false, og, n, ig, float_t{1}, &w[shape.weight_offset(g)],
+           shape.rows, &col[g * ig * n], n, float_t{0}, c + g * og * n, n,
+           parallelize);
+    }
+
+    for_i(parallelize, count,
+          [&](size_t i) {
+            vec_t &out = out_data[first + i];
+            for (size_t o = 0; o < shape.out_depth; o++) {
+              float_t *pa = &out[o * area];
+              if (count > 1) {
+                const float_t *src = &res[o * n + i * area];
+                std::copy(src, src + area, pa);
+              }
+              if (params.has_bias) vectorize::add(bias[o], area, pa);
+            }
+            if (epilogue) epilogue(out);
+          },
+          1u);
+  }
+}
+
+/**
+ * backward convolution w.r.t. the input:
+ * prev_delta += col2im(W^T * curr_delta)
+ **/
+inline void conv2d_grad_input_op_gemm(const tensor_t &curr_delta,
+                                      const vec_t &W,
+                                      tensor_t &prev_delta,
+                                      const core::conv_params &params,
+                                      const bool parallelize) {
+  const conv_gemm_shape shape(params);
+  vec_t masked;
+  if (shape.masked) masked = conv_gemm_masked_weights(params, W);
+  const vec_t &w = shape.masked ? masked : W;
+  const size_t ig    = shape.in_per_group() * shape.kernel_area;
+  const size_t og    = shape.out_per_group();
+  const size_t area  = shape.out_area;
+  const size_t chunk = conv_gemm_chunk(shape, curr_delta.size());
+
+  vec_t delta, dcol;
+  for (size_t first = 0; first < curr_delta.size(); first += chunk) {
+    const size_t count = std::min(chunk, curr_delta.size() - first);
+    const size_t n     = count * area;
+
+    const float_t *d = &curr_delta[first][0];
+    if (count > 1) {
+      delta.resize(shape.out_depth * n);
+      conv_gemm_gather(shape, curr_delta, first, count, &delta[0],
+                       parallelize);
+      d = &delta[0];
+    }
+
+    dcol.resize(shape.rows * n);
+    for (size_t g = 0; g < shape.groups; g++) {
+      gemm(true, false, ig, n, og, float_t{1}, &w[shape.weight_offset(g)],
+           shape.rows, d + g * og * n, n, float_t{0}, &dcol[g * ig * n], n,
+           parallelize);
+    }
+
+    for_i(parallelize, count,
+          [&](size_t i) {
+            conv_col2im(params, &dcol[i * area], n, &prev_delta[first + i][0]);
+          },
+          1u);
+  }
+}
+
+/**
+ * backward convolution w.r.t. the weights and bias:
+ * dW += curr_delta * im2col(prev_out)^T, summed over the whole batch.
+ * the weight gradient of the batch is accumulated into dW[0].
+ **/
+inline void conv2d_grad_weights_op_gemm(const tensor_t &prev_out,
+                                        const tensor_t &curr_delta,
+                                        tensor_t &dW,
+                                        tensor_t &db,
+                                        const core::conv_params &params,
+                                        const bool parallelize) {
+  const conv_gemm_shape shape(params);
+  const size_t ig    = shape.in_per_group() * shape.kernel_area;
+  const size_t og    = shape.out_per_group();
+  const size_t area  = shape.out_area;
+  const size_t chunk = conv_gemm_chunk(shape, prev_out.size());
+
+  vec_t dw(shape.out_depth * shape.rows, float_t{0});
+  vec_t col, delta;
+  for (size_t first = 0; first < prev_out.size(); first += chunk) {
+    const size_t count = std::min(chunk, prev_out.size() - first);
+    const size_t n     = count * area;
+
+    col.resize(shape.rows * n);
+    for_i(parallelize, count,
+          [&](size_t i) {
+            conv_im2col(params, &prev_out[first + i][0], &col[i * area], n);
+          },
+          1u);
+
+    const float_t *d = &curr_delta[first][0];
+    if (count > 1) {
+      delta.resize(shape.out_depth * n);
+      conv_gemm_gather(shape, curr_delta, first, count, &delta[0],
+                       parallelize);
+      d = &delta[0];
+    }
+
+    for (size_t g = 0; g < shape.groups; g++) {
+      gemm(false, true, og, ig, n, float_t{1}, d + g * og * n, n,
+           &col[g * ig * n], n, float_t{1}, &dw[shape.weight_offset(g)],
+           shape.rows, parallelize);
+    }
+  }
+
+  if (shape.masked) dw = conv_gemm_masked_weights(params, dw);
+  vectorize::reduce(&dw[0], dw.size(), &dW[0][0]);
+
+  if (params.has_bias) {
+    for_partials(parallelize, curr_delta.size(), db.size(),
+                 [&](size_t partial, size_t sample) {
+                   for (size_t o = 0; o < shape.out_depth; o++) {
+                     const float_t *delta = &curr_delta[sample][o * area];
+                     db[partial][o] +=
+                       std::accumulate(delta, delta + area, float_t{0});
+                   }
+                 });
+  }
+}
+
+/**
+ * backward convolution w.r.t. input, weights and bias
+ **/
+inline void conv2d_grad_op_gemm(const tensor_t &prev_out,
+                                const vec_t &W,
+                                tensor_t &dW,
+                                tensor_t &db,
+                                tensor_t &curr_delta,
+                                tensor_t &prev_delta,
+                                const core::conv_params &params,
+                                const bool parallelize) {
+  conv2d_grad_input_op_gemm(curr_delta, W, prev_delta, params, parallelize);
+  conv2d_grad_weights_op_gemm(prev_out, curr_delta, dW, db, params,
+                              parallelize);
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -10,12 +10,14 @@
 namespace tiny_dnn {
 namespace kernels {
 
-inline void conv2d_op_internal(const tensor_t &in_data,
-                               const vec_t &W,
-                               const vec_t &bias,
-                               tensor_t &out_data,
-                               const core::conv_params &params,
-                               const bool parallelize) {
+inline void conv2d_op_internal(
+  const tensor_t &in_data,
+  const vec_t &W,
+  const vec_t &bias,
+  tensor_t &out_data,
+  const core::conv_params &params,
+  const bool parallelize,
+  const core::sample_epilogue &epilogue = core::sample_epilogue()) {
   for_(parallelize, 0u, in_data.size(),
        [&](const blocked_range &r) {
          size_t out_area    = params.out.area();
@@ -66,6 +68,7 @@ inline void conv2d_op_internal(const tensor_t &in_data,
                vectorize::add(bias[o], out_area, pa);
              }
            }
+           if (epilogue) epilogue(a);
          }
        },
        0u);
@@ -84,7 +87,9 @@ void conv2d_op_internal(const tensor_t &prev_out,
                         const bool parallelize) {
   typedef typename vec_t::value_type float_t;
 
-  for_i(parallelize, prev_out.size(), [&](size_t sample) {
+  // samples sharing a row of dW (partial sums) run on the same task
+  for_partials(parallelize, prev_out.size(), dW.size(), [&](size_t partial,
+                                                            size_t sample) {
     // propagate delta to previous layer
     for (size_t inc = 0; inc < params.in.depth_; inc++) {
       for (size_t outc = 0; outc < params.out.depth_; outc++) {
@@ -160,7 +165,7 @@ void conv2d_op_internal(const tensor_t &prev_out,
             }
 
             idx = params.in.depth_ * outc + inc;
-            dW[sample][params.weight.get_index(wx, wy, idx)] += dst;
+            dW[partial][params.weight.get_index(wx, wy, idx)] += dst;
           }
         }
       }
@@ -172,7 +177,7 @@ void conv2d_op_internal(const tensor_t &prev_out,
         size_t idx            = params.out.get_index(0, 0, outc);
         const float_t *delta  = &curr_delta[sample][idx];
         const float_t *deltaa = delta + params.out.width_ * params.out.height_;
-        db[sample][outc] += std::accumulate(delta, deltaa, float_t{0});
+        db[partial][outc] += std::accumulate(delta, deltaa, float_t{0});
       }
     }
   });
@@ -140,6 +140,7 @@ class Conv2dLibDNNForwardOp : public core::OpKernel {
       // copy data to be activated
       std::copy(std::begin(out), std::end(out), std::begin(out_data[i]));
     }
+    context.apply_epilogue(out_data);
 
 #else
     CNN_UNREFERENCED_PARAMETER(context);
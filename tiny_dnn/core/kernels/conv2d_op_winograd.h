@@ -0,0 +1,344 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "tiny_dnn/core/kernels/gemm.h"
+#include "tiny_dnn/core/params/conv_params.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * transform matrices of the minimal filtering algorithm F(m x m, 3 x 3)
+ * from Lavin & Gray, "Fast Algorithms for Convolutional Neural Networks".
+ * an m x m output tile is computed from an (m + 2) x (m + 2) input tile as
+ *
+ *     Y = A^T [(G g G^T) * (B^T d B)] A
+ *
+ * where * is the element-wise product.
+ **/
+template <size_t M>
+struct winograd_f3;
+
+template <>
+struct winograd_f3<2> {
+  static float_t bt(size_t i, size_t j) {
+    static const float_t m[4][4] = {
+      {1, 0, -1, 0}, {0, 1, 1, 0}, {0, -1, 1, 0}, {0, 1, 0, -1}};
+    return m[i][j];
+  }
+
+  static float_t g(size_t i, size_t j) {
+    static const float_t m[4][3] = {
+      {1, 0, 0}, {0.5, 0.5, 0.5}, {0.5, -0.5, 0.5}, {0, 0, 1}};
+    return m[i][j];
+  }
+
+  static float_t at(size_t i, size_t j) {
+    static const float_t m[2][4] = {{1, 1, 1, 0}, {0, 1, -1, -1}};
+    return m[i][j];
+  }
+};
+
+template <>
+struct winograd_f3<4> {
+  static float_t bt(size_t i, size_t j) {
+    static const float_t m[6][6] = {
+      {4, 0, -5, 0, 1, 0},  {0, -4, -4, 1, 1, 0}, {0, 4, -4, -1, 1, 0},
+      {0, -2, -1, 2, 1, 0}, {0, 2, -1, -2, 1, 0}, {0, 4, 0, -5, 0, 1}};
+    return m[i][j];
+  }
+
+  static float_t g(size_t i, size_t j) {
+    static const float_t m[6][3] = {
+      {float_t(1) / 4, 0, 0},
+      {float_t(-1) / 6, float_t(-1) / 6, float_t(-1) / 6},
+      {float_t(-1) / 6, float_t(1) / 6, float_t(-1) / 6},
+      {float_t(1) / 24, float_t(1) / 12, float_t(1) / 6},
+      {float_t(1) / 24, float_t(-1) / 12, float_t(1) / 6},
+      {0, 0, 1}};
+    return m[i][j];
+  }
+
+  static float_t at(size_t i, size_t j) {
+    static const float_t m[4][6] = {{1, 1, 1, 1, 1, 0},
+                                    {0, 1, -1, 2, -2, 0},
+                                    {0, 1, 1, 4, 4, 0},
+                                    {0, 1, -1, 8, -8, 1}};
+    return m[i][j];
+  }
+};
+
+/**
+ * Winograd kernels cover stride-1 3x3 convolutions
+ **/
+inline bool conv2d_winograd_supported(const core::conv_params &params) {
+  return params.weight.width_ == 3 && params.weight.height_ == 3 &&
+         params.w_stride == 1 && params.h_stride == 1;
+}
+
+/**
+ * U = G g G^T for every (output channel, input channel) pair, stored as
+ * (m + 2)^2 matrices of [out.depth_ x in.depth_]. filters of unconnected
+ * channel pairs are zero.
+ **/
+template <size_t M>
+void winograd_filter_transform(const core::conv_params &params,
+                               const vec_t &W,
+                               vec_t &U,
+                               const bool parallelize) {
+  typedef winograd_f3<M> f;
+  const size_t alpha = M + 2;
+  const size_t id    = params.in.depth_;
+  const size_t od    = params.out.depth_;
+
+  U.resize(alpha * alpha * od * id);
+  for_i(parallelize, od, [&](size_t o) {
+    for (size_t inc = 0; inc < id; inc++) {
+      float_t u[alpha][alpha] = {};
+      if (params.tbl.is_connected(o, inc)) {
+        const float_t *g = &W[params.weight.get_index(0, 0, id * o + inc)];
+        float_t tmp[alpha][3] = {};
+        for (size_t i = 0; i < alpha; i++) {
+          for (size_t j = 0; j < 3; j++) {
+            for (size_t k = 0; k < 3; k++) {
+              tmp[i][j] += f::g(i, k) * g[k * 3 + j];
+            }
+          }
+        }
+        for (size_t i = 0; i < alpha; i++) {
+          for (size_t j = 0; j < alpha; j++) {
+            for (size_t k = 0; k < 3; k++) u[i][j] += tmp[i][k] * f::g(j, k);
+          }
+        }
+      }
+      for (size_t xi = 0; xi < alpha * alpha; xi++) {
+        U[xi * od * id + o * id + inc] = u[xi / alpha][xi % alpha];
+      }
+    }
+  });
+}
+
+/**
+ * filter transform of one layer, cached until the weights change, which is
+ * told by their stamp (see layer::weights_version()) rather than by
+ * comparing them.
+ *
+ * layers sharing their weights (see layer::share_weights) share the cache as
+ * well. a cached transform is immutable and handed out by shared_ptr, so
+ * several threads can run the forward pass with it concurrently; a change of
+ * the weights publishes a new transform instead of modifying the old one.
+ **/
+class conv2d_winograd_filter {
+ public:
+  struct entry {
+    size_t tile;
+    uint64_t version;  // stamp of the weights transformed
+    vec_t transformed;
+  };
+
+  conv2d_winograd_filter() : slot_(std::make_shared<slot>()) {}
+
+  /**
+   * use the same cache as other
+   **/
+  void share(const conv2d_winograd_filter &other) { slot_ = other.slot_; }
+
+  template <size_t M>
+  std::shared_ptr<const entry> get(const core::conv_params &params,
+                                   const vec_t &W,
+                                   uint64_t version,
+                                   const bool parallelize) {
+    std::shared_ptr<const entry> cached;
+    {
+      std::lock_guard<std::mutex> lock(slot_->mtx);
+      cached = slot_->current;
+    }
+    if (version && cached && cached->tile == M && cached->version == version) {
+      return cached;
+    }
+
+    std::shared_ptr<entry> updated = std::make_shared<entry>();
+    winograd_filter_transform<M>(params, W, updated->transformed, parallelize);
+    updated->version = version;
+    updated->tile    = M;
+
+    std::lock_guard<std::mutex> lock(slot_->mtx);
+    slot_->current = updated;
+    return updated;
+  }
+
+ private:
+  struct slot {
+    std::mutex mtx;
+    std::shared_ptr<const entry> current;
+  };
+
+  std::shared_ptr<slot> slot_;
+};
+
+template <size_t M>
+void conv2d_op_winograd(const tensor_t &in_data,
+                        const vec_t &W,
+                        const vec_t &bias,
+                        tensor_t &out_data,
+                        const core::conv_params &params,
+                        conv2d_winograd_filter &filter,
+                        uint64_t weights_version,
+                        const bool parallelize,
+                        const core::sample_epilogue &epilogue) {
+  typedef winograd_f3<M> f;
+  const size_t alpha   = M + 2;
+  const size_t id      = params.in.depth_;
+  const size_t od      = params.out.depth_;
+  const size_t iw      = params.in_padded.width_;
+  const size_t ih      = params.in_padded.height_;
+  const size_t ow      = params.out.width_;
+  const size_t oh      = params.out.height_;
+  const size_t tw      = (ow + M - 1) / M;
+  const size_t th      = (oh + M - 1) / M;
+  const size_t tiles_s = tw * th;  // tiles per sample
+
+  const auto cached = filter.get<M>(params, W, weights_version, parallelize);
+  const vec_t &U    = cached->transformed;
+
+  // lower as many samples at once as fit into the transform buffers
+  const size_t max_elements = size_t(1) << 22;
+  const size_t per_sample   = alpha * alpha * (id + od) * tiles_s;
+  const size_t chunk =
+    std::max(size_t(1), std::min(in_data.size(), max_elements / per_sample));
+
+  vec_t V, Y;
+  for (size_t first = 0; first < in_data.size(); first += chunk) {
+    const size_t count = std::min(chunk, in_data.size() - first);
+    const size_t tiles = count * tiles_s;
+
+    // V = B^T d B for every input tile
+    V.resize(alpha * alpha * id * tiles);
+    for_i(parallelize, count * id, [&](size_t job) {
+      const size_t sample = job / id;
+      const size_t inc    = job % id;
+      const float_t *pin =
+        &in_data[first + sample][params.in_padded.get_index(0, 0, inc)];
+
+      for (size_t ty = 0; ty < th; ty++) {
+        for (size_t tx = 0; tx < tw; tx++) {
+          float_t d[alpha][alpha] = {};
+          for (size_t i = 0; i < alpha && ty * M + i < ih; i++) {
+            const float_t *row = pin + (ty * M + i) * iw;
+            for (size_t j = 0; j < alpha && tx * M + j < iw; j++) {
+              d[i][j] = row[tx * M + j];
+            }
+          }
+
+          float_t tmp[alpha][alpha] = {};
+          for (size_t i = 0; i < alpha; i++) {
+            for (size_t k = 0; k < alpha; k++) {
+              const float_t b = f::bt(i, k);
+              if (b == float_t{0}) continue;
+              for (size_t j = 0; j < alpha; j++) tmp[i][j] += b * d[k][j];
+            }
+          }
+
+          const size_t t = sample * tiles_s + ty * tw + tx;
+          float_t *pv    = &V[inc * tiles + t];
+          for (size_t i = 0; i < alpha; i++) {
+            for (size_t j = 0; j < alpha; j++) {
+              float_t v{0};
+              for (size_t k = 0; k < alpha; k++) v += tmp[i][k] * f::bt(j, k);
+              pv[(i * alpha + j) * id * tiles] = v;
+            }
+          }
+        }
+      }
+    });
+
+    // one [od x id] * [id x tiles] product per element of the tile
+    Y.resize(alpha * alpha * od * tiles);
+    for_i(parallelize, alpha * alpha,
+          [&](size_t xi) {
+            gemm(false, false, od, tiles, id, float_t{1}, &U[xi * od * id],
+                 id, &V[xi * id * tiles], tiles, float_t{0},
+                 &Y[xi * od * tiles], tiles, false);
+          },
+          1u);
+
+    // Y = A^T m A for every output tile, clipped to the output size
+    for_i(parallelize, count * od, [&](size_t job) {
+      const size_t sample = job / od;
+      const size_t o      = job % od;
+      const float_t b     = params.has_bias ? bias[o] : float_t{0};
+      float_t *pout = &out_data[first + sample][params.out.get_index(0, 0, o)];
+
+      for (size_t ty = 0; ty < th; ty++) {
+        for (size_t tx = 0; tx < tw; tx++) {
+          const size_t t    = sample * tiles_s + ty * tw + tx;
+          const float_t *pm = &Y[o * tiles + t];
+          float_t tmp[M][alpha] = {};
+          for (size_t k = 0; k < alpha; k++) {
+            for (size_t j = 0; j < alpha; j++) {
+              const float_t m = pm[(k * alpha + j) * od * tiles];
+              for (size_t i = 0; i < M; i++) tmp[i][j] += f::at(i, k) * m;
+            }
+          }
+
+          for (size_t i = 0; i < M && ty * M + i < oh; i++) {
+            float_t *row = pout + (ty * M + i) * ow + tx * M;
+            for (size_t j = 0; j < M && tx * M + j < ow; j++) {
+              float_t y = b;
+              for (size_t k = 0; k < alpha; k++) y += tmp[i][k] * f::at(j, k);
+              row[j] = y;
+            }
+          }
+        }
+      }
+    });
+
+    // while the outputs of the chunk are still in cache
+    if (epilogue) {
+      for_i(parallelize, count,
+            [&](size_t sample) { epilogue(out_data[first + sample]); }, 1u);
+    }
+  }
+}
+
+/**
+ * forward convolution of a stride-1 3x3 kernel with Winograd's minimal
+ * filtering algorithm. F(4x4, 3x3) needs 4x fewer multiplications than the
+ * direct convolution, F(2x2, 3x3) (used for small outputs) 2.25x fewer.
+ * epilogue is applied to the samples of each chunk once they are written.
+ * the filter transform is cached in filter for the weights_version of W.
+ **/
+inline void conv2d_op_winograd(
+  const tensor_t &in_data,
+  const vec_t &W,
+  const vec_t &bias,
+  tensor_t &out_data,
+  const core::conv_params &params,
+  conv2d_winograd_filter &filter,
+  uint64_t weights_version,
+  const bool parallelize,
+  const core::sample_epilogue &epilogue = core::sample_epilogue()) {
+  assert(conv2d_winograd_supported(params));
+  if (params.out.width_ >= 4 && params.out.height_ >= 4) {
+    conv2d_op_winograd<4>(in_data, W, bias, out_data, params, filter,
+                          weights_version, parallelize, epilogue);
+  } else {
+    conv2d_op_winograd<2>(in_data, W, bias, out_data, params, filter,
+                          weights_version, parallelize, epilogue);
+  }
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -0,0 +1,57 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <cstdint>
+
+#ifdef CNN_USE_AVX
+#include <immintrin.h>
+#endif
+
+#include "tiny_dnn/core/kernels/dropout_op_internal.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * dropout_op_internal, 8 values per byte of the mask: the byte is spread
+ * over the lanes, each lane keeps its own bit and the lanes left nonzero
+ * select their scaled value.
+ **/
+inline void dropout_op_avx(const float_t *in,
+                           const uint32_t *mask,
+                           float_t scale,
+                           float_t *out,
+                           size_t n) {
+#if defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  const __m256 lane_bits =
+    _mm256_castsi256_ps(_mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128));
+  const __m256 s       = _mm256_set1_ps(scale);
+  const __m256 zero    = _mm256_setzero_ps();
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(mask);
+
+  // little endian: bit i of the mask is bit i % 8 of byte i / 8
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 b   = _mm256_castsi256_ps(_mm256_set1_epi32(bytes[i / 8]));
+    const __m256 bit = _mm256_cvtepi32_ps(
+      _mm256_castps_si256(_mm256_and_ps(b, lane_bits)));
+    const __m256 keep = _mm256_cmp_ps(bit, zero, _CMP_NEQ_OQ);
+    _mm256_storeu_ps(
+      out + i, _mm256_and_ps(keep, _mm256_mul_ps(_mm256_loadu_ps(in + i), s)));
+  }
+  for (; i < n; i++) {
+    out[i] = (mask[i / 32] >> (i % 32)) & 1 ? in[i] * scale : float_t{0};
+  }
+#else
+  dropout_op_internal(in, mask, scale, out, n);
+#endif
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
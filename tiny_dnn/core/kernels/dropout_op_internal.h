@@ -0,0 +1,33 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <cstdint>
+
+#include "tiny_dnn/config.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * out[i] = in[i] * scale where bit i of the packed mask is set, else 0.
+ * serves both passes of dropout: the outputs from the inputs and the
+ * input gradients from the output gradients.
+ **/
+inline void dropout_op_internal(const float_t *in,
+                                const uint32_t *mask,
+                                float_t scale,
+                                float_t *out,
+                                size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = (mask[i / 32] >> (i % 32)) & 1 ? in[i] * scale : float_t{0};
+  }
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -41,15 +41,19 @@ class FullyConnectedGradOp : public core::OpKernel {
     if (engine == core::backend_t::internal) {
       kernels::fully_connected_op_internal(
         prev_out, W[0], dW, params.has_bias_ ? *db : dummy, curr_delta,
-        prev_delta, params, context.parallelize());
+        prev_delta, params, buffers_, context.parallelize());
     } else if (engine == core::backend_t::avx) {
       kernels::fully_connected_op_avx(
         prev_out, W[0], dW, params.has_bias_ ? *db : dummy, curr_delta,
-        prev_delta, params, context.parallelize());
+        prev_delta, params, buffers_, context.parallelize());
     } else {
       throw nn_error("Not supported engine: " + to_string(engine));
     }
   }
+
+ private:
+  // matrices gathered by the GEMM kernels, reused across passes
+  kernels::fully_connected_gemm_buffers buffers_;
 };
 
 }  // namespace tiny_dnn
@@ -39,19 +39,26 @@ class FullyConnectedOp : public core::OpKernel {
     if (engine == core::backend_t::internal) {
       kernels::fully_connected_op_internal(
         in_data, W[0], params.has_bias_ ? (*bias)[0] : vec_t(), out_data,
-        params, context.parallelize());
+        params, buffers_, context.parallelize(), context.epilogue());
     } else if (engine == core::backend_t::nnpack) {
       kernels::fully_connected_op_nnpack(
         in_data, W[0], params.has_bias_ ? (*bias)[0] : vec_t(), out_data,
         params, context.parallelize());
+      context.apply_epilogue(out_data);
     } else if (engine == core::backend_t::avx) {
       kernels::fully_connected_op_avx(in_data, W[0],
                                       params.has_bias_ ? (*bias)[0] : vec_t(),
-                                      out_data, params, context.parallelize());
+                                      out_data, params, buffers_,
+                                      context.parallelize(),
+                                      context.epilogue());
     } else {
       throw nn_error("Not supported engine: " + to_string(engine));
     }
   }
+
+ private:
+  // matrices gathered by the GEMM kernels, reused across passes
+  kernels::fully_connected_gemm_buffers buffers_;
 };
 
 }  // namespace tiny_dnn
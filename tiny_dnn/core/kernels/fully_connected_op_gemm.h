@@ -0,0 +1,184 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+
+#include "tiny_dnn/core/kernels/gemm.h"
+#include "tiny_dnn/core/params/fully_params.h"
+#include "tiny_dnn/util/batch_view.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+// below this batch size, one matrix-vector product per sample is cheaper
+// than packing W for a GEMM
+const size_t fully_connected_gemm_min_batch = 8;
+
+/**
+ * matrices of a batch which is not laid out at a constant stride and has
+ * to be gathered. kept by the layer, so that they are allocated once and
+ * not on every pass.
+ **/
+struct fully_connected_gemm_buffers {
+  vec_t x;
+  vec_t y;
+  vec_t dy;
+  vec_t dx;
+};
+
+/**
+ * the samples of t as a [n x size] matrix: in place if they lie at a
+ * constant stride, otherwise gathered into buf
+ **/
+inline batch_view<const float_t> fully_connected_gather(const tensor_t &t,
+                                                        size_t size,
+                                                        vec_t &buf) {
+  batch_view<const float_t> v = as_batch_view(t);
+  if (!v.empty()) return v;
+  buf.resize(t.size() * size);
+  for (size_t sample = 0; sample < t.size(); sample++) {
+    std::copy(t[sample].begin(), t[sample].begin() + size, &buf[sample * size]);
+  }
+  return batch_view<const float_t>(&buf[0], size, t.size());
+}
+
+/**
+ * forward pass of the whole batch as one GEMM, Y = X * W + b, where X and Y
+ * hold one sample per row. epilogue is applied to each sample as soon as
+ * its bias is added.
+ **/
+inline void fully_connected_op_gemm(
+  const tensor_t &in_data,
+  const vec_t &W,
+  const vec_t &bias,
+  tensor_t &out_data,
+  const core::fully_params &params,
+  fully_connected_gemm_buffers &buffers,
+  const bool layer_parallelize,
+  const core::sample_epilogue &epilogue = core::sample_epilogue()) {
+  const size_t n        = in_data.size();
+  const size_t in_size  = params.in_size_;
+  const size_t out_size = params.out_size_;
+  if (n < fully_connected_gemm_min_batch) {
+    // rounded like the batched path, so results do not depend on the batch
+    for (size_t sample = 0; sample < n; sample++) {
+      float_t *pout = &out_data[sample][0];
+      gemm(false, false, 1, out_size, in_size, float_t{1}, &in_data[sample][0],
+           in_size, &W[0], out_size, float_t{0}, pout, out_size,
+           layer_parallelize);
+      if (params.has_bias_) {
+        for (size_t i = 0; i < out_size; i++) pout[i] += bias[i];
+      }
+      if (epilogue) epilogue(out_data[sample]);
+    }
+    return;
+  }
+
+  batch_view<const float_t> x =
+    fully_connected_gather(in_data, in_size, buffers.x);
+  batch_view<float_t> y = as_batch_view(out_data);
+  if (y.empty()) {
+    buffers.y.resize(n * out_size);
+    y = batch_view<float_t>(&buffers.y[0], out_size, n);
+  }
+
+  gemm(false, false, n, out_size, in_size, float_t{1}, x.data(), x.stride(),
+       &W[0], out_size, float_t{0}, y.data(), y.stride(), layer_parallelize);
+
+  for_i(layer_parallelize, n, [&](size_t sample) {
+    const float_t *py = y[sample];
+    float_t *pout     = &out_data[sample][0];
+    if (params.has_bias_) {
+      for (size_t i = 0; i < out_size; i++) pout[i] = py[i] + bias[i];
+    } else if (py != pout) {
+      std::copy(py, py + out_size, pout);
+    }
+    if (epilogue) epilogue(out_data[sample]);
+  });
+}
+
+/**
+ * backward pass of the whole batch as two GEMMs:
+ *
+ *     dX  = dY * W^T
+ *     dW += X^T * dY
+ *
+ * the weight and bias gradients of all samples are accumulated into
+ * dW[0] and db[0], which sum up to the same merged gradient as per-sample
+ * accumulation. small batches are processed sample by sample.
+ **/
+inline void fully_connected_grad_op_gemm(const tensor_t &prev_out,
+                                         const vec_t &W,
+                                         tensor_t &dW,
+                                         tensor_t &db,
+                                         const tensor_t &curr_delta,
+                                         tensor_t &prev_delta,
+                                         const core::fully_params &params,
+                                         fully_connected_gemm_buffers &buffers,
+                                         const bool layer_parallelize) {
+  const size_t n        = prev_out.size();
+  const size_t in_size  = params.in_size_;
+  const size_t out_size = params.out_size_;
+
+  if (params.has_bias_) {
+    for (size_t sample = 0; sample < n; sample++) {
+      vectorize::reduce(&curr_delta[sample][0], out_size, &db[0][0]);
+    }
+  }
+
+  if (n < fully_connected_gemm_min_batch) {
+    for (size_t sample = 0; sample < n; sample++) {
+      const float_t *delta = &curr_delta[sample][0];
+      // propagate delta to previous layer
+      for (size_t c = 0; c < in_size; c++) {
+        prev_delta[sample][c] +=
+          vectorize::dot(delta, &W[c * out_size], out_size);
+      }
+      // accumulate weight-step using delta
+      for_(layer_parallelize, 0u, out_size, [&](const blocked_range &r) {
+        for (size_t c = 0; c < in_size; c++) {
+          vectorize::muladd(delta + r.begin(), prev_out[sample][c],
+                            r.end() - r.begin(),
+                            &dW[0][c * out_size + r.begin()]);
+        }
+      });
+    }
+    return;
+  }
+
+  batch_view<const float_t> x =
+    fully_connected_gather(prev_out, in_size, buffers.x);
+  batch_view<const float_t> dy =
+    fully_connected_gather(curr_delta, out_size, buffers.dy);
+
+  // propagate delta to previous layer
+  batch_view<float_t> dx = as_batch_view(prev_delta);
+  if (dx.empty()) {
+    buffers.dx.resize(n * in_size);
+    gemm(false, true, n, in_size, out_size, float_t{1}, dy.data(),
+         dy.stride(), &W[0], out_size, float_t{0}, &buffers.dx[0], in_size,
+         layer_parallelize);
+    for_i(layer_parallelize, n, [&](size_t sample) {
+      vectorize::reduce(&buffers.dx[sample * in_size], in_size,
+                        &prev_delta[sample][0]);
+    });
+  } else {
+    gemm(false, true, n, in_size, out_size, float_t{1}, dy.data(),
+         dy.stride(), &W[0], out_size, float_t{1}, dx.data(), dx.stride(),
+         layer_parallelize);
+  }
+
+  // accumulate weight-step using delta
+  gemm(true, false, in_size, out_size, n, float_t{1}, x.data(), x.stride(),
+       dy.data(), dy.stride(), float_t{1}, &dW[0][0], out_size,
+       layer_parallelize);
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
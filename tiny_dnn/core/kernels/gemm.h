@@ -0,0 +1,406 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "tiny_dnn/util/aligned_allocator.h"
+#include "tiny_dnn/util/parallel_for.h"
+
+#ifdef CNN_USE_AVX
+#include "tiny_dnn/core/kernels/avx_kernel_common.h"
+#endif
+
+namespace tiny_dnn {
+namespace kernels {
+namespace detail {
+
+// register tile of C computed by one micro-kernel call
+const size_t gemm_mr = 6;
+const size_t gemm_nr = 16;
+
+// cache blocking: a gemm_mc x gemm_kc block of A stays in L2, a
+// gemm_kc x gemm_nr sliver of B in L1 and the packed panel of B in L3
+const size_t gemm_mc = 96;
+const size_t gemm_kc = 256;
+const size_t gemm_nc = 2048;
+
+// columns of C handled by one parallel task
+const size_t gemm_task_nc = 256;
+
+template <typename T>
+using gemm_buffer = std::vector<T, aligned_allocator<T, 64>>;
+
+/**
+ * pack rows [i0, i0 + mc) x columns [k0, k0 + kc) of op(A) into slivers of
+ * gemm_mr rows, stored column by column. missing rows are zero-filled.
+ **/
+template <typename T>
+void gemm_pack_a(bool trans,
+                 const T *a,
+                 size_t lda,
+                 size_t i0,
+                 size_t mc,
+                 size_t k0,
+                 size_t kc,
+                 T *dst) {
+  for (size_t is = 0; is < mc; is += gemm_mr) {
+    const size_t mr = std::min(gemm_mr, mc - is);
+    for (size_t k = 0; k < kc; k++) {
+      for (size_t r = 0; r < mr; r++) {
+        const size_t i = i0 + is + r;
+        dst[r] = trans ? a[(k0 + k) * lda + i] : a[i * lda + k0 + k];
+      }
+      for (size_t r = mr; r < gemm_mr; r++) dst[r] = T{0};
+      dst += gemm_mr;
+    }
+  }
+}
+
+/**
+ * pack rows [k0, k0 + kc) x columns [j0, j0 + nr) of op(B) into a sliver of
+ * gemm_nr columns, stored row by row. missing columns are zero-filled.
+ **/
+template <typename T>
+void gemm_pack_b(bool trans,
+                 const T *b,
+                 size_t ldb,
+                 size_t k0,
+                 size_t kc,
+                 size_t j0,
+                 size_t nr,
+                 T *dst) {
+  if (trans) {
+    // read the rows of B contiguously, the sliver stays in L1
+    for (size_t c = 0; c < nr; c++) {
+      const T *src = &b[(j0 + c) * ldb + k0];
+      for (size_t k = 0; k < kc; k++) dst[k * gemm_nr + c] = src[k];
+    }
+  }
+  for (size_t k = 0; k < kc; k++) {
+    if (!trans) {
+      const T *src = &b[(k0 + k) * ldb + j0];
+      std::copy(src, src + nr, dst);
+    }
+    for (size_t c = nr; c < gemm_nr; c++) dst[c] = T{0};
+    dst += gemm_nr;
+  }
+}
+
+/**
+ * C[0:m, 0:n] += alpha * (packed A sliver) * (packed B sliver)
+ **/
+template <typename T>
+void gemm_micro_kernel(size_t kc,
+                       T alpha,
+                       const T *a,
+                       const T *b,
+                       T *c,
+                       size_t ldc,
+                       size_t m,
+                       size_t n) {
+  T acc[gemm_mr][gemm_nr] = {};
+  for (size_t k = 0; k < kc; k++) {
+    for (size_t r = 0; r < gemm_mr; r++) {
+      const T ar = a[r];
+      for (size_t j = 0; j < gemm_nr; j++) acc[r][j] += ar * b[j];
+    }
+    a += gemm_mr;
+    b += gemm_nr;
+  }
+  for (size_t r = 0; r < m; r++) {
+    for (size_t j = 0; j < n; j++) c[r * ldc + j] += alpha * acc[r][j];
+  }
+}
+
+#ifdef CNN_USE_AVX
+
+// 6x16 register tile: 12 accumulators, 2 loads of B and 6 broadcasts of A
+// per step of k
+inline void gemm_micro_kernel(size_t kc,
+                              float alpha,
+                              const float *a,
+                              const float *b,
+                              float *c,
+                              size_t ldc,
+                              size_t m,
+                              size_t n) {
+  __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+  __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+  __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+  __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+  __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+  __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+  for (size_t k = 0; k < kc; k++) {
+    const __m256 b0 = _mm256_load_ps(b);
+    const __m256 b1 = _mm256_load_ps(b + 8);
+    __m256 ar;
+    ar  = _mm256_broadcast_ss(a + 0);
+    c00 = madd256_ps(ar, b0, c00);
+    c01 = madd256_ps(ar, b1, c01);
+    ar  = _mm256_broadcast_ss(a + 1);
+    c10 = madd256_ps(ar, b0, c10);
+    c11 = madd256_ps(ar, b1, c11);
+    ar  = _mm256_broadcast_ss(a + 2);
+    c20 = madd256_ps(ar, b0, c20);
+    c21 = madd256_ps(ar, b1, c21);
+    ar  = _mm256_broadcast_ss(a + 3);
+    c30 = madd256_ps(ar, b0, c30);
+    c31 = madd256_ps(ar, b1, c31);
+    ar  = _mm256_broadcast_ss(a + 4);
+    c40 = madd256_ps(ar, b0, c40);
+    c41 = madd256_ps(ar, b1, c41);
+    ar  = _mm256_broadcast_ss(a + 5);
+    c50 = madd256_ps(ar, b0, c50);
+    c51 = madd256_ps(ar, b1, c51);
+    a += gemm_mr;
+    b += gemm_nr;
+  }
+
+  alignas(32) float acc[gemm_mr][gemm_nr];
+  const __m256 valpha = _mm256_set1_ps(alpha);
+  _mm256_store_ps(acc[0], _mm256_mul_ps(c00, valpha));
+  _mm256_store_ps(acc[0] + 8, _mm256_mul_ps(c01, valpha));
+  _mm256_store_ps(acc[1], _mm256_mul_ps(c10, valpha));
+  _mm256_store_ps(acc[1] + 8, _mm256_mul_ps(c11, valpha));
+  _mm256_store_ps(acc[2], _mm256_mul_ps(c20, valpha));
+  _mm256_store_ps(acc[2] + 8, _mm256_mul_ps(c21, valpha));
+  _mm256_store_ps(acc[3], _mm256_mul_ps(c30, valpha));
+  _mm256_store_ps(acc[3] + 8, _mm256_mul_ps(c31, valpha));
+  _mm256_store_ps(acc[4], _mm256_mul_ps(c40, valpha));
+  _mm256_store_ps(acc[4] + 8, _mm256_mul_ps(c41, valpha));
+  _mm256_store_ps(acc[5], _mm256_mul_ps(c50, valpha));
+  _mm256_store_ps(acc[5] + 8, _mm256_mul_ps(c51, valpha));
+
+  if (n == gemm_nr) {
+    for (size_t r = 0; r < m; r++) {
+      float *pc = c + r * ldc;
+      _mm256_storeu_ps(pc, _mm256_add_ps(_mm256_loadu_ps(pc),
+                                         _mm256_load_ps(acc[r])));
+      _mm256_storeu_ps(pc + 8, _mm256_add_ps(_mm256_loadu_ps(pc + 8),
+                                             _mm256_load_ps(acc[r] + 8)));
+    }
+  } else {
+    for (size_t r = 0; r < m; r++) {
+      for (size_t j = 0; j < n; j++) c[r * ldc + j] += acc[r][j];
+    }
+  }
+}
+
+#endif  // CNN_USE_AVX
+
+template <typename T>
+void gemm_scale(size_t m, size_t n, T beta, T *c, size_t ldc) {
+  if (beta == T{1}) return;
+  for (size_t i = 0; i < m; i++) {
+    T *pc = c + i * ldc;
+    if (beta == T{0}) {
+      std::fill(pc, pc + n, T{0});
+    } else {
+      for (size_t j = 0; j < n; j++) pc[j] *= beta;
+    }
+  }
+}
+
+/**
+ * acc[0:size] += x * row[0:size], rounded like the micro-kernel
+ **/
+template <typename T>
+void gemv_madd(T x, const T *row, size_t size, T *acc) {
+  for (size_t j = 0; j < size; j++) acc[j] += x * row[j];
+}
+
+/**
+ * c[0:size] += alpha * acc[0:size]
+ **/
+template <typename T>
+void gemv_update(T alpha, const T *acc, size_t size, T *c) {
+  for (size_t j = 0; j < size; j++) c[j] += alpha * acc[j];
+}
+
+#ifdef CNN_USE_AVX
+
+// lanes [0, size) of 8 enabled
+inline __m256i gemv_tail_mask(size_t size) {
+  static const int32_t mask_src[] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0,
+  };
+  return _mm256_loadu_si256(
+    reinterpret_cast<const __m256i *>(mask_src + 8 - size));
+}
+
+inline void gemv_madd(float x, const float *row, size_t size, float *acc) {
+  const __m256 vx = _mm256_set1_ps(x);
+  size_t j        = 0;
+  for (; j + 8 <= size; j += 8) {
+    _mm256_storeu_ps(acc + j, madd256_ps(vx, _mm256_loadu_ps(row + j),
+                                         _mm256_loadu_ps(acc + j)));
+  }
+  if (j < size) {
+    const __m256i mask = gemv_tail_mask(size - j);
+    _mm256_maskstore_ps(acc + j, mask,
+                        madd256_ps(vx, _mm256_maskload_ps(row + j, mask),
+                                   _mm256_maskload_ps(acc + j, mask)));
+  }
+}
+
+inline void gemv_update(float alpha,
+                        const float *acc,
+                        size_t size,
+                        float *c) {
+  const __m256 valpha = _mm256_set1_ps(alpha);
+  for (size_t j = 0; j < size; j += 8) {
+    const __m256i mask = gemv_tail_mask(std::min(size_t(8), size - j));
+    const __m256 v = _mm256_mul_ps(_mm256_maskload_ps(acc + j, mask), valpha);
+    _mm256_maskstore_ps(c + j, mask,
+                        _mm256_add_ps(_mm256_maskload_ps(c + j, mask), v));
+  }
+}
+
+#endif  // CNN_USE_AVX
+
+/**
+ * c[0:n] += alpha * x[0:k] * B for a single row x with stride incx and a
+ * k x n matrix B. B is accumulated in blocks of gemm_kc in the same order
+ * and with the same rounding as the micro-kernel, so a row of C does not
+ * depend on how many rows are computed at once.
+ **/
+template <typename T>
+void gemv(size_t n,
+          size_t k,
+          T alpha,
+          const T *x,
+          size_t incx,
+          const T *b,
+          size_t ldb,
+          T *c,
+          bool parallelize) {
+  gemm_buffer<T> packed_x;
+  if (incx != 1) {
+    packed_x.resize(k);
+    for (size_t p = 0; p < k; p++) packed_x[p] = x[p * incx];
+    x = &packed_x[0];
+  }
+
+  for_(parallelize, 0u, n,
+       [&](const blocked_range &r) {
+         const size_t len = r.end() - r.begin();
+         gemm_buffer<T> acc(len);
+         for (size_t pc = 0; pc < k; pc += gemm_kc) {
+           const size_t kc = std::min(gemm_kc, k - pc);
+           std::fill(acc.begin(), acc.end(), T{0});
+           for (size_t p = pc; p < pc + kc; p++) {
+             gemv_madd(x[p], b + p * ldb + r.begin(), len, &acc[0]);
+           }
+           gemv_update(alpha, &acc[0], len, c + r.begin());
+         }
+       },
+       gemm_task_nc);
+}
+
+}  // namespace detail
+
+/**
+ * row-major general matrix multiplication
+ *
+ *     C = alpha * op(A) * op(B) + beta * C
+ *
+ * where op(A) is m x k, op(B) is k x n and op(X) is X or its transpose.
+ * A, B and C are addressed with leading dimensions lda, ldb and ldc, so
+ * sub-matrices can be passed without copying.
+ *
+ * Both operands are packed into cache-sized blocks (Goto's algorithm) and
+ * the inner loop runs a 6x16 register-tiled micro-kernel, which uses FMA
+ * with CNN_USE_AVX2. Tiles of C are distributed to the thread pool when
+ * parallelize is true. A single row of C times a non-transposed B skips the
+ * packing.
+ **/
+template <typename T>
+void gemm(bool trans_a,
+          bool trans_b,
+          size_t m,
+          size_t n,
+          size_t k,
+          T alpha,
+          const T *a,
+          size_t lda,
+          const T *b,
+          size_t ldb,
+          T beta,
+          T *c,
+          size_t ldc,
+          bool parallelize = true) {
+  using namespace detail;  // NOLINT
+
+  if (m == 0 || n == 0) return;
+  gemm_scale(m, n, beta, c, ldc);
+  if (k == 0 || alpha == T{0}) return;
+
+  // a single row of C does not benefit from packing B
+  if (m == 1 && !trans_b) {
+    gemv(n, k, alpha, a, trans_a ? lda : 1, b, ldb, c, parallelize);
+    return;
+  }
+
+  const size_t mblocks = (m + gemm_mc - 1) / gemm_mc;
+  gemm_buffer<T> packed_b;
+
+  for (size_t jc = 0; jc < n; jc += gemm_nc) {
+    const size_t nc      = std::min(gemm_nc, n - jc);
+    const size_t slivers = (nc + gemm_nr - 1) / gemm_nr;
+    const size_t nblocks = (nc + gemm_task_nc - 1) / gemm_task_nc;
+
+    for (size_t pc = 0; pc < k; pc += gemm_kc) {
+      const size_t kc = std::min(gemm_kc, k - pc);
+
+      packed_b.resize(slivers * kc * gemm_nr);
+      for_i(parallelize, slivers,
+            [&](size_t s) {
+              const size_t j = s * gemm_nr;
+              gemm_pack_b(trans_b, b, ldb, pc, kc, jc + j,
+                          std::min(gemm_nr, nc - j),
+                          &packed_b[s * kc * gemm_nr]);
+            },
+            16);
+
+      // one task per (block of A, column block of C)
+      for_(parallelize, 0u, mblocks * nblocks,
+           [&](const blocked_range &r) {
+             gemm_buffer<T> packed_a(gemm_mc * kc);
+             size_t packed_block = mblocks;
+             for (size_t t = r.begin(); t < r.end(); t++) {
+               const size_t mb = t / nblocks;
+               const size_t nb = t % nblocks;
+               const size_t ic = mb * gemm_mc;
+               const size_t mc = std::min(gemm_mc, m - ic);
+               if (packed_block != mb) {
+                 gemm_pack_a(trans_a, a, lda, ic, mc, pc, kc, &packed_a[0]);
+                 packed_block = mb;
+               }
+
+               const size_t jend = std::min(nc, (nb + 1) * gemm_task_nc);
+               for (size_t jr = nb * gemm_task_nc; jr < jend; jr += gemm_nr) {
+                 const T *pb = &packed_b[(jr / gemm_nr) * kc * gemm_nr];
+                 for (size_t ir = 0; ir < mc; ir += gemm_mr) {
+                   gemm_micro_kernel(kc, alpha, &packed_a[ir * kc], pb,
+                                     c + (ic + ir) * ldc + jc + jr, ldc,
+                                     std::min(gemm_mr, mc - ir),
+                                     std::min(gemm_nr, jend - jr));
+                 }
+               }
+             }
+           },
+           1u);
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
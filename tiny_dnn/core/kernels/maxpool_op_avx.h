@@ -7,27 +7,120 @@
 */
 #pragma once
 
+#include <cstdint>
+#include <limits>
 #include <vector>
 
+#ifdef CNN_USE_AVX
+#include <immintrin.h>
+
+#include "tiny_dnn/core/kernels/avx_kernel_common.h"
+#endif
+
 #include "tiny_dnn/core/kernels/maxpool_op_internal.h"
 
 namespace tiny_dnn {
 namespace kernels {
 
+#ifdef CNN_USE_AVX
+#ifndef CNN_USE_DOUBLE
+
+// take the lanes of v greater than max, recording offset as their argmax
+inline void update_max_ps(__m256 v, float offset, __m256 *max, __m256 *idx) {
+  const __m256 greater = _mm256_cmp_ps(v, *max, _CMP_GT_OQ);
+  *max                 = _mm256_max_ps(v, *max);
+  *idx = _mm256_or_ps(_mm256_and_ps(greater, _mm256_set1_ps(offset)),
+                      _mm256_andnot_ps(greater, *idx));
+}
+
+inline void store_argmax(__m256 idx, uint16_t *dst) {
+  const __m256i i = _mm256_cvttps_epi32(idx);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst),
+                   _mm_packus_epi32(_mm256_castsi256_si128(i),
+                                    _mm256_extractf128_si256(i, 1)));
+}
+
+/**
+ * Pool x Pool max-pooling with stride 2 of one plane, 8 outputs at a time.
+ * the outputs whose windows or loads cross the edges of the plane are left
+ * to maxpool_row.
+ **/
+template <size_t Pool>
+inline void maxpool_plane_s2_avx(const core::maxpool_params &params,
+                                 const float *in,
+                                 float *out,
+                                 uint16_t *argmax) {
+  const size_t w = params.in.width_;
+  for (size_t oy = 0; oy < params.out.height_; oy++) {
+    const size_t y0  = oy * 2;
+    const size_t row = oy * params.out.width_;
+    size_t ox        = 0;
+    if (y0 + Pool <= params.in.height_) {
+      // the last block reads up to in[y][2 * ox + 11 + 2 * Pool]
+      for (; ox + 8 <= params.out.width_ && 2 * ox + 12 + 2 * Pool <= w;
+           ox += 8) {
+        __m256 max = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+        __m256 idx = _mm256_setzero_ps();
+        for (size_t dy = 0; dy < Pool; dy++) {
+          const float *p     = in + (y0 + dy) * w + 2 * ox;
+          const float offset = static_cast<float>(dy * Pool);
+          __m256 even, odd;
+          deinterleave_ps(p, &even, &odd);
+          update_max_ps(even, offset, &max, &idx);
+          update_max_ps(odd, offset + 1, &max, &idx);
+          if (Pool == 3) {
+            deinterleave_ps(p + 2, &even, &odd);
+            update_max_ps(even, offset + 2, &max, &idx);
+          }
+        }
+        _mm256_storeu_ps(out + row + ox, max);
+        store_argmax(idx, argmax + row + ox);
+      }
+    }
+    maxpool_row(params, in, out, argmax, oy, ox);
+  }
+}
+
+#endif  // CNN_USE_DOUBLE
+#endif  // CNN_USE_AVX
+
 inline void maxpool_op_avx(const tensor_t &in_data,
                            tensor_t &out_data,
-                           std::vector<std::vector<size_t>> &max_idx,
-                           const std::vector<std::vector<size_t>> &out2in,
+                           std::vector<std::vector<uint16_t>> &max_idx,
+                           const core::maxpool_params &params,
                            const bool layer_parallelize) {
-  maxpool_op_internal(in_data, out_data, max_idx, out2in, layer_parallelize);
+#if defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  const size_t pool = params.pool_size_x;
+  if (params.pool_size_y == pool && (pool == 2 || pool == 3) &&
+      params.stride_x == 2 && params.stride_y == 2) {
+    const size_t in_area  = params.in.area();
+    const size_t out_area = params.out.area();
+    const size_t depth    = params.in.depth_;
+
+    for_i(layer_parallelize, in_data.size() * depth, [&](size_t i) {
+      const size_t sample = i / depth, c = i % depth;
+      const float *in     = &in_data[sample][c * in_area];
+      float *out          = &out_data[sample][c * out_area];
+      uint16_t *argmax    = &max_idx[sample][c * out_area];
+      if (pool == 2) {
+        maxpool_plane_s2_avx<2>(params, in, out, argmax);
+      } else {
+        maxpool_plane_s2_avx<3>(params, in, out, argmax);
+      }
+    });
+    return;
+  }
+#endif
+  maxpool_op_internal(in_data, out_data, max_idx, params, layer_parallelize);
 }
 
-inline void maxpool_grad_op_avx(tensor_t &prev_delta,
-                                const tensor_t &curr_delta,
-                                std::vector<std::vector<size_t>> &max_idx,
-                                const std::vector<size_t> &in2out,
-                                const bool layer_parallelize) {
-  maxpool_grad_op_internal(prev_delta, curr_delta, max_idx, in2out,
+inline void maxpool_grad_op_avx(
+  tensor_t &prev_delta,
+  const tensor_t &curr_delta,
+  const std::vector<std::vector<uint16_t>> &max_idx,
+  const core::maxpool_params &params,
+  const bool layer_parallelize) {
+  maxpool_grad_op_internal(prev_delta, curr_delta, max_idx, params,
                            layer_parallelize);
 }
 
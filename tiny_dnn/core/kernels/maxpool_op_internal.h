@@ -7,51 +7,112 @@
 */
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <limits>
 #include <vector>
 
+#include "tiny_dnn/core/params/maxpool_params.h"
+
 namespace tiny_dnn {
 namespace kernels {
 
+/**
+ * max of the window of output (ox, oy) in the plane in. windows start at
+ * (ox * stride_x, oy * stride_y) and are clipped at the right and bottom
+ * edges. the position of the maximum is stored in argmax as
+ * dy * pool_size_x + dx.
+ **/
+template <typename T>
+inline T maxpool_window(const core::maxpool_params &params,
+                        const T *in,
+                        size_t ox,
+                        size_t oy,
+                        uint16_t *argmax) {
+  const size_t x0    = ox * params.stride_x;
+  const size_t y0    = oy * params.stride_y;
+  const size_t dxmax = std::min(params.pool_size_x, params.in.width_ - x0);
+  const size_t dymax = std::min(params.pool_size_y, params.in.height_ - y0);
+
+  T max_value = std::numeric_limits<T>::lowest();
+  size_t idx  = 0;
+  for (size_t dy = 0; dy < dymax; dy++) {
+    const T *row = in + (y0 + dy) * params.in.width_ + x0;
+    for (size_t dx = 0; dx < dxmax; dx++) {
+      if (row[dx] > max_value) {
+        max_value = row[dx];
+        idx       = dy * params.pool_size_x + dx;
+      }
+    }
+  }
+  *argmax = static_cast<uint16_t>(idx);
+  return max_value;
+}
+
+/**
+ * max-pooling of the outputs [ox_begin, out.width_) of row oy of a plane
+ **/
+template <typename T>
+inline void maxpool_row(const core::maxpool_params &params,
+                        const T *in,
+                        T *out,
+                        uint16_t *argmax,
+                        size_t oy,
+                        size_t ox_begin) {
+  const size_t row = oy * params.out.width_;
+  for (size_t ox = ox_begin; ox < params.out.width_; ox++) {
+    out[row + ox] = maxpool_window(params, in, ox, oy, &argmax[row + ox]);
+  }
+}
+
 inline void maxpool_op_internal(const tensor_t &in_data,
                                 tensor_t &out_data,
-                                std::vector<std::vector<size_t>> &max_idx,
-                                const std::vector<std::vector<size_t>> &out2in,
+                                std::vector<std::vector<uint16_t>> &max_idx,
+                                const core::maxpool_params &params,
                                 const bool layer_parallelize) {
-  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
-    const vec_t &in          = in_data[sample];
-    vec_t &out               = out_data[sample];
-    std::vector<size_t> &max = max_idx[sample];
-
-    for (size_t i = 0; i < out2in.size(); i++) {
-      const auto &in_index = out2in[i];
-      float_t max_value    = std::numeric_limits<float_t>::lowest();
-      size_t idx           = 0;
-      for (auto j : in_index) {
-        if (in[j] > max_value) {
-          max_value = in[j];
-          idx       = j;
-        }
-      }
-      max[i] = idx;
-      out[i] = max_value;
+  const size_t in_area  = params.in.area();
+  const size_t out_area = params.out.area();
+  const size_t depth    = params.in.depth_;
+
+  for_i(layer_parallelize, in_data.size() * depth, [&](size_t i) {
+    const size_t sample = i / depth, c = i % depth;
+    const float_t *in   = &in_data[sample][c * in_area];
+    float_t *out        = &out_data[sample][c * out_area];
+    uint16_t *argmax    = &max_idx[sample][c * out_area];
+
+    for (size_t oy = 0; oy < params.out.height_; oy++) {
+      maxpool_row(params, in, out, argmax, oy, 0);
     }
   });
 }
 
-inline void maxpool_grad_op_internal(tensor_t &prev_delta,
-                                     const tensor_t &curr_delta,
-                                     std::vector<std::vector<size_t>> &max_idx,
-                                     const std::vector<size_t> &in2out,
-                                     const bool layer_parallelize) {
-  for_i(layer_parallelize, prev_delta.size(), [&](size_t sample) {
-    vec_t &prev                    = prev_delta[sample];
-    const vec_t &curr              = curr_delta[sample];
-    const std::vector<size_t> &max = max_idx[sample];
-
-    for (size_t i = 0; i < in2out.size(); i++) {
-      size_t outi = in2out[i];
-      prev[i]     = (max[outi] == i) ? curr[outi] : float_t{0};
+/**
+ * routes the gradient of each output to the maximum of its window. inputs
+ * shared by overlapping windows accumulate the gradients of all of them.
+ **/
+inline void maxpool_grad_op_internal(
+  tensor_t &prev_delta,
+  const tensor_t &curr_delta,
+  const std::vector<std::vector<uint16_t>> &max_idx,
+  const core::maxpool_params &params,
+  const bool layer_parallelize) {
+  const size_t in_area  = params.in.area();
+  const size_t out_area = params.out.area();
+  const size_t depth    = params.in.depth_;
+  const size_t pool_x   = params.pool_size_x;
+
+  for_i(layer_parallelize, prev_delta.size() * depth, [&](size_t i) {
+    const size_t sample    = i / depth, c = i % depth;
+    float_t *prev          = &prev_delta[sample][c * in_area];
+    const float_t *curr    = &curr_delta[sample][c * out_area];
+    const uint16_t *argmax = &max_idx[sample][c * out_area];
+
+    for (size_t oy = 0, o = 0; oy < params.out.height_; oy++) {
+      for (size_t ox = 0; ox < params.out.width_; ox++, o++) {
+        const size_t x = ox * params.stride_x + argmax[o] % pool_x;
+        const size_t y = oy * params.stride_y + argmax[o] / pool_x;
+        prev[y * params.in.width_ + x] += curr[o];
+      }
     }
   });
 }
@@ -0,0 +1,271 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#ifdef CNN_USE_AVX
+#include <immintrin.h>
+#endif
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * fused update rules of the optimizers: one pass over n weights W, their
+ * gradients dW and the optimizer state of the weights, which lies in
+ * arrays of its own next to the weights. the float versions use AVX with
+ * CNN_USE_AVX; the rules are the ones documented in optimizer.h.
+ **/
+
+template <typename T>
+void sgd_update(size_t n, T alpha, T lambda, const T *dW, T *W) {
+  for (size_t i = 0; i < n; i++) W[i] = W[i] - alpha * (dW[i] + lambda * W[i]);
+}
+
+// V = mu * V - alpha * (dW + lambda * W); W += V, or with nesterov
+// W += -mu * V_old + (1 + mu) * V
+template <typename T>
+void momentum_update(size_t n,
+                     T alpha,
+                     T lambda,
+                     T mu,
+                     bool nesterov,
+                     const T *dW,
+                     T *W,
+                     T *V) {
+  for (size_t i = 0; i < n; i++) {
+    const T v = mu * V[i] - alpha * (dW[i] + W[i] * lambda);
+    W[i] += nesterov ? (-mu) * V[i] + (1 + mu) * v : v;
+    V[i] = v;
+  }
+}
+
+template <typename T>
+void adagrad_update(size_t n, T alpha, T eps, const T *dW, T *W, T *g) {
+  for (size_t i = 0; i < n; i++) {
+    g[i] += dW[i] * dW[i];
+    W[i] -= alpha * dW[i] / (std::sqrt(g[i]) + eps);
+  }
+}
+
+template <typename T>
+void rmsprop_update(size_t n, T alpha, T mu, T eps, const T *dW, T *W, T *g) {
+  for (size_t i = 0; i < n; i++) {
+    g[i] = mu * g[i] + (1 - mu) * dW[i] * dW[i];
+    W[i] -= alpha * dW[i] / std::sqrt(g[i] + eps);
+  }
+}
+
+// c1 and c2 are the bias corrections 1 - b1^t and 1 - b2^t
+template <typename T>
+void adam_update(size_t n,
+                 T alpha,
+                 T b1,
+                 T b2,
+                 T c1,
+                 T c2,
+                 T eps,
+                 const T *dW,
+                 T *W,
+                 T *mt,
+                 T *vt) {
+  for (size_t i = 0; i < n; i++) {
+    mt[i] = b1 * mt[i] + (T(1) - b1) * dW[i];
+    vt[i] = b2 * vt[i] + (T(1) - b2) * dW[i] * dW[i];
+    W[i] -= alpha * (mt[i] / c1) / std::sqrt((vt[i] / c2) + eps);
+  }
+}
+
+// alpha includes the bias correction 1 / (1 - b1^t)
+template <typename T>
+void adamax_update(size_t n,
+                   T alpha,
+                   T b1,
+                   T b2,
+                   T eps,
+                   const T *dW,
+                   T *W,
+                   T *mt,
+                   T *ut) {
+  for (size_t i = 0; i < n; i++) {
+    mt[i] = b1 * mt[i] + (T(1) - b1) * dW[i];
+    ut[i] = std::max(b2 * ut[i], std::abs(dW[i]));
+    W[i] -= alpha * (mt[i] / (ut[i] + eps));
+  }
+}
+
+#ifdef CNN_USE_AVX
+
+// 8 weights at a time, the remaining ones by the generic versions
+
+inline void sgd_update(size_t n,
+                       float alpha,
+                       float lambda,
+                       const float *dW,
+                       float *W) {
+  const __m256 valpha  = _mm256_set1_ps(alpha);
+  const __m256 vlambda = _mm256_set1_ps(lambda);
+  size_t i             = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 w = _mm256_loadu_ps(W + i);
+    const __m256 g =
+      _mm256_add_ps(_mm256_loadu_ps(dW + i), _mm256_mul_ps(vlambda, w));
+    _mm256_storeu_ps(W + i, _mm256_sub_ps(w, _mm256_mul_ps(valpha, g)));
+  }
+  sgd_update<float>(n - i, alpha, lambda, dW + i, W + i);
+}
+
+inline void momentum_update(size_t n,
+                            float alpha,
+                            float lambda,
+                            float mu,
+                            bool nesterov,
+                            const float *dW,
+                            float *W,
+                            float *V) {
+  const __m256 valpha  = _mm256_set1_ps(alpha);
+  const __m256 vlambda = _mm256_set1_ps(lambda);
+  const __m256 vmu     = _mm256_set1_ps(mu);
+  const __m256 vnmu    = _mm256_set1_ps(-mu);
+  const __m256 vmu1    = _mm256_set1_ps(1 + mu);
+  size_t i             = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 w    = _mm256_loadu_ps(W + i);
+    const __m256 prev = _mm256_loadu_ps(V + i);
+    const __m256 g =
+      _mm256_add_ps(_mm256_loadu_ps(dW + i), _mm256_mul_ps(w, vlambda));
+    const __m256 v =
+      _mm256_sub_ps(_mm256_mul_ps(vmu, prev), _mm256_mul_ps(valpha, g));
+    const __m256 dw = nesterov ? _mm256_add_ps(_mm256_mul_ps(vnmu, prev),
+                                               _mm256_mul_ps(vmu1, v))
+                               : v;
+    _mm256_storeu_ps(W + i, _mm256_add_ps(w, dw));
+    _mm256_storeu_ps(V + i, v);
+  }
+  momentum_update<float>(n - i, alpha, lambda, mu, nesterov, dW + i, W + i,
+                         V + i);
+}
+
+inline void adagrad_update(
+  size_t n, float alpha, float eps, const float *dW, float *W, float *g) {
+  const __m256 valpha = _mm256_set1_ps(alpha);
+  const __m256 veps   = _mm256_set1_ps(eps);
+  size_t i            = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 d = _mm256_loadu_ps(dW + i);
+    const __m256 s =
+      _mm256_add_ps(_mm256_loadu_ps(g + i), _mm256_mul_ps(d, d));
+    _mm256_storeu_ps(g + i, s);
+    const __m256 step = _mm256_div_ps(
+      _mm256_mul_ps(valpha, d), _mm256_add_ps(_mm256_sqrt_ps(s), veps));
+    _mm256_storeu_ps(W + i, _mm256_sub_ps(_mm256_loadu_ps(W + i), step));
+  }
+  adagrad_update<float>(n - i, alpha, eps, dW + i, W + i, g + i);
+}
+
+inline void rmsprop_update(size_t n,
+                           float alpha,
+                           float mu,
+                           float eps,
+                           const float *dW,
+                           float *W,
+                           float *g) {
+  const __m256 valpha = _mm256_set1_ps(alpha);
+  const __m256 vmu    = _mm256_set1_ps(mu);
+  const __m256 vmu1   = _mm256_set1_ps(1 - mu);
+  const __m256 veps   = _mm256_set1_ps(eps);
+  size_t i            = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 d = _mm256_loadu_ps(dW + i);
+    const __m256 s =
+      _mm256_add_ps(_mm256_mul_ps(vmu, _mm256_loadu_ps(g + i)),
+                    _mm256_mul_ps(_mm256_mul_ps(vmu1, d), d));
+    _mm256_storeu_ps(g + i, s);
+    const __m256 step = _mm256_div_ps(_mm256_mul_ps(valpha, d),
+                                      _mm256_sqrt_ps(_mm256_add_ps(s, veps)));
+    _mm256_storeu_ps(W + i, _mm256_sub_ps(_mm256_loadu_ps(W + i), step));
+  }
+  rmsprop_update<float>(n - i, alpha, mu, eps, dW + i, W + i, g + i);
+}
+
+inline void adam_update(size_t n,
+                        float alpha,
+                        float b1,
+                        float b2,
+                        float c1,
+                        float c2,
+                        float eps,
+                        const float *dW,
+                        float *W,
+                        float *mt,
+                        float *vt) {
+  const __m256 valpha = _mm256_set1_ps(alpha);
+  const __m256 vb1    = _mm256_set1_ps(b1);
+  const __m256 vb1c   = _mm256_set1_ps(1 - b1);
+  const __m256 vb2    = _mm256_set1_ps(b2);
+  const __m256 vb2c   = _mm256_set1_ps(1 - b2);
+  const __m256 vc1    = _mm256_set1_ps(c1);
+  const __m256 vc2    = _mm256_set1_ps(c2);
+  const __m256 veps   = _mm256_set1_ps(eps);
+  size_t i            = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 d = _mm256_loadu_ps(dW + i);
+    const __m256 m = _mm256_add_ps(_mm256_mul_ps(vb1, _mm256_loadu_ps(mt + i)),
+                                   _mm256_mul_ps(vb1c, d));
+    const __m256 v = _mm256_add_ps(_mm256_mul_ps(vb2, _mm256_loadu_ps(vt + i)),
+                                   _mm256_mul_ps(_mm256_mul_ps(vb2c, d), d));
+    _mm256_storeu_ps(mt + i, m);
+    _mm256_storeu_ps(vt + i, v);
+    const __m256 step = _mm256_div_ps(
+      _mm256_mul_ps(valpha, _mm256_div_ps(m, vc1)),
+      _mm256_sqrt_ps(_mm256_add_ps(_mm256_div_ps(v, vc2), veps)));
+    _mm256_storeu_ps(W + i, _mm256_sub_ps(_mm256_loadu_ps(W + i), step));
+  }
+  adam_update<float>(n - i, alpha, b1, b2, c1, c2, eps, dW + i, W + i, mt + i,
+                     vt + i);
+}
+
+inline void adamax_update(size_t n,
+                          float alpha,
+                          float b1,
+                          float b2,
+                          float eps,
+                          const float *dW,
+                          float *W,
+                          float *mt,
+                          float *ut) {
+  const __m256 valpha = _mm256_set1_ps(alpha);
+  const __m256 vb1    = _mm256_set1_ps(b1);
+  const __m256 vb1c   = _mm256_set1_ps(1 - b1);
+  const __m256 vb2    = _mm256_set1_ps(b2);
+  const __m256 veps   = _mm256_set1_ps(eps);
+  const __m256 vabs   = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  size_t i            = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 d = _mm256_loadu_ps(dW + i);
+    const __m256 m = _mm256_add_ps(_mm256_mul_ps(vb1, _mm256_loadu_ps(mt + i)),
+                                   _mm256_mul_ps(vb1c, d));
+    const __m256 u = _mm256_max_ps(_mm256_mul_ps(vb2, _mm256_loadu_ps(ut + i)),
+                                   _mm256_and_ps(d, vabs));
+    _mm256_storeu_ps(mt + i, m);
+    _mm256_storeu_ps(ut + i, u);
+    const __m256 step =
+      _mm256_mul_ps(valpha, _mm256_div_ps(m, _mm256_add_ps(u, veps)));
+    _mm256_storeu_ps(W + i, _mm256_sub_ps(_mm256_loadu_ps(W + i), step));
+  }
+  adamax_update<float>(n - i, alpha, b1, b2, eps, dW + i, W + i, mt + i,
+                       ut + i);
+}
+
+#endif  // CNN_USE_AVX
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -85,13 +85,15 @@ inline void recurrent_cell_op_internal(
   const core::recurrent_cell_params &params,
   const bool layer_parallelize) {
   for (size_t sample = 0; sample < prev_out.size(); sample++) {
+    // weight gradients may hold fewer rows than samples (partial sums)
+    const size_t partial = partial_index(sample, prev_out.size(), dW.size());
     const vec_t &prev_out_          = prev_out[sample];
     const vec_t &prev_h_            = prev_h[sample];
-    vec_t &dU_                      = dU[sample];
-    vec_t &dW_                      = dW[sample];
-    vec_t &dV_                      = dV[sample];
-    vec_t &db_                      = db[sample];
-    vec_t &dc_                      = dc[sample];
+    vec_t &dU_                      = dU[partial];
+    vec_t &dW_                      = dW[partial];
+    vec_t &dV_                      = dV[partial];
+    vec_t &db_                      = db[partial];
+    vec_t &dc_                      = dc[partial];
     const vec_t &curr_output_delta_ = curr_output_delta[sample];
     vec_t &curr_state_delta_        = curr_state_delta[sample];
     vec_t &prev_output_delta_       = prev_output_delta[sample];
@@ -20,8 +20,10 @@ inline void tiny_deconv2d_back_kernel(const deconv_params &params,
                                       tensor_t &db,
                                       tensor_t &curr_delta,
                                       tensor_t *prev_delta) {
-  // propagate delta to previous layer
-  for_i(prev_out.size(), [&](size_t sample) {
+  // samples sharing a row of dW (partial sums) run on the same task
+  for_partials(true, prev_out.size(), dW.size(), [&](size_t partial,
+                                                     size_t sample) {
+    // propagate delta to previous layer
     for (size_t inc = 0; inc < params.in.depth_; inc++) {
       for (size_t outc = 0; outc < params.out.depth_; outc++) {
         if (!params.tbl.is_connected(outc, inc)) continue;
@@ -80,7 +82,7 @@ inline void tiny_deconv2d_back_kernel(const deconv_params &params,
             }
 
             idx = params.in.depth_ * outc + inc;
-            dW[sample][params.weight.get_index(wx, wy, idx)] += dst;
+            dW[partial][params.weight.get_index(wx, wy, idx)] += dst;
           }
         }
       }
@@ -94,7 +96,7 @@ inline void tiny_deconv2d_back_kernel(const deconv_params &params,
         size_t idx            = params.out.get_index(0, 0, outc);
         const float_t *delta  = &curr_delta[sample][idx];
         const float_t *deltaa = delta + params.out.width_ * params.out.height_;
-        db[sample][outc] += std::accumulate(delta, deltaa, float_t{0});
+        db[partial][outc] += std::accumulate(delta, deltaa, float_t{0});
       }
     }
   });
@@ -11,140 +11,175 @@
 #include <vector>
 
 #include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
+#include "tiny_dnn/core/kernels/tiny_quantized_weights.h"
 #include "tiny_dnn/core/params/conv_params.h"
 
 namespace tiny_dnn {
 namespace core {
 namespace kernels {
 
-inline void tiny_quantized_conv2d_kernel(const conv_params &params,
-                                         const vec_t &in,
-                                         const vec_t &W,
-                                         const vec_t &bias,
-                                         vec_t &a,
-                                         const bool layer_parallelize) {
-  // image quantization
-  float_t min_input(in[0]);
-  float_t max_input(in[0]);
-  for (size_t inc = 0; inc < params.in.depth_; inc++) {
-    for (size_t ins = 0;
-         ins < params.in_padded.height_ * params.in_padded.height_; ins++) {
-      size_t idx = params.in_padded.get_index(0, 0, inc);
-      min_input  = std::min(min_input, (&in[idx])[ins]);
-      max_input  = std::max(max_input, (&in[idx])[ins]);
-    }
-  }
-  std::vector<uint8_t> in_quantized =
-    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
-  // filter quantization
-  float_t min_filter(W[0]);
-  float_t max_filter(W[0]);
-  for (size_t inc = 0; inc < params.in_padded.depth_; inc++) {
-    for (size_t ins = 0; ins < params.weight.height_ * params.weight.height_;
-         ins++) {
-      size_t idx = params.in_padded.get_index(0, 0, inc);
-      min_filter = std::min(min_filter, (&W[idx])[ins]);
-      max_filter = std::max(max_filter, (&W[idx])[ins]);
-    }
-  }
-  if (min_filter == max_filter) {
-    max_filter = W[0] + 1e-3f;
-    min_filter = W[0] - 1e-3f;
-  }
-  std::vector<uint8_t> W_quantized =
-    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
-  // bias quantization
-  float_t min_bias(0);
-  float_t max_bias(0);
-  std::vector<uint8_t> bias_quantized;
-  if (params.has_bias) {
-    for (size_t inc = 0; inc < params.out.depth_; inc++) {
-      min_bias = std::min(min_bias, bias[inc]);
-      max_bias = std::max(max_bias, bias[inc]);
-    }
-    if (min_bias == max_bias) {
-      max_bias = bias[0] + 1e-3f;
-      min_bias = bias[0] - 1e-3f;
+/**
+ * weights W of a convolution laid out for quantized_gemm: a row per output
+ * channel, holding the kernels of all input channels. offsets are the codes
+ * of 0 of the rows, the weights of unconnected channels are set to them.
+ **/
+inline packed_quantized_weights pack_quantized_conv2d_weights(
+  const conv_params &params,
+  const std::vector<uint8_t> &W,
+  const std::vector<int32_t> &offsets) {
+  const size_t area  = params.weight.area();
+  const size_t depth = params.in.depth_ * area;
+  return packed_quantized_weights(
+    params.out.depth_, depth, offsets, [&](size_t o, size_t k) {
+      return params.tbl.is_connected(o, k / area) ? W[o * depth + k]
+                                                  : zero_code(offsets[o]);
+    });
+}
+
+/**
+ * 32-bit accumulators of the convolution of in_quantized, the padded input
+ * with the code offset_input for 0, with the packed weights a: the input
+ * under the kernel at every output pixel is copied into a column
+ * (im2col), and the columns are multiplied with the weights.
+ **/
+inline void quantized_conv2d_accumulate(
+  const conv_params &params,
+  const packed_quantized_weights &a,
+  const std::vector<uint8_t> &in_quantized,
+  const int32_t offset_input,
+  std::vector<int32_t> &a_quantized,
+  const bool layer_parallelize) {
+  const size_t depth = params.in.depth_ * params.weight.area();
+  const size_t area  = params.out.area();
+  std::vector<uint8_t> cols(area * depth);
+
+  for_i(layer_parallelize, params.out.height_, [&](size_t y) {
+    for (size_t x = 0; x < params.out.width_; x++) {
+      uint8_t *col = &cols[(y * params.out.width_ + x) * depth];
+      for (size_t inc = 0; inc < params.in.depth_; inc++) {
+        for (size_t wy = 0; wy < params.weight.height_; wy++) {
+          const uint8_t *pi = &in_quantized[params.in_padded.get_index(
+            x * params.w_stride, y * params.h_stride + wy, inc)];
+          col = std::copy(pi, pi + params.weight.width_, col);
+        }
+      }
     }
-    bias_quantized =
-      float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias);
-  }
-  // output range
-  float_t min_output_value;
-  float_t max_output_value;
-  quantization_range_for_multiplication<uint8_t, uint8_t, int32_t>(
-    min_input, max_input, min_filter, max_filter, &min_output_value,
-    &max_output_value);
+  });
+
+  a_quantized.resize(params.out.size());
+  quantized_gemm(a, &cols[0], area, depth, offset_input, &a_quantized[0],
+                 area, layer_parallelize);
+}
 
-  std::vector<int32_t> a_quantized(a.size(), static_cast<int32_t>(0));
+/**
+ * 8-bit convolution of one sample. in_quantized is the padded input
+ * quantized over [min_input, max_input], bias the float bias of the layer if
+ * params.has_bias. the result is requantized into
+ * a_requantized over [*min_output, *max_output] if that is a non-empty
+ * range, otherwise over a range of its own, returned in min_output/max_output.
+ **/
+inline void tiny_quantized_conv2d_kernel(
+  const conv_params &params,
+  const std::vector<uint8_t> &in_quantized,
+  const float_t min_input,
+  const float_t max_input,
+  const quantized_weights &w,
+  const vec_t *bias,
+  std::vector<uint8_t> &a_requantized,
+  float_t *min_output,
+  float_t *max_output,
+  const bool layer_parallelize) {
+  const std::vector<float_t> unit = accumulator_units(min_input, max_input, w);
+
+  const packed_quantized_weights &packed = w.packed([&] {
+    std::vector<int32_t> offsets(params.out.depth_);
+    for (size_t o = 0; o < offsets.size(); o++) offsets[o] = w.offset(o);
+    return pack_quantized_conv2d_weights(params, w.W, offsets);
+  });
 
   // calculating offset
   const int32_t offset_input = int64_to_int32(
     float_to_quantized_unclamped<uint8_t>(0.0f, min_input, max_input));
-  const int32_t offset_filter = int64_to_int32(
-    float_to_quantized_unclamped<uint8_t>(0.0f, min_filter, max_filter));
-  const int32_t zero_in_total_space = int64_to_int32(
-    float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value));
 
-  for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
-    for (size_t inc = 0; inc < params.in.depth_; inc++) {
-      if (!params.tbl.is_connected(o, inc)) continue;
-
-      size_t idx        = 0;
-      idx               = params.in.depth_ * o + inc;
-      idx               = params.weight.get_index(0, 0, idx);
-      const uint8_t *pw = &W_quantized[idx];
+  std::vector<int32_t> a_quantized;
+  quantized_conv2d_accumulate(params, packed, in_quantized, offset_input,
+                              a_quantized, layer_parallelize);
 
-      idx               = params.in_padded.get_index(0, 0, inc);
-      const uint8_t *pi = &in_quantized[idx];
-
-      idx                   = params.out.get_index(0, 0, o);
-      int32_t *pa_quantized = &a_quantized[idx];
-
-      for (size_t y = 0; y < params.out.height_; y++) {
-        for (size_t x = 0; x < params.out.width_; x++) {
-          const uint8_t *ppw = pw;
-          const uint8_t *ppi = pi +
-                               params.in_padded.width_ * (y * params.h_stride) +
-                               x * params.w_stride;
-          int32_t sum = 0;
-
-          // should be optimized for small kernel(3x3,5x5)
-          for (size_t wy = 0; wy < params.weight.height_; wy++) {
-            for (size_t wx = 0; wx < params.weight.width_; wx++) {
-              idx = wy * params.in_padded.width_ + wx;
-              sum += (static_cast<int32_t>(*ppw++) - offset_filter) *
-                     (static_cast<int32_t>(ppi[idx]) - offset_input);
-            }
-          }
-          pa_quantized[y * params.out.width_ + x] += sum;
-        }
-      }
-    }
-    if (params.has_bias) {
+  if (params.has_bias) {
+    for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
+      const int32_t b =
+        quantized_bias((*bias)[o], unit[unit.size() == 1 ? 0 : o]);
       int32_t *pa_quantized = &a_quantized[params.out.get_index(0, 0, o)];
       int32_t *paa_quantized =
         pa_quantized + params.out.width_ * params.out.height_;
-      std::for_each(pa_quantized, paa_quantized, [&](int32_t &f) {
-        f += (bias_quantized[o] - zero_in_total_space);
-      });
-    }
-  });
-
-  float_t min_output_requantized;
-  float_t max_output_requantized;
-  std::vector<uint8_t> a_requantized(a_quantized.size(),
-                                     static_cast<uint8_t>(0));
+      std::for_each(pa_quantized, paa_quantized, [&](int32_t &f) { f += b; });
+    });
+  }
 
   // Requantize from 32bits to 8 bits for next layer
-  quantize_down_and_shrink_range<int32_t, uint8_t>(
-    a_quantized, min_output_value, max_output_value, &min_output_requantized,
-    &max_output_requantized, &a_requantized);
+  requantize_accumulators(a_quantized, unit, params.out.area(), a_requantized,
+                          min_output, max_output);
+}
 
-  // dequantize to flaot, this could be removed within concatenated quantized
-  // network
-  a = quantized_tensor_to_float<uint8_t>(a_requantized, min_output_requantized,
-                                         max_output_requantized);
+/**
+ * quantize the padded input in, convolve it with the quantized weights w and
+ * dequantize the result into a
+ **/
+inline void tiny_quantized_conv2d_kernel(const conv_params &params,
+                                         const vec_t &in,
+                                         const quantized_weights &w,
+                                         const vec_t *bias,
+                                         vec_t &a,
+                                         const bool layer_parallelize) {
+  float_t min_input, max_input;
+  quantization_range(in, &min_input, &max_input);
+  std::vector<uint8_t> in_quantized =
+    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+
+  std::vector<uint8_t> a_quantized;
+  float_t min_output = 0, max_output = 0;
+  tiny_quantized_conv2d_kernel(params, in_quantized, min_input, max_input, w,
+                               bias, a_quantized, &min_output, &max_output,
+                               layer_parallelize);
+
+  a.resize(a_quantized.size());
+  quantized_tensor_to_float_in_place<uint8_t>(a_quantized, min_output,
+                                              max_output, &a);
+}
+
+inline void tiny_quantized_conv2d_kernel(const conv_params &params,
+                                         const vec_t &in,
+                                         const vec_t &W,
+                                         const vec_t &bias,
+                                         vec_t &a,
+                                         const bool layer_parallelize) {
+  tiny_quantized_conv2d_kernel(params, in, *quantize_weights(W), &bias, a,
+                               layer_parallelize);
+}
+
+/**
+ * copy the quantized image in into the padded layout of params, filling the
+ * border with the code of 0. returns false if 0 is outside [min, max].
+ **/
+inline bool pad_quantized_input(const conv_params &params,
+                                const std::vector<uint8_t> &in,
+                                const float_t min,
+                                const float_t max,
+                                std::vector<uint8_t> &dst) {
+  if (min > float_t(0) || max < float_t(0)) return false;
+  dst.assign(params.in_padded.size(),
+             float_to_quantized<uint8_t>(float_t(0), min, max));
+  for (size_t c = 0; c < params.in.depth_; c++) {
+    const uint8_t *pin = &in[params.in.get_index(0, 0, c)];
+    uint8_t *pdst      = &dst[params.in_padded.get_index(
+      params.weight.width_ / 2, params.weight.height_ / 2, c)];
+    for (size_t y = 0; y < params.in.height_; y++) {
+      std::copy(pin, pin + params.in.width_, pdst);
+      pin += params.in.width_;
+      pdst += params.in_padded.width_;
+    }
+  }
+  return true;
 }
 
 inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
@@ -385,8 +420,6 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
     bias_quantized.push_back(static_cast<uint8_t>(bias[i]));
   }
 
-  std::vector<int32_t> a_quantized(a.size(), static_cast<int32_t>(0));
-
   // calculating offset
   const int32_t offset_input = int64_to_int32(
     float_to_quantized_unclamped<uint8_t>(0.0f, in_r[0], in_r[1]));
@@ -395,50 +428,24 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
   const int32_t zero_in_total_space = int64_to_int32(
     float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value));
 
-  for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
-    for (size_t inc = 0; inc < params.in.depth_; inc++) {
-      if (!params.tbl.is_connected(o, inc)) continue;
-
-      size_t idx        = 0;
-      idx               = params.in.depth_ * o + inc;
-      idx               = params.weight.get_index(0, 0, idx);
-      const uint8_t *pw = &W_quantized[idx];
-
-      idx               = params.in_padded.get_index(0, 0, inc);
-      const uint8_t *pi = &in_quantized[idx];
-
-      idx                   = params.out.get_index(0, 0, o);
-      int32_t *pa_quantized = &a_quantized[idx];
+  std::vector<int32_t> a_quantized;
+  quantized_conv2d_accumulate(
+    params,
+    pack_quantized_conv2d_weights(
+      params, W_quantized,
+      std::vector<int32_t>(params.out.depth_, offset_filter)),
+    in_quantized, offset_input, a_quantized, layer_parallelize);
 
-      for (size_t y = 0; y < params.out.height_; y++) {
-        for (size_t x = 0; x < params.out.width_; x++) {
-          const uint8_t *ppw = pw;
-          const uint8_t *ppi = pi +
-                               params.in_padded.width_ * (y * params.h_stride) +
-                               x * params.w_stride;
-          int32_t sum = 0;
-
-          // should be optimized for small kernel(3x3,5x5)
-          for (size_t wy = 0; wy < params.weight.height_; wy++) {
-            for (size_t wx = 0; wx < params.weight.width_; wx++) {
-              idx = wy * params.in_padded.width_ + wx;
-              sum += (static_cast<int32_t>(*ppw++) - offset_filter) *
-                     (static_cast<int32_t>(ppi[idx]) - offset_input);
-            }
-          }
-          pa_quantized[y * params.out.width_ + x] += sum;
-        }
-      }
-    }
-    if (params.has_bias) {
+  if (params.has_bias) {
+    for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
       int32_t *pa_quantized = &a_quantized[params.out.get_index(0, 0, o)];
       int32_t *paa_quantized =
         pa_quantized + params.out.width_ * params.out.height_;
       std::for_each(pa_quantized, paa_quantized, [&](int32_t &f) {
         f += static_cast<int32_t>((bias[o] - zero_in_total_space));
       });
-    }
-  });
+    });
+  }
 
   float_t min_output_requantized;
   float_t max_output_requantized;
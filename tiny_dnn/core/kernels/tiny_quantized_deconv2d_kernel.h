@@ -11,137 +11,171 @@
 #include <vector>
 
 #include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
+#include "tiny_dnn/core/kernels/tiny_quantized_weights.h"
 #include "tiny_dnn/core/params/deconv_params.h"
 
 namespace tiny_dnn {
 namespace core {
 namespace kernels {
 
-inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
-                                           const vec_t &in,
-                                           const vec_t &W,
-                                           const vec_t &bias,
-                                           vec_t &out,
-                                           const bool layer_parallelize) {
-  // image quantization
-  float_t min_input(in[0]);
-  float_t max_input(in[0]);
-  for (size_t inc = 0; inc < params.in.depth_; inc++) {
-    for (size_t ins = 0; ins < params.in.height_ * params.in.height_; ins++) {
-      size_t idx = params.in.get_index(0, 0, inc);
-      min_input  = std::min(min_input, (&in[idx])[ins]);
-      max_input  = std::max(max_input, (&in[idx])[ins]);
-    }
+/**
+ * weights W of a deconvolution laid out for quantized_gemm: a row per output
+ * channel and position in the kernel, holding the weights of all input
+ * channels there. offsets are the codes of 0 of the output channels, the
+ * weights of unconnected channels are set to them.
+ **/
+inline packed_quantized_weights pack_quantized_deconv2d_weights(
+  const deconv_params &params,
+  const std::vector<uint8_t> &W,
+  const std::vector<int32_t> &offsets) {
+  const size_t area = params.weight.area();
+  std::vector<int32_t> row_offsets(params.out.depth_ * area);
+  for (size_t r = 0; r < row_offsets.size(); r++) {
+    row_offsets[r] = offsets[r / area];
   }
-  std::vector<uint8_t> in_quantized =
-    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
-  // filter quantization
-  float_t min_filter(W[0]);
-  float_t max_filter(W[0]);
+  return packed_quantized_weights(
+    row_offsets.size(), params.in.depth_, row_offsets,
+    [&](size_t r, size_t inc) {
+      const size_t o = r / area;
+      return params.tbl.is_connected(o, inc)
+               ? W[(params.in.depth_ * o + inc) * area + r % area]
+               : zero_code(offsets[o]);
+    });
+}
+
+/**
+ * 32-bit accumulators of the deconvolution of in_quantized, the input with
+ * the code offset_input for 0, with the packed weights a: the products of
+ * every input pixel with all weights are computed in one matrix product,
+ * then added up at the output pixels they fall on (col2im).
+ **/
+inline void quantized_deconv2d_accumulate(
+  const deconv_params &params,
+  const packed_quantized_weights &a,
+  const std::vector<uint8_t> &in_quantized,
+  const int32_t offset_input,
+  std::vector<int32_t> &out_quantized,
+  const bool layer_parallelize) {
+  const size_t in_area = params.in.area();
+  const size_t w_area  = params.weight.area();
+
+  // the input channels of a pixel are the column of the pixel
+  std::vector<uint8_t> cols(in_area * params.in.depth_);
   for (size_t inc = 0; inc < params.in.depth_; inc++) {
-    for (size_t ins = 0; ins < params.weight.height_ * params.weight.height_;
-         ins++) {
-      size_t idx = params.in.get_index(0, 0, inc);
-      min_filter = std::min(min_filter, (&W[idx])[ins]);
-      max_filter = std::max(max_filter, (&W[idx])[ins]);
-    }
-  }
-  if (min_filter == max_filter) {
-    max_filter = W[0] + 1e-3f;
-    min_filter = W[0] - 1e-3f;
-  }
-  std::vector<uint8_t> W_quantized =
-    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
-  // bias quantization
-  float_t min_bias(0);
-  float_t max_bias(0);
-  std::vector<uint8_t> bias_quantized;
-  if (params.has_bias) {
-    for (size_t inc = 0; inc < params.out.depth_; inc++) {
-      min_bias = std::min(min_bias, bias[inc]);
-      max_bias = std::max(max_bias, bias[inc]);
-    }
-    if (min_bias == max_bias) {
-      max_bias = bias[0] + 1e-3f;
-      min_bias = bias[0] - 1e-3f;
+    const uint8_t *pi = &in_quantized[params.in.get_index(0, 0, inc)];
+    for (size_t p = 0; p < in_area; p++) {
+      cols[p * params.in.depth_ + inc] = pi[p];
     }
-    bias_quantized =
-      float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias);
   }
 
-  // output range
-  float_t min_output_value;
-  float_t max_output_value;
-  quantization_range_for_multiplication<uint8_t, uint8_t, int32_t>(
-    min_input, max_input, min_filter, max_filter, &min_output_value,
-    &max_output_value);
+  std::vector<int32_t> products(a.rows() * in_area);
+  quantized_gemm(a, &cols[0], in_area, params.in.depth_, offset_input,
+                 &products[0], in_area, layer_parallelize);
+
+  out_quantized.assign(params.out.size(), 0);
+  for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
+    int32_t *pout = &out_quantized[params.out.get_index(0, 0, o)];
+    for (size_t wy = 0; wy < params.weight.height_; wy++) {
+      for (size_t wx = 0; wx < params.weight.width_; wx++) {
+        const int32_t *pp =
+          &products[(o * w_area + wy * params.weight.width_ + wx) * in_area];
+        for (size_t y = 0; y < params.in.height_; y++) {
+          int32_t *prow =
+            pout + (y * params.h_stride + wy) * params.out.width_ + wx;
+          for (size_t x = 0; x < params.in.width_; x++) {
+            prow[x * params.w_stride] += *pp++;
+          }
+        }
+      }
+    }
+  });
+}
 
-  std::vector<int32_t> out_quantized(out.size(), static_cast<int32_t>(0));
+/**
+ * 8-bit deconvolution of one sample. in_quantized is the input quantized
+ * over [min_input, max_input], bias the float bias of the layer if
+ * params.has_bias. the result is requantized into out_requantized over
+ * [*min_output, *max_output] if that is a non-empty range, otherwise over a
+ * range of its own, returned in min_output/max_output.
+ **/
+inline void tiny_quantized_deconv2d_kernel(
+  const deconv_params &params,
+  const std::vector<uint8_t> &in_quantized,
+  const float_t min_input,
+  const float_t max_input,
+  const quantized_weights &w,
+  const vec_t *bias,
+  std::vector<uint8_t> &out_requantized,
+  float_t *min_output,
+  float_t *max_output,
+  const bool layer_parallelize) {
+  const std::vector<float_t> unit = accumulator_units(min_input, max_input, w);
+
+  const packed_quantized_weights &packed = w.packed([&] {
+    std::vector<int32_t> offsets(params.out.depth_);
+    for (size_t o = 0; o < offsets.size(); o++) offsets[o] = w.offset(o);
+    return pack_quantized_deconv2d_weights(params, w.W, offsets);
+  });
 
   // calculating offset
   const int32_t offset_input = int64_to_int32(
     float_to_quantized_unclamped<uint8_t>(0.0f, min_input, max_input));
-  const int32_t offset_filter = int64_to_int32(
-    float_to_quantized_unclamped<uint8_t>(0.0f, min_filter, max_filter));
-  const int32_t zero_in_total_space = int64_to_int32(
-    float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value));
-
-  for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
-    for (size_t inc = 0; inc < params.in.depth_; inc++) {
-      if (!params.tbl.is_connected(o, inc)) continue;
-
-      size_t idx        = 0;
-      idx               = params.in.depth_ * o + inc;
-      idx               = params.weight.get_index(0, 0, idx);
-      const uint8_t *pw = &W_quantized[idx];
 
-      idx               = params.in.get_index(0, 0, inc);
-      const uint8_t *pi = &in_quantized[idx];
+  std::vector<int32_t> out_quantized;
+  quantized_deconv2d_accumulate(params, packed, in_quantized, offset_input,
+                                out_quantized, layer_parallelize);
 
-      idx                     = params.out.get_index(0, 0, o);
-      int32_t *pout_quantized = &out_quantized[idx];
-
-      for (size_t y = 0; y < params.in.height_; y++) {
-        for (size_t x = 0; x < params.in.width_; x++) {
-          const uint8_t *ppw = pw;
-          const uint8_t *ppi = pi + y * params.in.width_ + x;
-          // should be optimized for small kernel(3x3,5x5)
-          for (size_t wy = 0; wy < params.weight.height_; wy++) {
-            for (size_t wx = 0; wx < params.weight.width_; wx++) {
-              pout_quantized[(y * params.h_stride + wy) * params.out.width_ +
-                             (x * params.w_stride + wx)] +=
-                static_cast<int32_t>(ppw[wy * params.weight.width_ + wx] -
-                                     offset_filter) *
-                static_cast<int32_t>(*ppi - offset_input);
-            }
-          }
-        }
-      }
-    }
-    if (params.has_bias) {
+  if (params.has_bias) {
+    for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
+      const int32_t b =
+        quantized_bias((*bias)[o], unit[unit.size() == 1 ? 0 : o]);
       int32_t *pout_quantized = &out_quantized[params.out.get_index(0, 0, o)];
       int32_t *ppout_quantized =
         pout_quantized + params.out.width_ * params.out.height_;
-      std::for_each(pout_quantized, ppout_quantized, [&](int32_t &f) {
-        f += (bias_quantized[o] - zero_in_total_space);
-      });
-    }
-  });
-
-  float_t min_output_requantized;
-  float_t max_output_requantized;
-  std::vector<uint8_t> out_requantized(out_quantized.size(),
-                                       static_cast<uint8_t>(0));
+      std::for_each(pout_quantized, ppout_quantized,
+                    [&](int32_t &f) { f += b; });
+    });
+  }
 
   // Requantize from 32bits to 8 bits for next layer
-  quantize_down_and_shrink_range<int32_t, uint8_t>(
-    out_quantized, min_output_value, max_output_value, &min_output_requantized,
-    &max_output_requantized, &out_requantized);
+  requantize_accumulators(out_quantized, unit, params.out.area(),
+                          out_requantized, min_output, max_output);
+}
 
-  // dequantize to flaot, this could be removed within concatenated quantized
-  // network
-  out = quantized_tensor_to_float<uint8_t>(
-    out_requantized, min_output_requantized, max_output_requantized);
+/**
+ * quantize in, deconvolve it with the quantized weights w and dequantize the
+ * result into out
+ **/
+inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
+                                           const vec_t &in,
+                                           const quantized_weights &w,
+                                           const vec_t *bias,
+                                           vec_t &out,
+                                           const bool layer_parallelize) {
+  float_t min_input, max_input;
+  quantization_range(in, &min_input, &max_input);
+  std::vector<uint8_t> in_quantized =
+    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+
+  std::vector<uint8_t> out_quantized;
+  float_t min_output = 0, max_output = 0;
+  tiny_quantized_deconv2d_kernel(params, in_quantized, min_input, max_input,
+                                 w, bias, out_quantized, &min_output,
+                                 &max_output, layer_parallelize);
+
+  out.resize(out_quantized.size());
+  quantized_tensor_to_float_in_place<uint8_t>(out_quantized, min_output,
+                                              max_output, &out);
+}
+
+inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
+                                           const vec_t &in,
+                                           const vec_t &W,
+                                           const vec_t &bias,
+                                           vec_t &out,
+                                           const bool layer_parallelize) {
+  tiny_quantized_deconv2d_kernel(params, in, *quantize_weights(W), &bias, out,
+                                 layer_parallelize);
 }
 
 inline void tiny_quantized_deconv2d_back_kernel(const deconv_params &params,
@@ -381,8 +415,6 @@ inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
     bias_quantized.push_back(static_cast<uint8_t>(bias[i]));
   }
 
-  std::vector<int32_t> out_quantized(out.size(), static_cast<int32_t>(0));
-
   // calculating offset
   const int32_t offset_input = int64_to_int32(
     float_to_quantized_unclamped<uint8_t>(0.0f, in_r[0], in_r[1]));
@@ -391,47 +423,24 @@ inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
   const int32_t zero_in_total_space = int64_to_int32(
     float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value));
 
-  for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
-    for (size_t inc = 0; inc < params.in.depth_; inc++) {
-      if (!params.tbl.is_connected(o, inc)) continue;
-
-      size_t idx        = 0;
-      idx               = params.in.depth_ * o + inc;
-      idx               = params.weight.get_index(0, 0, idx);
-      const uint8_t *pw = &W_quantized[idx];
-
-      idx               = params.in.get_index(0, 0, inc);
-      const uint8_t *pi = &in_quantized[idx];
+  std::vector<int32_t> out_quantized;
+  quantized_deconv2d_accumulate(
+    params,
+    pack_quantized_deconv2d_weights(
+      params, W_quantized,
+      std::vector<int32_t>(params.out.depth_, offset_filter)),
+    in_quantized, offset_input, out_quantized, layer_parallelize);
 
-      idx                     = params.out.get_index(0, 0, o);
-      int32_t *pout_quantized = &out_quantized[idx];
-
-      for (size_t y = 0; y < params.in.height_; y++) {
-        for (size_t x = 0; x < params.in.width_; x++) {
-          const uint8_t *ppw = pw;
-          const uint8_t *ppi = pi + y * params.in.width_ + x;
-          // should be optimized for small kernel(3x3,5x5)
-          for (size_t wy = 0; wy < params.weight.height_; wy++) {
-            for (size_t wx = 0; wx < params.weight.width_; wx++) {
-              pout_quantized[(y * params.h_stride + wy) * params.out.width_ +
-                             (x * params.w_stride + wx)] +=
-                static_cast<int32_t>(ppw[wy * params.weight.width_ + wx] -
-                                     offset_filter) *
-                static_cast<int32_t>(*ppi - offset_input);
-            }
-          }
-        }
-      }
-    }
-    if (params.has_bias) {
+  if (params.has_bias) {
+    for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
       int32_t *pout_quantized = &out_quantized[params.out.get_index(0, 0, o)];
       int32_t *poutout_quantized =
         pout_quantized + params.out.width_ * params.out.height_;
       std::for_each(pout_quantized, poutout_quantized, [&](int32_t &f) {
         f += static_cast<int32_t>((bias[o] - zero_in_total_space));
       });
-    }
-  });
+    });
+  }
 
   float_t min_output_requantized;
   float_t max_output_requantized;
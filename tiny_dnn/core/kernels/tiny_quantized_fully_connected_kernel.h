@@ -10,123 +10,152 @@
 #include <algorithm>
 #include <vector>
 
-#ifdef CNN_USE_GEMMLOWP
 #include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
-#include "tiny_dnn/core/kernels/tiny_quantized_matmul_kernel.h"
+#include "tiny_dnn/core/kernels/tiny_quantized_weights.h"
 #include "tiny_dnn/core/params/fully_params.h"
 
 namespace tiny_dnn {
 namespace core {
 namespace kernels {
 
+/**
+ * weights W of a fully-connected layer laid out for quantized_gemm: a row per
+ * output, holding its weights of all inputs. offsets are the codes of 0 of
+ * the rows.
+ **/
+inline packed_quantized_weights pack_quantized_fully_connected_weights(
+  const fully_params &params,
+  const std::vector<uint8_t> &W,
+  const std::vector<int32_t> &offsets) {
+  return packed_quantized_weights(
+    params.out_size_, params.in_size_, offsets,
+    [&](size_t i, size_t c) { return W[c * params.out_size_ + i]; });
+}
+
+/**
+ * 8-bit product of the weights with a batch of samples in one quantized_gemm.
+ * in_quantized holds the samples in_size_ bytes apart, sample i quantized
+ * over [min_input[i], max_input[i]]; b is the float bias of the layer if
+ * params.has_bias_. output i is requantized into out_requantized[i] over
+ * [min_output[i], max_output[i]] if that is a non-empty range, otherwise
+ * over a range of its own, returned in min_output[i]/max_output[i].
+ **/
 inline void tiny_quantized_fully_connected_kernel(
   const fully_params &params,
-  const vec_t &in,
-  const vec_t &W,
-  const vec_t &b,
-  vec_t &out,
+  const std::vector<uint8_t> &in_quantized,
+  const std::vector<float_t> &min_input,
+  const std::vector<float_t> &max_input,
+  const quantized_weights &w,
+  const vec_t *b,
+  std::vector<std::vector<uint8_t>> &out_requantized,
+  std::vector<float_t> &min_output,
+  std::vector<float_t> &max_output,
   const bool layer_parallelize) {
-  // input quantization
-  float_t min_input(in[0]);
-  float_t max_input(in[0]);
-  for (size_t c = 0; c < params.in_size_; c++) {
-    min_input = std::min(min_input, in[c]);
-    max_input = std::max(max_input, in[c]);
-  }
-  std::vector<uint8_t> in_quantized =
-    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
-  // filter quantization
-  float_t min_filter(W[0]);
-  float_t max_filter(W[0]);
-  for (size_t c = 0; c < W.size(); c++) {
-    min_filter = std::min(min_filter, W[c]);
-    max_filter = std::max(max_filter, W[c]);
-  }
-  if (min_filter == max_filter) {
-    max_filter = W[0] + 1e-3f;
-    min_filter = W[0] - 1e-3f;
+  const size_t samples = min_input.size();
+
+  const packed_quantized_weights &packed = w.packed([&] {
+    std::vector<int32_t> offsets(params.out_size_);
+    for (size_t i = 0; i < offsets.size(); i++) offsets[i] = w.offset(i);
+    return pack_quantized_fully_connected_weights(params, w.W, offsets);
+  });
+
+  // the code of 0 of every sample
+  std::vector<int32_t> offsets_input(samples);
+  for (size_t j = 0; j < samples; j++) {
+    offsets_input[j] = int64_to_int32(float_to_quantized_unclamped<uint8_t>(
+      0.0f, min_input[j], max_input[j]));
   }
-  std::vector<uint8_t> W_quantized =
-    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
-  // output range
-  float_t min_output_value;
-  float_t max_output_value;
-  quantization_range_for_multiplication<uint8_t, uint8_t, int32_t>(
-    min_input, max_input, min_filter, max_filter, &min_output_value,
-    &max_output_value);
-  // bias quantization
-  float_t min_bias(0);
-  float_t max_bias(0);
-  std::vector<uint8_t> bias_quantized;
-  if (params.has_bias_) {
-    for (size_t inc = 0; inc < b.size(); inc++) {
-      min_bias = std::min(min_bias, b[inc]);
-      max_bias = std::max(max_bias, b[inc]);
-    }
-    if (min_bias == max_bias) {
-      max_bias = b[0] + 1e-3f;
-      min_bias = b[0] - 1e-3f;
+
+  // outputs x samples
+  std::vector<int32_t> out_quantized(params.out_size_ * samples);
+  quantized_gemm(packed, &in_quantized[0], samples, params.in_size_,
+                 &offsets_input[0], &out_quantized[0], samples,
+                 layer_parallelize);
+
+  out_requantized.resize(samples);
+  for_i(layer_parallelize, samples, [&](size_t j) {
+    const std::vector<float_t> unit =
+      accumulator_units(min_input[j], max_input[j], w);
+    std::vector<int32_t> acc(params.out_size_);
+    for (size_t i = 0; i < params.out_size_; i++) {
+      acc[i] = out_quantized[i * samples + j];
+      if (params.has_bias_) {
+        acc[i] += quantized_bias((*b)[i], unit[unit.size() == 1 ? 0 : i]);
+      }
     }
-    bias_quantized = float_tensor_to_quantized<uint8_t>(b, min_bias, max_bias);
-  }
-  min_output_value += min_bias;
-  max_output_value += max_bias;
 
-  std::vector<int32_t> out_quantized(out.size(), static_cast<int32_t>(0));
+    // Requantize from 32bits to 8 bits for next layer
+    requantize_accumulators(acc, unit, 1, out_requantized[j], &min_output[j],
+                            &max_output[j]);
+  });
+}
 
-  // calculating offset
-  const int32_t offset_input =
-    float_to_quantized_unclamped<uint8_t>(0.0f, min_input, max_input);
-  const int32_t offset_filter =
-    float_to_quantized_unclamped<uint8_t>(0.0f, min_filter, max_filter);
-  const int32_t zero_in_total_space =
-    float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value);
+/**
+ * 8-bit matrix-vector product of one sample, see the batch kernel above
+ **/
+inline void tiny_quantized_fully_connected_kernel(
+  const fully_params &params,
+  const std::vector<uint8_t> &in_quantized,
+  const float_t min_input,
+  const float_t max_input,
+  const quantized_weights &w,
+  const vec_t *b,
+  std::vector<uint8_t> &out_requantized,
+  float_t *min_output,
+  float_t *max_output,
+  const bool layer_parallelize) {
+  std::vector<std::vector<uint8_t>> out(1);
+  std::vector<float_t> min_out(1, *min_output), max_out(1, *max_output);
+  out[0].swap(out_requantized);
+  tiny_quantized_fully_connected_kernel(
+    params, in_quantized, std::vector<float_t>(1, min_input),
+    std::vector<float_t>(1, max_input), w, b, out, min_out, max_out,
+    layer_parallelize);
+  out[0].swap(out_requantized);
+  *min_output = min_out[0];
+  *max_output = max_out[0];
+}
 
-  const int32_t offset_output = 0;
-  const int32_t mult_output   = 1;
-  const int32_t shift_output  = 0;
-
-  bool use_gemm = false;
-  if (use_gemm) {
-    std::vector<size_t> shape{params.in_size_, 1, params.out_size_,
-                              params.in_size_};
-    tiny_quantized_matmul(in_quantized, W_quantized, out_quantized, shape,
-                          offset_input, offset_filter, offset_output,
-                          mult_output, shift_output);
-    if (params.has_bias_) {
-      for_i(layer_parallelize, params.out_size_,
-            [&](size_t i) { out[i] += b[i]; });
-    }
-  } else {
-    for_i(layer_parallelize, params.out_size_, [&](size_t i) {
-      for (size_t c = 0; c < params.in_size_; c++) {
-        out_quantized[i] +=
-          static_cast<int32_t>(W_quantized[c * params.out_size_ + i] -
-                               offset_filter) *
-          static_cast<int32_t>(in_quantized[c] - offset_input);
-      }
-      if (params.has_bias_) {
-        out_quantized[i] += (bias_quantized[i] - zero_in_total_space);
-      }
-    });
-  }
+/**
+ * quantize in, multiply it with the quantized weights w and dequantize the
+ * result into out
+ **/
+inline void tiny_quantized_fully_connected_kernel(
+  const fully_params &params,
+  const vec_t &in,
+  const quantized_weights &w,
+  const vec_t *b,
+  vec_t &out,
+  const bool layer_parallelize) {
+  float_t min_input, max_input;
+  quantization_range(in, &min_input, &max_input);
+  std::vector<uint8_t> in_quantized =
+    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
 
-  float_t min_output_requantized;
-  float_t max_output_requantized;
-  std::vector<uint8_t> out_requantized(out_quantized.size(),
-                                       static_cast<uint8_t>(0));
+  std::vector<uint8_t> out_quantized;
+  float_t min_output = 0, max_output = 0;
+  tiny_quantized_fully_connected_kernel(params, in_quantized, min_input,
+                                        max_input, w, b, out_quantized,
+                                        &min_output, &max_output,
+                                        layer_parallelize);
 
-  // Requantize from 32bits to 8 bits for next layer
-  quantize_down_and_shrink_range<int32_t, uint8_t>(
-    out_quantized, min_output_value, max_output_value, &min_output_requantized,
-    &max_output_requantized, &out_requantized);
+  out.resize(out_quantized.size());
+  quantized_tensor_to_float_in_place<uint8_t>(out_quantized, min_output,
+                                              max_output, &out);
+}
 
-  // dequantize to flaot, this could be removed within concatenated quantized
-  // network
-  out = quantized_tensor_to_float<uint8_t>(
-    out_requantized, min_output_requantized, max_output_requantized);
+inline void tiny_quantized_fully_connected_kernel(
+  const fully_params &params,
+  const vec_t &in,
+  const vec_t &W,
+  const vec_t &b,
+  vec_t &out,
+  const bool layer_parallelize) {
+  tiny_quantized_fully_connected_kernel(params, in, *quantize_weights(W), &b,
+                                        out, layer_parallelize);
 }
 
+#ifdef CNN_USE_GEMMLOWP
 inline void tiny_quantized_fully_connected_back_kernel(
   const fully_params &params,
   const vec_t &prev_out,
@@ -313,8 +342,6 @@ inline void tiny_quantized_fully_connected_kernel(
   min_output_value += min_bias;
   max_output_value += max_bias;
 
-  std::vector<int32_t> out_quantized(out.size(), static_cast<int32_t>(0));
-
   // calculating offset
   const int32_t offset_input =
     float_to_quantized_unclamped<uint8_t>(0.0f, in_r[0], in_r[1]);
@@ -323,33 +350,16 @@ inline void tiny_quantized_fully_connected_kernel(
   const int32_t zero_in_total_space =
     float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value);
 
-  const int32_t offset_output = 0;
-  const int32_t mult_output   = 1;
-  const int32_t shift_output  = 0;
-
-  bool use_gemm = false;
-  if (use_gemm) {
-    std::vector<size_t> shape{params.in_size_, 1, params.out_size_,
-                              params.in_size_};
-    tiny_quantized_matmul(in_quantized, W_quantized, out_quantized, shape,
-                          offset_input, offset_filter, offset_output,
-                          mult_output, shift_output);
-    if (params.has_bias_) {
-      for_i(layer_parallelize, params.out_size_,
-            [&](size_t i) { out[i] += b[i]; });
+  std::vector<int32_t> out_quantized(params.out_size_);
+  quantized_gemm(pack_quantized_fully_connected_weights(
+                   params, W_quantized,
+                   std::vector<int32_t>(params.out_size_, offset_filter)),
+                 &in_quantized[0], 1, params.in_size_, offset_input,
+                 &out_quantized[0], 1, layer_parallelize);
+  if (params.has_bias_) {
+    for (size_t i = 0; i < params.out_size_; i++) {
+      out_quantized[i] += (bias_quantized[i] - zero_in_total_space);
     }
-  } else {
-    for_i(layer_parallelize, params.out_size_, [&](size_t i) {
-      for (size_t c = 0; c < params.in_size_; c++) {
-        out_quantized[i] +=
-          static_cast<int32_t>(W_quantized[c * params.out_size_ + i] -
-                               offset_filter) *
-          static_cast<int32_t>(in_quantized[c] - offset_input);
-      }
-      if (params.has_bias_) {
-        out_quantized[i] += (bias_quantized[i] - zero_in_total_space);
-      }
-    });
   }
 
   float_t min_output_requantized;
@@ -368,9 +378,8 @@ inline void tiny_quantized_fully_connected_kernel(
   out_r[0] = min_output_requantized;
   out_r[1] = max_output_requantized;
 }
+#endif  // CNN_USE_GEMMLOWP
 
 }  // namespace kernels
 }  // namespace core
 }  // namespace tiny_dnn
-
-#endif  // CNN_USE_GEMMLOWP
@@ -0,0 +1,458 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "tiny_dnn/util/aligned_allocator.h"
+#include "tiny_dnn/util/cpu_features.h"
+#include "tiny_dnn/util/macro.h"
+#include "tiny_dnn/util/nn_error.h"
+#include "tiny_dnn/util/parallel_for.h"
+
+#ifdef CNN_X86
+#include <immintrin.h>
+#endif
+
+// the AVX-512 VNNI intrinsics need GCC 8, clang 6 or Visual Studio 2019
+#if defined(CNN_X86) &&                                          \
+  ((defined(__clang__) && __clang_major__ >= 6) ||               \
+   (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 8) || \
+   (defined(_MSC_VER) && _MSC_VER >= 1920))
+#define CNN_QGEMM_VNNI
+#endif
+
+namespace tiny_dnn {
+namespace core {
+namespace kernels {
+
+/**
+ * instruction set a quantized_gemm runs on:
+ * - generic: portable C++
+ * - avx2: vpmaddubsw and vpmaddwd on 8 rows of weights at once. the 16-bit
+ *   sums of vpmaddubsw saturate, so every weight is split into 7 high bits
+ *   and the lowest bit, which are multiplied separately and stay exact.
+ * - avx512_vnni: vpdpbusd on 16 rows of weights, 4 products per 32-bit lane
+ *   in one instruction
+ **/
+enum class quantized_gemm_isa { generic, avx2, avx512_vnni };
+
+inline bool quantized_gemm_supported(quantized_gemm_isa isa) {
+  switch (isa) {
+    case quantized_gemm_isa::generic: return true;
+#ifdef CNN_X86
+    case quantized_gemm_isa::avx2: return cpu_features().avx2;
+#endif
+#ifdef CNN_QGEMM_VNNI
+    case quantized_gemm_isa::avx512_vnni: return cpu_features().avx512_vnni;
+#endif
+    default: return false;
+  }
+}
+
+/**
+ * fastest instruction set of this processor
+ **/
+inline quantized_gemm_isa default_quantized_gemm_isa() {
+  if (quantized_gemm_supported(quantized_gemm_isa::avx512_vnni)) {
+    return quantized_gemm_isa::avx512_vnni;
+  }
+  if (quantized_gemm_supported(quantized_gemm_isa::avx2)) {
+    return quantized_gemm_isa::avx2;
+  }
+  return quantized_gemm_isa::generic;
+}
+
+// columns of the result computed by one micro-kernel call
+const size_t qgemm_nr = 8;
+
+// rows of the result computed by one micro-kernel call, at most
+const size_t qgemm_max_mr = 16;
+
+// columns of the result handled by one parallel task
+const size_t qgemm_task_nc = 64;
+
+/**
+ * 8-bit weights laid out for quantized_gemm: rows x depth codes, each minus
+ * 128 to make it a signed byte, in tiles of mr rows. a tile holds groups of
+ * 4 consecutive codes of each of its rows, 4 * mr bytes per group; for
+ * avx2 every group is stored twice, the high 7 bits then the lowest bit.
+ * rows past the last and codes past depth are 0.
+ **/
+class packed_quantized_weights {
+ public:
+  packed_quantized_weights() = default;
+
+  /**
+   * @param offsets code of 0 in every row
+   * @param code    function (row, k) returning the k-th code of row
+   **/
+  template <typename Code>
+  packed_quantized_weights(
+    size_t rows,
+    size_t depth,
+    const std::vector<int32_t> &offsets,
+    Code code,
+    quantized_gemm_isa isa = default_quantized_gemm_isa())
+    : isa_(isa),
+      rows_(rows),
+      depth_(depth),
+      groups_((depth + 3) / 4),
+      mr_(isa == quantized_gemm_isa::avx512_vnni ? 16 : 8),
+      planes_(isa == quantized_gemm_isa::avx2 ? 2 : 1),
+      offsets_(offsets),
+      row_sums_(rows, 0) {
+    const size_t tiles = (rows + mr_ - 1) / mr_;
+    data_.assign(tiles * tile_size(), 0);
+    for (size_t i = 0; i < rows; i++) {
+      int8_t *row = &data_[(i / mr_) * tile_size() + (i % mr_) * 4];
+      for (size_t k = 0; k < depth; k++) {
+        const uint8_t q = code(i, k);
+        row_sums_[i] += static_cast<int32_t>(q) - offsets[i];
+
+        // 128 is even: the code and the signed weight have the same lowest bit
+        const int32_t s = static_cast<int32_t>(q) - 128;
+        int8_t *dst     = row + (k / 4) * planes_ * 4 * mr_ + k % 4;
+        if (planes_ == 2) {
+          dst[0]       = static_cast<int8_t>((s - (q & 1)) / 2);
+          dst[4 * mr_] = static_cast<int8_t>(q & 1);
+        } else {
+          dst[0] = static_cast<int8_t>(s);
+        }
+      }
+    }
+  }
+
+  quantized_gemm_isa isa() const { return isa_; }
+  size_t rows() const { return rows_; }
+  size_t depth() const { return depth_; }
+  size_t mr() const { return mr_; }
+  int32_t offset(size_t row) const { return offsets_[row]; }
+
+  // sum of the codes of row minus its offset
+  int32_t row_sum(size_t row) const { return row_sums_[row]; }
+
+  const int8_t *tile(size_t t) const { return &data_[t * tile_size()]; }
+
+ private:
+  size_t tile_size() const { return groups_ * planes_ * 4 * mr_; }
+
+  quantized_gemm_isa isa_ = quantized_gemm_isa::generic;
+  size_t rows_            = 0;
+  size_t depth_           = 0;
+  size_t groups_          = 0;
+  size_t mr_              = 8;
+  size_t planes_          = 1;
+  std::vector<int32_t> offsets_;
+  std::vector<int32_t> row_sums_;
+  std::vector<int8_t, aligned_allocator<int8_t, 64>> data_;
+};
+
+/**
+ * micro-kernels: tile[j][r] = sum over k of the signed weight (r, k) of the
+ * packed tile a times byte k of column b[j], for the first NR columns. NR is
+ * qgemm_nr, or 1, 2 or 4 for the last columns of narrow products.
+ **/
+template <size_t NR>
+void qgemm_kernel_generic(const int8_t *a,
+                          size_t depth,
+                          const uint8_t *const *b,
+                          int32_t (*tile)[qgemm_max_mr]) {
+  const size_t mr = 8;
+  for (size_t j = 0; j < NR; j++) {
+    std::fill(tile[j], tile[j] + mr, 0);
+  }
+  for (size_t k = 0; k < depth; k++) {
+    const int8_t *ak = a + (k / 4) * 4 * mr + k % 4;
+    for (size_t j = 0; j < NR; j++) {
+      const int32_t bk = b[j][k];
+      for (size_t r = 0; r < mr; r++) tile[j][r] += ak[r * 4] * bk;
+    }
+  }
+}
+
+// 4 bytes of a column, the last group of a column zero-padded
+template <size_t NR>
+void qgemm_columns_tail(const uint8_t *const *b,
+                        size_t depth,
+                        uint8_t (*padded)[4]) {
+  const size_t full = depth / 4 * 4;
+  for (size_t j = 0; j < NR; j++) {
+    std::fill(padded[j], padded[j] + 4, uint8_t(0));
+    std::copy(b[j] + full, b[j] + depth, padded[j]);
+  }
+}
+
+inline int32_t qgemm_group(const uint8_t *p) {
+  int32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+#ifdef CNN_X86
+
+// acc + the 8 dot products of the group of column b with the high and the
+// low plane of 8 rows of weights: (2 * hi + lo) . b, computed in 32 bits
+CNN_TARGET("avx2")
+CNN_MUST_INLINE __m256i qgemm_madd_avx2(__m256i acc,
+                                        const uint8_t *b,
+                                        __m256i hi,
+                                        __m256i lo,
+                                        __m256i ones,
+                                        __m256i twos) {
+  const __m256i bv = _mm256_set1_epi32(qgemm_group(b));
+  const __m256i h  = _mm256_madd_epi16(_mm256_maddubs_epi16(bv, hi), twos);
+  const __m256i l  = _mm256_madd_epi16(_mm256_maddubs_epi16(bv, lo), ones);
+  return _mm256_add_epi32(acc, _mm256_add_epi32(h, l));
+}
+
+// the accumulators of columns NR and up are left out at compile time
+template <size_t NR>
+CNN_TARGET("avx2")
+void qgemm_kernel_avx2(const int8_t *a,
+                       size_t depth,
+                       const uint8_t *const *b,
+                       int32_t (*tile)[qgemm_max_mr]) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  const __m256i twos = _mm256_set1_epi16(2);
+  __m256i c0 = _mm256_setzero_si256(), c1 = _mm256_setzero_si256();
+  __m256i c2 = _mm256_setzero_si256(), c3 = _mm256_setzero_si256();
+  __m256i c4 = _mm256_setzero_si256(), c5 = _mm256_setzero_si256();
+  __m256i c6 = _mm256_setzero_si256(), c7 = _mm256_setzero_si256();
+
+  uint8_t padded[NR][4];
+  qgemm_columns_tail<NR>(b, depth, padded);
+  const uint8_t *p[NR];
+  std::copy(b, b + NR, p);
+
+  // the full groups of the columns, then the padded last one
+  size_t groups = depth / 4;
+  for (int part = 0; part < 2; part++) {
+    for (size_t g = 0; g < groups; g++) {
+      const __m256i hi =
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(a));
+      const __m256i lo =
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(a + 32));
+      const size_t o = g * 4;
+      c0             = qgemm_madd_avx2(c0, p[0] + o, hi, lo, ones, twos);
+      if (NR > 1) c1 = qgemm_madd_avx2(c1, p[1 % NR] + o, hi, lo, ones, twos);
+      if (NR > 2) {
+        c2 = qgemm_madd_avx2(c2, p[2 % NR] + o, hi, lo, ones, twos);
+        c3 = qgemm_madd_avx2(c3, p[3 % NR] + o, hi, lo, ones, twos);
+      }
+      if (NR > 4) {
+        c4 = qgemm_madd_avx2(c4, p[4 % NR] + o, hi, lo, ones, twos);
+        c5 = qgemm_madd_avx2(c5, p[5 % NR] + o, hi, lo, ones, twos);
+        c6 = qgemm_madd_avx2(c6, p[6 % NR] + o, hi, lo, ones, twos);
+        c7 = qgemm_madd_avx2(c7, p[7 % NR] + o, hi, lo, ones, twos);
+      }
+      a += 64;
+    }
+    for (size_t j = 0; j < NR; j++) p[j] = padded[j];
+    groups = depth % 4 ? 1 : 0;
+  }
+
+  const __m256i c[] = {c0, c1, c2, c3, c4, c5, c6, c7};
+  for (size_t j = 0; j < NR; j++) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(tile[j]), c[j]);
+  }
+}
+
+#endif  // CNN_X86
+
+#ifdef CNN_QGEMM_VNNI
+
+CNN_TARGET("avx512f,avx512bw,avx512vnni")
+CNN_MUST_INLINE __m512i qgemm_madd_vnni(__m512i acc,
+                                        const uint8_t *b,
+                                        __m512i w) {
+  return _mm512_dpbusd_epi32(acc, _mm512_set1_epi32(qgemm_group(b)), w);
+}
+
+template <size_t NR>
+CNN_TARGET("avx512f,avx512bw,avx512vnni")
+void qgemm_kernel_vnni(const int8_t *a,
+                       size_t depth,
+                       const uint8_t *const *b,
+                       int32_t (*tile)[qgemm_max_mr]) {
+  __m512i c0 = _mm512_setzero_si512(), c1 = _mm512_setzero_si512();
+  __m512i c2 = _mm512_setzero_si512(), c3 = _mm512_setzero_si512();
+  __m512i c4 = _mm512_setzero_si512(), c5 = _mm512_setzero_si512();
+  __m512i c6 = _mm512_setzero_si512(), c7 = _mm512_setzero_si512();
+
+  uint8_t padded[NR][4];
+  qgemm_columns_tail<NR>(b, depth, padded);
+  const uint8_t *p[NR];
+  std::copy(b, b + NR, p);
+
+  size_t groups = depth / 4;
+  for (int part = 0; part < 2; part++) {
+    for (size_t g = 0; g < groups; g++) {
+      const __m512i w = _mm512_load_si512(a);
+      const size_t o  = g * 4;
+      c0              = qgemm_madd_vnni(c0, p[0] + o, w);
+      if (NR > 1) c1 = qgemm_madd_vnni(c1, p[1 % NR] + o, w);
+      if (NR > 2) {
+        c2 = qgemm_madd_vnni(c2, p[2 % NR] + o, w);
+        c3 = qgemm_madd_vnni(c3, p[3 % NR] + o, w);
+      }
+      if (NR > 4) {
+        c4 = qgemm_madd_vnni(c4, p[4 % NR] + o, w);
+        c5 = qgemm_madd_vnni(c5, p[5 % NR] + o, w);
+        c6 = qgemm_madd_vnni(c6, p[6 % NR] + o, w);
+        c7 = qgemm_madd_vnni(c7, p[7 % NR] + o, w);
+      }
+      a += 64;
+    }
+    for (size_t j = 0; j < NR; j++) p[j] = padded[j];
+    groups = depth % 4 ? 1 : 0;
+  }
+
+  const __m512i c[] = {c0, c1, c2, c3, c4, c5, c6, c7};
+  for (size_t j = 0; j < NR; j++) _mm512_storeu_si512(tile[j], c[j]);
+}
+
+#endif  // CNN_QGEMM_VNNI
+
+template <size_t NR>
+void qgemm_kernel(quantized_gemm_isa isa,
+                  const int8_t *a,
+                  size_t depth,
+                  const uint8_t *const *b,
+                  int32_t (*tile)[qgemm_max_mr]) {
+  switch (isa) {
+#ifdef CNN_X86
+    case quantized_gemm_isa::avx2:
+      qgemm_kernel_avx2<NR>(a, depth, b, tile);
+      break;
+#endif
+#ifdef CNN_QGEMM_VNNI
+    case quantized_gemm_isa::avx512_vnni:
+      qgemm_kernel_vnni<NR>(a, depth, b, tile);
+      break;
+#endif
+    default: qgemm_kernel_generic<NR>(a, depth, b, tile); break;
+  }
+}
+
+/**
+ * the first n <= qgemm_nr columns of b on the narrowest micro-kernel taking
+ * them, so that a product with few columns (a single sample of a
+ * fully-connected layer, say) does not pay for qgemm_nr
+ **/
+inline void qgemm_kernel(quantized_gemm_isa isa,
+                         const int8_t *a,
+                         size_t depth,
+                         const uint8_t *const *b,
+                         size_t n,
+                         int32_t (*tile)[qgemm_max_mr]) {
+  if (n == 1) {
+    qgemm_kernel<1>(isa, a, depth, b, tile);
+  } else if (n == 2) {
+    qgemm_kernel<2>(isa, a, depth, b, tile);
+  } else if (n <= 4) {
+    qgemm_kernel<4>(isa, a, depth, b, tile);
+  } else {
+    qgemm_kernel<qgemm_nr>(isa, a, depth, b, tile);
+  }
+}
+
+/**
+ * 8-bit matrix product with 32-bit results:
+ *
+ *     c[i * ldc + j] = sum over k of (A(i, k) - a.offset(i)) *
+ *                                    (b[j * ldb + k] - offsets_b[j])
+ *
+ * for the packed weights a (rows x depth) and cols columns of depth bytes
+ * each, starting ldb bytes apart, every column with a code of 0 of its own.
+ * the signed bytes the kernels multiply are the codes minus 128, the offsets
+ * are corrected for with the sums of the rows and of the columns afterwards.
+ * runs on the instruction set a was packed for, tasks of qgemm_task_nc
+ * columns go to the thread pool when parallelize is true.
+ **/
+inline void quantized_gemm(const packed_quantized_weights &a,
+                           const uint8_t *b,
+                           size_t cols,
+                           size_t ldb,
+                           const int32_t *offsets_b,
+                           int32_t *c,
+                           size_t ldc,
+                           bool parallelize = true) {
+  const size_t rows  = a.rows();
+  const size_t depth = a.depth();
+  if (rows == 0 || cols == 0) return;
+  if (!quantized_gemm_supported(a.isa())) {
+    throw nn_error("instruction set of the packed weights is not supported");
+  }
+
+  std::vector<int32_t> col_sums(cols, 0);
+  for (size_t j = 0; j < cols; j++) {
+    const uint8_t *col = b + j * ldb;
+    int32_t sum        = 0;
+    for (size_t k = 0; k < depth; k++) sum += col[k];
+    col_sums[j] = sum;
+  }
+
+  const size_t mr     = a.mr();
+  const size_t tiles  = (rows + mr - 1) / mr;
+  const size_t blocks = (cols + qgemm_task_nc - 1) / qgemm_task_nc;
+
+  // one task per (column block, tile of rows)
+  for_(parallelize, 0u, blocks * tiles,
+       [&](const blocked_range &r) {
+         alignas(64) int32_t tile[qgemm_nr][qgemm_max_mr];
+         const uint8_t *cp[qgemm_nr];
+         for (size_t t = r.begin(); t < r.end(); t++) {
+           const size_t i0   = (t % tiles) * mr;
+           const size_t m    = std::min(mr, rows - i0);
+           const size_t jend = std::min(cols, (t / tiles + 1) * qgemm_task_nc);
+           for (size_t j0 = (t / tiles) * qgemm_task_nc; j0 < jend;
+                j0 += qgemm_nr) {
+             const size_t n = std::min(qgemm_nr, jend - j0);
+             // missing columns repeat the last one and are dropped
+             for (size_t j = 0; j < qgemm_nr; j++) {
+               cp[j] = b + (j0 + std::min(j, n - 1)) * ldb;
+             }
+             qgemm_kernel(a.isa(), a.tile(t % tiles), depth, cp, n, tile);
+
+             for (size_t i = 0; i < m; i++) {
+               const int32_t row_sum  = a.row_sum(i0 + i);
+               const int32_t col_mult = 128 - a.offset(i0 + i);
+               int32_t *pc            = c + (i0 + i) * ldc + j0;
+               for (size_t j = 0; j < n; j++) {
+                 pc[j] = tile[j][i] + col_mult * col_sums[j0 + j] -
+                         offsets_b[j0 + j] * row_sum;
+               }
+             }
+           }
+         }
+       },
+       1u);
+}
+
+/**
+ * quantized_gemm with the same code of 0, offset_b, for all columns
+ **/
+inline void quantized_gemm(const packed_quantized_weights &a,
+                           const uint8_t *b,
+                           size_t cols,
+                           size_t ldb,
+                           int32_t offset_b,
+                           int32_t *c,
+                           size_t ldc,
+                           bool parallelize = true) {
+  const std::vector<int32_t> offsets_b(cols, offset_b);
+  quantized_gemm(a, b, cols, ldb, offsets_b.data(), c, ldc, parallelize);
+}
+
+}  // namespace kernels
+}  // namespace core
+}  // namespace tiny_dnn
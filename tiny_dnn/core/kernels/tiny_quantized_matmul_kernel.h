@@ -125,11 +125,6 @@ void tiny_quantized_matmul(const std::vector<T1> &a,
         lda, b_data, offset_b, ldb, c_data, shift_c, offset_c, mult_c, ldc);
 #endif
   }
-
-  float min_c_value;
-  float max_c_value;
-  quantization_range_for_multiplication<T1, T2, Toutput>(
-    min_a, max_a, min_b, max_b, &min_c_value, &max_c_value);
 }
 
 }  // namespace kernels
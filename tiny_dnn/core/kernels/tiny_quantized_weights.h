@@ -0,0 +1,307 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
+#include "tiny_dnn/core/kernels/tiny_quantized_gemm.h"
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+namespace core {
+namespace kernels {
+
+/**
+ * widen [*min, *max] to contain 0 and shift it so that 0 falls exactly on an
+ * 8-bit code. otherwise the zero point is rounded and every value picks up
+ * the same error, which adds up in the dot products.
+ **/
+inline void nudge_quantization_range(float_t *min, float_t *max) {
+  *min = std::min(*min, float_t(0));
+  *max = std::max(*max, float_t(0));
+  if (*min == *max) return;
+  const float_t step = (*max - *min) / 255;
+  *min               = -std::round(-*min / step) * step;
+  *max               = *min + 255 * step;
+}
+
+/**
+ * range to quantize the values of v in
+ **/
+inline void quantization_range(const vec_t &v, float_t *min, float_t *max) {
+  auto range = std::minmax_element(v.begin(), v.end());
+  *min       = *range.first;
+  *max       = *range.second;
+  nudge_quantization_range(min, max);
+}
+
+/**
+ * 8-bit weights of a quantized layer with the float range the codes map to,
+ * either one range for all weights or one per output channel.
+ * the bias is not part of them: it is read in float from the layer and added
+ * in the 32-bit accumulator, whose range depends on the input.
+ **/
+struct quantized_weights {
+  std::vector<uint8_t> W;
+  std::vector<float_t> min_W, max_W;
+
+  size_t channels() const { return min_W.size(); }
+
+  float_t min(size_t channel) const {
+    return min_W[min_W.size() == 1 ? 0 : channel];
+  }
+
+  float_t max(size_t channel) const {
+    return max_W[max_W.size() == 1 ? 0 : channel];
+  }
+
+  /**
+   * code of 0 in channel
+   **/
+  int32_t offset(size_t channel) const {
+    return int64_to_int32(
+      float_to_quantized_unclamped<uint8_t>(0.0f, min(channel), max(channel)));
+  }
+
+  /**
+   * W laid out for quantized_gemm by pack(), a function returning the
+   * packed_quantized_weights. packed on the first call only, the layout
+   * depends on the layer the weights belong to.
+   **/
+  template <typename Pack>
+  const packed_quantized_weights &packed(Pack pack) const {
+    std::call_once(packed_once_, [&] { packed_ = pack(); });
+    return packed_;
+  }
+
+ private:
+  mutable std::once_flag packed_once_;
+  mutable packed_quantized_weights packed_;
+};
+
+/**
+ * quantize W. with channels > 1, weight k belongs to output channel
+ * (k / block) % channels and each channel is quantized over the range of its
+ * own weights, otherwise W over the range of all.
+ **/
+inline std::shared_ptr<quantized_weights> quantize_weights(const vec_t &W,
+                                                           size_t channels = 1,
+                                                           size_t block = 1) {
+  std::shared_ptr<quantized_weights> q = std::make_shared<quantized_weights>();
+  q->min_W.assign(channels, std::numeric_limits<float_t>::max());
+  q->max_W.assign(channels, std::numeric_limits<float_t>::lowest());
+  auto channel_of = [&](size_t k) {
+    return channels == 1 ? 0 : (k / block) % channels;
+  };
+  for (size_t k = 0; k < W.size(); k++) {
+    const size_t c = channel_of(k);
+    q->min_W[c]    = std::min(q->min_W[c], W[k]);
+    q->max_W[c]    = std::max(q->max_W[c], W[k]);
+  }
+  for (size_t c = 0; c < channels; c++) {
+    if (q->min_W[c] == q->max_W[c]) {
+      q->max_W[c] += 1e-3f;
+      q->min_W[c] -= 1e-3f;
+    }
+    nudge_quantization_range(&q->min_W[c], &q->max_W[c]);
+  }
+  q->W.resize(W.size());
+  for (size_t k = 0; k < W.size(); k++) {
+    const size_t c = channel_of(k);
+    q->W[k] = float_to_quantized<uint8_t>(W[k], q->min_W[c], q->max_W[c]);
+  }
+  return q;
+}
+
+/**
+ * the code offset of 0 as a weight, for the weights of channels a connection
+ * table leaves out
+ **/
+inline uint8_t zero_code(int32_t offset) {
+  if (offset < 0 || offset > 255) {
+    throw nn_error("unconnected weights need a range containing 0");
+  }
+  return static_cast<uint8_t>(offset);
+}
+
+/**
+ * value of one unit of the 32-bit accumulator of a product of two 8-bit
+ * operands quantized over [min_a, max_a] and [min_b, max_b]
+ **/
+inline float_t accumulator_unit(float_t min_a,
+                                float_t max_a,
+                                float_t min_b,
+                                float_t max_b) {
+  return float_for_one_quantized_level<uint8_t>(min_a, max_a) *
+         float_for_one_quantized_level<uint8_t>(min_b, max_b);
+}
+
+/**
+ * accumulator unit of every weight range of w for an input quantized over
+ * [min_input, max_input]
+ **/
+inline std::vector<float_t> accumulator_units(float_t min_input,
+                                              float_t max_input,
+                                              const quantized_weights &w) {
+  std::vector<float_t> unit(w.channels());
+  for (size_t c = 0; c < unit.size(); c++) {
+    unit[c] = accumulator_unit(min_input, max_input, w.min_W[c], w.max_W[c]);
+  }
+  return unit;
+}
+
+/**
+ * bias in units of the accumulator
+ **/
+inline int32_t quantized_bias(float_t bias, float_t unit) {
+  return static_cast<int32_t>(std::round(bias / unit));
+}
+
+/**
+ * convert 32-bit accumulators into 8-bit codes. the accumulators of output
+ * channel c are the channel_size values starting at c * channel_size and
+ * are worth unit[c] each (unit[0] for all channels if unit has one element).
+ * if [*min, *max] is a non-empty range on entry, the codes are saturated to
+ * it, otherwise they cover the range of the values, returned in min/max.
+ **/
+inline void requantize_accumulators(const std::vector<int32_t> &acc,
+                                    const std::vector<float_t> &unit,
+                                    size_t channel_size,
+                                    std::vector<uint8_t> &out,
+                                    float_t *min,
+                                    float_t *max) {
+  const size_t channels = acc.size() / channel_size;
+  auto unit_of          = [&](size_t c) {
+    return unit[unit.size() == 1 ? 0 : c];
+  };
+
+  if (!(*min < *max)) {
+    double lo = 0.0, hi = 0.0;
+    for (size_t c = 0; c < channels; c++) {
+      auto range = std::minmax_element(acc.begin() + c * channel_size,
+                                       acc.begin() + (c + 1) * channel_size);
+      lo = std::min(lo, double(*range.first) * unit_of(c));
+      hi = std::max(hi, double(*range.second) * unit_of(c));
+    }
+    *min = static_cast<float_t>(lo);
+    *max = static_cast<float_t>(hi);
+    nudge_quantization_range(min, max);
+  }
+
+  out.resize(acc.size());
+  if (*min == *max) {
+    std::fill(out.begin(), out.end(), uint8_t(0));
+    return;
+  }
+  const double zero = std::round(-double(*min) * 255.0 / (*max - *min));
+  for (size_t c = 0; c < channels; c++) {
+    const double scale = double(unit_of(c)) * 255.0 / (*max - *min);
+    for (size_t i = c * channel_size; i < (c + 1) * channel_size; i++) {
+      const double code = std::round(acc[i] * scale) + zero;
+      out[i] = static_cast<uint8_t>(std::min(255.0, std::max(0.0, code)));
+    }
+  }
+}
+
+/**
+ * quantized copy of the weights of a layer, recomputed only when the float
+ * weights change (e.g. by training or by loading a model) instead of on
+ * every forward call. a change is told by the stamp of the weights (see
+ * layer::weights_version()), so the float weights are neither copied nor
+ * compared.
+ **/
+class quantized_weight_cache {
+ public:
+  quantized_weight_cache() : slot_(std::make_shared<slot>()) {}
+
+  /**
+   * use the same cache as other
+   **/
+  void share(const quantized_weight_cache &other) { slot_ = other.slot_; }
+
+  /**
+   * W quantized as by quantize_weights(W, channels, block). version is the
+   * stamp of W, 0 if unknown, in which case W is quantized again.
+   **/
+  std::shared_ptr<const quantized_weights> get(const vec_t &W,
+                                               uint64_t version,
+                                               size_t channels = 1,
+                                               size_t block    = 1) {
+    {
+      std::lock_guard<std::mutex> lock(slot_->mtx);
+      if (slot_->current && version && slot_->version == version &&
+          slot_->current->channels() == channels) {
+        return slot_->current;
+      }
+    }
+
+    std::shared_ptr<const quantized_weights> updated =
+      quantize_weights(W, channels, block);
+
+    std::lock_guard<std::mutex> lock(slot_->mtx);
+    slot_->current = updated;
+    slot_->version = version;
+    return updated;
+  }
+
+ private:
+  struct slot {
+    std::mutex mtx;
+    std::shared_ptr<const quantized_weights> current;
+    uint64_t version = 0;  // stamp of the weights current was quantized from
+  };
+
+  std::shared_ptr<slot> slot_;
+};
+
+/**
+ * 8-bit activations of a batch with one range per sample, kept by the layer
+ * which wrote them next to their dequantized float copy. a quantized layer
+ * reading that float tensor takes the codes instead of quantizing it again.
+ **/
+struct quantized_activations {
+  std::vector<std::vector<uint8_t>> codes;
+  std::vector<float_t> min;
+  std::vector<float_t> max;
+
+  /**
+   * remember that out holds the dequantized codes
+   **/
+  void publish(const tensor_t &out) {
+    data_  = &out;
+    first_ = out.empty() || out[0].empty() ? nullptr : &out[0][0];
+  }
+
+  void clear() {
+    data_  = nullptr;
+    first_ = nullptr;
+  }
+
+  /**
+   * true if t still holds the values of the codes: it is the published
+   * tensor and its buffers were not replaced in the meantime
+   **/
+  bool describes(const tensor_t &t) const {
+    return data_ == &t && first_ && t.size() == codes.size() &&
+           !t[0].empty() && &t[0][0] == first_;
+  }
+
+ private:
+  const tensor_t *data_ = nullptr;
+  const float_t *first_ = nullptr;
+};
+
+}  // namespace kernels
+}  // namespace core
+}  // namespace tiny_dnn
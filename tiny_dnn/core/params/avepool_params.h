@@ -0,0 +1,52 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+
+#include "tiny_dnn/core/params/params.h"
+
+namespace tiny_dnn {
+namespace core {
+
+class avepool_params : public Params {
+ public:
+  index3d<size_t> in;
+  index3d<size_t> out;
+  size_t pool_size_x;
+  size_t pool_size_y;
+  size_t stride_x;
+  size_t stride_y;
+  padding pad_type;
+
+  ///< number of windows along x which lie within the input
+  size_t windows_x() const {
+    return in.width_ < pool_size_x
+             ? 0
+             : std::min(out.width_, (in.width_ - pool_size_x) / stride_x + 1);
+  }
+
+  ///< number of windows along y which lie within the input
+  size_t windows_y() const {
+    return in.height_ < pool_size_y
+             ? 0
+             : std::min(out.height_,
+                        (in.height_ - pool_size_y) / stride_y + 1);
+  }
+
+  float_t scale_factor() const {
+    return float_t(1) / static_cast<float_t>(pool_size_x * pool_size_y);
+  }
+};
+
+inline avepool_params &Params::avepool() {
+  return *(static_cast<avepool_params *>(this));
+}
+
+}  // namespace core
+}  // namespace tiny_dnn
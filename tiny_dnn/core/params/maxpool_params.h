@@ -7,6 +7,7 @@
 */
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 #include "tiny_dnn/core/params/params.h"
@@ -24,12 +25,9 @@ class maxpool_params : public Params {
   size_t stride_y;
   padding pad_type;
 
-  /* mapping out => max_index(in) (1:1) */
-  std::vector<std::vector<size_t>> out2inmax;
-  /* mapping out => in (1:N) */
-  std::vector<std::vector<size_t>> out2in;
-  /* mapping in => out (N:1) */
-  std::vector<size_t> in2out;
+  /* mapping out => position of the max in its window (1:1), stored as
+   * dy * pool_size_x + dx */
+  std::vector<std::vector<uint16_t>> out2inmax;
 };
 
 struct max_pooling_layer_worker_specific_storage {
@@ -7,12 +7,23 @@
 */
 #pragma once
 
+#include <functional>
+
+#include "tiny_dnn/util/util.h"
+
 namespace tiny_dnn {
 namespace core {
 
+/**
+ * in-place transformation of one output sample, applied by a kernel right
+ * after writing the sample, e.g. an activation fused into the layer
+ **/
+typedef std::function<void(vec_t &)> sample_epilogue;
+
 class conv_params;
 class fully_params;
 class maxpool_params;
+class avepool_params;
 class global_avepool_params;
 class recurrent_cell_params;
 
@@ -24,6 +35,7 @@ class Params {
   conv_params &conv();
   fully_params &fully();
   maxpool_params &maxpool();
+  avepool_params &avepool();
   global_avepool_params &global_avepool();
   recurrent_cell_params &recurrent_cell();
 };
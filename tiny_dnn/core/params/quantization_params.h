@@ -0,0 +1,34 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include "tiny_dnn/config.h"
+
+namespace tiny_dnn {
+namespace core {
+
+/**
+ * calibrated quantization of a quantized layer (see post_training_quantizer).
+ * by default the ranges of the 8-bit input and output are measured on every
+ * call and all weights share one range. an empty range (min == max) keeps
+ * measuring.
+ **/
+class quantization_params {
+ public:
+  float_t min_input  = float_t(0);
+  float_t max_input  = float_t(0);
+  float_t min_output = float_t(0);
+  float_t max_output = float_t(0);
+  bool per_channel   = false;  // one weight range per output channel
+
+  bool static_input() const { return min_input < max_input; }
+  bool static_output() const { return min_output < max_output; }
+};
+
+}  // namespace core
+}  // namespace tiny_dnn
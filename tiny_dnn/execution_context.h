@@ -0,0 +1,98 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <vector>
+
+#include "tiny_dnn/network.h"
+
+namespace tiny_dnn {
+
+/**
+ * state of one inference request on a shared network.
+ *
+ * a network keeps the activations of its last batch in its edges and its
+ * layers keep scratch buffers, so one network object cannot predict on
+ * several threads at once. an execution_context is a copy of the network's
+ * architecture which reads the weights of the model instead of holding its
+ * own: it only owns activations and scratch. create one context per thread
+ * (or per request) and run them concurrently on one loaded model:
+ *
+ *     network<sequential> model;
+ *     model.load("model.bin");
+ *
+ *     // on every worker thread
+ *     execution_context<sequential> ctx(model);
+ *     vec_t y = ctx.predict(x);
+ *
+ * the weights of the model must not change while contexts are running.
+ * once the model has been set up (e.g. loaded or trained), creating
+ * contexts does not modify it and may happen concurrently as well.
+ * requires serialization support (CNN_NO_SERIALIZATION undefined).
+ **/
+template <typename NetType>
+class execution_context {
+ public:
+  explicit execution_context(network<NetType> &model) {
+    net_.share_model(model);
+    net_.set_netphase(net_phase::test);
+  }
+
+  /**
+   * executes forward-propagation and returns output
+   **/
+  vec_t predict(const vec_t &in) { return net_.predict(in); }
+
+  /**
+   * executes forward-propagation and returns output
+   **/
+  tensor_t predict(const tensor_t &in) { return net_.predict(in); }
+
+  /**
+   * executes forward-propagation and returns output
+   **/
+  std::vector<tensor_t> predict(const std::vector<tensor_t> &in) {
+    return net_.predict(in);
+  }
+
+  /**
+   * executes forward-propagation and returns maximum output
+   **/
+  float_t predict_max_value(const vec_t &in) {
+    return net_.predict_max_value(in);
+  }
+
+  /**
+   * executes forward-propagation and returns maximum output index
+   **/
+  label_t predict_label(const vec_t &in) { return net_.predict_label(in); }
+
+  /**
+   * @see network::predict_batch
+   **/
+  template <typename Func>
+  void predict_batch(const vec_t *in,
+                     size_t count,
+                     Func f,
+                     size_t batch_size = CNN_PREDICT_BATCH_SIZE) {
+    net_.predict_batch(in, count, f, batch_size);
+  }
+
+  /**
+   * @see network::predict_batch
+   **/
+  std::vector<vec_t> predict_batch(const std::vector<vec_t> &in,
+                                   size_t batch_size = CNN_PREDICT_BATCH_SIZE) {
+    return net_.predict_batch(in, batch_size);
+  }
+
+ private:
+  network<NetType> net_;
+};
+
+}  // namespace tiny_dnn
@@ -8,11 +8,15 @@
 #pragma once
 
 #include <algorithm>
+#include <cassert>
 #include <cstdint>
 #include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "tiny_dnn/io/dataset.h"
+#include "tiny_dnn/util/mapped_file.h"
 #include "tiny_dnn/util/util.h"
 
 #define CIFAR10_IMAGE_DEPTH (3)
@@ -22,6 +26,34 @@
 #define CIFAR10_IMAGE_SIZE (CIFAR10_IMAGE_AREA * CIFAR10_IMAGE_DEPTH)
 
 namespace tiny_dnn {
+namespace detail {
+
+// rescale the CIFAR10_IMAGE_SIZE pixels at src into a padded image at dst
+inline void scale_cifar10_image(const uint8_t *src,
+                                float_t scale_min,
+                                float_t scale_max,
+                                int x_padding,
+                                int y_padding,
+                                float_t *dst) {
+  const int w = CIFAR10_IMAGE_WIDTH + 2 * x_padding;
+  const int h = CIFAR10_IMAGE_HEIGHT + 2 * y_padding;
+
+  if (x_padding || y_padding) {
+    std::fill(dst, dst + w * h * CIFAR10_IMAGE_DEPTH, scale_min);
+  }
+  for (int c = 0; c < CIFAR10_IMAGE_DEPTH; c++) {
+    for (int y = 0; y < CIFAR10_IMAGE_HEIGHT; y++) {
+      for (int x = 0; x < CIFAR10_IMAGE_WIDTH; x++) {
+        dst[c * w * h + (y + y_padding) * w + x + x_padding] =
+          scale_min +
+          (scale_max - scale_min) *
+            src[c * CIFAR10_IMAGE_AREA + y * CIFAR10_IMAGE_WIDTH + x] / 255;
+      }
+    }
+  }
+}
+
+}  // namespace detail
 
 /**
  * parse CIFAR-10 database format images
@@ -58,32 +90,96 @@ inline void parse_cifar10(const std::string &filename,
 
     if (!ifs.read(reinterpret_cast<char *>(&buf[0]), CIFAR10_IMAGE_SIZE)) break;
 
-    if (x_padding || y_padding) {
-      int w = CIFAR10_IMAGE_WIDTH + 2 * x_padding;
-      int h = CIFAR10_IMAGE_HEIGHT + 2 * y_padding;
-
-      img.resize(w * h * CIFAR10_IMAGE_DEPTH, scale_min);
-
-      for (int c = 0; c < CIFAR10_IMAGE_DEPTH; c++) {
-        for (int y = 0; y < CIFAR10_IMAGE_HEIGHT; y++) {
-          for (int x = 0; x < CIFAR10_IMAGE_WIDTH; x++) {
-            img[c * w * h + (y + y_padding) * w + x + x_padding] =
-              scale_min +
-              (scale_max - scale_min) *
-                buf[c * CIFAR10_IMAGE_AREA + y * CIFAR10_IMAGE_WIDTH + x] / 255;
-          }
-        }
-      }
-    } else {
-      std::transform(buf.begin(), buf.end(), std::back_inserter(img),
-                     [=](unsigned char c) {
-                       return scale_min + (scale_max - scale_min) * c / 255;
-                     });
-    }
+    img.resize((CIFAR10_IMAGE_WIDTH + 2 * x_padding) *
+               (CIFAR10_IMAGE_HEIGHT + 2 * y_padding) * CIFAR10_IMAGE_DEPTH);
+    detail::scale_cifar10_image(&buf[0], scale_min, scale_max, x_padding,
+                                y_padding, &img[0]);
 
     train_images->push_back(img);
     train_labels->push_back(label);
   }
 }
 
+/**
+ * CIFAR-10 database format images and labels, mapped into memory and
+ * rescaled on demand, with the same rescaling and padding as parse_cifar10.
+ * the records of several files (e.g. data_batch_1.bin ... data_batch_5.bin)
+ * are numbered consecutively.
+ *
+ * @param filenames [in] filenames of database(binary version)
+ * @param scale_min [in] min-value of output
+ * @param scale_max [in] max-value of output
+ * @param x_padding [in] adding border width (left,right)
+ * @param y_padding [in] adding border width (top,bottom)
+ **/
+class cifar10_dataset : public dataset {
+ public:
+  cifar10_dataset(const std::vector<std::string> &filenames,
+                  float_t scale_min,
+                  float_t scale_max,
+                  int x_padding,
+                  int y_padding)
+    : scale_min_(scale_min),
+      scale_max_(scale_max),
+      x_padding_(x_padding),
+      y_padding_(y_padding) {
+    if (x_padding < 0 || y_padding < 0)
+      throw nn_error("padding size must not be negative");
+    if (scale_min >= scale_max)
+      throw nn_error("scale_max must be greater than scale_min");
+
+    begin_.push_back(0);
+    for (const auto &filename : filenames) {
+      files_.emplace_back(new mapped_file(filename));
+      begin_.push_back(begin_.back() +
+                       files_.back()->size() / record_size());
+    }
+  }
+
+  cifar10_dataset(const std::string &filename,
+                  float_t scale_min,
+                  float_t scale_max,
+                  int x_padding,
+                  int y_padding)
+    : cifar10_dataset(std::vector<std::string>(1, filename),
+                      scale_min,
+                      scale_max,
+                      x_padding,
+                      y_padding) {}
+
+  size_t size() const override { return begin_.back(); }
+
+  size_t sample_size() const override {
+    return (CIFAR10_IMAGE_WIDTH + 2 * x_padding_) *
+           (CIFAR10_IMAGE_HEIGHT + 2 * y_padding_) * CIFAR10_IMAGE_DEPTH;
+  }
+
+  void sample(size_t index, float_t *dst) const override {
+    detail::scale_cifar10_image(record(index) + 1, scale_min_, scale_max_,
+                                x_padding_, y_padding_, dst);
+  }
+
+  label_t label(size_t index) const override {
+    return static_cast<label_t>(*record(index));
+  }
+
+ private:
+  static size_t record_size() { return 1 + CIFAR10_IMAGE_SIZE; }
+
+  const uint8_t *record(size_t index) const {
+    assert(index < size());
+    const size_t f =
+      std::upper_bound(begin_.begin(), begin_.end(), index) - begin_.begin() -
+      1;
+    return files_[f]->data() + (index - begin_[f]) * record_size();
+  }
+
+  std::vector<std::unique_ptr<mapped_file>> files_;
+  std::vector<size_t> begin_;  // index of the first record of each file
+  float_t scale_min_;
+  float_t scale_max_;
+  int x_padding_;
+  int y_padding_;
+};
+
 }  // namespace tiny_dnn
@@ -0,0 +1,333 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <exception>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <random>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/io/dataset.h"
+#include "tiny_dnn/util/deform.h"
+#include "tiny_dnn/util/util.h"
+
+#ifdef DNN_USE_IMAGE_API
+#include "tiny_dnn/util/image.h"
+#endif  // DNN_USE_IMAGE_API
+
+namespace tiny_dnn {
+
+/**
+ * a mini-batch of samples, each a single channel tensor
+ **/
+struct sample_batch {
+  std::vector<tensor_t> inputs;
+  std::vector<label_t> labels;
+};
+
+/**
+ * mini-batches of a dataset, decoded and augmented ahead of the training
+ * loop by worker threads.
+ *
+ * every epoch visits the samples in a new random order. up to prefetch
+ * batches are assembled in the background while the consumer works on the
+ * current one, so decoding and augmentation overlap with training. batches
+ * are delivered in order, and the random numbers a transform draws depend
+ * only on the seed and the batch, not on the number of workers.
+ * with no workers, batches are assembled on the calling thread.
+ *
+ *     mnist_dataset train("train-images.idx3-ubyte",
+ *                         "train-labels.idx1-ubyte", -1.0, 1.0, 2, 2);
+ *     data_pipeline batches(train, 32, 2);
+ *     batches.add_transform(transforms::corrupt(0.1, -1.0));
+ *     net.train<cross_entropy>(optimizer, batches, 10);
+ **/
+class data_pipeline {
+ public:
+  /**
+   * transforms a decoded sample in place, drawing random numbers from rng.
+   * called concurrently from the workers.
+   **/
+  typedef std::function<void(vec_t &sample, std::mt19937 &rng)> transform;
+
+  /**
+   * @param samples     dataset to read, has to outlive the pipeline
+   * @param batch_size  number of samples per batch
+   * @param num_workers number of threads assembling batches
+   * @param prefetch    number of batches assembled ahead of the consumer
+   **/
+  data_pipeline(const dataset &samples,
+                size_t batch_size,
+                size_t num_workers = 1,
+                size_t prefetch    = 2)
+    : samples_(samples),
+      batch_size_(batch_size),
+      num_workers_(num_workers),
+      slots_(std::max<size_t>(prefetch, 1) + 1) {
+    if (batch_size == 0) throw nn_error("batch size must be positive");
+  }
+
+  ~data_pipeline() { stop(); }
+
+  data_pipeline(const data_pipeline &) = delete;
+  data_pipeline &operator=(const data_pipeline &) = delete;
+
+  /**
+   * append a transform applied to every sample after decoding. transforms
+   * run in the order they were added, and have to be added before the
+   * first epoch.
+   **/
+  data_pipeline &add_transform(transform t) {
+    if (started_) {
+      throw nn_error("transforms must be added before the first epoch");
+    }
+    transforms_.push_back(std::move(t));
+    return *this;
+  }
+
+  ///< visit the samples in dataset order instead of a random one
+  data_pipeline &set_shuffle(bool shuffle) {
+    shuffle_ = shuffle;
+    return *this;
+  }
+
+  size_t batch_size() const { return batch_size_; }
+
+  ///< number of samples of an epoch
+  size_t size() const { return samples_.size(); }
+
+  /**
+   * start a new epoch, abandoning the rest of the current one. the order of
+   * the samples and the seed of the transforms are drawn from the shared
+   * random generator (see set_random_seed).
+   **/
+  void start_epoch() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    // let the batches in flight finish before their slots are reused
+    claimed_ = batch_count_;
+    ++epoch_;
+    idle_.wait(lock, [&]() { return busy_ == 0; });
+
+    if (order_.size() != samples_.size()) {
+      order_.resize(samples_.size());
+      for (size_t i = 0; i < order_.size(); i++) order_[i] = i;
+    }
+    auto &gen = random_generator::get_instance()();
+    if (shuffle_) std::shuffle(order_.begin(), order_.end(), gen);
+    seed_ = gen();
+
+    for (auto &s : slots_) s.ready = false;
+    batch_count_ = (order_.size() + batch_size_ - 1) / batch_size_;
+    claimed_     = 0;
+    consumed_    = 0;
+    holding_     = false;
+    error_       = nullptr;
+    started_     = true;
+    if (workers_.empty()) {
+      for (size_t i = 0; i < num_workers_; i++) {
+        workers_.emplace_back([this]() { work(); });
+      }
+    }
+    ready_.notify_all();
+  }
+
+  /**
+   * wait for the next batch of the epoch. the batch stays valid until the
+   * next call to next() or start_epoch().
+   * @return the batch, or nullptr at the end of the epoch
+   **/
+  const sample_batch *next() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (!started_) throw nn_error("start_epoch must be called first");
+    if (holding_) {
+      slots_[consumed_ % slots_.size()].ready = false;
+      consumed_++;
+      holding_ = false;
+      ready_.notify_all();
+    }
+    if (consumed_ == batch_count_) return nullptr;
+
+    slot &s = slots_[consumed_ % slots_.size()];
+    if (workers_.empty()) {
+      lock.unlock();
+      assemble(consumed_, s.batch, true);
+      lock.lock();
+    } else {
+      // an error ends the epoch, until start_epoch is called again
+      done_.wait(lock, [&]() { return s.ready || error_; });
+      if (error_) std::rethrow_exception(error_);
+    }
+    holding_ = true;
+    return &s.batch;
+  }
+
+ private:
+  struct slot {
+    sample_batch batch;
+    bool ready = false;
+  };
+
+  void work() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    for (;;) {
+      ready_.wait(lock, [&]() {
+        return stop_ || (claimed_ < batch_count_ &&
+                         claimed_ < consumed_ + slots_.size());
+      });
+      if (stop_) return;
+
+      const size_t index = claimed_++;
+      const size_t epoch = epoch_;
+      slot &s            = slots_[index % slots_.size()];
+      busy_++;
+      lock.unlock();
+      std::exception_ptr error;
+      try {
+        assemble(index, s.batch, false);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      lock.lock();
+      busy_--;
+      if (epoch == epoch_) {
+        if (error) {
+          if (!error_) error_ = error;
+        } else {
+          s.ready = true;
+        }
+        done_.notify_all();
+      }
+      if (busy_ == 0) idle_.notify_all();
+    }
+  }
+
+  void assemble(size_t index, sample_batch &batch, bool parallelize) {
+    const size_t first = index * batch_size_;
+    const size_t n     = std::min(batch_size_, order_.size() - first);
+    batch.inputs.resize(n);
+    batch.labels.resize(n);
+
+    std::mt19937 rng(static_cast<std::mt19937::result_type>(seed_ + index));
+    std::vector<std::mt19937::result_type> seeds(n);
+    for (auto &s : seeds) s = rng();
+
+    for_i(parallelize, n, [&](size_t i) {
+      tensor_t &t = batch.inputs[i];
+      t.resize(1);
+      t[0].resize(samples_.sample_size());
+      samples_.sample(order_[first + i], &t[0][0]);
+      batch.labels[i] = samples_.label(order_[first + i]);
+      if (!transforms_.empty()) {
+        std::mt19937 sample_rng(seeds[i]);
+        for (const auto &f : transforms_) f(t[0], sample_rng);
+      }
+    }, 1);
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    ready_.notify_all();
+    for (auto &w : workers_) w.join();
+    workers_.clear();
+  }
+
+  const dataset &samples_;
+  size_t batch_size_;
+  size_t num_workers_;
+  bool shuffle_ = true;
+  std::vector<transform> transforms_;
+
+  std::vector<size_t> order_;
+  std::vector<slot> slots_;  // batch i is assembled in slots_[i % size]
+  size_t seed_        = 0;
+  size_t epoch_       = 0;
+  size_t batch_count_ = 0;
+  size_t claimed_     = 0;  // batches handed to workers
+  size_t consumed_    = 0;  // batches released by the consumer
+  size_t busy_        = 0;  // workers assembling a batch
+  bool holding_       = false;
+  bool started_       = false;
+  bool stop_          = false;
+  std::exception_ptr error_;
+
+  std::mutex mtx_;
+  std::condition_variable ready_;  // work for the workers
+  std::condition_variable done_;   // a batch is ready
+  std::condition_variable idle_;   // no batch in flight
+  std::vector<std::thread> workers_;
+};
+
+/**
+ * sample transforms for data_pipeline
+ **/
+namespace transforms {
+
+/**
+ * set each value to min_value with probability corruption_level
+ **/
+inline data_pipeline::transform corrupt(float_t corruption_level,
+                                        float_t min_value) {
+  return [=](vec_t &sample, std::mt19937 &rng) {
+    tiny_dnn::corrupt(sample, corruption_level, min_value, rng);
+  };
+}
+
+/**
+ * subtract mean from the sample, either value by value (mean has the size
+ * of the sample), or channel by channel (mean has one value per channel,
+ * e.g. as computed by mean_image)
+ **/
+inline data_pipeline::transform subtract_mean(const vec_t &mean) {
+  return [=](vec_t &sample, std::mt19937 &) {
+    if (mean.empty() || sample.size() % mean.size() != 0) {
+      throw nn_error("mean of " + to_string(mean.size()) +
+                     " values does not fit a sample of " +
+                     to_string(sample.size()));
+    }
+    const size_t area = sample.size() / mean.size();
+    for (size_t i = 0; i < sample.size(); i++) sample[i] -= mean[i / area];
+  };
+}
+
+#ifdef DNN_USE_IMAGE_API
+/**
+ * resize each channel of a sample of shape in into width x height, with the
+ * filters of resize_image
+ **/
+inline data_pipeline::transform resize(const shape3d &in,
+                                       size_t width,
+                                       size_t height) {
+  return [=](vec_t &sample, std::mt19937 &) {
+    if (sample.size() != in.size()) {
+      throw nn_error("sample of " + to_string(sample.size()) +
+                     " values does not have the shape " + to_string(in));
+    }
+    const size_t out_area = width * height;
+    std::vector<float> src(sample.begin(), sample.end());
+    std::vector<float> dst(out_area * in.depth_);
+    for (size_t c = 0; c < in.depth_; c++) {
+      detail::resize_image_core(
+        &src[c * in.area()], static_cast<int>(in.width_),
+        static_cast<int>(in.height_), &dst[c * out_area],
+        static_cast<int>(width), static_cast<int>(height), 1);
+    }
+    sample.assign(dst.begin(), dst.end());
+  };
+}
+#endif  // DNN_USE_IMAGE_API
+
+}  // namespace transforms
+}  // namespace tiny_dnn
@@ -0,0 +1,58 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <vector>
+
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+
+/**
+ * labeled samples decoded on demand, e.g. from a file mapped into memory
+ * (see mnist_dataset, cifar10_dataset), instead of being decoded up front.
+ * samples are addressed by index, so they can be visited in any order, and
+ * may be decoded from several threads at once.
+ *
+ *     mnist_dataset train("train-images.idx3-ubyte",
+ *                         "train-labels.idx1-ubyte", -1.0, 1.0, 2, 2);
+ *     net.train<cross_entropy>(optimizer, train, 32, 10);
+ **/
+class dataset {
+ public:
+  virtual ~dataset() = default;
+
+  ///< number of samples
+  virtual size_t size() const = 0;
+
+  ///< number of values of a sample
+  virtual size_t sample_size() const = 0;
+
+  ///< decode the index-th sample into dst[0] ... dst[sample_size() - 1]
+  virtual void sample(size_t index, float_t *dst) const = 0;
+
+  virtual label_t label(size_t index) const = 0;
+
+  /**
+   * decode the samples indices[0] ... indices[count - 1]
+   **/
+  void load(const size_t *indices,
+            size_t count,
+            std::vector<vec_t> *samples,
+            std::vector<label_t> *labels) const {
+    samples->resize(count);
+    labels->resize(count);
+    for (size_t i = 0; i < count; i++) {
+      (*samples)[i].resize(sample_size());
+      sample(indices[i], &(*samples)[i][0]);
+      (*labels)[i] = label(indices[i]);
+    }
+  }
+};
+
+}  // namespace tiny_dnn
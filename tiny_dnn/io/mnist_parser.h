@@ -7,11 +7,15 @@
 */
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
 #include <fstream>
 #include <string>
 #include <vector>
 
+#include "tiny_dnn/io/dataset.h"
+#include "tiny_dnn/util/mapped_file.h"
 #include "tiny_dnn/util/util.h"
 
 namespace tiny_dnn {
@@ -42,6 +46,26 @@ inline void parse_mnist_header(std::ifstream &ifs, mnist_header &header) {
   if (ifs.fail() || ifs.bad()) throw nn_error("file error");
 }
 
+// rescale the pixels at src into a padded image at dst
+inline void scale_mnist_image(const uint8_t *src,
+                              const mnist_header &header,
+                              float_t scale_min,
+                              float_t scale_max,
+                              int x_padding,
+                              int y_padding,
+                              float_t *dst) {
+  const int width  = header.num_cols + 2 * x_padding;
+  const int height = header.num_rows + 2 * y_padding;
+
+  std::fill(dst, dst + width * height, scale_min);
+  for (uint32_t y = 0; y < header.num_rows; y++)
+    for (uint32_t x = 0; x < header.num_cols; x++)
+      dst[width * (y + y_padding) + x + x_padding] =
+        (src[y * header.num_cols + x] / float_t(255)) *
+          (scale_max - scale_min) +
+        scale_min;
+}
+
 inline void parse_mnist_image(std::ifstream &ifs,
                               const mnist_header &header,
                               float_t scale_min,
@@ -57,14 +81,14 @@ inline void parse_mnist_image(std::ifstream &ifs,
   ifs.read(reinterpret_cast<char *>(&image_vec[0]),
            header.num_rows * header.num_cols);
 
-  dst.resize(width * height, scale_min);
+  dst.resize(width * height);
+  scale_mnist_image(&image_vec[0], header, scale_min, scale_max, x_padding,
+                    y_padding, &dst[0]);
+}
 
-  for (uint32_t y = 0; y < header.num_rows; y++)
-    for (uint32_t x = 0; x < header.num_cols; x++)
-      dst[width * (y + y_padding) + x + x_padding] =
-        (image_vec[y * header.num_cols + x] / float_t(255)) *
-          (scale_max - scale_min) +
-        scale_min;
+inline uint32_t read_big_endian(const uint8_t *p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+         (uint32_t(p[2]) << 8) | uint32_t(p[3]);
 }
 
 }  // namespace detail
@@ -156,4 +180,85 @@ inline void parse_mnist_images(const std::string &image_file,
   }
 }
 
+/**
+ * MNIST database format images and labels, mapped into memory and rescaled
+ * on demand, with the same rescaling and padding as parse_mnist_images
+ * http://yann.lecun.com/exdb/mnist/
+ *
+ * @param image_file [in]  filename of images (i.e.train-images-idx3-ubyte)
+ * @param label_file [in]  filename of labels (i.e.train-labels-idx1-ubyte)
+ * @param scale_min  [in]  min-value of output
+ * @param scale_max  [in]  max-value of output
+ * @param x_padding  [in]  adding border width (left,right)
+ * @param y_padding  [in]  adding border width (top,bottom)
+ **/
+class mnist_dataset : public dataset {
+ public:
+  mnist_dataset(const std::string &image_file,
+                const std::string &label_file,
+                float_t scale_min,
+                float_t scale_max,
+                int x_padding,
+                int y_padding)
+    : images_(image_file),
+      labels_(label_file),
+      scale_min_(scale_min),
+      scale_max_(scale_max),
+      x_padding_(x_padding),
+      y_padding_(y_padding) {
+    if (x_padding < 0 || y_padding < 0)
+      throw nn_error("padding size must not be negative");
+    if (scale_min >= scale_max)
+      throw nn_error("scale_max must be greater than scale_min");
+
+    if (images_.size() < 16 || labels_.size() < 8)
+      throw nn_error("MNIST file format error");
+    const uint8_t *p = images_.data();
+
+    header_.magic_number = detail::read_big_endian(p);
+    header_.num_items    = detail::read_big_endian(p + 4);
+    header_.num_rows     = detail::read_big_endian(p + 8);
+    header_.num_cols     = detail::read_big_endian(p + 12);
+    if (header_.magic_number != 0x00000803 || header_.num_items == 0 ||
+        (images_.size() - 16) / header_.num_items <
+          uint64_t(header_.num_rows) * header_.num_cols)
+      throw nn_error("MNIST image-file format error:" + image_file);
+
+    const uint8_t *q = labels_.data();
+    if (detail::read_big_endian(q) != 0x00000801 ||
+        detail::read_big_endian(q + 4) != header_.num_items ||
+        labels_.size() - 8 < header_.num_items)
+      throw nn_error("MNIST label-file format error:" + label_file);
+  }
+
+  size_t size() const override { return header_.num_items; }
+
+  size_t sample_size() const override {
+    return (header_.num_cols + 2 * x_padding_) *
+           (header_.num_rows + 2 * y_padding_);
+  }
+
+  void sample(size_t index, float_t *dst) const override {
+    assert(index < size());
+    const size_t area = size_t(header_.num_rows) * header_.num_cols;
+    detail::scale_mnist_image(images_.data() + 16 + index * area, header_,
+                              scale_min_, scale_max_, x_padding_, y_padding_,
+                              dst);
+  }
+
+  label_t label(size_t index) const override {
+    assert(index < size());
+    return static_cast<label_t>(labels_.data()[8 + index]);
+  }
+
+ private:
+  mapped_file images_;
+  mapped_file labels_;
+  detail::mnist_header header_;
+  float_t scale_min_;
+  float_t scale_max_;
+  int x_padding_;
+  int y_padding_;
+};
+
 }  // namespace tiny_dnn
@@ -0,0 +1,245 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tiny_dnn/util/mapped_file.h"
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+
+/**
+ * model file, a container for the architecture and the raw weights of a
+ * network that is loaded by mapping it into memory:
+ *
+ *     model_file_header
+ *     model_file_blob[blob_count]    where each weight vector lies
+ *     architecture                   binary archive of nodes::save_model
+ *     weights                        the float_t values of each weight
+ *                                    vector, starting on a page boundary,
+ *                                    every vector aligned to alignment
+ *
+ * the weight vectors of the layers loaded from the file refer to the
+ * mapping instead of holding a copy, so loading costs no parsing or copying,
+ * and processes loading the same file share the physical memory of its
+ * weights until they modify them. numbers are stored in the byte order of
+ * the writer, which a reader has to share.
+ **/
+struct model_file_header {
+  static constexpr uint32_t current_version = 1;
+  static constexpr uint32_t byte_order_mark = 0x01020304;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;    // byte_order_mark as written
+  uint32_t float_size;    // sizeof(float_t)
+  uint32_t alignment;     // of the weight vectors, in bytes
+  uint64_t model_offset;  // architecture
+  uint64_t model_size;    // 0 if the file holds weights only
+  uint64_t blob_offset;   // table of the weight vectors
+  uint64_t blob_count;
+
+  static const char *file_magic() { return "tinydnn"; }
+};
+
+struct model_file_blob {
+  uint64_t offset;  // from the start of the file, in bytes
+  uint64_t size;    // number of values
+};
+
+namespace detail {
+
+inline uint64_t align_up(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+inline void write_padding(std::ostream &os, uint64_t from, uint64_t to) {
+  static const char zeros[64] = {};
+  while (from < to) {
+    const uint64_t n = std::min<uint64_t>(to - from, sizeof(zeros));
+    os.write(zeros, static_cast<std::streamsize>(n));
+    from += n;
+  }
+}
+
+}  // namespace detail
+
+/**
+ * write the architecture (if model) and the weights (if weights) of net
+ **/
+template <typename Nodes>
+void save_model_file(const std::string &filename,
+                     const Nodes &net,
+                     bool model,
+                     bool weights) {
+#ifndef CNN_NO_SERIALIZATION
+  std::string architecture;
+  if (model) {
+    std::stringstream ss;
+    {
+      cereal::BinaryOutputArchive oa(ss);
+      net.save_model(oa);
+    }
+    architecture = ss.str();
+  }
+
+  std::vector<const vec_t *> vectors;
+  if (weights) {
+    for (const auto *l : net) {
+      for (const vec_t *w : l->weights()) vectors.push_back(w);
+    }
+  }
+
+  const uint64_t page = 4096;
+  model_file_header h;
+  std::memcpy(h.magic, model_file_header::file_magic(), sizeof(h.magic));
+  h.version      = model_file_header::current_version;
+  h.byte_order   = model_file_header::byte_order_mark;
+  h.float_size   = sizeof(float_t);
+  h.alignment    = 64;
+  h.blob_offset  = sizeof(model_file_header);
+  h.blob_count   = vectors.size();
+  h.model_offset = h.blob_offset + h.blob_count * sizeof(model_file_blob);
+  h.model_size   = architecture.size();
+
+  std::vector<model_file_blob> blobs(vectors.size());
+  uint64_t end = detail::align_up(h.model_offset + h.model_size, page);
+  for (size_t i = 0; i < vectors.size(); i++) {
+    blobs[i].offset = end;
+    blobs[i].size   = vectors[i]->size();
+    end = detail::align_up(end + blobs[i].size * sizeof(float_t), h.alignment);
+  }
+
+  std::ofstream ofs(filename.c_str(), std::ios::binary | std::ios::out);
+  if (ofs.fail() || ofs.bad()) throw nn_error("failed to open:" + filename);
+  ofs.write(reinterpret_cast<const char *>(&h), sizeof(h));
+  if (!blobs.empty()) {
+    ofs.write(reinterpret_cast<const char *>(&blobs[0]),
+              static_cast<std::streamsize>(blobs.size() * sizeof(blobs[0])));
+  }
+  ofs.write(architecture.data(),
+            static_cast<std::streamsize>(architecture.size()));
+  uint64_t pos = h.model_offset + h.model_size;
+  for (size_t i = 0; i < vectors.size(); i++) {
+    detail::write_padding(ofs, pos, blobs[i].offset);
+    const uint64_t bytes = blobs[i].size * sizeof(float_t);
+    if (bytes > 0) {
+      ofs.write(reinterpret_cast<const char *>(&(*vectors[i])[0]),
+                static_cast<std::streamsize>(bytes));
+    }
+    pos = blobs[i].offset + bytes;
+  }
+  if (ofs.fail() || ofs.bad()) throw nn_error("failed to write:" + filename);
+#else
+  CNN_UNREFERENCED_PARAMETER(filename);
+  CNN_UNREFERENCED_PARAMETER(net);
+  CNN_UNREFERENCED_PARAMETER(model);
+  CNN_UNREFERENCED_PARAMETER(weights);
+  throw nn_error("tiny-dnn was not built with Serialization support");
+#endif  // CNN_NO_SERIALIZATION
+}
+
+/**
+ * read the architecture (if model) and the weights (if weights) of net
+ * from a file written by save_model_file. the weights are not copied: the
+ * layers of net refer to the returned mapping, which has to outlive them.
+ * @return the mapping, or nullptr if no weights were read
+ **/
+template <typename Nodes>
+std::shared_ptr<mapped_file> load_model_file(const std::string &filename,
+                                             Nodes &net,
+                                             bool model,
+                                             bool weights) {
+#ifndef CNN_NO_SERIALIZATION
+  auto file = std::make_shared<mapped_file>(filename);
+  const uint8_t *base = file->data();
+
+  model_file_header h;
+  if (file->size() < sizeof(h)) throw nn_error("not a model file:" + filename);
+  std::memcpy(&h, base, sizeof(h));
+  if (std::memcmp(h.magic, model_file_header::file_magic(), sizeof(h.magic))) {
+    throw nn_error("not a model file:" + filename);
+  }
+  if (h.version == 0 || h.version > model_file_header::current_version) {
+    throw nn_error("unsupported model file version " +
+                   to_string(h.version) + ":" + filename);
+  }
+  if (h.byte_order != model_file_header::byte_order_mark) {
+    throw nn_error("model file of a different byte order:" + filename);
+  }
+  if (h.float_size != sizeof(float_t)) {
+    throw nn_error("model file of a different float_t:" + filename);
+  }
+  const uint64_t size = file->size();
+  auto in_file = [&](uint64_t offset, uint64_t bytes) {
+    return offset <= size && bytes <= size - offset;
+  };
+  if (h.alignment == 0 || h.alignment % 64 != 0 ||
+      h.blob_count > size / sizeof(model_file_blob) ||
+      !in_file(h.blob_offset, h.blob_count * sizeof(model_file_blob)) ||
+      !in_file(h.model_offset, h.model_size)) {
+    throw nn_error("corrupted model file:" + filename);
+  }
+
+  if (model) {
+    if (h.model_size == 0) {
+      throw nn_error("model file without architecture:" + filename);
+    }
+    std::stringstream ss(
+      std::string(reinterpret_cast<const char *>(base + h.model_offset),
+                  static_cast<size_t>(h.model_size)));
+    cereal::BinaryInputArchive ia(ss);
+    net.load_model(ia);
+  }
+  if (!weights) return nullptr;
+
+  std::vector<model_file_blob> blobs(static_cast<size_t>(h.blob_count));
+  if (!blobs.empty()) {
+    std::memcpy(&blobs[0], base + h.blob_offset,
+                blobs.size() * sizeof(model_file_blob));
+  }
+  size_t next = 0;
+  for (auto *l : net) {
+    std::vector<float_t *> data;
+    for (const vec_t *w : l->weights()) {
+      if (next == blobs.size()) {
+        throw nn_error("model file holds too few weights:" + filename);
+      }
+      const model_file_blob &b = blobs[next++];
+      if (b.size != w->size() || b.offset % h.alignment != 0 ||
+          b.size > size / sizeof(float_t) ||
+          !in_file(b.offset, b.size * sizeof(float_t))) {
+        throw nn_error("weight size mismatch in " + l->layer_type() + ":" +
+                       filename);
+      }
+      data.push_back(reinterpret_cast<float_t *>(file->data() + b.offset));
+    }
+    l->set_external_weights(data);
+  }
+  if (next != blobs.size()) {
+    throw nn_error("model file holds too many weights:" + filename);
+  }
+  return file;
+#else
+  CNN_UNREFERENCED_PARAMETER(filename);
+  CNN_UNREFERENCED_PARAMETER(net);
+  CNN_UNREFERENCED_PARAMETER(model);
+  CNN_UNREFERENCED_PARAMETER(weights);
+  throw nn_error("tiny-dnn was not built with Serialization support");
+#endif  // CNN_NO_SERIALIZATION
+}
+
+}  // namespace tiny_dnn
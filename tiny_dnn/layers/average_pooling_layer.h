@@ -8,11 +8,14 @@
 #pragma once
 
 #include <algorithm>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
-#include "tiny_dnn/layers/partial_connected_layer.h"
+#include "tiny_dnn/core/kernels/avepool_grad_op.h"
+#include "tiny_dnn/core/kernels/avepool_op.h"
+
 #include "tiny_dnn/util/util.h"
 
 #ifdef DNN_USE_IMAGE_API
@@ -21,97 +24,11 @@
 
 namespace tiny_dnn {
 
-// forward_propagation
-inline void tiny_average_pooling_kernel(
-  bool parallelize,
-  const std::vector<tensor_t *> &in_data,
-  std::vector<tensor_t *> &out_data,
-  const shape3d &out_dim,
-  float_t scale_factor,
-  std::vector<typename partial_connected_layer::wi_connections> &out2wi) {
-  for_i(parallelize, in_data[0]->size(), [&](size_t sample) {
-    const vec_t &in = (*in_data[0])[sample];
-    const vec_t &W  = (*in_data[1])[0];
-    const vec_t &b  = (*in_data[2])[0];
-    vec_t &out      = (*out_data[0])[sample];
-
-    auto oarea = out_dim.area();
-    size_t idx = 0;
-    for (size_t d = 0; d < out_dim.depth_; ++d) {
-      float_t weight = W[d] * scale_factor;
-      float_t bias   = b[d];
-      for (size_t i = 0; i < oarea; ++i, ++idx) {
-        const auto &connections = out2wi[idx];
-        float_t value{0};
-        for (auto connection : connections) value += in[connection.second];
-        value *= weight;
-        value += bias;
-        out[idx] = value;
-      }
-    }
-
-    assert(out.size() == out2wi.size());
-  });
-}
-
-// back_propagation
-inline void tiny_average_pooling_back_kernel(
-  bool parallelize,
-  const std::vector<tensor_t *> &in_data,
-  const std::vector<tensor_t *> &out_data,
-  std::vector<tensor_t *> &out_grad,
-  std::vector<tensor_t *> &in_grad,
-  const shape3d &in_dim,
-  float_t scale_factor,
-  std::vector<typename partial_connected_layer::io_connections> &weight2io,
-  std::vector<typename partial_connected_layer::wo_connections> &in2wo,
-  std::vector<std::vector<size_t>> &bias2out) {
-  CNN_UNREFERENCED_PARAMETER(out_data);
-  for_i(parallelize, in_data[0]->size(), [&](size_t sample) {
-    const vec_t &prev_out = (*in_data[0])[sample];
-    const vec_t &W        = (*in_data[1])[0];
-    vec_t &dW             = (*in_grad[1])[sample];
-    vec_t &db             = (*in_grad[2])[sample];
-    vec_t &prev_delta     = (*in_grad[0])[sample];
-    vec_t &curr_delta     = (*out_grad[0])[sample];
-
-    auto inarea = in_dim.area();
-    size_t idx  = 0;
-    for (size_t i = 0; i < in_dim.depth_; ++i) {
-      float_t weight = W[i] * scale_factor;
-      for (size_t j = 0; j < inarea; ++j, ++idx) {
-        prev_delta[idx] = weight * curr_delta[in2wo[idx][0].second];
-      }
-    }
-
-    for (size_t i = 0; i < weight2io.size(); ++i) {
-      const auto &connections = weight2io[i];
-      float_t diff{0};
-
-      for (auto connection : connections)
-        diff += prev_out[connection.first] * curr_delta[connection.second];
-
-      dW[i] += diff * scale_factor;
-    }
-
-    for (size_t i = 0; i < bias2out.size(); i++) {
-      const std::vector<size_t> &outs = bias2out[i];
-      float_t diff{0};
-
-      for (auto o : outs) diff += curr_delta[o];
-
-      db[i] += diff;
-    }
-  });
-}
-
 /**
  * average pooling with trainable weights
  **/
-class average_pooling_layer : public partial_connected_layer {
+class average_pooling_layer : public layer {
  public:
-  using Base = partial_connected_layer;
-
   /**
    * @param in_width     [in] width of input image
    * @param in_height    [in] height of input image
@@ -121,18 +38,25 @@ class average_pooling_layer : public partial_connected_layer {
   average_pooling_layer(size_t in_width,
                         size_t in_height,
                         size_t in_channels,
-                        size_t pool_size)
+                        size_t pool_size,
+                        core::backend_t backend_type = core::default_engine())
     : average_pooling_layer(in_width,
                             in_height,
                             in_channels,
                             pool_size,
-                            (in_height == 1 ? 1 : pool_size)) {}
+                            (in_height == 1 ? 1 : pool_size),
+                            backend_type) {}
 
   average_pooling_layer(const shape3d &in_shape,
                         size_t pool_size,
-                        size_t stride)
-    : average_pooling_layer(
-        in_shape.width_, in_shape.width_, in_shape.depth_, pool_size, stride) {}
+                        size_t stride,
+                        core::backend_t backend_type = core::default_engine())
+    : average_pooling_layer(in_shape.width_,
+                            in_shape.height_,
+                            in_shape.depth_,
+                            pool_size,
+                            stride,
+                            backend_type) {}
 
   /**
    * @param in_width     [in] width of input image
@@ -146,7 +70,8 @@ class average_pooling_layer : public partial_connected_layer {
                         size_t in_height,
                         size_t in_channels,
                         size_t pool_size,
-                        size_t stride)
+                        size_t stride,
+                        core::backend_t backend_type = core::default_engine())
     : average_pooling_layer(in_width,
                             in_height,
                             in_channels,
@@ -154,7 +79,8 @@ class average_pooling_layer : public partial_connected_layer {
                             (in_height == 1 ? 1 : pool_size),
                             stride,
                             stride,
-                            padding::valid) {}
+                            padding::valid,
+                            backend_type) {}
 
   /**
    * @param in_width     [in] width of input image
@@ -175,111 +101,133 @@ class average_pooling_layer : public partial_connected_layer {
                         size_t pool_size_y,
                         size_t stride_x,
                         size_t stride_y,
-                        padding pad_type = padding::valid)
-    : Base(in_width * in_height * in_channels,
-           conv_out_length(in_width, pool_size_x, stride_x, pad_type) *
-             conv_out_length(in_height, pool_size_y, stride_y, pad_type) *
-             in_channels,
-           in_channels,
-           in_channels,
-           float_t(1) / (pool_size_x * pool_size_y)),
-      stride_x_(stride_x),
-      stride_y_(stride_y),
-      pool_size_x_(pool_size_x),
-      pool_size_y_(pool_size_y),
-      pad_type_(pad_type),
-      in_(in_width, in_height, in_channels),
-      out_(conv_out_length(in_width, pool_size_x, stride_x, pad_type),
-           conv_out_length(in_height, pool_size_y, stride_y, pad_type),
-           in_channels),
-      w_(pool_size_x, pool_size_y, in_channels) {
+                        padding pad_type             = padding::valid,
+                        core::backend_t backend_type = core::default_engine())
+    : layer(std_input_order(true), {vector_type::data}) {
     if ((in_width % pool_size_x) || (in_height % pool_size_y)) {
       pooling_size_mismatch(in_width, in_height, pool_size_x, pool_size_y);
     }
 
-    init_connection(pool_size_x, pool_size_y);
+    set_avepool_params(
+      shape3d(in_width, in_height, in_channels),
+      shape3d(conv_out_length(in_width, pool_size_x, stride_x, pad_type),
+              conv_out_length(in_height, pool_size_y, stride_y, pad_type),
+              in_channels),
+      pool_size_x, pool_size_y, stride_x, stride_y, pad_type);
+
+    init_backend(backend_type);
+    layer::set_backend_type(backend_type);
   }
 
-  std::vector<index3d<size_t>> in_shape() const override {
-    return {in_, w_, index3d<size_t>(1, 1, out_.depth_)};
+  // move constructor
+  average_pooling_layer(average_pooling_layer &&other)  // NOLINT
+    : layer(std::move(other)), params_(std::move(other.params_)) {
+    init_backend(std::move(layer::engine()));
   }
 
-  std::vector<index3d<size_t>> out_shape() const override { return {out_}; }
+  size_t fan_in_size() const override {
+    return params_.pool_size_x * params_.pool_size_y;
+  }
 
-  std::string layer_type() const override { return "ave-pool"; }
+  // the number of windows sharing an input
+  size_t fan_out_size() const override {
+    const size_t windows_x =
+      (params_.pool_size_x + params_.stride_x - 1) / params_.stride_x;
+    const size_t windows_y =
+      (params_.pool_size_y + params_.stride_y - 1) / params_.stride_y;
+    return std::min(windows_x, params_.out.width_) *
+           std::min(windows_y, params_.out.height_);
+  }
 
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
-    tiny_average_pooling_kernel(parallelize_, in_data, out_data, out_,
-                                Base::scale_factor_, Base::out2wi_);
+    // forward pooling op context
+    fwd_ctx_.set_in_out(in_data, out_data);
+    fwd_ctx_.setParallelize(layer::parallelize());
+    fwd_ctx_.setEngine(layer::engine());
+
+    // launch pooling kernel
+    kernel_fwd_->compute(fwd_ctx_);
   }
 
   void back_propagation(const std::vector<tensor_t *> &in_data,
                         const std::vector<tensor_t *> &out_data,
                         std::vector<tensor_t *> &out_grad,
                         std::vector<tensor_t *> &in_grad) override {
-    tiny_average_pooling_back_kernel(
-      parallelize_, in_data, out_data, out_grad, in_grad, in_,
-      Base::scale_factor_, Base::weight2io_, Base::in2wo_, Base::bias2out_);
+    // backward pooling op context
+    bwd_ctx_.set_in_out(in_data, out_data, out_grad, in_grad);
+    bwd_ctx_.setParallelize(layer::parallelize());
+    bwd_ctx_.setEngine(layer::engine());
+
+    // launch pooling kernel
+    kernel_back_->compute(bwd_ctx_);
   }
 
-  std::pair<size_t, size_t> pool_size() const {
-    return std::make_pair(pool_size_x_, pool_size_y_);
+  // only the first depth weights are used, W[c] scales channel c as the
+  // partial_connected_layer did; the shape of the weights is kept for
+  // compatibility with saved models
+  std::vector<index3d<size_t>> in_shape() const override {
+    return {params_.in,
+            index3d<size_t>(params_.pool_size_x, params_.pool_size_y,
+                            params_.in.depth_),
+            index3d<size_t>(1, 1, params_.in.depth_)};
   }
 
-  friend struct serialization_buddy;
+  std::vector<index3d<size_t>> out_shape() const override {
+    return {params_.out};
+  }
 
- private:
-  size_t stride_x_;
-  size_t stride_y_;
-  size_t pool_size_x_;
-  size_t pool_size_y_;
-  padding pad_type_;
-  shape3d in_;
-  shape3d out_;
-  shape3d w_;
-
-  static size_t pool_out_dim(size_t in_size,
-                             size_t pooling_size,
-                             size_t stride) {
-    return static_cast<int>(
-      std::ceil((static_cast<float_t>(in_size) - pooling_size) / stride) + 1);
+  std::string layer_type() const override { return "ave-pool"; }
+
+  std::pair<size_t, size_t> pool_size() const {
+    return std::make_pair(params_.pool_size_x, params_.pool_size_y);
   }
 
-  void init_connection(size_t pooling_size_x, size_t pooling_size_y) {
-    for (size_t c = 0; c < in_.depth_; ++c) {
-      for (size_t y = 0; y < in_.height_ - pooling_size_y + 1; y += stride_y_) {
-        for (size_t x = 0; x < in_.width_ - pooling_size_x + 1;
-             x += stride_x_) {
-          connect_kernel(pooling_size_x, pooling_size_y, x, y, c);
-        }
-      }
-    }
+  friend struct serialization_buddy;
 
-    for (size_t c = 0; c < in_.depth_; ++c) {
-      for (size_t y = 0; y < out_.height_; ++y) {
-        for (size_t x = 0; x < out_.width_; ++x) {
-          this->connect_bias(c, out_.get_index(x, y, c));
-        }
-      }
+ private:
+  /* The Average Pooling operation params */
+  core::avepool_params params_;
+
+  /* forward op context */
+  core::OpKernelContext fwd_ctx_;
+
+  /* backward op context */
+  core::OpKernelContext bwd_ctx_;
+
+  /* Forward and backward ops */
+  std::shared_ptr<core::OpKernel> kernel_fwd_;
+  std::shared_ptr<core::OpKernel> kernel_back_;
+
+  void init_backend(core::backend_t backend_type) {
+    core::OpKernelConstruction ctx =
+      core::OpKernelConstruction(layer::device(), &params_);
+
+    if (backend_type == core::backend_t::internal ||
+        backend_type == core::backend_t::nnpack ||
+        backend_type == core::backend_t::avx) {
+      kernel_fwd_.reset(new AvePoolOp(ctx));
+      kernel_back_.reset(new AvePoolGradOp(ctx));
+      return;
+    } else {
+      throw nn_error("Not supported engine: " + to_string(backend_type));
     }
   }
 
-  void connect_kernel(size_t pooling_size_x,
-                      size_t pooling_size_y,
-                      size_t x,
-                      size_t y,
-                      size_t inc) {
-    size_t dymax  = std::min(pooling_size_y, in_.height_ - y);
-    size_t dxmax  = std::min(pooling_size_x, in_.width_ - x);
-    size_t dstx   = x / stride_x_;
-    size_t dsty   = y / stride_y_;
-    size_t outidx = out_.get_index(dstx, dsty, inc);
-    for (size_t dy = 0; dy < dymax; ++dy) {
-      for (size_t dx = 0; dx < dxmax; ++dx) {
-        this->connect_weight(in_.get_index(x + dx, y + dy, inc), outidx, inc);
-      }
-    }
+  void set_avepool_params(const shape3d &in,
+                          const shape3d &out,
+                          size_t pool_size_x,
+                          size_t pool_size_y,
+                          size_t stride_x,
+                          size_t stride_y,
+                          padding pad_type) {
+    params_.in          = in;
+    params_.out         = out;
+    params_.pool_size_x = pool_size_x;
+    params_.pool_size_y = pool_size_y;
+    params_.stride_x    = stride_x;
+    params_.stride_y    = stride_y;
+    params_.pad_type    = pad_type;
   }
 };
 
@@ -68,11 +68,13 @@ inline void tiny_average_unpooling_back_kernel(
   std::vector<std::vector<size_t>> &bias2out) {
   CNN_UNREFERENCED_PARAMETER(out_data);
   CNN_UNREFERENCED_PARAMETER(scale_factor);
-  for_i(parallelize, in_data[0]->size(), [&](size_t sample) {
+  const size_t partials = in_grad[1]->size();
+  for_partials(parallelize, in_data[0]->size(), partials, [&](size_t partial,
+                                                              size_t sample) {
     const vec_t &prev_out = (*in_data[0])[sample];
     const vec_t &W        = (*in_data[1])[0];
-    vec_t &dW             = (*in_grad[1])[sample];
-    vec_t &db             = (*in_grad[2])[sample];
+    vec_t &dW             = (*in_grad[1])[partial];
+    vec_t &db             = (*in_grad[2])[partial];
     vec_t &prev_delta     = (*in_grad[0])[sample];
     vec_t &curr_delta     = (*out_grad[0])[sample];
 
@@ -211,6 +211,19 @@ class batch_normalization_layer : public layer {
     calc_stddev(variance);
   }
 
+  /**
+   * the normalization of the test phase as affine transform of every
+   * channel c, y = scale[c] * x + shift[c]
+   **/
+  void affine_transform(vec_t &scale, vec_t &shift) const {
+    scale.resize(in_channels_);
+    shift.resize(in_channels_);
+    for (size_t i = 0; i < in_channels_; i++) {
+      scale[i] = float_t(1) / std::sqrt(variance_[i] + eps_);
+      shift[i] = -mean_[i] * scale[i];
+    }
+  }
+
   float_t epsilon() const { return eps_; }
 
   float_t momentum() const { return momentum_; }
@@ -65,19 +65,33 @@ class concat_layer : public layer {
 
   std::vector<shape3d> out_shape() const override { return {out_shape_}; }
 
+  /**
+   * the inputs are written in place where possible: the first forward pass
+   * makes each input a view of its channels of the output (see
+   * edge::make_view_of), so that from then on the producers write into the
+   * output and the gradients are read from it. the inputs which cannot be
+   * views, e.g. because other layers consume them too, are copied.
+   **/
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     const size_t num_samples = (*out_data[0]).size();
-
-    for_i(num_samples, [&](size_t s) {
-      float_t *outs = &(*out_data[0])[s][0];
-
-      for (size_t i = 0; i < in_shapes_.size(); i++) {
-        const float_t *ins = &(*in_data[i])[s][0];
-        size_t dim         = in_shapes_[i].size();
-        outs               = std::copy(ins, ins + dim, outs);
+    edge &out                = *next()[0];
+
+    for (size_t i = 0, offset = 0; i < in_shapes_.size(); i++) {
+      edge &in         = *prev()[i];
+      const size_t dim = in_shapes_[i].size();
+      if (!in.is_view_of(out, offset)) {
+        for_i(num_samples, [&](size_t s) {
+          const float_t *ins = &(*in_data[i])[s][0];
+          float_t *outs      = &(*out_data[0])[s][offset];
+          if (ins != outs) std::copy(ins, ins + dim, outs);
+        });
+        if (!inference_only() && in.next().size() <= 1) {
+          in.make_view_of(out, offset);
+        }
       }
-    });
+      offset += dim;
+    }
   }
 
   void back_propagation(const std::vector<tensor_t *> &in_data,
@@ -87,18 +101,20 @@ class concat_layer : public layer {
     CNN_UNREFERENCED_PARAMETER(in_data);
     CNN_UNREFERENCED_PARAMETER(out_data);
 
-    size_t num_samples = (*out_grad[0]).size();
-
-    for_i(num_samples, [&](size_t s) {
-      const float_t *outs = &(*out_grad[0])[s][0];
-
-      for (size_t i = 0; i < in_shapes_.size(); i++) {
-        size_t dim   = in_shapes_[i].size();
-        float_t *ins = &(*in_grad[i])[s][0];
-        std::copy(outs, outs + dim, ins);
-        outs += dim;
+    const size_t num_samples = (*out_grad[0]).size();
+    const edge &out          = *next()[0];
+
+    for (size_t i = 0, offset = 0; i < in_shapes_.size(); i++) {
+      const size_t dim = in_shapes_[i].size();
+      if (!prev()[i]->is_view_of(out, offset)) {
+        for_i(num_samples, [&](size_t s) {
+          const float_t *outs = &(*out_grad[0])[s][offset];
+          float_t *ins        = &(*in_grad[i])[s][0];
+          if (ins != outs) std::copy(outs, outs + dim, ins);
+        });
       }
-    });
+      offset += dim;
+    }
   }
 
   friend struct serialization_buddy;
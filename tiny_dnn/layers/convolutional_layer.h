@@ -13,10 +13,12 @@
 #include <utility>
 #include <vector>
 
+#include "tiny_dnn/activations/activation_layer.h"
 #include "tiny_dnn/core/kernels/conv2d_grad_op.h"
 #include "tiny_dnn/core/kernels/conv2d_op.h"
 #include "tiny_dnn/core/kernels/conv2d_op_libdnn.h"
 #include "tiny_dnn/core/kernels/conv2d_op_opencl.h"
+#include "tiny_dnn/layers/batch_normalization_layer.h"
 
 #include "tiny_dnn/util/util.h"
 
@@ -67,7 +69,7 @@ class convolutional_layer : public layer {
                       bool has_bias                = true,
                       size_t w_stride              = 1,
                       size_t h_stride              = 1,
-                      core::backend_t backend_type = core::default_engine())
+                      core::backend_t backend_type = core::backend_t::automatic)
     : convolutional_layer(in_width,
                           in_height,
                           window_size,
@@ -116,7 +118,7 @@ class convolutional_layer : public layer {
                       bool has_bias                = true,
                       size_t w_stride              = 1,
                       size_t h_stride              = 1,
-                      core::backend_t backend_type = core::default_engine())
+                      core::backend_t backend_type = core::backend_t::automatic)
     : convolutional_layer(in_width,
                           in_height,
                           window_width,
@@ -166,7 +168,7 @@ class convolutional_layer : public layer {
                       bool has_bias                = true,
                       size_t w_stride              = 1,
                       size_t h_stride              = 1,
-                      core::backend_t backend_type = core::default_engine())
+                      core::backend_t backend_type = core::backend_t::automatic)
     : convolutional_layer(in_width,
                           in_height,
                           window_size,
@@ -218,11 +220,15 @@ class convolutional_layer : public layer {
                       bool has_bias                = true,
                       size_t w_stride              = 1,
                       size_t h_stride              = 1,
-                      core::backend_t backend_type = core::default_engine())
+                      core::backend_t backend_type = core::backend_t::automatic)
     : layer(std_input_order(has_bias), {vector_type::data}) {
     conv_set_params(shape3d(in_width, in_height, in_channels), window_width,
                     window_height, out_channels, pad_type, has_bias, w_stride,
                     h_stride, connection_table);
+    // without an explicit engine, e.g. Winograd is picked for 3x3
+    if (backend_type == core::backend_t::automatic) {
+      backend_type = core::default_engine(params_);
+    }
     init_backend(backend_type);
     layer::set_backend_type(backend_type);
   }
@@ -234,6 +240,7 @@ class convolutional_layer : public layer {
       padding_op_(std::move(other.padding_op_)),
       kernel_fwd_(std::move(other.kernel_fwd_)),
       kernel_back_(std::move(other.kernel_back_)),
+      activation_(other.activation_),
       cws_(std::move(other.cws_)) {
     init_backend(std::move(other.engine()));
   }
@@ -266,6 +273,8 @@ class convolutional_layer : public layer {
     fwd_ctx_.set_in_out(fwd_in_data_, out_data);
     fwd_ctx_.setParallelize(layer::parallelize());
     fwd_ctx_.setEngine(layer::engine());
+    fwd_ctx_.setWeightsVersion(layer::weights_version(in_data));
+    if (activation_) fwd_ctx_.setEpilogue(activation_->epilogue());
 
     // launch convolutional kernel
     kernel_fwd_->compute(fwd_ctx_);
@@ -287,6 +296,9 @@ class convolutional_layer : public layer {
                         const std::vector<tensor_t *> &out_data,
                         std::vector<tensor_t *> &out_grad,
                         std::vector<tensor_t *> &in_grad) override {
+    if (activation_) {
+      throw nn_error("convolution with fused activation is inference-only");
+    }
     bwd_in_data_.resize(in_data.size());
     std::copy(in_data.begin(), in_data.end(), bwd_in_data_.begin());
     bwd_in_data_[0] = in_data_padded(in_data);
@@ -311,10 +323,54 @@ class convolutional_layer : public layer {
 
   void set_sample_count(size_t sample_count) override {
     layer::set_sample_count(sample_count);
+    if (inference_only_) return;
     cws_.prev_delta_padded_.resize(sample_count,
                                    vec_t(params_.in_padded.size(), float_t(0)));
   }
 
+  /**
+   * fold a following batch normalization into weights and bias, or apply a
+   * following activation to the output right after the convolution
+   **/
+  bool fuse(const std::shared_ptr<layer> &next) override {
+    if (activation_) return false;
+    if (auto act = std::dynamic_pointer_cast<activation_layer>(next)) {
+      activation_ = act;
+      return true;
+    }
+
+    auto bn = dynamic_cast<batch_normalization_layer *>(next.get());
+    if (!bn || !params_.has_bias ||
+        bn->in_shape()[0] != index3d<size_t>(params_.out.area(), 1,
+                                             params_.out.depth_)) {
+      return false;
+    }
+    vec_t scale, shift;
+    bn->affine_transform(scale, shift);
+
+    setup(false);
+    vec_t &W          = *weights()[0];
+    vec_t &b          = *weights()[1];
+    const size_t size = W.size() / params_.out.depth_;  // per output channel
+    for (size_t o = 0; o < params_.out.depth_; o++) {
+      for (size_t i = o * size; i < (o + 1) * size; i++) W[i] *= scale[o];
+      b[o] = b[o] * scale[o] + shift[o];
+    }
+    return true;
+  }
+
+  const layer *fused_activation() const override {
+    return activation_.get();
+  }
+
+  void share_weights(layer &src) override {
+    layer::share_weights(src);
+    auto &conv   = static_cast<convolutional_layer &>(src);
+    auto *op     = dynamic_cast<Conv2dOp *>(kernel_fwd_.get());
+    auto *src_op = dynamic_cast<Conv2dOp *>(conv.kernel_fwd_.get());
+    if (op && src_op) op->share_weight_cache(*src_op);
+  }
+
   std::vector<index3d<size_t>> in_shape() const override {
     if (params_.has_bias) {
       return {params_.in, params_.weight,
@@ -393,6 +449,7 @@ class convolutional_layer : public layer {
 #endif  // DNN_USE_IMAGE_API
 
   friend struct serialization_buddy;
+  friend class quantized_convolutional_layer;
 
  private:
   tensor_t *in_data_padded(const std::vector<tensor_t *> &in) {
@@ -470,7 +527,8 @@ class convolutional_layer : public layer {
 
     if (backend_type == core::backend_t::internal ||
         backend_type == core::backend_t::nnpack ||
-        backend_type == core::backend_t::avx) {
+        backend_type == core::backend_t::avx ||
+        backend_type == core::backend_t::winograd) {
       kernel_fwd_.reset(new Conv2dOp(ctx));
       kernel_back_.reset(new Conv2dGradOp(ctx));
       return;
@@ -506,6 +564,9 @@ class convolutional_layer : public layer {
   std::shared_ptr<core::OpKernel> kernel_fwd_;
   std::shared_ptr<core::OpKernel> kernel_back_;
 
+  /* Activation applied to the output, see fuse() */
+  std::shared_ptr<activation_layer> activation_;
+
   std::vector<tensor_t *> fwd_in_data_;
   std::vector<tensor_t *> bwd_in_data_;
   std::vector<tensor_t *> bwd_in_grad_;
@@ -308,6 +308,7 @@ class deconvolutional_layer : public layer {
 #endif  // DNN_USE_IMAGE_API
 
   friend struct serialization_buddy;
+  friend class quantized_deconvolutional_layer;
 
  private:
   void init_backend(const core::backend_t backend_type) {
@@ -8,16 +8,33 @@
 #pragma once
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "tiny_dnn/core/kernels/dropout_op_avx.h"
+#include "tiny_dnn/core/kernels/dropout_op_internal.h"
 #include "tiny_dnn/layers/layer.h"
 #include "tiny_dnn/util/util.h"
 
 namespace tiny_dnn {
 
 /**
- * applies dropout to the input
+ * applies dropout to the input.
+ *
+ * in training, each unit is kept with probability 1 - dropout_rate and
+ * scaled by 1 / (1 - dropout_rate), so that the expected output equals the
+ * input; the others are set to zero. out of training, the layer is the
+ * identity.
+ *
+ * the masks are drawn from a philox4x32 stream keyed by a seed of the layer
+ * (taken from the shared generator on construction, so set_random_seed
+ * makes them repeatable). element i of sample s in the n-th training pass
+ * uses word i of the substream (s, n), so the masks do not depend on the
+ * number of threads or the order in which the samples are processed.
+ * the masks of a batch are kept as bits, one row of mask_words() words per
+ * sample, and applied together with the scaling in a single pass.
  **/
 class dropout_layer : public layer {
  public:
@@ -33,9 +50,11 @@ class dropout_layer : public layer {
       phase_(phase),
       dropout_rate_(dropout_rate),
       scale_(float_t(1) / (float_t(1) - dropout_rate_)),
-      in_size_(in_dim) {
-    mask_.resize(1, std::vector<uint8_t>(in_dim));
-    clear_mask();
+      in_size_(in_dim),
+      seed_(random_seed64()),
+      pass_(0),
+      first_sample_(0) {
+    layer::set_backend_type(core::default_engine());
   }
 
   dropout_layer(const dropout_layer &obj) = default;
@@ -76,12 +95,17 @@ class dropout_layer : public layer {
     CNN_UNREFERENCED_PARAMETER(in_data);
     CNN_UNREFERENCED_PARAMETER(out_data);
 
+    // the layer is the identity out of training
+    const bool train = phase_ == net_phase::train &&
+                       mask_.size() >= prev_delta.size() * mask_words();
+
     for_i(prev_delta.size(), [&](size_t sample) {
-      // assert(prev_delta[sample].size() == curr_delta[sample].size());
-      // assert(mask_[sample].size() == prev_delta[sample].size());
-      size_t sz = prev_delta[sample].size();
-      for (size_t i = 0; i < sz; ++i) {
-        prev_delta[sample][i] = mask_[sample][i] * curr_delta[sample][i];
+      const vec_t &curr = curr_delta[sample];
+      vec_t &prev       = prev_delta[sample];
+      if (train) {
+        apply_mask(&curr[0], &mask_[sample * mask_words()], &prev[0]);
+      } else {
+        std::copy(curr.begin(), curr.end(), prev.begin());
       }
     });
   }
@@ -93,26 +117,30 @@ class dropout_layer : public layer {
 
     const size_t sample_count = in.size();
 
-    if (mask_.size() < sample_count) {
-      mask_.resize(sample_count, mask_[0]);
+    if (phase_ != net_phase::train) {
+      for_i(sample_count, [&](size_t sample) {
+        std::copy(in[sample].begin(), in[sample].end(), out[sample].begin());
+      });
+      return;
     }
 
-    for_i(sample_count, [&](size_t sample) {
-      std::vector<uint8_t> &mask = mask_[sample];
-
-      const vec_t &in_vec = in[sample];
-      vec_t &out_vec      = out[sample];
+    mask_.resize(sample_count * mask_words());
+    pass_++;
+    const philox4x32 gen(seed_);
+    const uint32_t threshold = mask_threshold();
+    const bool keep_all      = dropout_rate_ <= float_t{0};
 
-      if (phase_ == net_phase::train) {
-        for (size_t i = 0; i < in_vec.size(); i++)
-          mask[i]     = bernoulli(dropout_rate_);
-
-        for (size_t i = 0; i < in_vec.size(); i++)
-          out_vec[i]  = mask[i] * scale_ * in_vec[i];
+    for_i(sample_count, [&](size_t sample) {
+      uint32_t *mask = &mask_[sample * mask_words()];
+      if (keep_all) {
+        std::fill(mask, mask + mask_words(), 0xffffffffu);
       } else {
-        for (size_t i = 0, end = in_vec.size(); i < end; i++)
-          out_vec[i] = in_vec[i];
+        gen.bernoulli(static_cast<uint32_t>(first_sample_ + sample),
+                      static_cast<uint32_t>(pass_),
+                      static_cast<uint32_t>(pass_ >> 32), 0, threshold, mask,
+                      in_size_);
       }
+      apply_mask(&in[sample][0], mask, &out[sample][0]);
     });
   }
 
@@ -123,17 +151,31 @@ class dropout_layer : public layer {
 
   std::string layer_type() const override { return "dropout"; }
 
-  // currently used by tests only
-  const std::vector<uint8_t> &get_mask(size_t sample_index) const {
-    return mask_[sample_index];
+  bool is_identity_for_inference() const override { return true; }
+
+  void follow_random_stream(const layer &src, size_t first_sample) override {
+    const auto &d = dynamic_cast<const dropout_layer &>(src);
+    seed_         = d.seed_;
+    pass_         = d.pass_;
+    first_sample_ = first_sample;
   }
 
-  void clear_mask() {
-    for (auto &sample : mask_) {
-      std::fill(sample.begin(), sample.end(), 0);
+  ///< number of 32-bit words holding the mask of a sample
+  size_t mask_words() const { return (in_size_ + 31) / 32; }
+
+  // currently used by tests only
+  std::vector<uint8_t> get_mask(size_t sample_index) const {
+    std::vector<uint8_t> mask(in_size_);
+    if (mask_.size() < (sample_index + 1) * mask_words()) return mask;
+    const uint32_t *bits = &mask_[sample_index * mask_words()];
+    for (size_t i = 0; i < in_size_; i++) {
+      mask[i] = (bits[i / 32] >> (i % 32)) & 1;
     }
+    return mask;
   }
 
+  void clear_mask() { std::fill(mask_.begin(), mask_.end(), 0u); }
+
   friend struct serialization_buddy;
 
  private:
@@ -141,7 +183,28 @@ class dropout_layer : public layer {
   float_t dropout_rate_;
   float_t scale_;
   size_t in_size_;
-  std::vector<std::vector<uint8_t>> mask_;
+  std::vector<uint32_t> mask_;  // bits of the last training batch
+  uint64_t seed_;  // key of the mask stream
+  uint64_t pass_;  // number of training passes so far
+  size_t first_sample_;  // substream of sample 0, see follow_random_stream
+
+  void apply_mask(const float_t *in, const uint32_t *mask, float_t *out) {
+    if (layer::engine() == core::backend_t::avx) {
+      kernels::dropout_op_avx(in, mask, scale_, out, in_size_);
+    } else {
+      kernels::dropout_op_internal(in, mask, scale_, out, in_size_);
+    }
+  }
+
+  // mask elements are set (the unit is kept) when their random word is
+  // below this, i.e. with probability 1 - dropout_rate_. a rate of 0 does
+  // not fit and is handled by the caller.
+  uint32_t mask_threshold() const {
+    const double t =
+      std::ldexp(1.0 - static_cast<double>(dropout_rate_), 32);
+    if (t <= 0) return 0;
+    return t < 4294967295.0 ? static_cast<uint32_t>(t) : 0xffffffffu;
+  }
 };
 
 }  // namespace tiny_dnn
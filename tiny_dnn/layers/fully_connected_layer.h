@@ -12,6 +12,8 @@
 #include <utility>
 #include <vector>
 
+#include "tiny_dnn/activations/activation_layer.h"
+#include "tiny_dnn/layers/batch_normalization_layer.h"
 #include "tiny_dnn/layers/layer.h"
 
 #include "tiny_dnn/core/kernels/fully_connected_grad_op.h"
@@ -44,7 +46,8 @@ class fully_connected_layer : public layer {
     : layer(std::move(other)),
       params_(std::move(other.params_)),
       kernel_fwd_(std::move(other.kernel_fwd_)),
-      kernel_back_(std::move(other.kernel_back_)) {
+      kernel_back_(std::move(other.kernel_back_)),
+      activation_(other.activation_) {
     init_backend(std::move(other.engine()));
   }
 
@@ -73,6 +76,7 @@ class fully_connected_layer : public layer {
     fwd_ctx_.set_in_out(in_data, out_data);
     fwd_ctx_.setParallelize(layer::parallelize());
     fwd_ctx_.setEngine(layer::engine());
+    if (activation_) fwd_ctx_.setEpilogue(activation_->epilogue());
 
     // launch fully connected kernel
     kernel_fwd_->compute(fwd_ctx_);
@@ -82,6 +86,9 @@ class fully_connected_layer : public layer {
                         const std::vector<tensor_t *> &out_data,
                         std::vector<tensor_t *> &out_grad,
                         std::vector<tensor_t *> &in_grad) override {
+    if (activation_) {
+      throw nn_error("fully-connected with fused activation is inference-only");
+    }
     // backward fully connected op context
     bwd_ctx_.set_in_out(in_data, out_data, out_grad, in_grad);
     bwd_ctx_.setParallelize(layer::parallelize());
@@ -93,7 +100,44 @@ class fully_connected_layer : public layer {
 
   std::string layer_type() const override { return "fully-connected"; }
 
+  /**
+   * fold a following batch normalization into weights and bias, or apply a
+   * following activation to the output right after the product
+   **/
+  bool fuse(const std::shared_ptr<layer> &next) override {
+    if (activation_) return false;
+    if (auto act = std::dynamic_pointer_cast<activation_layer>(next)) {
+      activation_ = act;
+      return true;
+    }
+
+    auto bn = dynamic_cast<batch_normalization_layer *>(next.get());
+    if (!bn || !params_.has_bias_ || bn->in_data_size() != params_.out_size_) {
+      return false;
+    }
+    vec_t scale, shift;
+    bn->affine_transform(scale, shift);
+
+    setup(false);
+    vec_t &W             = *weights()[0];
+    vec_t &b             = *weights()[1];
+    const size_t spatial = params_.out_size_ / scale.size();
+    for (size_t i = 0; i < params_.out_size_; i++) {
+      const size_t c = i / spatial;
+      for (size_t j = 0; j < params_.in_size_; j++) {
+        W[j * params_.out_size_ + i] *= scale[c];
+      }
+      b[i] = b[i] * scale[c] + shift[c];
+    }
+    return true;
+  }
+
+  const layer *fused_activation() const override {
+    return activation_.get();
+  }
+
   friend struct serialization_buddy;
+  friend class quantized_fully_connected_layer;
 
  protected:
   void set_params(const size_t in_size, const size_t out_size, bool has_bias) {
@@ -129,6 +173,9 @@ class fully_connected_layer : public layer {
   /* Forward and backward ops */
   std::shared_ptr<core::OpKernel> kernel_fwd_;
   std::shared_ptr<core::OpKernel> kernel_back_;
+
+  /* Activation applied to the output, see fuse() */
+  std::shared_ptr<activation_layer> activation_;
 };
 
 }  // namespace tiny_dnn
@@ -15,6 +15,7 @@
 #include <queue>
 #include <sstream>
 #include <string>
+#include <typeinfo>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -65,6 +66,8 @@ class layer : public node {
     : node(in_type.size(), out_type.size()),
       initialized_(false),
       parallelize_(true),
+      grad_accumulation_(grad_accumulation::per_sample),
+      inference_only_(false),
       in_channels_(in_type.size()),
       out_channels_(out_type.size()),
       in_type_(in_type),
@@ -166,6 +169,10 @@ class layer : public node {
     return v;
   }
 
+  /**
+   * mutable access to the trainable weights. the caller is assumed to modify
+   * them, so the weights count as changed (see weights_changed()).
+   **/
   std::vector<vec_t *> weights() {
     std::vector<vec_t *> v;
     for (size_t i = 0; i < in_channels_; i++) {
@@ -173,9 +180,53 @@ class layer : public node {
         v.push_back(get_weight_data(i));
       }
     }
+    weights_changed();
     return v;
   }
 
+  /**
+   * stamp of the current values of the trainable weights, renewed by
+   * weights_changed(). kernels keeping values derived from the weights
+   * (e.g. transformed or quantized filters) compare stamps instead of the
+   * weights themselves.
+   **/
+  uint64_t weights_version() const {
+    uint64_t version = 0;
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (is_trainable_weight(in_type_[i]) && prev_[i]) {
+        version = std::max(version, prev_[i]->version());
+      }
+    }
+    return version;
+  }
+
+  /**
+   * weights_version() if the trainable weights among in_data, the inputs of
+   * forward_propagation, are those of this layer, otherwise 0: the stamp of
+   * weights passed in by the caller is unknown.
+   **/
+  uint64_t weights_version(const std::vector<tensor_t *> &in_data) const {
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (is_trainable_weight(in_type_[i]) &&
+          (!prev_[i] || i >= in_data.size() ||
+           in_data[i] != prev_[i]->get_data())) {
+        return 0;
+      }
+    }
+    return weights_version();
+  }
+
+  /**
+   * note that the trainable weights were modified, e.g. through pointers
+   * obtained from weights() earlier. initialization, loading and the
+   * optimizer call it themselves.
+   **/
+  void weights_changed() {
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (is_trainable_weight(in_type_[i]) && prev_[i]) prev_[i]->touch();
+    }
+  }
+
   std::vector<tensor_t *> weights_grads() {
     std::vector<tensor_t *> v;
     for (size_t i = 0; i < in_channels_; i++) {
@@ -215,10 +266,21 @@ class layer : public node {
     size_t n = 0;
     for (size_t i = 0; i < out_channels_; i++) {
       if (out_type_[i] != vector_type::data) continue;
-      tensor_t &dst_grad = *ith_out_node(i)->get_gradient();
+      edgeptr_t e = ith_out_node(i);
       assert(n < cnt);
       const auto &src_grad = grad[n++];
       size_t sz            = src_grad.size();
+
+      if (e->storage() == edge_storage::contiguous) {
+        batch_view<float_t> dst_grad = e->reset_batch_gradient(sz);
+        for (size_t j = 0; j < sz; ++j) {
+          assert(dst_grad.sample_size() == src_grad[j]->size());
+          std::copy(src_grad[j]->begin(), src_grad[j]->end(), dst_grad[j]);
+        }
+        continue;
+      }
+
+      tensor_t &dst_grad = *e->get_gradient();
       dst_grad.resize(sz);
       for (size_t j = 0; j < sz; ++j) {
         assert(dst_grad[j].size() == src_grad[j]->size());
@@ -232,15 +294,27 @@ class layer : public node {
     size_t n = 0;
     for (size_t i = 0; i < in_channels_; i++) {
       if (in_type_[i] != vector_type::data) continue;
-      tensor_t &dst_data = *ith_in_node(i)->get_data();
-      size_t in_size     = ith_in_node(i)->shape().size();
+      edgeptr_t e    = ith_in_node(i);
+      size_t in_size = e->shape().size();
       assert(n < cnt);
       const auto &src_data = data[n++];
       size_t sz            = src_data.size();
-      dst_data.resize(sz);
 
       CNN_UNREFERENCED_PARAMETER(in_size);
 
+      if (e->storage() == edge_storage::contiguous) {
+        // one copy per sample into a single buffer, no per-sample allocation
+        batch_view<float_t> dst_data = e->reset_batch_data(sz);
+        for (size_t j = 0; j < sz; ++j) {
+          assert(src_data[j]->size() == in_size);
+          std::copy(src_data[j]->begin(), src_data[j]->end(), dst_data[j]);
+        }
+        continue;
+      }
+
+      tensor_t &dst_data = *e->get_data();
+      dst_data.resize(sz);
+
       for (size_t j = 0; j < sz; ++j) {
         assert(
           src_data[j]->size() ==
@@ -250,6 +324,46 @@ class layer : public node {
     }
   }
 
+  /**
+   * select how the data edges connected to this layer store their samples
+   * (weight and bias edges always hold a single vector)
+   **/
+  void set_edge_storage(edge_storage storage) {
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (in_type_[i] == vector_type::data) {
+        ith_in_node(i)->set_storage(storage);
+      }
+    }
+    for (size_t i = 0; i < out_channels_; i++) {
+      if (out_type_[i] == vector_type::data) {
+        ith_out_node(i)->set_storage(storage);
+      }
+    }
+  }
+
+  /**
+   * select how the gradients of trainable weights are accumulated over a
+   * batch. with grad_accumulation::per_thread the gradient tensors of the
+   * weights hold one partial sum per thread instead of one row per sample.
+   * kernels accumulate sample i into row partial_index(i, samples, rows).
+   **/
+  void set_grad_accumulation(grad_accumulation mode) {
+    grad_accumulation_ = mode;
+  }
+
+  grad_accumulation get_grad_accumulation() const { return grad_accumulation_; }
+
+  /**
+   * skip everything forward() prepares only for a following backward(),
+   * i.e. sizing and clearing the gradients of the data edges. backward()
+   * must not be called while this is set.
+   **/
+  void set_inference_only(bool inference_only) {
+    inference_only_ = inference_only;
+  }
+
+  bool inference_only() const { return inference_only_; }
+
   void output(std::vector<const tensor_t *> &out) const {
     out.clear();
     for (size_t i = 0; i < out_channels_; i++) {
@@ -277,6 +391,37 @@ class layer : public node {
     return {float_t{0.0}, float_t{1.0}};
   }
 
+  /**
+   * absorb next, the only consumer of the output of this layer, into this
+   * layer for inference (see nodes::fuse_layers). a layer keeping next,
+   * e.g. an activation, shares its ownership, so next must be owned by a
+   * shared_ptr in that case
+   * @return false if next cannot be fused into this layer
+   **/
+  virtual bool fuse(const std::shared_ptr<layer> &next) {
+    CNN_UNREFERENCED_PARAMETER(next);
+    return false;
+  }
+
+  ///< activation applied to the output of this layer by fuse(), if any
+  virtual const layer *fused_activation() const { return nullptr; }
+
+  /**
+   * true if the output of this layer equals its input for inference, e.g.
+   * dropout, so that nodes::fuse_layers can remove it
+   **/
+  virtual bool is_identity_for_inference() const { return false; }
+
+  /**
+   * draw the random numbers of the next training pass as src, the layer
+   * this one replicates, does for samples first_sample, first_sample + 1,
+   * ... of its batch (see network::set_data_parallelism)
+   **/
+  virtual void follow_random_stream(const layer &src, size_t first_sample) {
+    CNN_UNREFERENCED_PARAMETER(src);
+    CNN_UNREFERENCED_PARAMETER(first_sample);
+  }
+
   /**
    * array of input shapes (width x height x depth)
    **/
@@ -393,6 +538,25 @@ class layer : public node {
     initialized_ = true;
   }
 
+  /**
+   * let the i-th vector of weights() hold the values at data[i] instead of
+   * a copy of them, e.g. a model file mapped into memory (see mapped_file).
+   * the memory must stay valid as long as the layer uses it.
+   **/
+  void set_external_weights(const std::vector<float_t *> &data) {
+    auto all_weights = weights();
+    if (data.size() != all_weights.size()) {
+      throw nn_error("weight count mismatch in " + layer_type());
+    }
+    for (size_t i = 0; i < data.size(); i++) {
+      const size_t size = all_weights[i]->size();
+      vec_t w(aligned_allocator<float_t, 64>(data[i], size));
+      w.resize(size);  // leaves the values at data[i] as they are
+      *all_weights[i] = std::move(w);
+    }
+    initialized_ = true;
+  }
+
 /////////////////////////////////////////////////////////////////////////
 // visualize
 
@@ -547,7 +711,7 @@ class layer : public node {
     // values.
     for (size_t i = 0; i < out_channels_; i++) {
       fwd_out_data_[i] = ith_out_node(i)->get_data();
-      ith_out_node(i)->clear_grads();
+      if (!inference_only_) ith_out_node(i)->clear_grads();
     }
 
     // call the forward computation kernel/routine
@@ -564,7 +728,14 @@ class layer : public node {
     for (size_t i = 0; i < in_channels_; i++) {
       const auto &nd  = ith_in_node(i);
       bwd_in_data_[i] = nd->get_data();
-      bwd_in_grad_[i] = nd->get_gradient();
+    }
+
+    // the gradients of the weights are sized here rather than in forward(),
+    // which therefore never writes to the weight edges
+    resize_weight_gradients(bwd_in_data_[0]->size());
+
+    for (size_t i = 0; i < in_channels_; i++) {
+      bwd_in_grad_[i] = ith_in_node(i)->get_gradient();
     }
     for (size_t i = 0; i < out_channels_; i++) {
       const auto &nd   = ith_out_node(i);
@@ -651,6 +822,7 @@ class layer : public node {
     }
     // in case we succeed with data initialization, we mark the
     // layer/node as initialized.
+    weights_changed();
     initialized_ = true;
   }
 
@@ -660,22 +832,37 @@ class layer : public node {
     }
   }
 
-  void update_weight(optimizer *o) {
-    auto &diff = weights_diff_;
+  /**
+   * merge the gradients of the trainable weights and append them to dW, and
+   * the weights to W. call finish_weight_update() once the optimizer has
+   * updated them.
+   **/
+  void collect_weight_updates(std::vector<const vec_t *> *dW,
+                              std::vector<vec_t *> *W) {
+    weights_diff_.resize(in_type_.size());
     for (size_t i = 0; i < in_type_.size(); i++) {
       if (trainable() && is_trainable_weight(in_type_[i])) {
-        vec_t &target = *get_weight_data(i);
-        ith_in_node(i)->merge_grads(&diff);
-        // parallelize only when target size is big enough to mitigate
-        // thread spawning overhead.
-        bool parallelize = (target.size() >= 512);
-        o->update(diff, target, parallelize);
+        ith_in_node(i)->merge_grads(&weights_diff_[i]);
+        dW->push_back(&weights_diff_[i]);
+        W->push_back(get_weight_data(i));
       }
     }
+  }
+
+  void finish_weight_update() {
     clear_grads();
+    weights_changed();
     post_update();
   }
 
+  void update_weight(optimizer *o) {
+    std::vector<const vec_t *> dW;
+    std::vector<vec_t *> W;
+    collect_weight_updates(&dW, &W);
+    o->step(dW, W);
+    finish_weight_update();
+  }
+
   bool has_same_weights(const layer &rhs, float_t eps) const {
     auto w1 = weights();
     auto w2 = rhs.weights();
@@ -691,24 +878,58 @@ class layer : public node {
     return true;
   }
 
-  virtual void set_sample_count(size_t sample_count) {
-    // increase the size if necessary - but do not decrease
-    auto resize = [sample_count](tensor_t *tensor) {
-      tensor->resize(sample_count, (*tensor)[0]);
-    };
+  /**
+   * use the weights of src instead of an own copy.
+   *
+   * src must be a layer of the same type and configuration. afterwards both
+   * layers read (and train) the same weight vectors, while activations and
+   * scratch buffers stay separate, so the two layers can run forward
+   * concurrently as long as nobody modifies the weights meanwhile.
+   **/
+  virtual void share_weights(layer &src) {
+    if (typeid(*this) != typeid(src) || in_type_ != src.in_type_) {
+      throw nn_error("cannot share weights between different layers: " +
+                     layer_type() + " and " + src.layer_type());
+    }
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (!is_trainable_weight(in_type_[i])) continue;
+      if (in_shape()[i] != src.in_shape()[i]) {
+        throw nn_error("weight shape mismatch in " + layer_type());
+      }
+    }
+    src.setup(false);
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (is_trainable_weight(in_type_[i])) prev_[i] = src.ith_in_node(i);
+    }
+    initialized_ = true;
+  }
 
+  virtual void set_sample_count(size_t sample_count) {
+    // the gradients of the weights are resized by backward()
     for (size_t i = 0; i < in_channels_; i++) {
       if (!is_trainable_weight(in_type_[i])) {
-        resize(ith_in_node(i)->get_data());
+        ith_in_node(i)->resize_data(sample_count);
+        if (!inference_only_) ith_in_node(i)->resize_gradient(sample_count);
       }
-      resize(ith_in_node(i)->get_gradient());
     }
 
     for (size_t i = 0; i < out_channels_; i++) {
       if (!is_trainable_weight(out_type_[i])) {
-        resize(ith_out_node(i)->get_data());
+        ith_out_node(i)->resize_data(sample_count);
+      }
+      if (!inference_only_) ith_out_node(i)->resize_gradient(sample_count);
+    }
+  }
+
+  void resize_weight_gradients(size_t sample_count) {
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (!is_trainable_weight(in_type_[i])) continue;
+      if (grad_accumulation_ == grad_accumulation::per_thread) {
+        ith_in_node(i)->resize_gradient(
+          sample_count, std::min(sample_count, parallel_concurrency()));
+      } else {
+        ith_in_node(i)->resize_gradient(sample_count);
       }
-      resize(ith_out_node(i)->get_gradient());
     }
   }
 
@@ -721,6 +942,23 @@ class layer : public node {
   template <typename OutputArchive>
   static void save_layer(OutputArchive &oa, const layer &l);
 
+  /**
+   * version of the layer records written to binary archives, stored with the
+   * number of layers of a model. archives written before records had a
+   * version hold 0.
+   *   1: quantized layers hold their quantization parameters
+   *   2: convolutional and fully-connected layers hold their fused activation
+   **/
+  static uint32_t archive_version() { return 2; }
+
+  /**
+   * archive_version() of the binary model being loaded on this thread
+   **/
+  static uint32_t &loading_archive_version() {
+    static thread_local uint32_t version = archive_version();
+    return version;
+  }
+
   template <class Archive>
   void serialize_prolog(Archive &ar);
 
@@ -729,6 +967,10 @@ class layer : public node {
   bool initialized_;
   /** Flag indicating whether the layer/node operations ara paralellized */
   bool parallelize_;
+  /** How the gradients of trainable weights are accumulated over a batch */
+  grad_accumulation grad_accumulation_;
+  /** Flag indicating whether backward() is skipped, see set_inference_only */
+  bool inference_only_;
   /** The number of input vectors/edges */
   size_t in_channels_;
   /** The number of output vectors/edges */
@@ -743,10 +985,10 @@ class layer : public node {
   std::shared_ptr<core::backend> backend_;
   /** Pointer to the device on which the layer/node will run */
   Device *device_ptr_ = nullptr;
-  /** Used in update_weight method. Kept as a member variable to reduce
-   * frequent
-   * memory allocation */
-  vec_t weights_diff_;
+  /** Merged gradients of the weights, one per input. Kept as a member
+   * variable to reduce frequent memory allocation, and to outlive
+   * collect_weight_updates */
+  std::vector<vec_t> weights_diff_;
 
   template <typename T, typename Func>
   inline void for_i(T size, Func f, size_t grainsize = 100) {
@@ -754,6 +996,7 @@ class layer : public node {
   }
 
   friend struct serialization_buddy;
+  friend void substitute(layer *from, layer *to);
 
  private:
   /** Flag indicating whether the layer/node parameters are trainable */
@@ -883,6 +1126,45 @@ inline void connect(layer *head,
   tail->prev_[tail_index]->add_next_node(tail);
 }
 
+/**
+ * remove tail, whose only input is the first output of head, from the
+ * computational graph: head writes into the output edge of tail instead
+ **/
+inline void bypass(layer *head, layer *tail) {
+  if (tail->prev_.size() != 1 || tail->next_.size() != 1 ||
+      tail->prev_[0] != head->next_[0] || !tail->next_[0]) {
+    throw nn_error("cannot bypass " + tail->layer_type());
+  }
+  head->next_[0] = tail->next_[0];
+  head->next_[0]->set_prev_node(head);
+  tail->prev_[0].reset();
+  tail->next_[0].reset();
+}
+
+/**
+ * put to in place of from in the computational graph: to takes over all
+ * input and output edges of from, including its weights and biases
+ **/
+inline void substitute(layer *from, layer *to) {
+  if (from->in_type_ != to->in_type_ || from->out_type_ != to->out_type_ ||
+      from->in_shape() != to->in_shape() ||
+      from->out_shape() != to->out_shape()) {
+    throw nn_error("cannot substitute " + to->layer_type() + " for " +
+                   from->layer_type());
+  }
+  for (size_t i = 0; i < from->prev_.size(); i++) {
+    to->prev_[i] = from->prev_[i];
+    if (to->prev_[i]) to->prev_[i]->replace_next_node(from, to);
+    from->prev_[i].reset();
+  }
+  for (size_t i = 0; i < from->next_.size(); i++) {
+    to->next_[i] = from->next_[i];
+    if (to->next_[i]) to->next_[i]->set_prev_node(to);
+    from->next_[i].reset();
+  }
+  to->initialized_ = from->initialized_;
+}
+
 inline layer &operator<<(layer &lhs, layer &rhs) {
   connect(&lhs, &rhs);
   return rhs;
@@ -18,6 +18,7 @@
 #include "tiny_dnn/core/backend_avx.h"
 #endif
 
+#include "tiny_dnn/layers/convolutional_layer.h"
 #include "tiny_dnn/util/util.h"
 
 #ifdef DNN_USE_IMAGE_API
@@ -209,11 +210,24 @@ class quantized_convolutional_layer : public layer {
     init_backend(backend_type);
   }
 
+  /**
+   * quantized counterpart of src, with the same configuration but weights
+   * of its own
+   **/
+  explicit quantized_convolutional_layer(const convolutional_layer &src)
+    : layer(std_input_order(src.params_.has_bias), {vector_type::data}) {
+    const core::conv_params &p = src.params_;
+    conv_set_params(p.in, p.weight.width_, p.weight.height_, p.out.depth_,
+                    p.pad_type, p.has_bias, p.w_stride, p.h_stride, p.tbl);
+    init_backend(core::backend_t::internal);
+  }
+
   // move constructor
   quantized_convolutional_layer(
     quantized_convolutional_layer &&other)  // NOLINT
     : layer(std::move(other)),
       params_(std::move(other.params_)),
+      qparams_(other.qparams_),
       cws_(std::move(other.cws_)) {
     init_backend(core::backend_t::internal);
   }
@@ -236,7 +250,7 @@ class quantized_convolutional_layer : public layer {
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     // launch convolutional kernel
-    if (in_data.size() == 3) {
+    if (in_data.size() == 2 || in_data.size() == 3) {
       layer::backend_->conv2d_q(in_data, out_data);
 
     } else if (in_data.size() == 6) {
@@ -278,6 +292,14 @@ class quantized_convolutional_layer : public layer {
 
   std::string layer_type() const override { return "q_conv"; }
 
+  /**
+   * use the activation ranges and weight scales found by calibration
+   * (see post_training_quantizer) instead of measuring them on every call
+   **/
+  void set_quantization(const core::quantization_params &q) { qparams_ = q; }
+
+  const core::quantization_params &quantization() const { return qparams_; }
+
 #ifdef DNN_USE_IMAGE_API
   image<> weight_to_image() const {
     image<> img;
@@ -407,8 +429,9 @@ class quantized_convolutional_layer : public layer {
     cws.prev_out_padded_.resize(sample_count);
 
     if (params_.pad_type == padding::same) {
-      cws.prev_out_buf_.resize(sample_count, cws.prev_out_buf_[0]);
-      cws.prev_delta_padded_.resize(sample_count, cws.prev_delta_padded_[0]);
+      const vec_t zeros(params_.in_padded.size(), float_t{0});
+      cws.prev_out_buf_.resize(sample_count, zeros);
+      cws.prev_delta_padded_.resize(sample_count, zeros);
     }
 
     for (size_t sample = 0; sample < sample_count; ++sample) {
@@ -466,12 +489,14 @@ class quantized_convolutional_layer : public layer {
 
     // allocate new backend
     if (backend_type == core::backend_t::internal) {
-      backend = std::make_shared<core::tiny_backend>(
+      auto tiny = std::make_shared<core::tiny_backend>(
         &params_, [this](const tensor_t &in) { return copy_and_pad_input(in); },
         [this](const tensor_t &delta, tensor_t &dst) {
           return copy_and_unpad_delta(delta, dst);
         },
         &cws_);
+      tiny->set_quantization_params(&qparams_);
+      backend = tiny;
     } else {
       throw nn_error("Not supported backend type.");
     }
@@ -487,6 +512,9 @@ class quantized_convolutional_layer : public layer {
   /* The convolution parameters */
   core::conv_params params_;
 
+  /* Calibrated ranges and weight scales */
+  core::quantization_params qparams_;
+
   /* The type of backend */
   // backend_t backend_type_;
 
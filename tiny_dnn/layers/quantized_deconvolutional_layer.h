@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "tiny_dnn/core/backend_tiny.h"
+#include "tiny_dnn/layers/deconvolutional_layer.h"
 #ifdef CNN_USE_AVX
 #include "tiny_dnn/core/backend_avx.h"
 #endif
@@ -210,10 +211,23 @@ class quantized_deconvolutional_layer : public layer {
     init_backend(backend_type);
   }
 
+  /**
+   * quantized counterpart of src, with the same configuration but weights
+   * of its own
+   **/
+  explicit quantized_deconvolutional_layer(const deconvolutional_layer &src)
+    : layer(std_input_order(src.params_.has_bias), {vector_type::data}) {
+    const core::deconv_params &p = src.params_;
+    deconv_set_params(p.in, p.weight.width_, p.weight.height_, p.out.depth_,
+                      p.pad_type, p.has_bias, p.w_stride, p.h_stride, p.tbl);
+    init_backend(core::backend_t::internal);
+  }
+
   // move constructor
   quantized_deconvolutional_layer(quantized_deconvolutional_layer &&other)
     : layer(std::move(other)),
       params_(std::move(other.params_)),
+      qparams_(other.qparams_),
       backend_type_(std::move(other.backend_type_)),
       deconv_layer_worker_storage_(
         std::move(other.deconv_layer_worker_storage_)) {
@@ -234,7 +248,7 @@ class quantized_deconvolutional_layer : public layer {
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     // launch deconvolutional kernel
-    if (in_data.size() == 3) {
+    if (in_data.size() == 2 || in_data.size() == 3) {
       layer::backend_->deconv2d_q(in_data, out_data);
 
     } else if (in_data.size() == 6) {
@@ -276,6 +290,14 @@ class quantized_deconvolutional_layer : public layer {
 
   std::string layer_type() const override { return "q_deconv"; }
 
+  /**
+   * use the activation ranges and weight scales found by calibration
+   * (see post_training_quantizer) instead of measuring them on every call
+   **/
+  void set_quantization(const core::quantization_params &q) { qparams_ = q; }
+
+  const core::quantization_params &quantization() const { return qparams_; }
+
 #ifdef DNN_USE_IMAGE_API
   image<> weightto_image() const {
     image<> img;
@@ -323,13 +345,15 @@ class quantized_deconvolutional_layer : public layer {
 
     // allocate new backend
     if (backend_type == core::backend_t::internal) {
-      backend = std::make_shared<core::tiny_backend>(
+      auto tiny = std::make_shared<core::tiny_backend>(
         &params_,
         [this](const tensor_t &in) { return copy_and_unpad_output(in); },
         [this](const tensor_t &delta, tensor_t &dst) {
           return copy_and_pad_delta(delta, dst);
         },
         &deconv_layer_worker_storage_);
+      tiny->set_quantization_params(&qparams_);
+      backend = tiny;
     } else {
       throw nn_error("Not supported backend type.");
     }
@@ -487,6 +511,9 @@ class quantized_deconvolutional_layer : public layer {
   /* The convolution parameters */
   core::deconv_params params_;
 
+  /* Calibrated ranges and weight scales */
+  core::quantization_params qparams_;
+
   /* The type of backend */
   core::backend_t backend_type_;
 
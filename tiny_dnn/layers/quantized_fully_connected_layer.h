@@ -12,6 +12,7 @@
 #include <utility>
 #include <vector>
 
+#include "tiny_dnn/layers/fully_connected_layer.h"
 #include "tiny_dnn/layers/layer.h"
 #include "tiny_dnn/util/product.h"
 
@@ -37,9 +38,22 @@ class quantized_fully_connected_layer : public layer {
     init_backend(backend_type);
   }
 
+  /**
+   * quantized counterpart of src, with the same configuration but weights
+   * of its own
+   **/
+  explicit quantized_fully_connected_layer(const fully_connected_layer &src)
+    : layer(std_input_order(src.params_.has_bias_), {vector_type::data}) {
+    set_params(src.params_.in_size_, src.params_.out_size_,
+               src.params_.has_bias_);
+    init_backend(core::backend_t::internal);
+  }
+
   // move constructor
   quantized_fully_connected_layer(quantized_fully_connected_layer &&other)
-    : layer(std::move(other)), params_(std::move(other.params_)) {
+    : layer(std::move(other)),
+      params_(std::move(other.params_)),
+      qparams_(other.qparams_) {
     init_backend(core::backend_t::internal);
   }
 
@@ -81,10 +95,19 @@ class quantized_fully_connected_layer : public layer {
 
   std::string layer_type() const override { return "q_fully-connected"; }
 
+  /**
+   * use the activation ranges and weight scales found by calibration
+   * (see post_training_quantizer) instead of measuring them on every call
+   **/
+  void set_quantization(const core::quantization_params &q) { qparams_ = q; }
+
+  const core::quantization_params &quantization() const { return qparams_; }
+
   friend struct serialization_buddy;
 
  protected:
   core::fully_params params_;
+  core::quantization_params qparams_;
 
   void set_params(const size_t in_size, const size_t out_size, bool has_bias) {
     params_.in_size_  = in_size;
@@ -97,7 +120,9 @@ class quantized_fully_connected_layer : public layer {
 
     // allocate new backend
     if (backend_type == core::backend_t::internal) {
-      backend = std::make_shared<core::tiny_backend>(&params_);
+      auto tiny = std::make_shared<core::tiny_backend>(&params_);
+      tiny->set_quantization_params(&qparams_);
+      backend = tiny;
     } else {
       throw nn_error("Not supported backend type.");
     }
@@ -139,20 +139,37 @@ class slice_layer : public layer {
     }
   }
 
+  /**
+   * the outputs are views of their channels of the input where possible
+   * (see edge::make_view_of), so that the consumers read the input and
+   * write its gradient in place. the outputs which cannot be views, e.g.
+   * because other layers consume the input too, are copied.
+   **/
   void slice_channels_forward(const tensor_t &in_data,
                               std::vector<tensor_t *> &out_data) {
     size_t channel_idx       = 0;
     const size_t num_samples = in_data.size();
     const size_t spatial_dim = in_shape_.area();
+    edge &in                 = *prev()[0];
+    const bool views         = !inference_only() && in.next().size() <= 1;
 
     for (size_t i = 0; i < num_outputs_; i++) {
-      for (size_t s = 0; s < num_samples; s++) {
-        float_t *out      = &(*out_data[i])[s][0];
-        const float_t *in = &in_data[s][0] + channel_idx * spatial_dim;
+      edge &out           = *next()[i];
+      const size_t offset = channel_idx * spatial_dim;
+      const size_t dim    = slice_size_[i] * spatial_dim;
+      channel_idx += slice_size_[i];
+      if (out.is_view_of(in, offset)) continue;
+      if (views && out.make_view_of(in, offset)) {
+        // the consumers expect a cleared gradient
+        out.clear_grads();
+        continue;
+      }
 
-        std::copy(in, in + slice_size_[i] * spatial_dim, out);
+      for (size_t s = 0; s < num_samples; s++) {
+        float_t *outs      = &(*out_data[i])[s][0];
+        const float_t *ins = &in_data[s][0] + offset;
+        if (ins != outs) std::copy(ins, ins + dim, outs);
       }
-      channel_idx += slice_size_[i];
     }
   }
 
@@ -161,15 +178,19 @@ class slice_layer : public layer {
     size_t channel_idx       = 0;
     const size_t num_samples = in_grad.size();
     const size_t spatial_dim = in_shape_.area();
+    const edge &in           = *prev()[0];
 
     for (size_t i = 0; i < num_outputs_; i++) {
-      for (size_t s = 0; s < num_samples; s++) {
-        const float_t *out = &(*out_grad[i])[s][0];
-        float_t *in        = &in_grad[s][0] + channel_idx * spatial_dim;
+      const size_t offset = channel_idx * spatial_dim;
+      const size_t dim    = slice_size_[i] * spatial_dim;
+      channel_idx += slice_size_[i];
+      if (next()[i]->is_view_of(in, offset)) continue;
 
-        std::copy(out, out + slice_size_[i] * spatial_dim, in);
+      for (size_t s = 0; s < num_samples; s++) {
+        const float_t *outs = &(*out_grad[i])[s][0];
+        float_t *ins        = &in_grad[s][0] + offset;
+        if (ins != outs) std::copy(outs, outs + dim, ins);
       }
-      channel_idx += slice_size_[i];
     }
   }
 
@@ -23,6 +23,9 @@
 #include <utility>
 #include <vector>
 
+#include "tiny_dnn/io/data_pipeline.h"
+#include "tiny_dnn/io/dataset.h"
+#include "tiny_dnn/io/model_file.h"
 #include "tiny_dnn/lossfunctions/loss_function.h"
 #include "tiny_dnn/nodes.h"
 #include "tiny_dnn/util/util.h"
@@ -35,7 +38,11 @@ enum class content_type {
   weights_and_model  ///< save/load both the weights and the architecture
 };
 
-enum class file_format { binary, json };
+enum class file_format {
+  binary,
+  json,
+  mapped  ///< model file whose weights are mapped on load, see model_file.h
+};
 
 struct result {
   result() : num_success(0), num_total(0) {}
@@ -204,6 +211,48 @@ class network {
     return predict(vec_t(begin(in), end(in)));
   }
 
+  /**
+   * executes forward-propagation of in[0] ... in[count - 1] in batches of
+   * batch_size samples, and calls f(first, out) for each batch.
+   *
+   * out holds the (first channel's) outputs of samples
+   * first ... first + out.size() - 1 and is only valid during the call.
+   * the samples of a batch are processed in parallel, and no more than one
+   * batch of activations is kept in memory.
+   *
+   *     auto f = [&](size_t first, const tensor_t &y) {
+   *       for (size_t i = 0; i < y.size(); i++) use(first + i, y[i]);
+   *     };
+   *     net.predict_batch(&x[0], x.size(), f);
+   **/
+  template <typename Func>
+  void predict_batch(const vec_t *in,
+                     size_t count,
+                     Func f,
+                     size_t batch_size = CNN_PREDICT_BATCH_SIZE) {
+    predict_batch_impl(
+      in, count, batch_size,
+      [&](size_t first, const std::vector<const tensor_t *> &out) {
+        f(first, *out[0]);
+      });
+  }
+
+  /**
+   * executes forward-propagation of a set of samples, batch_size samples at
+   * a time, and returns the outputs
+   **/
+  std::vector<vec_t> predict_batch(const std::vector<vec_t> &in,
+                                   size_t batch_size = CNN_PREDICT_BATCH_SIZE) {
+    std::vector<vec_t> out(in.size());
+    if (in.empty()) return out;
+    predict_batch(&in[0], in.size(),
+                  [&](size_t first, const tensor_t &y) {
+                    std::copy(y.begin(), y.end(), out.begin() + first);
+                  },
+                  batch_size);
+    return out;
+  }
+
   /**
    * trains the network for a fixed number of epochs (for classification task)
    *
@@ -383,6 +432,136 @@ class network {
     return fit<Error>(optimizer, in, t, batch_size, epoch, nop, nop);
   }
 
+  /**
+   * trains the network for a fixed number of epochs on the samples of a
+   * dataset (for classification task). every epoch visits the samples in a
+   * new random order, and only the samples of the current mini-batch are
+   * decoded, by a background thread while the previous one is trained on
+   * (see data_pipeline).
+   *
+   * @param optimizer          optimizing algorithm for training
+   * @param samples            labeled samples (label-id is 0-origin)
+   * @param batch_size         number of samples per parameter update
+   * @param epoch              number of training epochs
+   * @param on_batch_enumerate callback for each mini-batch enumerate
+   * @param on_epoch_enumerate callback for each epoch
+   * @param reset_weights      set true if reset current network weights
+   * @param n_threads          number of tasks
+   **/
+  template <typename Error,
+            typename Optimizer,
+            typename OnBatchEnumerate,
+            typename OnEpochEnumerate>
+  bool train(Optimizer &optimizer,
+             const dataset &samples,
+             size_t batch_size,
+             int epoch,
+             OnBatchEnumerate on_batch_enumerate,
+             OnEpochEnumerate on_epoch_enumerate,
+             const bool reset_weights = false,
+             const int n_threads      = CNN_TASK_SIZE) {
+    if (batch_size == 0 || samples.size() < batch_size) {
+      return false;
+    }
+    data_pipeline batches(samples, batch_size);
+    return train<Error>(optimizer, batches, epoch, on_batch_enumerate,
+                        on_epoch_enumerate, reset_weights, n_threads);
+  }
+
+  /**
+   * trains the network for a fixed number of epochs on the mini-batches of
+   * a data_pipeline (for classification task), which decodes and augments
+   * the next mini-batches while the current one is trained on.
+   *
+   * @param optimizer          optimizing algorithm for training
+   * @param batches            labeled mini-batches (label-id is 0-origin)
+   * @param epoch              number of training epochs
+   * @param on_batch_enumerate callback for each mini-batch enumerate
+   * @param on_epoch_enumerate callback for each epoch
+   * @param reset_weights      set true if reset current network weights
+   * @param n_threads          number of tasks
+   **/
+  template <typename Error,
+            typename Optimizer,
+            typename OnBatchEnumerate,
+            typename OnEpochEnumerate>
+  bool train(Optimizer &optimizer,
+             data_pipeline &batches,
+             int epoch,
+             OnBatchEnumerate on_batch_enumerate,
+             OnEpochEnumerate on_epoch_enumerate,
+             const bool reset_weights = false,
+             const int n_threads      = CNN_TASK_SIZE) {
+    const size_t batch_size = batches.batch_size();
+    if (batches.size() < batch_size) {
+      return false;
+    }
+    const bool memory_planning = net_.memory_planning();
+    net_.set_memory_planning(false);
+    set_netphase(net_phase::train);
+    net_.setup(reset_weights);
+
+    for (auto n : net_) n->set_parallelize(true);
+    optimizer.reset();
+    stop_training_ = false;
+    in_batch_.resize(batch_size);
+    t_batch_.resize(batch_size);
+
+    const size_t out_dim = out_data_size();
+    std::vector<tensor_t> targets(batch_size, tensor_t(1, vec_t(out_dim)));
+    for (int iter = 0; iter < epoch && !stop_training_; iter++) {
+      batches.start_epoch();
+      const sample_batch *b;
+      while (!stop_training_ && (b = batches.next()) != nullptr) {
+        const size_t n = b->inputs.size();
+        for (size_t i = 0; i < n; i++) {
+          if (b->inputs[i][0].size() != in_data_size()) {
+            data_mismatch(**net_.begin(), b->inputs[i][0]);
+          }
+          const label_t label = b->labels[i];
+          if (label >= out_dim) {
+            throw nn_error("label " + to_string(label) +
+                           " is out of the network output range");
+          }
+          vec_t &t = targets[i][0];
+          std::fill(t.begin(), t.end(), net_.target_value_min());
+          t[label] = net_.target_value_max();
+        }
+        train_once<Error>(optimizer, &b->inputs[0], &targets[0],
+                          static_cast<int>(n), n_threads, nullptr);
+        on_batch_enumerate();
+      }
+      on_epoch_enumerate();
+    }
+    set_netphase(net_phase::test);
+    net_.set_memory_planning(memory_planning);
+    return true;
+  }
+
+  /**
+   * @param optimizer          optimizing algorithm for training
+   * @param samples            labeled samples (label-id is 0-origin)
+   * @param batch_size         number of samples per parameter update
+   * @param epoch              number of training epochs
+   **/
+  template <typename Error, typename Optimizer>
+  bool train(Optimizer &optimizer,
+             const dataset &samples,
+             size_t batch_size = 1,
+             int epoch         = 1) {
+    return train<Error>(optimizer, samples, batch_size, epoch, nop, nop);
+  }
+
+  /**
+   * @param optimizer          optimizing algorithm for training
+   * @param batches            labeled mini-batches (label-id is 0-origin)
+   * @param epoch              number of training epochs
+   **/
+  template <typename Error, typename Optimizer>
+  bool train(Optimizer &optimizer, data_pipeline &batches, int epoch = 1) {
+    return train<Error>(optimizer, batches, epoch, nop, nop);
+  }
+
   /**
    * set the netphase to train or test
    * @param phase phase of network, could be train or test
@@ -393,6 +572,83 @@ class network {
     }
   }
 
+  /**
+   * select the storage of activations and gradients between layers.
+   * edge_storage::contiguous keeps one NCHW buffer per edge instead of one
+   * vector per sample, so that a batch is copied into the network without
+   * per-sample allocations and kernels can access it as a single matrix.
+   * the activations whose memory is shared by memory planning are still
+   * stored per sample.
+   */
+  void set_edge_storage(edge_storage storage) {
+    net_.set_edge_storage(storage);
+  }
+
+  /**
+   * select how weight gradients are accumulated over a batch.
+   * grad_accumulation::per_thread keeps one partial sum per thread instead
+   * of one gradient per sample, so the memory for weight gradients no longer
+   * grows with the batch size. the partial sums are reduced in a fixed order,
+   * results do not depend on thread scheduling.
+   */
+  void set_grad_accumulation(grad_accumulation mode) {
+    net_.set_grad_accumulation(mode);
+  }
+
+  /**
+   * fold batch normalization into the preceding convolutional and
+   * fully-connected layers, let those layers apply a following activation
+   * to their output, and drop dropout layers, removing the absorbed
+   * layers. the result computes the test phase of this network; it can't
+   * be trained once activations have been fused.
+   * @return number of removed layers
+   */
+  size_t fuse_layers() { return net_.fuse_layers(); }
+
+  /**
+   * put l in place of the index-th layer. l must have the same inputs and
+   * outputs, and takes over the connections and weights of that layer.
+   */
+  void replace_layer(size_t index, std::shared_ptr<layer> l) {
+    net_.replace(index, std::move(l));
+  }
+
+  /**
+   * let the activations between the layers share a small set of buffers,
+   * which are recycled as soon as the last consumer of an activation has
+   * finished. the peak memory of a deep chain of layers drops to about its
+   * two largest activations. meant for inference: fit() disables planning
+   * while it trains, and intermediate outputs of layers are not available.
+   */
+  void set_memory_planning(bool enable) { net_.set_memory_planning(enable); }
+
+  bool memory_planning() const { return net_.memory_planning(); }
+
+  ///< number of elements per sample taken by intermediate activations
+  size_t activation_memory_size() { return net_.activation_memory_size(); }
+
+  /**
+   * rebuild this network with the architecture of src, whose layers read
+   * (and train) the weights of src instead of holding their own copy.
+   * activations and scratch buffers are not shared.
+   * @see execution_context
+   */
+  void share_model(network &src) {
+#ifndef CNN_NO_SERIALIZATION
+    std::stringstream ss;
+    {
+      cereal::BinaryOutputArchive oa(ss);
+      src.net_.save_model(oa);
+    }
+    cereal::BinaryInputArchive ia(ss);
+    net_.load_model(ia, &src.net_);
+    mapped_file_ = src.mapped_file_;
+#else
+    CNN_UNREFERENCED_PARAMETER(src);
+    throw nn_error("tiny-dnn was not built with Serialization support");
+#endif  // CNN_NO_SERIALIZATION
+  }
+
   /**
    * request to finish an ongoing training
    *
@@ -403,20 +659,51 @@ class network {
    */
   void stop_ongoing_training() { stop_training_ = true; }
 
+  /**
+   * train every mini-batch on num_replicas copies of the network at once.
+   *
+   * the mini-batch is split into num_replicas shards, which run forward and
+   * backward concurrently on this network and on replicas that read its
+   * weights but keep their own activations and gradients. the gradients are
+   * then averaged over the whole mini-batch and applied in one optimizer
+   * step, so training computes the same updates as on a single network,
+   * except for layers whose result depends on the other samples of the
+   * batch (e.g. batch_normalization, which normalizes each shard by itself
+   * and keeps the running statistics of shard 0). dropout draws the same
+   * masks as for the whole batch.
+   * this pays off when the layers alone cannot keep all cores busy, e.g.
+   * small layers or large core counts. a mini-batch is split into no more
+   * shards than it has samples, nor than the n_threads passed to train()
+   * or fit(). requires serialization support (CNN_NO_SERIALIZATION
+   * undefined).
+   *
+   * @param num_replicas number of shards per mini-batch, 1 to disable
+   **/
+  void set_data_parallelism(size_t num_replicas) {
+    if (num_replicas == 0) throw nn_error("num_replicas must be positive");
+    num_replicas_ = num_replicas;
+    replicas_.clear();
+  }
+
+  size_t data_parallelism() const { return num_replicas_; }
+
   /**
    * test and generate confusion-matrix for classification task
    **/
   result test(const std::vector<vec_t> &in, const std::vector<label_t> &t) {
     result test_result;
     set_netphase(net_phase::test);
-    for (size_t i = 0; i < in.size(); i++) {
-      const label_t predicted = fprop_max_index(in[i]);
-      const label_t actual    = t[i];
-
-      if (predicted == actual) test_result.num_success++;
-      test_result.num_total++;
-      test_result.confusion_matrix[predicted][actual]++;
-    }
+    if (in.empty()) return test_result;
+    predict_batch(&in[0], in.size(), [&](size_t first, const tensor_t &y) {
+      for (size_t i = 0; i < y.size(); i++) {
+        const label_t predicted = label_t(max_index(y[i]));
+        const label_t actual    = t[first + i];
+
+        if (predicted == actual) test_result.num_success++;
+        test_result.num_total++;
+        test_result.confusion_matrix[predicted][actual]++;
+      }
+    });
     return test_result;
   }
 
@@ -424,12 +711,8 @@ class network {
    * generate output for each input
    **/
   std::vector<vec_t> test(const std::vector<vec_t> &in) {
-    std::vector<vec_t> test_result(in.size());
     set_netphase(net_phase::test);
-    for (size_t i = 0; i < in.size(); i++) {
-      test_result[i] = predict(in[i]);
-    }
-    return test_result;
+    return predict_batch(in);
   }
 
   /**
@@ -438,11 +721,13 @@ class network {
   template <typename E>
   float_t get_loss(const std::vector<vec_t> &in, const std::vector<vec_t> &t) {
     float_t sum_loss = float_t(0);
+    if (in.empty()) return sum_loss;
 
-    for (size_t i = 0; i < in.size(); i++) {
-      const vec_t predicted = predict(in[i]);
-      sum_loss += E::f(predicted, t[i]);
-    }
+    predict_batch(&in[0], in.size(), [&](size_t first, const tensor_t &y) {
+      for (size_t i = 0; i < y.size(); i++) {
+        sum_loss += E::f(y[i], t[first + i]);
+      }
+    });
     return sum_loss;
   }
 
@@ -454,13 +739,18 @@ class network {
     float_t sum_loss = float_t(0);
     std::vector<tensor_t> in_tensor;
     normalize_tensor(in, in_tensor);
-
-    for (size_t i = 0; i < in.size(); i++) {
-      const tensor_t predicted = predict(in_tensor[i]);
-      for (size_t j = 0; j < predicted.size(); j++) {
-        sum_loss += E::f(predicted[j], t[i][j]);
-      }
-    }
+    if (in_tensor.empty()) return sum_loss;
+
+    predict_batch_impl(
+      &in_tensor[0], in_tensor.size(), CNN_PREDICT_BATCH_SIZE,
+      [&](size_t first, const std::vector<const tensor_t *> &out) {
+        for (size_t j = 0; j < out.size(); j++) {
+          const tensor_t &y = *out[j];
+          for (size_t i = 0; i < y.size(); i++) {
+            sum_loss += E::f(y[i], t[first + i][j]);
+          }
+        }
+      });
     return sum_loss;
   }
 
@@ -498,7 +788,7 @@ class network {
             vec_t &w     = *weights[i];
             tensor_t &dw = *grads[i];
             for (size_t j = 0; j < w.size(); j++) {
-              if (!calc_delta<E>(in, v, w, dw, j, eps)) {
+              if (!calc_delta<E>(in, v, *current, w, dw, j, eps)) {
                 return false;
               }
             }
@@ -509,7 +799,8 @@ class network {
             vec_t &w     = *weights[i];
             tensor_t &dw = *grads[i];
             for (size_t j = 0; j < 10; j++) {
-              if (!calc_delta<E>(in, v, w, dw, uniform_idx(w), eps)) {
+              if (!calc_delta<E>(in, v, *current, w, dw, uniform_idx(w),
+                                 eps)) {
                 return false;
               }
             }
@@ -605,10 +896,23 @@ class network {
   const_iterator begin() const { return net_.begin(); }
   const_iterator end() const { return net_.end(); }
 
+  /**
+   * with file_format::mapped the weights refer to the file, mapped into
+   * memory, instead of being copied. the mapping is released with the
+   * network.
+   **/
   void load(const std::string &filename,
             content_type what  = content_type::weights_and_model,
             file_format format = file_format::binary) {
 #ifndef CNN_NO_SERIALIZATION
+    if (format == file_format::mapped) {
+      mapped_file_ =
+        load_model_file(filename, net_, what != content_type::weights,
+                        what != content_type::model);
+      return;
+    }
+    if (what != content_type::weights) mapped_file_.reset();
+
     std::ifstream ifs(filename.c_str(), std::ios::binary | std::ios::in);
     if (ifs.fail() || ifs.bad()) throw nn_error("failed to open:" + filename);
 
@@ -632,6 +936,12 @@ class network {
             content_type what  = content_type::weights_and_model,
             file_format format = file_format::binary) const {
 #ifndef CNN_NO_SERIALIZATION
+    if (format == file_format::mapped) {
+      save_model_file(filename, net_, what != content_type::weights,
+                      what != content_type::model);
+      return;
+    }
+
     std::ofstream ofs(filename.c_str(), std::ios::binary | std::ios::out);
     if (ofs.fail() || ofs.bad()) throw nn_error("failed to open:" + filename);
 
@@ -773,6 +1083,8 @@ class network {
            const std::vector<tensor_t> &t_cost = std::vector<tensor_t>()) {
     // check_training_data(in, t);
     check_target_cost_matrix(desired_outputs, t_cost);
+    const bool memory_planning = net_.memory_planning();
+    net_.set_memory_planning(false);
     set_netphase(net_phase::train);
     net_.setup(reset_weights);
 
@@ -799,6 +1111,7 @@ class network {
       on_epoch_enumerate();
     }
     set_netphase(net_phase::test);
+    net_.set_memory_planning(memory_planning);
     return true;
   }
 
@@ -830,6 +1143,7 @@ class network {
    * then calls the optimizer algorithm to update the weights
    *
    * @param batch_size the number of data points to use in this batch
+   * @param num_tasks  the most shards to split the batch into
    */
   template <typename E, typename Optimizer>
   void train_onebatch(Optimizer &optimizer,
@@ -838,7 +1152,13 @@ class network {
                       int batch_size,
                       const int num_tasks,
                       const tensor_t *t_cost) {
-    CNN_UNREFERENCED_PARAMETER(num_tasks);
+    const size_t shards =
+      std::min({num_replicas_, static_cast<size_t>(batch_size),
+                static_cast<size_t>(std::max(num_tasks, 1))});
+    if (shards > 1) {
+      train_sharded<E>(optimizer, in, t, batch_size, shards, t_cost);
+      return;
+    }
     std::copy(&in[0], &in[0] + batch_size, &in_batch_[0]);
     std::copy(&t[0], &t[0] + batch_size, &t_batch_[0]);
     std::vector<tensor_t> t_cost_batch =
@@ -849,6 +1169,162 @@ class network {
     net_.update_weights(&optimizer);
   }
 
+  /**
+   * trains on one minibatch split into shards, shard 0 on this network and
+   * the others on replicas, all at once, then updates the weights with the
+   * average of their gradients
+   */
+  template <typename E, typename Optimizer>
+  void train_sharded(Optimizer &optimizer,
+                     const tensor_t *in,
+                     const tensor_t *t,
+                     int batch_size,
+                     size_t shards,
+                     const tensor_t *t_cost) {
+    prepare_replicas(shards - 1);
+    std::vector<nodes *> replicas(shards - 1);
+    std::vector<float_t> share(shards);
+    for (size_t s = 0; s < shards; s++) {
+      if (s > 0) replicas[s - 1] = &replicas_[s - 1]->net_;
+      share[s] = float_t(shard_begin(s + 1, batch_size, shards) -
+                         shard_begin(s, batch_size, shards)) /
+                 batch_size;
+    }
+
+    // the replicas draw the random numbers of their samples of the batch
+    for (size_t s = 1; s < shards; s++) {
+      auto dst = replicas_[s - 1]->net_.begin();
+      for (auto src = net_.begin(); src != net_.end(); ++src, ++dst) {
+        (*dst)->follow_random_stream(**src,
+                                     shard_begin(s, batch_size, shards));
+      }
+    }
+
+    for_i(true, shards,
+          [&](size_t s) {
+            network &r         = s == 0 ? *this : *replicas_[s - 1];
+            const size_t first = shard_begin(s, batch_size, shards);
+            const size_t last  = shard_begin(s + 1, batch_size, shards);
+            r.in_batch_.assign(in + first, in + last);
+            r.t_batch_.assign(t + first, t + last);
+            std::vector<tensor_t> t_cost_batch =
+              t_cost ? std::vector<tensor_t>(t_cost + first, t_cost + last)
+                     : std::vector<tensor_t>();
+            r.template bprop<E>(r.fprop(r.in_batch_), r.t_batch_,
+                                t_cost_batch);
+          },
+          1);
+    in_batch_.resize(batch_size);
+    t_batch_.resize(batch_size);
+
+    net_.update_weights(&optimizer, replicas, share);
+  }
+
+  static size_t shard_begin(size_t shard, size_t batch_size, size_t shards) {
+    return shard * batch_size / shards;
+  }
+
+  /**
+   * make sure there are count replicas of the network which read its
+   * weights, rebuilding them if the weights were replaced since
+   */
+  void prepare_replicas(size_t count) {
+    bool valid = replicas_.size() >= count;
+    for (size_t r = 0; r < count && valid; r++) {
+      valid = reads_weights_of(*replicas_[r]);
+    }
+    if (valid) return;
+
+#ifndef CNN_NO_SERIALIZATION
+    std::stringstream ss;
+    {
+      cereal::BinaryOutputArchive oa(ss);
+      net_.save_model(oa);
+    }
+    const std::string model = ss.str();
+    replicas_.clear();
+    for (size_t r = 0; r < count; r++) {
+      auto replica = std::make_shared<network>(name_);
+      std::stringstream is(model);
+      cereal::BinaryInputArchive ia(is);
+      replica->net_.load_model(ia);
+      replica->net_.setup(false);
+      auto dst = replica->net_.begin();
+      for (auto src = net_.begin(); src != net_.end(); ++src, ++dst) {
+        std::vector<float_t *> data;
+        for (vec_t *w : (*src)->weights()) data.push_back(&(*w)[0]);
+        (*dst)->set_external_weights(data);
+        (*dst)->set_trainable((*src)->trainable());
+        (*dst)->set_parallelize(true);
+      }
+      replica->set_netphase(net_phase::train);
+      replicas_.push_back(replica);
+    }
+#else
+    throw nn_error("tiny-dnn was not built with Serialization support");
+#endif  // CNN_NO_SERIALIZATION
+  }
+
+  bool reads_weights_of(network &replica) {
+    if (replica.net_.size() != net_.size()) return false;
+    auto dst = replica.net_.begin();
+    for (auto src = net_.begin(); src != net_.end(); ++src, ++dst) {
+      auto w  = (*src)->weights();
+      auto rw = (*dst)->weights();
+      if (w.size() != rw.size()) return false;
+      for (size_t i = 0; i < w.size(); i++) {
+        if (w[i]->empty() || w[i]->data() != rw[i]->data()) return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * forward samples [first, first + batch_size) at a time and pass the
+   * output tensors of every channel to f(first, out)
+   **/
+  template <typename Sample, typename Func>
+  void predict_batch_impl(const Sample *in,
+                          size_t count,
+                          size_t batch_size,
+                          Func f) {
+    if (batch_size == 0) throw nn_error("batch size must be positive");
+
+    std::vector<std::vector<const vec_t *>> batch;
+    for (size_t first = 0; first < count; first += batch_size) {
+      const size_t n = std::min(batch_size, count - first);
+      gather_batch(in + first, n, batch);
+      f(first, net_.forward_batch(batch));
+    }
+  }
+
+  void gather_batch(const vec_t *in,
+                    size_t count,
+                    std::vector<std::vector<const vec_t *>> &batch) {
+    batch.resize(1);
+    batch[0].resize(count);
+    for (size_t i = 0; i < count; i++) {
+      if (in[i].size() != (size_t)in_data_size()) {
+        data_mismatch(**net_.begin(), in[i]);
+      }
+      batch[0][i] = &in[i];
+    }
+  }
+
+  void gather_batch(const tensor_t *in,
+                    size_t count,
+                    std::vector<std::vector<const vec_t *>> &batch) {
+    const size_t channel_count = in[0].size();
+    batch.resize(channel_count);
+    for (size_t channel = 0; channel < channel_count; channel++) {
+      batch[channel].resize(count);
+      for (size_t i = 0; i < count; i++) {
+        assert(in[i].size() == channel_count);
+        batch[channel][i] = &in[i][channel];
+      }
+    }
+  }
+
   vec_t fprop(const vec_t &in) {
     if (in.size() != (size_t)in_data_size()) data_mismatch(**net_.begin(), in);
 #if 0
@@ -880,6 +1356,7 @@ class network {
   template <typename E>
   bool calc_delta(const std::vector<tensor_t> &in,
                   const std::vector<tensor_t> &v,
+                  layer &owner,
                   vec_t &w,
                   tensor_t &dw,
                   size_t check_index,
@@ -907,25 +1384,28 @@ class network {
 
     float_t f_p    = float_t(0);
     w[check_index] = prev_w + delta;
+    owner.weights_changed();
     for (size_t i = 0; i < sample_count; i++) {
       f_p += get_loss<E>(in[i], v[i]);
     }
 
     float_t f_m    = float_t(0);
     w[check_index] = prev_w - delta;
+    owner.weights_changed();
     for (size_t i = 0; i < sample_count; i++) {
       f_m += get_loss<E>(in[i], v[i]);
     }
 
     float_t delta_by_numerical = (f_p - f_m) / (float_t(2) * delta);
     w[check_index]             = prev_w;
+    owner.weights_changed();
 
     // calculate dw/dE by bprop
     bprop<E>(fprop(in), v, std::vector<tensor_t>());
 
     float_t delta_by_bprop = 0;
-    for (size_t sample = 0; sample < sample_count; ++sample) {
-      delta_by_bprop += dw[sample][check_index];
+    for (size_t row = 0; row < dw.size(); ++row) {
+      delta_by_bprop += dw[row][check_index];
     }
     net_.clear_grads();
 
@@ -1061,10 +1541,13 @@ class network {
   }
 
   std::string name_;
+  std::shared_ptr<mapped_file> mapped_file_;  // weights loaded as mapped
   NetType net_;
   bool stop_training_;
   std::vector<tensor_t> in_batch_;
   std::vector<tensor_t> t_batch_;
+  size_t num_replicas_ = 1;
+  std::vector<std::shared_ptr<network>> replicas_;  // of train_sharded
 };
 
 /**
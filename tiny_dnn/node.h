@@ -8,6 +8,7 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <iomanip>
 #include <memory>
 #include <numeric>
@@ -18,6 +19,7 @@
 #include <vector>
 
 #include "tiny_dnn/optimizers/optimizer.h"
+#include "tiny_dnn/util/batch_view.h"
 #include "tiny_dnn/util/product.h"
 #include "tiny_dnn/util/util.h"
 #include "tiny_dnn/util/weight_init.h"
@@ -69,38 +71,79 @@ class node : public std::enable_shared_from_this<node> {
                       layer *tail,
                       size_t head_index,
                       size_t tail_index);
+  friend void bypass(layer *head, layer *tail);
+  friend void substitute(layer *from, layer *to);
 
   mutable std::vector<edgeptr_t> prev_;
   mutable std::vector<edgeptr_t> next_;
 };
 
+/**
+ * memory layout of the per-sample data held by an edge
+ **/
+enum class edge_storage {
+  per_sample,  ///< one vec_t per sample (tensor_t)
+  contiguous   ///< one NCHW buffer per edge, accessed through batch_view
+};
+
+/**
+ * how the weight gradients of a batch are accumulated
+ **/
+enum class grad_accumulation {
+  per_sample,  ///< one gradient per sample, memory grows with the batch size
+  per_thread   ///< one partial sum per thread, independent of the batch size
+};
+
 /**
  * class containing input/output data
+ *
+ * Data and gradient hold one vector per sample (tensor_t). With
+ * edge_storage::contiguous these vectors are views of a single NCHW buffer
+ * per edge, so that the same memory can also be read as one matrix through
+ * batch_view without any copy, and resizing the batch does not allocate one
+ * vector per sample.
  **/
 class edge {
  public:
   edge(node *prev, const shape3d &shape, vector_type vtype)
     : shape_(shape),
       vtype_(vtype),
+      storage_(edge_storage::per_sample),
       data_({vec_t(shape.size())}),
       grad_({vec_t(shape.size())}),
+      data_buf_(shape.size()),
+      grad_buf_(shape.size()),
+      viewed_(false),
+      grad_samples_(1),
+      version_(next_version()),
       prev_(prev) {}
 
+  /**
+   * average the gradient over the samples it was accumulated from.
+   * the rows of the gradient (one per sample, or partial sums) are added
+   * with a pairwise tree reduction in place, whose order only depends on
+   * the number of rows; they are overwritten by partial results.
+   **/
   void merge_grads(vec_t *dst) {
-    assert(!grad_.empty());
-    const auto &grad_head = grad_[0];
-    size_t sz             = grad_head.size();
+    const size_t rows = grad_.size();
+    assert(rows > 0);
+    const size_t sz = grad_[0].size();
     dst->resize(sz);
-    float_t *pdst = &(*dst)[0];
-    // dst = 0
-    std::fill((*dst).begin(), (*dst).end(), 0.0);
-    // @todo consider adding parallelism
-    size_t batch_size      = grad_.size();
-    float_t rcp_batch_size = 1.0 / batch_size;
-    for (size_t sample = 0; sample < batch_size; ++sample) {
-      // dst += grad_[sample]
-      vectorize::muladd<float_t>(&grad_[sample][0], rcp_batch_size, sz, pdst);
-    }
+
+    float_t rcp_batch_size = float_t(1) / std::max(grad_samples_, rows);
+    for_(sz >= 512, 0u, sz, [&](const blocked_range &r) {
+      const size_t len = r.end() - r.begin();
+      for (size_t stride = 1; stride < rows; stride *= 2) {
+        for (size_t i = 0; i + stride < rows; i += 2 * stride) {
+          vectorize::reduce<float_t>(&grad_[i + stride][r.begin()], len,
+                                     &grad_[i][r.begin()]);
+        }
+      }
+      const float_t *src = &grad_[0][0];
+      for (size_t j = r.begin(); j < r.end(); j++) {
+        (*dst)[j] = src[j] * rcp_batch_size;
+      }
+    });
   }
 
   void clear_grads() {
@@ -119,6 +162,139 @@ class edge {
 
   const tensor_t *get_gradient() const { return &grad_; }
 
+  /**
+   * data of all samples as one contiguous [sample x shape().size()] matrix.
+   * the view and get_data() share their memory; samples held elsewhere are
+   * moved into the buffer of the edge first.
+   **/
+  batch_view<float_t> batch_data() { return batch(data_, data_buf_); }
+
+  batch_view<const float_t> batch_data() const {
+    return batch(data_, data_buf_);
+  }
+
+  batch_view<float_t> batch_gradient() { return batch(grad_, grad_buf_); }
+
+  batch_view<const float_t> batch_gradient() const {
+    return batch(grad_, grad_buf_);
+  }
+
+  /**
+   * lay out sample_count samples in the buffer of the edge without copying
+   * the previous content, which is about to be overwritten
+   **/
+  batch_view<float_t> reset_batch_data(size_t sample_count) {
+    bind_rows(data_, data_buf_, sample_count, false);
+    return data_buf_.view();
+  }
+
+  batch_view<float_t> reset_batch_gradient(size_t sample_count) {
+    bind_rows(grad_, grad_buf_, sample_count, false);
+    return grad_buf_.view();
+  }
+
+  ///< number of samples currently held by this edge
+  size_t sample_count() const { return data_.size(); }
+
+  /**
+   * stamp of the values of the edge, renewed by touch(). stamps are unique
+   * over all edges, so a cache derived from the values of a weight edge is
+   * up to date as long as the stamp it was computed from is current.
+   **/
+  uint64_t version() const { return version_; }
+
+  ///< note that the values of the edge were changed
+  void touch() { version_ = next_version(); }
+
+  void resize_data(size_t sample_count) {
+    resize(data_, data_buf_, sample_count);
+  }
+
+  void resize_gradient(size_t sample_count) {
+    resize(grad_, grad_buf_, sample_count);
+    grad_samples_ = sample_count;
+  }
+
+  /**
+   * hold the gradient of sample_count samples as partial_count partial
+   * sums, see for_partials and partial_index
+   **/
+  void resize_gradient(size_t sample_count, size_t partial_count) {
+    resize(grad_, grad_buf_, partial_count);
+    grad_samples_ = sample_count;
+  }
+
+  /**
+   * exchange the per-sample data with data, e.g. to lend the memory of the
+   * edge to another one. rows taken over from data are resized to the
+   * shape of this edge. the data of an edge whose memory is lent this way
+   * should be stored per sample, see set_storage().
+   **/
+  void swap_data(tensor_t &data) {
+    data_.swap(data);
+    for (auto &row : data_) row.resize(shape_.size());
+  }
+
+  /**
+   * let sample s of the data and gradient of this edge be a view of sample s
+   * of parent from element offset on, e.g. of some channels of parent, so
+   * that writing this edge writes parent and no copy is needed between the
+   * two. the values of parent are kept, those of this edge are not.
+   *
+   * the views hold no memory and must not outlive the rows of parent; the
+   * layers relying on them check is_view_of() before each use and copy
+   * instead when it fails. returns false without changing anything if other
+   * edges view the rows of this edge, or if parent holds no gradient per
+   * sample.
+   **/
+  bool make_view_of(edge &parent, size_t offset) {
+    assert(offset + shape_.size() <= parent.shape_.size());
+    tensor_t &data = parent.data_;
+    tensor_t &grad = parent.grad_;
+    if (viewed_ || grad.size() != data.size()) return false;
+
+    view_rows(data_, data, offset);
+    view_rows(grad_, grad, offset);
+    parent.viewed_ = true;
+    return true;
+  }
+
+  ///< true if the data and gradient are views of parent, see make_view_of()
+  bool is_view_of(const edge &parent, size_t offset) const {
+    return rows_view(data_, parent.data_, offset) &&
+           rows_view(grad_, parent.grad_, offset);
+  }
+
+  /**
+   * give rows which are views of other memory than the buffer of the edge
+   * memory of their own again, keeping their values, e.g. before the memory
+   * they view is handed out
+   **/
+  void detach_views() {
+    if (vtype_ != vector_type::data) return;
+    detach_rows(data_, data_buf_);
+    detach_rows(grad_, grad_buf_);
+    viewed_ = false;
+  }
+
+  edge_storage storage() const { return storage_; }
+
+  /**
+   * select how the samples are stored. the values held by the edge are
+   * kept.
+   **/
+  void set_storage(edge_storage storage) {
+    if (storage == storage_) return;
+    storage_ = storage;
+    if (storage_ == edge_storage::contiguous) {
+      bind_rows(data_, data_buf_, data_.size());
+      bind_rows(grad_, grad_buf_, grad_.size());
+    } else {
+      detach_rows(data_, batch_storage());
+      detach_rows(grad_, batch_storage());
+    }
+  }
+
   const std::vector<node *> &next() const { return next_; }
   node *prev() { return prev_; }
   const node *prev() const { return prev_; }
@@ -126,14 +302,113 @@ class edge {
   const shape3d &shape() const { return shape_; }
   vector_type vtype() const { return vtype_; }
   void add_next_node(node *next) { next_.push_back(next); }
+  void set_prev_node(node *prev) { prev_ = prev; }
+  void replace_next_node(node *from, node *to) {
+    std::replace(next_.begin(), next_.end(), from, to);
+  }
 
  private:
+  batch_view<float_t> batch(tensor_t &t, batch_storage &buf) const {
+    if (!buf.holds(t)) bind_rows(t, buf, t.size());
+    return buf.view();
+  }
+
+  /**
+   * let sample s of t be a view of sample s of buf. the values of t are
+   * moved into buf if keep is true, unless t already views buf.
+   **/
+  void bind_rows(tensor_t &t,
+                 batch_storage &buf,
+                 size_t sample_count,
+                 bool keep = true) const {
+    if (!buf.holds(t)) {
+      // t may view the old memory of buf, which must outlive the copy
+      batch_storage copy(shape_.size());
+      if (keep) copy.copy_from(t);
+      buf = std::move(copy);
+    }
+    buf.resize(sample_count);
+
+    const size_t size = shape_.size();
+    t.resize(sample_count);
+    for (size_t sample = 0; sample < sample_count; ++sample) {
+      float_t *p = buf[sample];
+      if (!t[sample].empty() && &t[sample][0] == p) continue;
+      vec_t row(vec_t::allocator_type(p, size));
+      row.resize(size);  // keeps the values found at p
+      t[sample] = std::move(row);
+    }
+  }
+
+  // give every row viewing other memory than buf memory of its own
+  static void detach_rows(tensor_t &t, const batch_storage &buf) {
+    const bool own = buf.holds(t);
+    for (size_t sample = 0; sample < t.size(); ++sample) {
+      auto &row = t[sample];
+      if (row.get_allocator().external() &&
+          !(own && &row[0] == buf[sample])) {
+        row = vec_t(row.begin(), row.end());
+      }
+    }
+  }
+
+  void view_rows(tensor_t &t, tensor_t &parent, size_t offset) const {
+    const size_t size = shape_.size();
+    t.resize(parent.size());
+    for (size_t sample = 0; sample < parent.size(); ++sample) {
+      float_t *p = &parent[sample][offset];
+      if (!t[sample].empty() && &t[sample][0] == p) continue;
+      vec_t row(vec_t::allocator_type(p, size));
+      row.resize(size);  // keeps the values found at p
+      t[sample] = std::move(row);
+    }
+  }
+
+  static bool rows_view(const tensor_t &t,
+                        const tensor_t &parent,
+                        size_t offset) {
+    if (t.size() != parent.size()) return false;
+    for (size_t sample = 0; sample < t.size(); ++sample) {
+      if (t[sample].empty() ||
+          parent[sample].size() < offset + t[sample].size() ||
+          &t[sample][0] != &parent[sample][offset]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static uint64_t next_version() {
+    static std::atomic<uint64_t> counter(0);
+    return ++counter;
+  }
+
+  void resize(tensor_t &t, batch_storage &buf, size_t sample_count) {
+    if (storage_ == edge_storage::contiguous) {
+      if (t.size() != sample_count || as_batch_view(t).empty()) {
+        bind_rows(t, buf, sample_count);
+      }
+    } else if (t.size() == sample_count) {
+      return;
+    } else if (t.empty()) {
+      t.resize(sample_count, vec_t(shape_.size()));
+    } else {
+      t.resize(sample_count, t[0]);
+    }
+  }
+
   shape3d shape_;
   vector_type vtype_;
-  tensor_t data_;
-  tensor_t grad_;
-  node *prev_;                // previous node, "producer" of this tensor
-  std::vector<node *> next_;  // next nodes, "consumers" of this tensor
+  edge_storage storage_;
+  mutable tensor_t data_;
+  mutable tensor_t grad_;
+  mutable batch_storage data_buf_;  // samples of data_ if contiguous
+  mutable batch_storage grad_buf_;  // samples of grad_ if contiguous
+  bool viewed_;                     // true if other edges may view our rows
+  size_t grad_samples_;             // number of samples accumulated into grad_
+  uint64_t version_;                // stamp of data_, see version()
+  node *prev_;                      // previous node, "producer" of this tensor
+  std::vector<node *> next_;        // next nodes, "consumers" of this tensor
 };
 
 inline std::vector<node *> node::prev_nodes() const {
@@ -7,7 +7,9 @@
 */
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <sstream>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
@@ -18,16 +20,23 @@
 #include <cereal/types/utility.hpp>
 #endif
 
+#include "tiny_dnn/activations/activation_layer.h"
 #include "tiny_dnn/layers/layer.h"
 #include "tiny_dnn/optimizers/optimizer.h"
+#include "tiny_dnn/util/memory_planner.h"
+#include "tiny_dnn/util/task_graph.h"
 #include "tiny_dnn/util/util.h"
 
 namespace cereal {
 
+// binary archives keep layer::archive_version() in the upper 32 bits of the
+// number of layers; json counts the layers itself and ignores the tag
 template <typename Archive>
 void save(Archive &ar, const std::vector<tiny_dnn::layer *> &v) {
 #ifndef CNN_NO_SERIALIZATION
-  ar(cereal::make_size_tag(static_cast<cereal::size_type>(v.size())));
+  const uint64_t version = tiny_dnn::layer::archive_version();
+  ar(cereal::make_size_tag(static_cast<cereal::size_type>(
+    version << 32 | static_cast<uint64_t>(v.size()))));
   for (auto n : v) {
     tiny_dnn::layer::save_layer(ar, *n);
   }
@@ -39,8 +48,11 @@ void save(Archive &ar, const std::vector<tiny_dnn::layer *> &v) {
 template <typename Archive>
 void load(Archive &ar, std::vector<std::shared_ptr<tiny_dnn::layer>> &v) {
 #ifndef CNN_NO_SERIALIZATION
-  cereal::size_type size;
-  ar(cereal::make_size_tag(size));
+  cereal::size_type tag;
+  ar(cereal::make_size_tag(tag));
+  const uint64_t size = static_cast<uint64_t>(tag) & 0xffffffffu;
+  tiny_dnn::layer::loading_archive_version() =
+    static_cast<uint32_t>(static_cast<uint64_t>(tag) >> 32);
 
   for (size_t i = 0; i < size; i++) {
     v.emplace_back(tiny_dnn::layer::load_layer(ar));
@@ -98,11 +110,83 @@ class nodes {
     const std::vector<tensor_t> &first) = 0;  // NOLINT
 
   /**
-   * update weights and clear all gradients
+   * forward a batch without copying it into per-sample tensors
+   * @param in_data : pointers to the input vectors, [channel][sample]
+   * @return output of each output channel, [channel] -> [sample]. the
+   *         tensors are owned by the network and valid until the next call
+   **/
+  virtual std::vector<const tensor_t *> forward_batch(
+    const std::vector<std::vector<const vec_t *>> &in_data) = 0;
+
+  /**
+   * update weights and clear all gradients, in one optimizer step over the
+   * weights of all layers
    **/
   virtual void update_weights(optimizer *opt) {
+    std::vector<const vec_t *> dW;
+    std::vector<vec_t *> W;
+    for (auto l : nodes_) {
+      l->collect_weight_updates(&dW, &W);
+    }
+    opt->step(dW, W);
+    for (auto l : nodes_) {
+      l->finish_weight_update();
+    }
+  }
+
+  /**
+   * update the weights with the gradients of this network and of replicas,
+   * copies of it which read its weights and ran on other parts of the
+   * mini-batch. the gradients are averaged with weight share[0] for this
+   * network and share[i + 1] for replicas[i].
+   **/
+  void update_weights(optimizer *opt,
+                      const std::vector<nodes *> &replicas,
+                      const std::vector<float_t> &share) {
+    std::vector<const vec_t *> dW;
+    std::vector<vec_t *> W;
+    for (auto l : nodes_) {
+      l->collect_weight_updates(&dW, &W);
+    }
+    std::vector<std::vector<const vec_t *>> replica_dW(replicas.size());
+    for (size_t r = 0; r < replicas.size(); r++) {
+      std::vector<vec_t *> unused;
+      for (auto l : replicas[r]->nodes_) {
+        l->collect_weight_updates(&replica_dW[r], &unused);
+      }
+      if (replica_dW[r].size() != dW.size()) {
+        throw nn_error("replica does not match the network");
+      }
+    }
+
+    // all-reduce
+    reduced_grads_.resize(dW.size());
+    for (size_t i = 0; i < dW.size(); i++) {
+      vec_t &sum = reduced_grads_[i];
+      sum.resize(dW[i]->size());
+      for_(sum.size() >= 512, 0, sum.size(), [&](const blocked_range &range) {
+        const float_t *src = &(*dW[i])[0];
+        for (size_t j = range.begin(); j < range.end(); j++) {
+          sum[j] = share[0] * src[j];
+        }
+        for (size_t r = 0; r < replicas.size(); r++) {
+          src = &(*replica_dW[r][i])[0];
+          for (size_t j = range.begin(); j < range.end(); j++) {
+            sum[j] += share[r + 1] * src[j];
+          }
+        }
+      });
+      dW[i] = &sum;
+    }
+
+    opt->step(dW, W);
     for (auto l : nodes_) {
-      l->update_weight(opt);
+      l->finish_weight_update();
+    }
+    for (auto replica : replicas) {
+      for (auto l : replica->nodes_) {
+        l->finish_weight_update();
+      }
     }
   }
 
@@ -121,6 +205,122 @@ class nodes {
     }
   }
 
+  /**
+   * select how activations/gradients are stored on every data edge
+   **/
+  void set_edge_storage(edge_storage storage) {
+    plan_.reset();  // planned edges are switched back to per_sample
+    for (auto l : nodes_) {
+      l->set_edge_storage(storage);
+    }
+  }
+
+  /**
+   * let every layer use the weights of the corresponding layer of src,
+   * which must have the same architecture
+   **/
+  void share_weights(nodes &src) {
+    if (src.nodes_.size() != nodes_.size()) {
+      throw nn_error("cannot share weights between different networks");
+    }
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      nodes_[i]->share_weights(*src.nodes_[i]);
+    }
+  }
+
+  /**
+   * select how every layer accumulates the gradients of its weights
+   **/
+  void set_grad_accumulation(grad_accumulation mode) {
+    for (auto l : nodes_) {
+      l->set_grad_accumulation(mode);
+    }
+  }
+
+  /**
+   * let the activations between the layers share a small set of buffers.
+   *
+   * a static plan derived from the order the layers run in assigns every
+   * intermediate activation to a buffer, which is handed on to another
+   * activation as soon as all consumers of the first one have finished.
+   * only the inputs and outputs of the network keep memory of their own.
+   * meant for inference: while enabled, backward() is not available and
+   * activations of intermediate layers are gone after forward().
+   **/
+  void set_memory_planning(bool enable) {
+    if (enable == memory_planning_) return;
+    memory_planning_ = enable;
+    plan_.reset();
+    for (auto l : nodes_) {
+      l->set_inference_only(enable);
+    }
+  }
+
+  bool memory_planning() const { return memory_planning_; }
+
+  /**
+   * number of elements per sample taken by intermediate activations: the
+   * size of all planned buffers with memory planning, otherwise the sum
+   * over all activations
+   **/
+  size_t activation_memory_size() {
+    if (memory_planning_) {
+      prepare_memory_plan();
+      return plan_->planner.total_size();
+    }
+    size_t total = 0;
+    for_each_planned_edge([&](size_t, edge *e, const std::vector<size_t> &) {
+      total += e->shape().size();
+    });
+    return total;
+  }
+
+  /**
+   * fuse layers for inference. a batch normalization following a
+   * convolutional or fully-connected layer with bias is folded into its
+   * weights, an activation following one of them is applied to its output
+   * in place (see layer::fuse). layers which are the identity for inference,
+   * e.g. dropout, are skipped. the absorbed layers are removed, so the
+   * network computes the test phase of the original one with fewer passes
+   * over memory and fewer activations. layers with a fused activation
+   * can't be trained; an activation owned by the caller is copied into the
+   * layer applying it.
+   * @return number of removed layers
+   **/
+  size_t fuse_layers() {
+    size_t removed = 0;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      layer *head = nodes_[i];
+      layer *tail = nullptr;
+      while ((tail = sole_consumer(head)) != nullptr &&
+             (tail->is_identity_for_inference() ||
+              head->fuse(shared_node(tail)))) {
+        bypass(head, tail);
+        replace_output_layer(tail, head);
+        nodes_.erase(std::find(nodes_.begin(), nodes_.end(), tail));
+        release_node(tail);
+        removed++;
+      }
+    }
+    if (removed > 0) update_schedule();
+    return removed;
+  }
+
+  /**
+   * put l in place of the index-th layer. l must have the same inputs and
+   * outputs, it takes over the connections and the weights of the layer.
+   **/
+  void replace(size_t index, std::shared_ptr<layer> l) {
+    layer *from = nodes_[index];
+    substitute(from, l.get());
+    replace_input_layer(from, l.get());
+    replace_output_layer(from, l.get());
+    nodes_[index] = l.get();
+    release_node(from);
+    own_nodes_.push_back(l);
+    update_schedule();
+  }
+
   size_t size() const { return nodes_.size(); }
   iterator begin() { return nodes_.begin(); }
   iterator end() { return nodes_.end(); }
@@ -196,8 +396,14 @@ class nodes {
   template <typename OutputArchive>
   void save_model(OutputArchive &oa) const;
 
+  /**
+   * @param ia      archive written by save_model
+   * @param weights if not null, the loaded layers share the weights of
+   *                this network (see layer::share_weights) instead of
+   *                initializing their own
+   **/
   template <typename InputArchive>
-  void load_model(InputArchive &ia);
+  void load_model(InputArchive &ia, nodes *weights = nullptr);
 
   template <typename OutputArchive>
   void save_weights(OutputArchive &oa) const {
@@ -249,6 +455,108 @@ class nodes {
     }
   }
 
+  /**
+   * forward layer i, lending it the buffers of its output activations and
+   * taking back the buffers of inputs no other layer needs anymore
+   **/
+  void forward_layer(size_t i) {
+    if (!memory_planning_) {
+      nodes_[i]->forward();
+      return;
+    }
+    memory_plan &p = *plan_;
+    for (size_t e : p.writes[i]) {
+      p.edges[e]->swap_data(p.slots[p.planner.slot(e)]);
+    }
+    nodes_[i]->forward();
+    for (size_t e : p.reads[i]) {
+      if (p.pending[e].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        p.edges[e]->swap_data(p.slots[p.planner.slot(e)]);
+      }
+    }
+  }
+
+  // build the memory plan if needed and rewind it for the next forward pass
+  void prepare_memory_plan() {
+    if (!memory_planning_) return;
+    if (!plan_) build_memory_plan();
+    for (size_t e = 0; e < plan_->edges.size(); e++) {
+      plan_->pending[e] = plan_->readers[e];
+    }
+  }
+
+  void invalidate_memory_plan() { plan_.reset(); }
+
+  /**
+   * let the memory plan rely on layers running concurrently only as far as
+   * add_dependency() allows. by default the layers run one after another
+   * in the order of nodes_
+   **/
+  virtual void add_dependencies(memory_planner &planner) const {
+    CNN_UNREFERENCED_PARAMETER(planner);
+  }
+
+  virtual bool is_output_layer(const layer *l) const {
+    return l == nodes_.back();
+  }
+
+  virtual void replace_input_layer(layer *from, layer *to) {
+    CNN_UNREFERENCED_PARAMETER(from);
+    CNN_UNREFERENCED_PARAMETER(to);
+  }
+
+  virtual void replace_output_layer(layer *from, layer *to) {
+    CNN_UNREFERENCED_PARAMETER(from);
+    CNN_UNREFERENCED_PARAMETER(to);
+  }
+
+  // called after layers were removed from or replaced in nodes_
+  virtual void update_schedule() { invalidate_memory_plan(); }
+
+  // the layer consuming the single output of l, if there is no other
+  // consumer and l is not an output of the network
+  layer *sole_consumer(const layer *l) const {
+    if (is_output_layer(l) || l->next().size() != 1 || !l->next()[0]) {
+      return nullptr;
+    }
+    const std::vector<node *> &consumers = l->next()[0]->next();
+    if (consumers.size() != 1) return nullptr;
+    layer *tail = dynamic_cast<layer *>(consumers[0]);
+    if (std::find(nodes_.begin(), nodes_.end(), tail) == nodes_.end() ||
+        tail->prev().size() != 1 || tail->next().size() != 1) {
+      return nullptr;
+    }
+    return tail;
+  }
+
+  // l for layer::fuse: the owning pointer if the network owns l, a copy of
+  // an activation owned by the caller, or a pointer not owning l otherwise
+  std::shared_ptr<layer> shared_node(layer *l) const {
+    for (auto &n : own_nodes_) {
+      if (n.get() == l) return n;
+    }
+#ifndef CNN_NO_SERIALIZATION
+    if (dynamic_cast<activation_layer *>(l)) {
+      std::stringstream ss;
+      {
+        cereal::BinaryOutputArchive oa(ss);
+        layer::save_layer(oa, *l);
+      }
+      cereal::BinaryInputArchive ia(ss);
+      return layer::load_layer(ia);
+    }
+#endif
+    return std::shared_ptr<layer>(std::shared_ptr<layer>(), l);
+  }
+
+  void release_node(layer *l) {
+    own_nodes_.erase(std::remove_if(own_nodes_.begin(), own_nodes_.end(),
+                                    [l](const std::shared_ptr<layer> &n) {
+                                      return n.get() == l;
+                                    }),
+                     own_nodes_.end());
+  }
+
   template <typename T>
   void push_back_impl(T &&node, std::true_type) {  // is_rvalue_reference
     own_nodes_.push_back(
@@ -264,8 +572,92 @@ class nodes {
 
   /* Nodes which this class has ownership */
   std::vector<std::shared_ptr<layer>> own_nodes_;
+
+ protected:
   /* List of all nodes which includes own_nodes */
   std::vector<layer *> nodes_;
+
+ private:
+  struct memory_plan {
+    memory_planner planner;
+    std::vector<edge *> edges;    // planned activations, one per buffer
+    std::vector<size_t> readers;  // number of consumers of each activation
+    std::vector<std::vector<size_t>> writes;  // activations written by layer
+    std::vector<std::vector<size_t>> reads;   // activations read by layer
+    std::vector<tensor_t> slots;
+    std::unique_ptr<std::atomic<size_t>[]> pending;
+  };
+
+  // f(producer, edge, consumers) for every activation between two layers
+  // which is not an output of the network
+  template <typename Func>
+  void for_each_planned_edge(Func f) const {
+    std::unordered_map<const node *, size_t> node2id;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      node2id[nodes_[i]] = i;
+    }
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      if (is_output_layer(nodes_[i])) continue;
+      for (auto &e : nodes_[i]->next()) {
+        if (!e || e->vtype() != vector_type::data) continue;
+        std::vector<size_t> consumers;
+        for (auto n : e->next()) {
+          auto it = node2id.find(n);
+          if (it != node2id.end()) consumers.push_back(it->second);
+        }
+        std::sort(consumers.begin(), consumers.end());
+        consumers.erase(std::unique(consumers.begin(), consumers.end()),
+                        consumers.end());
+        if (!consumers.empty()) f(i, e.get(), consumers);
+      }
+    }
+  }
+
+  void build_memory_plan() {
+    std::shared_ptr<memory_plan> p = std::make_shared<memory_plan>();
+    p->planner = memory_planner(nodes_.size());
+    p->writes.resize(nodes_.size());
+    p->reads.resize(nodes_.size());
+    add_dependencies(p->planner);
+    for (auto l : nodes_) {
+      l->set_inference_only(true);
+      // views set up by concat and slice layers must not outlive the
+      // memory handed over to the buffers below
+      for (auto &e : l->prev()) {
+        if (e) e->detach_views();
+      }
+      for (auto &e : l->next()) {
+        if (e) e->detach_views();
+      }
+    }
+
+    for_each_planned_edge(
+      [&](size_t producer, edge *e, const std::vector<size_t> &consumers) {
+        size_t b = p->planner.add_buffer(producer, e->shape().size());
+        p->edges.push_back(e);
+        p->readers.push_back(consumers.size());
+        p->writes[producer].push_back(b);
+        for (size_t c : consumers) {
+          p->planner.add_reader(b, c);
+          p->reads[c].push_back(b);
+        }
+
+        // the memory of the activation is replaced by the buffers
+        e->set_storage(edge_storage::per_sample);
+        tensor_t unused;
+        e->swap_data(unused);
+        e->resize_gradient(1);
+      });
+
+    p->planner.plan();
+    p->slots.resize(p->planner.num_slots());
+    p->pending.reset(new std::atomic<size_t>[p->edges.size()]);
+    plan_ = p;
+  }
+
+  bool memory_planning_ = false;
+  std::shared_ptr<memory_plan> plan_;
+  std::vector<vec_t> reduced_grads_;  // gradients averaged over replicas
 };
 
 /**
@@ -274,6 +666,9 @@ class nodes {
 class sequential : public nodes {
  public:
   void backward(const std::vector<tensor_t> &first) override {
+    if (memory_planning()) {
+      throw nn_error("backward is not available with memory planning");
+    }
     std::vector<std::vector<const vec_t *>> reordered_grad;
     reorder_for_layerwise_processing(first, reordered_grad);
     assert(reordered_grad.size() == 1);
@@ -288,23 +683,31 @@ class sequential : public nodes {
   std::vector<tensor_t> forward(const std::vector<tensor_t> &first) override {
     std::vector<std::vector<const vec_t *>> reordered_data;
     reorder_for_layerwise_processing(first, reordered_data);
-    assert(reordered_data.size() == 1);
+    return normalize_out(forward_batch(reordered_data));
+  }
 
-    nodes_.front()->set_in_data(&reordered_data[0], 1);
+  std::vector<const tensor_t *> forward_batch(
+    const std::vector<std::vector<const vec_t *>> &in_data) override {
+    if (in_data.size() != 1) {
+      throw nn_error("input size mismatch");
+    }
 
-    for (auto l : nodes_) {
-      l->forward();
+    nodes_.front()->set_in_data(&in_data[0], 1);
+
+    prepare_memory_plan();
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      forward_layer(i);
     }
 
     std::vector<const tensor_t *> out;
     nodes_.back()->output(out);
-
-    return normalize_out(out);
+    return out;
   }
 
   template <typename T>
   void add(T &&layer) {
     push_back(std::forward<T>(layer));
+    invalidate_memory_plan();
 
     if (nodes_.size() != 1) {
       auto head = nodes_[nodes_.size() - 2];
@@ -361,11 +764,17 @@ class sequential : public nodes {
 
 /**
  * generic graph network
- * @todo not implemented
+ *
+ * layers are dispatched to the thread pool as soon as the layers they depend
+ * on have finished, so independent branches (e.g. the towers feeding a
+ * concat_layer) run concurrently in both forward and backward pass.
  **/
 class graph : public nodes {
  public:
   void backward(const std::vector<tensor_t> &out_grad) override {
+    if (memory_planning()) {
+      throw nn_error("backward is not available with memory planning");
+    }
     size_t output_channel_count = out_grad[0].size();
 
     if (output_channel_count != output_layers_.size()) {
@@ -380,32 +789,37 @@ class graph : public nodes {
       output_layers_[i]->set_out_grads(&reordered_grad[i], 1);
     }
 
-    for (auto l = nodes_.rbegin(); l != nodes_.rend(); l++) {
-      (*l)->backward();
-    }
+    backward_tasks_.run([this](size_t i) { nodes_[i]->backward(); });
   }
 
   std::vector<tensor_t> forward(const std::vector<tensor_t> &in_data) override {
-    size_t input_data_channel_count = in_data[0].size();
+    std::vector<std::vector<const vec_t *>> reordered_data;
+    reorder_for_layerwise_processing(in_data, reordered_data);
+    return merge_outs(forward_batch(reordered_data));
+  }
+
+  std::vector<const tensor_t *> forward_batch(
+    const std::vector<std::vector<const vec_t *>> &in_data) override {
+    size_t input_data_channel_count = in_data.size();
 
     if (input_data_channel_count != input_layers_.size()) {
       throw nn_error("input size mismatch");
     }
 
-    std::vector<std::vector<const vec_t *>> reordered_data;
-    reorder_for_layerwise_processing(in_data, reordered_data);
-    assert(reordered_data.size() == input_data_channel_count);
-
     for (size_t channel_index = 0; channel_index < input_data_channel_count;
          channel_index++) {
-      input_layers_[channel_index]->set_in_data(&reordered_data[channel_index],
-                                                1);
+      input_layers_[channel_index]->set_in_data(&in_data[channel_index], 1);
     }
 
-    for (auto l : nodes_) {
-      l->forward();
+    prepare_memory_plan();
+    forward_tasks_.run([this](size_t i) { forward_layer(i); });
+
+    std::vector<const tensor_t *> outs, out;
+    for (auto l : output_layers_) {
+      l->output(out);
+      outs.push_back(out[0]);
     }
-    return merge_outs();
+    return outs;
   }
 
   void construct(const std::vector<layer *> &input,
@@ -447,6 +861,7 @@ class graph : public nodes {
     input_layers_  = input;
     output_layers_ = output;
 
+    build_schedule();
     setup(false);
   }
 
@@ -539,21 +954,19 @@ class graph : public nodes {
     for (auto out : gc.out_nodes) {
       output_layers_.push_back(nodes_[out]);
     }
+    build_schedule();
 #else
     throw nn_error("TinyDNN was not built with Serialization support");
 #endif  // CNN_NO_SERIALIZATION
   }
 
   // normalize indexing back to [sample][layer][feature]
-  std::vector<tensor_t> merge_outs() {
+  std::vector<tensor_t> merge_outs(const std::vector<const tensor_t *> &out) {
     std::vector<tensor_t> merged;
-    std::vector<const tensor_t *> out;
-    size_t output_channel_count = output_layers_.size();
+    size_t output_channel_count = out.size();
     for (size_t output_channel = 0; output_channel < output_channel_count;
          ++output_channel) {
-      output_layers_[output_channel]->output(out);
-
-      size_t sample_count = out[0]->size();
+      size_t sample_count = out[output_channel]->size();
       if (output_channel == 0) {
         assert(merged.empty());
         merged.resize(sample_count, tensor_t(output_channel_count));
@@ -562,12 +975,71 @@ class graph : public nodes {
       assert(merged.size() == sample_count);
 
       for (size_t sample = 0; sample < sample_count; ++sample) {
-        merged[sample][output_channel] = (*out[0])[sample];
+        merged[sample][output_channel] = (*out[output_channel])[sample];
       }
     }
     return merged;
   }
 
+  void add_dependencies(memory_planner &planner) const override {
+    for (size_t i = 0; i < forward_tasks_.size(); i++) {
+      for (size_t next : forward_tasks_.successors(i)) {
+        planner.add_dependency(i, next);
+      }
+    }
+  }
+
+  bool is_output_layer(const layer *l) const override {
+    return std::find(output_layers_.begin(), output_layers_.end(), l) !=
+           output_layers_.end();
+  }
+
+  void replace_input_layer(layer *from, layer *to) override {
+    std::replace(input_layers_.begin(), input_layers_.end(), from, to);
+  }
+
+  void replace_output_layer(layer *from, layer *to) override {
+    std::replace(output_layers_.begin(), output_layers_.end(), from, to);
+  }
+
+  void update_schedule() override { build_schedule(); }
+
+  // derive the dependencies between the layers in nodes_
+  void build_schedule() {
+    invalidate_memory_plan();
+    std::unordered_map<const node *, size_t> node2id;
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      node2id[nodes_[i]] = i;
+    }
+
+    forward_tasks_  = task_graph(nodes_.size());
+    backward_tasks_ = task_graph(nodes_.size());
+
+    for (size_t i = 0; i < nodes_.size(); i++) {
+      for (auto &e : nodes_[i]->next()) {
+        if (!e) continue;
+        std::vector<size_t> consumers;
+        for (auto n : e->next()) {
+          auto it = node2id.find(n);
+          if (it == node2id.end()) continue;
+          consumers.push_back(it->second);
+          forward_tasks_.add_dependency(i, it->second);
+          backward_tasks_.add_dependency(it->second, i);
+        }
+
+        // every consumer writes into the gradient of e in back_propagation.
+        // keep them in the order of the sequential backward pass, so that
+        // the result is deterministic and free of data races.
+        std::sort(consumers.begin(), consumers.end());
+        consumers.erase(std::unique(consumers.begin(), consumers.end()),
+                        consumers.end());
+        for (size_t j = consumers.size(); j > 1; j--) {
+          backward_tasks_.add_dependency(consumers[j - 1], consumers[j - 2]);
+        }
+      }
+    }
+  }
+
   size_t find_index(const std::vector<node *> &nodes, layer *target) {
     for (size_t i = 0; i < nodes.size(); i++) {
       if (nodes[i] == static_cast<node *>(&*target)) return i;
@@ -576,6 +1048,8 @@ class graph : public nodes {
   }
   std::vector<layer *> input_layers_;
   std::vector<layer *> output_layers_;
+  task_graph forward_tasks_;
+  task_graph backward_tasks_;
 };
 
 template <typename OutputArchive>
@@ -594,10 +1068,11 @@ void nodes::save_model(OutputArchive &oa) const {
 }
 
 template <typename InputArchive>
-void nodes::load_model(InputArchive &ia) {
+void nodes::load_model(InputArchive &ia, nodes *weights) {
 #ifndef CNN_NO_SERIALIZATION
   own_nodes_.clear();
   nodes_.clear();
+  invalidate_memory_plan();
 
   ia(cereal::make_nvp("nodes", own_nodes_));
 
@@ -605,6 +1080,9 @@ void nodes::load_model(InputArchive &ia) {
     nodes_.push_back(&*n);
   }
 
+  // before connecting, which would initialize weights of our own
+  if (weights) share_weights(*weights);
+
   if (typeid(*this) == typeid(sequential)) {
     dynamic_cast<sequential *>(this)->load_connections(ia);
   } else {
@@ -8,8 +8,9 @@
 #pragma once
 
 #include <algorithm>
-#include <unordered_map>
+#include <vector>
 
+#include "tiny_dnn/core/kernels/optimizer_kernels.h"
 #include "tiny_dnn/util/util.h"
 
 namespace tiny_dnn {
@@ -28,23 +29,106 @@ struct optimizer {
   virtual ~optimizer()               = default;
   virtual void update(const vec_t &dW, vec_t &W, bool parallelize) = 0;
   virtual void reset() {}  // override to implement pre-learning action
+
+  /**
+   * one optimization step of the whole model: update every W[i] by its
+   * gradient dW[i]. pass the parameters in the same order on every step.
+   **/
+  virtual void step(const std::vector<const vec_t *> &dW,
+                    const std::vector<vec_t *> &W) {
+    for (size_t i = 0; i < W.size(); i++) {
+      update(*dW[i], *W[i], parallel_update(W[i]->size()));
+    }
+  }
+
+  // parallelize only when the parameter is big enough to mitigate thread
+  // spawning overhead
+  static bool parallel_update(size_t size) { return size >= 512; }
+
+ protected:
+  // f(offset, length) over chunks of [0, size) large enough for a fused kernel
+  template <typename Func>
+  static void for_chunks(bool parallelize, size_t size, Func f) {
+    for_(parallelize, 0u, size,
+         [&](const blocked_range &r) { f(r.begin(), r.end() - r.begin()); },
+         1024);
+  }
 };
 
-// helper class to hold N values for each weight
+/**
+ * helper class to hold N values for each weight.
+ *
+ * the values of all parameters lie in N flat arenas, one slot per parameter
+ * in the order the parameters are first updated. parameters updated in the
+ * same order on every step find their slot without a search.
+ **/
 template <int N>
 struct stateful_optimizer : public optimizer {
+  void update(const vec_t &dW, vec_t &W, bool parallelize) override {
+    update_slot(dW, W, slot(W), parallelize);
+    end_step();
+  }
+
+  void step(const std::vector<const vec_t *> &dW,
+            const std::vector<vec_t *> &W) override {
+    next_ = 0;
+    for (size_t i = 0; i < W.size(); i++) {
+      update_slot(*dW[i], *W[i], slot(*W[i]), parallel_update(W[i]->size()));
+    }
+    end_step();
+  }
+
   void reset() override {
     for (auto &e : E_) e.clear();
+    slots_.clear();
+    next_ = 0;
   }
 
  protected:
+  struct param_slot {
+    const vec_t *key;
+    size_t offset;  // in the arenas
+    size_t size;
+  };
+
+  // update W by dW, with its values in the arenas at s
+  virtual void update_slot(const vec_t &dW,
+                           vec_t &W,
+                           const param_slot &s,
+                           bool parallelize) = 0;
+
+  // called once per update() or step(), after all parameters are updated
+  virtual void end_step() {}
+
   template <int Index>
-  vec_t &get(const vec_t &key) {
+  float_t *state(const param_slot &s) {
     static_assert(Index < N, "index out of range");
-    if (E_[Index][&key].empty()) E_[Index][&key].resize(key.size(), float_t());
-    return E_[Index][&key];
+    return E_[Index].data() + s.offset;
+  }
+
+  const param_slot &slot(const vec_t &key) {
+    size_t i = next_;
+    if (i >= slots_.size() || slots_[i].key != &key) {
+      i = 0;
+      while (i < slots_.size() && slots_[i].key != &key) i++;
+    }
+    if (i == slots_.size()) {
+      // slots start on a cache line
+      const size_t offset = E_[0].size();
+      const size_t padded = (key.size() + 15) / 16 * 16;
+      for (auto &e : E_) e.resize(offset + padded, float_t(0));
+      slots_.push_back({&key, offset, key.size()});
+    }
+    if (slots_[i].size != key.size()) {
+      throw nn_error("parameter size changed, reset the optimizer");
+    }
+    next_ = i + 1;
+    return slots_[i];
   }
-  std::unordered_map<const vec_t *, vec_t> E_[N];
+
+  vec_t E_[N];
+  std::vector<param_slot> slots_;
+  size_t next_ = 0;  // slot expected next
 };
 
 /**
@@ -57,11 +141,13 @@ struct stateful_optimizer : public optimizer {
 struct adagrad : public stateful_optimizer<1> {
   adagrad() : alpha(float_t(0.01)), eps(float_t(1e-8)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &g = get<0>(W);
-    for_i(parallelize, W.size(), [&](size_t i) {
-      g[i] += dW[i] * dW[i];
-      W[i] -= alpha * dW[i] / (std::sqrt(g[i]) + eps);
+  void update_slot(const vec_t &dW,
+                   vec_t &W,
+                   const param_slot &s,
+                   bool parallelize) override {
+    float_t *g = state<0>(s);
+    for_chunks(parallelize, W.size(), [&](size_t i, size_t n) {
+      kernels::adagrad_update(n, alpha, eps, &dW[i], &W[i], g + i);
     });
   }
 
@@ -79,12 +165,13 @@ struct adagrad : public stateful_optimizer<1> {
 struct RMSprop : public stateful_optimizer<1> {
   RMSprop() : alpha(float_t(0.0001)), mu(float_t(0.99)), eps(float_t(1e-8)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &g = get<0>(W);
-
-    for_i(parallelize, W.size(), [&](size_t i) {
-      g[i] = mu * g[i] + (1 - mu) * dW[i] * dW[i];
-      W[i] -= alpha * dW[i] / std::sqrt(g[i] + eps);
+  void update_slot(const vec_t &dW,
+                   vec_t &W,
+                   const param_slot &s,
+                   bool parallelize) override {
+    float_t *g = state<0>(s);
+    for_chunks(parallelize, W.size(), [&](size_t i, size_t n) {
+      kernels::rmsprop_update(n, alpha, mu, eps, &dW[i], &W[i], g + i);
     });
   }
 
@@ -109,19 +196,23 @@ struct adam : public stateful_optimizer<2> {
       b2_t(float_t(0.999)),
       eps(float_t(1e-8)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &mt = get<0>(W);
-    vec_t &vt = get<1>(W);
-
-    for_i(parallelize, W.size(), [&](size_t i) {
-      mt[i] = b1 * mt[i] + (float_t(1) - b1) * dW[i];
-      vt[i] = b2 * vt[i] + (float_t(1) - b2) * dW[i] * dW[i];
-
-      // L2 norm based update rule
-      W[i] -= alpha * (mt[i] / (float_t(1) - b1_t)) /
-              std::sqrt((vt[i] / (float_t(1) - b2_t)) + eps);
+  void update_slot(const vec_t &dW,
+                   vec_t &W,
+                   const param_slot &s,
+                   bool parallelize) override {
+    float_t *mt      = state<0>(s);
+    float_t *vt      = state<1>(s);
+    const float_t c1 = float_t(1) - b1_t;
+    const float_t c2 = float_t(1) - b2_t;
+
+    // L2 norm based update rule
+    for_chunks(parallelize, W.size(), [&](size_t i, size_t n) {
+      kernels::adam_update(n, alpha, b1, b2, c1, c2, eps, &dW[i], &W[i],
+                           mt + i, vt + i);
     });
+  }
 
+  void end_step() override {
     b1_t *= b1;
     b2_t *= b2;
   }
@@ -150,21 +241,23 @@ struct adamax : public stateful_optimizer<2> {
       b1_t(b1),
       eps(float_t(1e-8)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &mt = get<0>(W);
-    vec_t &ut = get<1>(W);
-
-    for_i(parallelize, W.size(), [&](int i) {
-      mt[i] = b1 * mt[i] + (float_t(1) - b1) * dW[i];
-      ut[i] = std::max(b2 * ut[i], std::abs(dW[i]));
-
-      // Lp norm based update rule
-      W[i] -= (alpha / (1.0 - b1_t)) * (mt[i] / (ut[i] + eps));
+  void update_slot(const vec_t &dW,
+                   vec_t &W,
+                   const param_slot &s,
+                   bool parallelize) override {
+    float_t *mt      = state<0>(s);
+    float_t *ut      = state<1>(s);
+    const float_t lr = static_cast<float_t>(alpha / (1.0 - b1_t));
+
+    // Lp norm based update rule
+    for_chunks(parallelize, W.size(), [&](size_t i, size_t n) {
+      kernels::adamax_update(n, lr, b1, b2, eps, &dW[i], &W[i], mt + i,
+                             ut + i);
     });
-
-    b1_t *= b1;
   }
 
+  void end_step() override { b1_t *= b1; }
+
   float_t alpha;  // learning rate
   float_t b1;     // decay term
   float_t b2;     // decay term
@@ -183,8 +276,9 @@ struct gradient_descent : public optimizer {
   gradient_descent() : alpha(float_t(0.01)), lambda(float_t(0)) {}
 
   void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    for_i(parallelize, W.size(),
-          [&](size_t i) { W[i] = W[i] - alpha * (dW[i] + lambda * W[i]); });
+    for_chunks(parallelize, W.size(), [&](size_t i, size_t n) {
+      kernels::sgd_update(n, alpha, lambda, &dW[i], &W[i]);
+    });
   }
 
   float_t alpha;   // learning rate
@@ -202,13 +296,14 @@ struct momentum : public stateful_optimizer<1> {
  public:
   momentum() : alpha(float_t(0.01)), lambda(float_t(0)), mu(float_t(0.9)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &dWprev = get<0>(W);
-
-    for_i(parallelize, W.size(), [&](size_t i) {
-      float_t V = mu * dWprev[i] - alpha * (dW[i] + W[i] * lambda);
-      W[i] += V;
-      dWprev[i] = V;
+  void update_slot(const vec_t &dW,
+                   vec_t &W,
+                   const param_slot &s,
+                   bool parallelize) override {
+    float_t *dWprev = state<0>(s);
+    for_chunks(parallelize, W.size(), [&](size_t i, size_t n) {
+      kernels::momentum_update(n, alpha, lambda, mu, false, &dW[i], &W[i],
+                               dWprev + i);
     });
   }
 
@@ -229,13 +324,14 @@ struct nesterov_momentum : public stateful_optimizer<1> {
   nesterov_momentum()
     : alpha(float_t(0.01)), lambda(float_t(0)), mu(float_t(0.9)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &dWprev = get<0>(W);
-
-    for_i(parallelize, W.size(), [&](size_t i) {
-      float_t V = mu * dWprev[i] - alpha * (dW[i] + W[i] * lambda);
-      W[i] += (-mu) * dWprev[i] + (1 + mu) * V;
-      dWprev[i] = V;
+  void update_slot(const vec_t &dW,
+                   vec_t &W,
+                   const param_slot &s,
+                   bool parallelize) override {
+    float_t *dWprev = state<0>(s);
+    for_chunks(parallelize, W.size(), [&](size_t i, size_t n) {
+      kernels::momentum_update(n, alpha, lambda, mu, true, &dW[i], &W[i],
+                               dWprev + i);
     });
   }
 
@@ -0,0 +1,263 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/layers/quantized_convolutional_layer.h"
+#include "tiny_dnn/layers/quantized_deconvolutional_layer.h"
+#include "tiny_dnn/layers/quantized_fully_connected_layer.h"
+#include "tiny_dnn/network.h"
+#include "tiny_dnn/util/activation_histogram.h"
+
+namespace tiny_dnn {
+
+/**
+ * settings of post_training_quantizer. percentile is the share of the
+ * values kept by calibration_method::percentile, in percent. kl_divergence
+ * clips harder and needs a large calibration set to fill its histograms.
+ * per_channel quantizes the weights of every output channel over a range
+ * of its own.
+ **/
+struct quantization_options {
+  calibration_method method = calibration_method::percentile;
+  float_t percentile        = float_t(99.99);
+  bool per_channel          = true;
+  size_t batch_size         = CNN_PREDICT_BATCH_SIZE;
+};
+
+/**
+ * calibrated ranges of the quantized layers, and the accuracy of the float
+ * and the quantized network
+ **/
+struct quantization_report {
+  struct layer_range {
+    size_t index;      // position of the layer in the network
+    std::string type;  // type of the float layer
+    std::pair<float_t, float_t> input;
+    std::pair<float_t, float_t> output;
+  };
+
+  std::vector<layer_range> layers;
+  size_t samples             = 0;  // number of labeled samples evaluated
+  float_t float_accuracy     = 0;  // in percent
+  float_t quantized_accuracy = 0;  // in percent
+  float_t max_output_error   = 0;  // largest difference of an output value
+
+  float_t accuracy_delta() const { return quantized_accuracy - float_accuracy; }
+
+  void print(std::ostream &os) const {
+    for (const auto &l : layers) {
+      os << "#" << l.index << " " << l.type << " in [" << l.input.first
+         << ", " << l.input.second << "] out [" << l.output.first << ", "
+         << l.output.second << "]" << std::endl;
+    }
+    os << "accuracy (" << samples << " samples): float " << float_accuracy
+       << "%, int8 " << quantized_accuracy << "%, delta " << accuracy_delta()
+       << "%" << std::endl;
+    os << "max output error: " << max_output_error << std::endl;
+  }
+};
+
+/**
+ * post-training 8-bit quantization of a trained float network.
+ *
+ * calibrate() runs the network over a set of representative inputs and
+ * records histograms of the inputs and outputs of its convolutional,
+ * deconvolutional and fully-connected layers. quantize() then writes a
+ * copy of the network in which these layers are replaced by their
+ * quantized counterparts, with activation ranges fixed to the calibrated
+ * ones instead of measured on every call, and evaluate() compares the
+ * accuracy of both:
+ *
+ *     post_training_quantizer<sequential> quantizer(net);
+ *     quantizer.calibrate(calibration_images);
+ *
+ *     network<sequential> int8_net;
+ *     quantizer.quantize(int8_net);
+ *     quantizer.evaluate(int8_net, test_images, test_labels).print(std::cout);
+ *
+ * the other layers stay in float. quantize before fusing layers, a layer
+ * with a fused activation can't be quantized. the calibrated ranges are
+ * saved with the model of the quantized network. requires serialization
+ * support (CNN_NO_SERIALIZATION undefined).
+ **/
+template <typename NetType>
+class post_training_quantizer {
+ public:
+  explicit post_training_quantizer(
+    network<NetType> &net,
+    const quantization_options &options = quantization_options())
+    : net_(net), options_(options) {
+    for (size_t i = 0; i < net_.layer_size(); i++) {
+      if (!quantizable(*net_[i])) continue;
+      if (net_[i]->fused_activation()) {
+        throw nn_error("cannot quantize a layer with a fused activation");
+      }
+      targets_.push_back(i);
+    }
+    inputs_.resize(targets_.size());
+    outputs_.resize(targets_.size());
+  }
+
+  /**
+   * run the float network over in and add the values of the activations
+   * of the layers to quantize to their histograms. may be called several
+   * times to calibrate on more samples.
+   **/
+  void calibrate(const std::vector<vec_t> &in) {
+    if (in.empty()) return;
+    const bool memory_planning = net_.memory_planning();
+    net_.set_memory_planning(false);  // keep all activations
+    net_.set_netphase(net_phase::test);
+    net_.predict_batch(&in[0], in.size(),
+                       [&](size_t, const tensor_t &) {
+                         for (size_t k = 0; k < targets_.size(); k++) {
+                           const layer *l = net_[targets_[k]];
+                           inputs_[k].add(*l->prev()[0]->get_data());
+                           outputs_[k].add(*l->next()[0]->get_data());
+                         }
+                       },
+                       options_.batch_size);
+    net_.set_memory_planning(memory_planning);
+  }
+
+  /**
+   * write the quantized copy of the network into dst
+   **/
+  void quantize(network<NetType> &dst) const {
+#ifndef CNN_NO_SERIALIZATION
+    if (!targets_.empty() && inputs_[0].count() == 0) {
+      throw nn_error("calibrate the network before quantizing it");
+    }
+    std::stringstream ss;
+    {
+      cereal::BinaryOutputArchive oa(ss);
+      net_.to_archive(oa, content_type::weights_and_model);
+    }
+    cereal::BinaryInputArchive ia(ss);
+    dst.from_archive(ia, content_type::weights_and_model);
+
+    for (size_t k = 0; k < targets_.size(); k++) {
+      dst.replace_layer(targets_[k], quantized_layer(*dst[targets_[k]], k));
+    }
+#else
+    CNN_UNREFERENCED_PARAMETER(dst);
+    throw nn_error("tiny-dnn was not built with Serialization support");
+#endif  // CNN_NO_SERIALIZATION
+  }
+
+  /**
+   * calibrated ranges of the layers quantize() replaces
+   **/
+  quantization_report report() const {
+    quantization_report r;
+    for (size_t k = 0; k < targets_.size(); k++) {
+      r.layers.push_back({targets_[k], net_[targets_[k]]->layer_type(),
+                          range(inputs_[k]), range(outputs_[k])});
+    }
+    return r;
+  }
+
+  /**
+   * report() with the accuracy of the float network and of quantized, the
+   * network written by quantize(), on the labeled samples in and t
+   **/
+  quantization_report evaluate(network<NetType> &quantized,
+                               const std::vector<vec_t> &in,
+                               const std::vector<label_t> &t) {
+    quantization_report r = report();
+    r.samples             = in.size();
+    if (in.empty()) return r;
+
+    net_.set_netphase(net_phase::test);
+    quantized.set_netphase(net_phase::test);
+    const std::vector<vec_t> expected =
+      net_.predict_batch(in, options_.batch_size);
+    const std::vector<vec_t> actual =
+      quantized.predict_batch(in, options_.batch_size);
+
+    size_t float_hits = 0, quantized_hits = 0;
+    for (size_t i = 0; i < in.size(); i++) {
+      float_hits += argmax(expected[i]) == t[i];
+      quantized_hits += argmax(actual[i]) == t[i];
+      for (size_t j = 0; j < expected[i].size(); j++) {
+        r.max_output_error = std::max(
+          r.max_output_error, std::abs(expected[i][j] - actual[i][j]));
+      }
+    }
+    r.float_accuracy     = float_t(100) * float_hits / in.size();
+    r.quantized_accuracy = float_t(100) * quantized_hits / in.size();
+    return r;
+  }
+
+ private:
+  static bool quantizable(const layer &l) {
+    return typeid(l) == typeid(convolutional_layer) ||
+           typeid(l) == typeid(deconvolutional_layer) ||
+           typeid(l) == typeid(fully_connected_layer);
+  }
+
+  static label_t argmax(const vec_t &v) {
+    return static_cast<label_t>(std::max_element(v.begin(), v.end()) -
+                                v.begin());
+  }
+
+  // calibrated range of an activation, with 0 on a code
+  std::pair<float_t, float_t> range(const activation_histogram &h) const {
+    std::pair<float_t, float_t> r =
+      h.range(options_.method, options_.percentile);
+    core::kernels::nudge_quantization_range(&r.first, &r.second);
+    return r;
+  }
+
+  core::quantization_params params(size_t k) const {
+    core::quantization_params q;
+    std::tie(q.min_input, q.max_input)   = range(inputs_[k]);
+    std::tie(q.min_output, q.max_output) = range(outputs_[k]);
+    q.per_channel                        = options_.per_channel;
+    return q;
+  }
+
+  // quantized counterpart of the k-th layer to quantize
+  std::shared_ptr<layer> quantized_layer(const layer &l, size_t k) const {
+    if (typeid(l) == typeid(convolutional_layer)) {
+      auto q = std::make_shared<quantized_convolutional_layer>(
+        dynamic_cast<const convolutional_layer &>(l));
+      q->set_quantization(params(k));
+      return q;
+    }
+    if (typeid(l) == typeid(deconvolutional_layer)) {
+      auto q = std::make_shared<quantized_deconvolutional_layer>(
+        dynamic_cast<const deconvolutional_layer &>(l));
+      q->set_quantization(params(k));
+      return q;
+    }
+    auto q = std::make_shared<quantized_fully_connected_layer>(
+      dynamic_cast<const fully_connected_layer &>(l));
+    q->set_quantization(params(k));
+    return q;
+  }
+
+  network<NetType> &net_;
+  quantization_options options_;
+  std::vector<size_t> targets_;  // indices of the layers to quantize
+  std::vector<activation_histogram> inputs_;
+  std::vector<activation_histogram> outputs_;
+};
+
+}  // namespace tiny_dnn
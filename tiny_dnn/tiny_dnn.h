@@ -9,6 +9,8 @@
 
 #include "tiny_dnn/config.h"
 #include "tiny_dnn/network.h"
+#include "tiny_dnn/execution_context.h"
+#include "tiny_dnn/post_training_quantizer.h"
 #include "tiny_dnn/nodes.h"
 
 #include "tiny_dnn/core/framework/tensor.h"
@@ -58,6 +60,7 @@
 #include "tiny_dnn/util/deform.h"
 #include "tiny_dnn/util/graph_visualizer.h"
 #include "tiny_dnn/util/product.h"
+#include "tiny_dnn/util/thread_pool.h"
 #include "tiny_dnn/util/weight_init.h"
 
 #include "tiny_dnn/io/cifar10_parser.h"
@@ -0,0 +1,222 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/util/nn_error.h"
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+
+/**
+ * how the range an activation is quantized over is chosen from its values
+ **/
+enum class calibration_method {
+  min_max,     ///< all values, the smallest to the largest
+  percentile,  ///< all but the given share of outliers on either side
+  kl_divergence  ///< the range losing the least information in 8 bits
+};
+
+/**
+ * histogram of the values of an activation over a range symmetric around 0.
+ * the range doubles whenever a value falls outside of it, so the histogram
+ * is filled in a single pass over a calibration set.
+ **/
+class activation_histogram {
+ public:
+  /**
+   * @param bins number of bins, a multiple of 4
+   **/
+  explicit activation_histogram(size_t bins = 2048)
+    : counts_(bins, 0),
+      limit_(0),
+      min_(std::numeric_limits<float_t>::max()),
+      max_(std::numeric_limits<float_t>::lowest()),
+      total_(0),
+      zeros_(0) {
+    if (bins == 0 || bins % 4 != 0) {
+      throw nn_error("number of histogram bins must be a multiple of 4");
+    }
+  }
+
+  void add(const vec_t &v) {
+    if (v.empty()) return;
+    auto range = std::minmax_element(v.begin(), v.end());
+    min_       = std::min(min_, *range.first);
+    max_       = std::max(max_, *range.second);
+    grow(std::max(std::abs(*range.first), std::abs(*range.second)));
+
+    total_ += v.size();
+    if (limit_ == float_t(0)) {  // all values so far are 0
+      zeros_ += v.size();
+      return;
+    }
+    const size_t bins   = counts_.size();
+    const float_t scale = float_t(bins) / (2 * limit_);
+    for (auto x : v) {
+      const float_t pos = (x + limit_) * scale;
+      const size_t bin  = pos <= 0 ? 0 : static_cast<size_t>(pos);
+      counts_[std::min(bin, bins - 1)]++;
+    }
+  }
+
+  void add(const tensor_t &t) {
+    for (const auto &v : t) add(v);
+  }
+
+  ///< number of values added
+  size_t count() const { return total_; }
+
+  float_t min() const { return min_; }
+
+  float_t max() const { return max_; }
+
+  /**
+   * range to quantize the values over
+   * @param percentile share of the values to keep, in percent
+   *                   (calibration_method::percentile only)
+   **/
+  std::pair<float_t, float_t> range(calibration_method method,
+                                    float_t percentile = float_t(99.99)) const {
+    if (total_ == 0) return {float_t(0), float_t(0)};
+    if (limit_ == float_t(0) || method == calibration_method::min_max) {
+      return {min_, max_};
+    }
+    if (method == calibration_method::percentile) {
+      return percentile_range(percentile);
+    }
+    return kl_range();
+  }
+
+ private:
+  float_t bin_width() const { return 2 * limit_ / float_t(counts_.size()); }
+
+  // double the range until it holds [-x, x], merging pairs of bins
+  void grow(float_t x) {
+    if (x <= limit_) return;
+    if (limit_ == float_t(0)) {
+      limit_ = x;
+      counts_[counts_.size() / 2] += zeros_;
+      zeros_ = 0;
+      return;
+    }
+    const size_t bins = counts_.size();
+    while (limit_ < x) {
+      std::vector<size_t> merged(bins, 0);
+      for (size_t i = 0; i < bins; i++) merged[bins / 4 + i / 2] += counts_[i];
+      counts_.swap(merged);
+      limit_ *= 2;
+    }
+  }
+
+  std::pair<float_t, float_t> percentile_range(float_t percentile) const {
+    const double outliers = total_ * (1.0 - percentile / 100.0);
+    const size_t bins     = counts_.size();
+
+    size_t lo = 0;
+    for (size_t below = 0; lo < bins; lo++) {
+      below += counts_[lo];
+      if (below > outliers) break;
+    }
+    size_t hi = bins;
+    for (size_t above = 0; hi > 0; hi--) {
+      above += counts_[hi - 1];
+      if (above > outliers) break;
+    }
+    const float_t w = bin_width();
+    return {std::max(min_, -limit_ + lo * w),
+            std::min(max_, -limit_ + hi * w)};
+  }
+
+  /**
+   * entropy calibration: the threshold t for [-t, t] whose 8-bit
+   * quantization diverges least (Kullback-Leibler) from the histogram of
+   * the absolute values, with the values beyond t clipped to it
+   **/
+  std::pair<float_t, float_t> kl_range() const {
+    const size_t half = counts_.size() / 2;
+    std::vector<double> hist(half);
+    for (size_t j = 0; j < half; j++) {
+      hist[j] = double(counts_[half + j] + counts_[half - 1 - j]);
+    }
+    // codes left for the magnitude of signed values
+    const size_t levels = (min_ >= 0 || max_ <= 0) ? 255 : 128;
+    if (half <= levels) return {min_, max_};
+
+    double beyond = 0;
+    for (auto c : hist) beyond += c;
+
+    size_t best     = half;
+    double best_div = std::numeric_limits<double>::max();
+    std::vector<double> p, q;
+    for (size_t i = 1; i <= half; i++) {
+      beyond -= hist[i - 1];
+      if (i < levels) continue;
+      p.assign(hist.begin(), hist.begin() + i);
+      p[i - 1] += beyond;
+
+      // p quantized to levels groups, each spread over its non-empty bins
+      q.assign(i, 0.0);
+      for (size_t g = 0; g < levels; g++) {
+        const size_t first = g * i / levels;
+        const size_t last  = (g + 1) * i / levels;
+        double sum         = 0;
+        size_t nonzero     = 0;
+        for (size_t j = first; j < last; j++) {
+          sum += hist[j];
+          nonzero += p[j] != 0;
+        }
+        for (size_t j = first; j < last; j++) {
+          if (p[j] != 0) q[j] = sum / nonzero;
+        }
+      }
+
+      const double div = divergence(p, q);
+      if (div < best_div) {
+        best_div = div;
+        best     = i;
+      }
+    }
+    const float_t t = best * bin_width();
+    return {std::max(min_, -t), std::min(max_, t)};
+  }
+
+  // Kullback-Leibler divergence of the normalized distributions p and q
+  static double divergence(const std::vector<double> &p,
+                           const std::vector<double> &q) {
+    double sum_p = 0, sum_q = 0;
+    for (size_t j = 0; j < p.size(); j++) {
+      sum_p += p[j];
+      sum_q += q[j];
+    }
+    if (sum_p == 0 || sum_q == 0) return std::numeric_limits<double>::max();
+    const double eps = 1e-12;
+    double div       = 0;
+    for (size_t j = 0; j < p.size(); j++) {
+      if (p[j] == 0) continue;
+      const double pj = p[j] / sum_p;
+      const double qj = std::max(q[j] / sum_q, eps);
+      div += pj * std::log(pj / qj);
+    }
+    return div;
+  }
+
+  std::vector<size_t> counts_;  // bins over [-limit_, limit_)
+  float_t limit_;
+  float_t min_;
+  float_t max_;
+  size_t total_;
+  size_t zeros_;  // values added while limit_ was 0
+};
+
+}  // namespace tiny_dnn
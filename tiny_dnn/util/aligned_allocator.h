@@ -8,7 +8,9 @@
 #pragma once
 
 #include <stdlib.h>
+#include <functional>
 #include <string>
+#include <type_traits>
 #include <utility>
 
 #ifdef _WIN32
@@ -39,11 +41,32 @@ class aligned_allocator {
     typedef aligned_allocator<U, alignment> other;
   };
 
+  // the allocator moves with the memory it handed out
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
   aligned_allocator() {}
 
+  /**
+   * allocator whose first allocation of exactly size elements returns the
+   * memory at data instead of allocating, e.g. a memory-mapped file. the
+   * values found there are kept: default construction leaves them as they
+   * are, and the memory is not freed. data must stay valid as long as it is
+   * used, and must be aligned to alignment.
+   **/
+  aligned_allocator(T *data, size_type size)
+    : external_(data), external_size_(size) {}
+
   template <typename U>
   aligned_allocator(const aligned_allocator<U, alignment> &) {}
 
+  // copies of a container allocate memory of their own
+  aligned_allocator select_on_container_copy_construction() const {
+    return aligned_allocator();
+  }
+
+  const T *external() const { return external_; }
+
   const_pointer address(const_reference value) const {
     return std::addressof(value);
   }
@@ -51,6 +74,10 @@ class aligned_allocator {
   pointer address(reference value) const { return std::addressof(value); }
 
   pointer allocate(size_type size, const void * = nullptr) {
+    if (external_ && !external_taken_ && size == external_size_) {
+      external_taken_ = true;
+      return external_;
+    }
     void *p = aligned_alloc(alignment, sizeof(T) * size);
     if (!p && size > 0) throw nn_error("failed to allocate");
     return static_cast<pointer>(p);
@@ -60,7 +87,9 @@ class aligned_allocator {
     return ~static_cast<std::size_t>(0) / sizeof(T);
   }
 
-  void deallocate(pointer ptr, size_type) { aligned_free(ptr); }
+  void deallocate(pointer ptr, size_type) {
+    if (ptr != external_) aligned_free(ptr);
+  }
 
   template <class U, class V>
   void construct(U *ptr, const V &value) {
@@ -77,7 +106,11 @@ class aligned_allocator {
   template <class U>
   void construct(U *ptr) {
     void *p = ptr;
-    ::new (p) U();
+    if (is_external(p)) {
+      ::new (p) U;
+    } else {
+      ::new (p) U();
+    }
   }
 
   template <class U>
@@ -86,6 +119,12 @@ class aligned_allocator {
   }
 
  private:
+  bool is_external(const void *p) const {
+    std::less<const void *> less;
+    return external_ && !less(p, external_) &&
+           less(p, external_ + external_size_);
+  }
+
   void *aligned_alloc(size_type align, size_type size) const {
 #if defined(_MSC_VER)
     return ::_aligned_malloc(size, align);
@@ -111,18 +150,24 @@ class aligned_allocator {
     ::free(ptr);
 #endif
   }
+
+  T *external_             = nullptr;
+  size_type external_size_ = 0;
+  bool external_taken_     = false;
 };
 
+// allocators are interchangeable unless one of them hands out external memory
 template <typename T1, typename T2, std::size_t alignment>
-inline bool operator==(const aligned_allocator<T1, alignment> &,
-                       const aligned_allocator<T2, alignment> &) {
-  return true;
+inline bool operator==(const aligned_allocator<T1, alignment> &a,
+                       const aligned_allocator<T2, alignment> &b) {
+  return static_cast<const void *>(a.external()) ==
+         static_cast<const void *>(b.external());
 }
 
 template <typename T1, typename T2, std::size_t alignment>
-inline bool operator!=(const aligned_allocator<T1, alignment> &,
-                       const aligned_allocator<T2, alignment> &) {
-  return false;
+inline bool operator!=(const aligned_allocator<T1, alignment> &a,
+                       const aligned_allocator<T2, alignment> &b) {
+  return !(a == b);
 }
 
 }  // namespace tiny_dnn
@@ -0,0 +1,231 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+
+/**
+ * non-owning view over a batch of equally sized samples.
+ *
+ * samples are laid out back-to-back (NCHW), so the whole batch can be handed
+ * to GEMM-style kernels as one row-major [sample_count x sample_size] matrix
+ * with leading dimension stride().
+ *
+ *     batch_view<float_t> v = e->batch_data();
+ *     float_t *x = v[sample];  // x[0] ... x[v.sample_size() - 1]
+ **/
+template <typename T>
+class batch_view {
+ public:
+  typedef T value_type;
+
+  batch_view()
+    : data_(nullptr), sample_size_(0), sample_count_(0), stride_(0) {}
+
+  batch_view(T *data, size_t sample_size, size_t sample_count)
+    : batch_view(data, sample_size, sample_count, sample_size) {}
+
+  batch_view(T *data, size_t sample_size, size_t sample_count, size_t stride)
+    : data_(data),
+      sample_size_(sample_size),
+      sample_count_(sample_count),
+      stride_(stride) {
+    assert(stride_ >= sample_size_);
+  }
+
+  // implicit conversion to read-only view
+  operator batch_view<const T>() const {
+    return batch_view<const T>(data_, sample_size_, sample_count_, stride_);
+  }
+
+  T *operator[](size_t sample) const {
+    assert(sample < sample_count_);
+    return data_ + sample * stride_;
+  }
+
+  T *data() const { return data_; }
+
+  size_t sample_size() const { return sample_size_; }
+
+  size_t sample_count() const { return sample_count_; }
+
+  ///< distance (in elements) between first elements of adjacent samples
+  size_t stride() const { return stride_; }
+
+  ///< number of elements referenced by this view
+  size_t size() const { return sample_size_ * sample_count_; }
+
+  bool empty() const { return sample_count_ == 0 || sample_size_ == 0; }
+
+  ///< true if the samples are packed without gaps
+  bool contiguous() const { return stride_ == sample_size_; }
+
+  /**
+   * view of [first, first + count) samples
+   **/
+  batch_view subview(size_t first, size_t count) const {
+    assert(first + count <= sample_count_);
+    return batch_view(data_ + first * stride_, sample_size_, count, stride_);
+  }
+
+ private:
+  T *data_;
+  size_t sample_size_;
+  size_t sample_count_;
+  size_t stride_;
+};
+
+namespace detail {
+
+template <typename T, typename Tensor>
+batch_view<T> rows_batch_view(Tensor &t) {
+  if (t.empty() || t[0].empty()) return batch_view<T>();
+  const size_t size  = t[0].size();
+  const auto address = [&](size_t sample) {
+    return reinterpret_cast<std::uintptr_t>(&t[sample][0]);
+  };
+  const std::uintptr_t first = address(0);
+  size_t stride              = size;
+  if (t.size() > 1) {
+    const std::uintptr_t next = address(1);
+    if (next < first + size * sizeof(float_t) ||
+        (next - first) % sizeof(float_t) != 0) {
+      return batch_view<T>();
+    }
+    stride = (next - first) / sizeof(float_t);
+  }
+  for (size_t sample = 1; sample < t.size(); ++sample) {
+    if (t[sample].size() != size ||
+        address(sample) != first + sample * stride * sizeof(float_t)) {
+      return batch_view<T>();
+    }
+  }
+  return batch_view<T>(&t[0][0], size, t.size(), stride);
+}
+
+}  // namespace detail
+
+/**
+ * the samples of t as one matrix, if they lie at a constant stride, e.g.
+ * the data of an edge with edge_storage::contiguous or of a view made by
+ * edge::make_view_of. an empty view is returned otherwise, and the samples
+ * have to be gathered first.
+ **/
+inline batch_view<float_t> as_batch_view(tensor_t &t) {
+  return detail::rows_batch_view<float_t>(t);
+}
+
+inline batch_view<const float_t> as_batch_view(const tensor_t &t) {
+  return detail::rows_batch_view<const float_t>(t);
+}
+
+/**
+ * contiguous NCHW storage for a batch of samples.
+ *
+ * one aligned heap block holds every sample, so resizing the batch does not
+ * touch the allocator unless it grows beyond the largest size seen so far.
+ **/
+class batch_storage {
+ public:
+  explicit batch_storage(size_t sample_size = 0, size_t sample_count = 0)
+    : sample_size_(sample_size), sample_count_(0) {
+    resize(sample_count);
+  }
+
+  /**
+   * change the number of samples.
+   * existing samples are kept, new samples are zero-filled.
+   **/
+  void resize(size_t sample_count) {
+    const size_t required = sample_count * sample_size_;
+    if (buffer_.size() < required) {
+      buffer_.resize(required, float_t{0});
+    } else if (sample_count > sample_count_) {
+      std::fill(buffer_.begin() + sample_count_ * sample_size_,
+                buffer_.begin() + required, float_t{0});
+    }
+    sample_count_ = sample_count;
+  }
+
+  void fill(float_t value) {
+    if (sample_count_ == 0) return;
+    vectorize::fill(&buffer_[0], sample_count_ * sample_size_, value);
+  }
+
+  float_t *operator[](size_t sample) {
+    assert(sample < sample_count_);
+    return &buffer_[sample * sample_size_];
+  }
+
+  const float_t *operator[](size_t sample) const {
+    assert(sample < sample_count_);
+    return &buffer_[sample * sample_size_];
+  }
+
+  batch_view<float_t> view() {
+    return batch_view<float_t>(buffer_.empty() ? nullptr : &buffer_[0],
+                               sample_size_, sample_count_);
+  }
+
+  batch_view<const float_t> view() const {
+    return batch_view<const float_t>(buffer_.empty() ? nullptr : &buffer_[0],
+                                     sample_size_, sample_count_);
+  }
+
+  size_t sample_size() const { return sample_size_; }
+
+  size_t sample_count() const { return sample_count_; }
+
+  ///< number of elements currently reserved by this storage
+  size_t capacity() const { return buffer_.size(); }
+
+  ///< true if sample s of t is a view of sample s of this storage
+  bool holds(const tensor_t &t) const {
+    if (t.size() != sample_count_) return false;
+    for (size_t sample = 0; sample < sample_count_; ++sample) {
+      if (t[sample].empty() || &t[sample][0] != (*this)[sample]) return false;
+    }
+    return true;
+  }
+
+  /**
+   * gather per-sample vectors into this storage
+   **/
+  void copy_from(const tensor_t &src) {
+    resize(src.size());
+    for (size_t sample = 0; sample < src.size(); ++sample) {
+      assert(src[sample].size() == sample_size_);
+      std::copy(src[sample].begin(), src[sample].end(), (*this)[sample]);
+    }
+  }
+
+  /**
+   * scatter this storage into per-sample vectors
+   **/
+  void copy_to(tensor_t &dst) const {
+    dst.resize(sample_count_);
+    for (size_t sample = 0; sample < sample_count_; ++sample) {
+      const float_t *src = (*this)[sample];
+      dst[sample].assign(src, src + sample_size_);
+    }
+  }
+
+ private:
+  size_t sample_size_;
+  size_t sample_count_;
+  vec_t buffer_;
+};
+
+}  // namespace tiny_dnn
@@ -7,6 +7,8 @@
 */
 #pragma once
 
+#include <cstdarg>
+#include <cstdio>
 #include <string>
 
 #include "tiny_dnn/config.h"
@@ -0,0 +1,104 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+  defined(_M_IX86)
+#define CNN_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif  // x86
+
+/**
+ * compile one function for an instruction set the rest of the build may not
+ * be compiled for (e.g. AVX2 without -mavx2). such a function must only be
+ * called after checking cpu_features().
+ **/
+#if defined(__GNUC__) || defined(__clang__)
+#define CNN_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CNN_TARGET(isa)
+#endif
+
+namespace tiny_dnn {
+
+/**
+ * instruction set extensions of the processor the program runs on, usable
+ * only if the operating system also saves their registers
+ **/
+struct cpu_feature_set {
+  bool avx2        = false;
+  bool avx512bw    = false;
+  bool avx512_vnni = false;
+};
+
+namespace detail {
+
+#ifdef CNN_X86
+inline void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+  int r[4];
+  __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+  for (int i = 0; i < 4; i++) regs[i] = static_cast<uint32_t>(r[i]);
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// register state the operating system saves on context switches (XCR0)
+inline uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  uint32_t lo, hi;
+  __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+}
+#endif  // CNN_X86
+
+inline cpu_feature_set detect_cpu_features() {
+  cpu_feature_set f;
+#ifdef CNN_X86
+  uint32_t r[4];
+  cpuid(0, 0, r);
+  if (r[0] < 7) return f;
+
+  cpuid(1, 0, r);
+  const bool osxsave = (r[2] & (1u << 27)) != 0;
+  const bool avx     = (r[2] & (1u << 28)) != 0;
+  if (!osxsave || !avx) return f;
+  const uint64_t xcr0 = xgetbv0();
+  const bool ymm      = (xcr0 & 0x6) == 0x6;    // xmm, ymm
+  const bool zmm      = (xcr0 & 0xe6) == 0xe6;  // and opmask, zmm
+
+  cpuid(7, 0, r);
+  const bool avx512f = zmm && (r[1] & (1u << 16)) != 0;
+  f.avx2             = ymm && (r[1] & (1u << 5)) != 0;
+  f.avx512bw         = avx512f && (r[1] & (1u << 30)) != 0;
+  f.avx512_vnni      = f.avx512bw && (r[2] & (1u << 11)) != 0;
+#endif  // CNN_X86
+  return f;
+}
+
+}  // namespace detail
+
+/**
+ * features of this processor, detected on the first call
+ **/
+inline const cpu_feature_set &cpu_features() {
+  static const cpu_feature_set features = detail::detect_cpu_features();
+  return features;
+}
+
+}  // namespace tiny_dnn
@@ -17,4 +17,17 @@ inline vec_t corrupt(vec_t &&in, float_t corruption_level, float_t min_value) {
   return in;
 }
 
+/**
+ * set each value of in to min_value with probability corruption_level,
+ * drawing from rng instead of the shared generator
+ **/
+inline void corrupt(vec_t &in,
+                    float_t corruption_level,
+                    float_t min_value,
+                    std::mt19937 &rng) {
+  std::bernoulli_distribution hit(corruption_level);
+  for (size_t i = 0; i < in.size(); i++)
+    if (hit(rng)) in[i] = min_value;
+}
+
 }  // namespace tiny_dnn
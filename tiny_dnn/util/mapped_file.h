@@ -0,0 +1,123 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CNN_HAS_MMAP
+#endif
+
+#include "tiny_dnn/util/aligned_allocator.h"
+#include "tiny_dnn/util/nn_error.h"
+
+namespace tiny_dnn {
+
+/**
+ * a whole file mapped into memory, copy-on-write.
+ *
+ * pages are read from the file on first access and shared by all processes
+ * that map the same file as long as nobody writes to them; a write gives
+ * the writing process a private copy of the page and never reaches the
+ * file. the mapping starts on a page boundary. on platforms without
+ * memory mapping the file is read into an aligned buffer instead.
+ **/
+class mapped_file {
+ public:
+  explicit mapped_file(const std::string &filename) {
+#if defined(_WIN32)
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      throw nn_error("failed to open:" + filename);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+      close();
+      throw nn_error("failed to map:" + filename);
+    }
+    size_    = static_cast<size_t>(size.QuadPart);
+    mapping_ =
+      CreateFileMappingA(file_, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (mapping_) data_ = MapViewOfFile(mapping_, FILE_MAP_COPY, 0, 0, 0);
+    if (!data_) {
+      close();
+      throw nn_error("failed to map:" + filename);
+    }
+#elif defined(CNN_HAS_MMAP)
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw nn_error("failed to open:" + filename);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      throw nn_error("failed to map:" + filename);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void *p =
+      ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // the mapping keeps the file open
+    if (p == MAP_FAILED) throw nn_error("failed to map:" + filename);
+    data_ = p;
+#else
+    std::ifstream ifs(filename.c_str(), std::ios::binary | std::ios::ate);
+    if (ifs.fail()) throw nn_error("failed to open:" + filename);
+    size_ = static_cast<size_t>(ifs.tellg());
+    buffer_.resize(size_);
+    ifs.seekg(0);
+    if (size_ == 0 ||
+        !ifs.read(reinterpret_cast<char *>(&buffer_[0]), size_)) {
+      throw nn_error("failed to read:" + filename);
+    }
+    data_ = &buffer_[0];
+#endif
+  }
+
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  ~mapped_file() { close(); }
+
+  uint8_t *data() const { return static_cast<uint8_t *>(data_); }
+
+  size_t size() const { return size_; }
+
+ private:
+  void close() {
+#if defined(_WIN32)
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#elif defined(CNN_HAS_MMAP)
+    if (data_) ::munmap(data_, size_);
+#endif
+    data_ = nullptr;
+  }
+
+  void *data_  = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  HANDLE file_    = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+#elif !defined(CNN_HAS_MMAP)
+  std::vector<uint8_t, aligned_allocator<uint8_t, 4096>> buffer_;
+#endif
+};
+
+}  // namespace tiny_dnn
@@ -0,0 +1,196 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "tiny_dnn/util/nn_error.h"
+
+namespace tiny_dnn {
+
+/**
+ * static assignment of buffers to a small set of reusable memory slots.
+ *
+ * a buffer is written by one step and read by any number of later steps.
+ * two buffers can share a slot if every reader of the first has finished
+ * before the writer of the second starts (liveness analysis). steps are
+ * numbered in a topological order and by default run one after another;
+ * add_dependency() describes a partial order instead, e.g. the steps of a
+ * task_graph which runs independent steps concurrently.
+ *
+ *     memory_planner p(3);
+ *     size_t a = p.add_buffer(0, 100);  // written by step 0
+ *     p.add_reader(a, 1);
+ *     size_t b = p.add_buffer(1, 50);   // step 1 reads a, writes b
+ *     p.add_reader(b, 2);
+ *     size_t c = p.add_buffer(2, 80);   // reuses the slot of a
+ *     p.plan();
+ *
+ * buffers without readers stay alive until the end and are never reused.
+ **/
+class memory_planner {
+ public:
+  explicit memory_planner(size_t steps = 0)
+    : pred_(steps), ordered_(true), planned_(false) {}
+
+  size_t steps() const { return pred_.size(); }
+
+  /**
+   * declare a buffer of size elements written by step writer
+   * @return index of the buffer
+   **/
+  size_t add_buffer(size_t writer, size_t size) {
+    if (writer >= steps()) throw nn_error("invalid step");
+    buffers_.push_back(buffer{writer, size, {}});
+    planned_ = false;
+    return buffers_.size() - 1;
+  }
+
+  /**
+   * declare that step reads buffer
+   **/
+  void add_reader(size_t buffer, size_t step) {
+    if (buffer >= buffers_.size() || step >= steps() ||
+        step <= buffers_[buffer].writer) {
+      throw nn_error("invalid buffer reader");
+    }
+    buffers_[buffer].readers.push_back(step);
+    planned_ = false;
+  }
+
+  /**
+   * let step after run only when step before has finished. once a
+   * dependency is given, steps without a path between them are assumed to
+   * run concurrently.
+   **/
+  void add_dependency(size_t before, size_t after) {
+    if (before >= after || after >= steps()) {
+      throw nn_error("dependencies must follow the step order");
+    }
+    pred_[after].push_back(before);
+    ordered_ = false;
+    planned_ = false;
+  }
+
+  /**
+   * assign every buffer to a slot. buffers are placed in the order of their
+   * writers, each one into the free slot closest in size (best fit).
+   **/
+  void plan() {
+    compute_ancestors();
+
+    std::vector<size_t> order(buffers_.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+      return buffers_[a].writer < buffers_[b].writer;
+    });
+
+    slot_of_.assign(buffers_.size(), 0);
+    slot_size_.clear();
+    std::vector<size_t> last;  // last buffer placed into each slot
+    for (size_t b : order) {
+      const size_t size = buffers_[b].size;
+      size_t best       = slot_size_.size();
+      for (size_t s = 0; s < slot_size_.size(); s++) {
+        if (!released_before(last[s], buffers_[b].writer)) continue;
+        if (best == slot_size_.size() || better_fit(s, best, size)) best = s;
+      }
+      if (best == slot_size_.size()) {
+        slot_size_.push_back(0);
+        last.push_back(b);
+      }
+      slot_size_[best] = std::max(slot_size_[best], size);
+      last[best]       = b;
+      slot_of_[b]      = best;
+    }
+    planned_ = true;
+  }
+
+  size_t num_slots() const { return slot_size_.size(); }
+
+  ///< slot assigned to buffer by plan()
+  size_t slot(size_t buffer) const {
+    check_planned();
+    return slot_of_[buffer];
+  }
+
+  ///< size of the largest buffer assigned to slot
+  size_t slot_size(size_t slot) const {
+    check_planned();
+    return slot_size_[slot];
+  }
+
+  ///< memory needed by all slots, in elements
+  size_t total_size() const {
+    check_planned();
+    return std::accumulate(slot_size_.begin(), slot_size_.end(), size_t(0));
+  }
+
+ private:
+  struct buffer {
+    size_t writer;
+    size_t size;
+    std::vector<size_t> readers;
+  };
+
+  void check_planned() const {
+    if (!planned_) throw nn_error("memory_planner::plan() was not called");
+  }
+
+  // true if step a has finished before step b starts
+  bool happens_before(size_t a, size_t b) const {
+    if (ordered_) return a < b;
+    return (ancestors_[b][a / 64] >> (a % 64)) & 1;
+  }
+
+  // true if buffer b is dead by the time step starts
+  bool released_before(size_t b, size_t step) const {
+    const std::vector<size_t> &readers = buffers_[b].readers;
+    if (readers.empty()) return false;
+    return std::all_of(readers.begin(), readers.end(),
+                       [&](size_t r) { return happens_before(r, step); });
+  }
+
+  // prefer the smallest slot holding size without growing, otherwise the
+  // largest one, which grows the least
+  bool better_fit(size_t s, size_t best, size_t size) const {
+    const bool fits_s    = slot_size_[s] >= size;
+    const bool fits_best = slot_size_[best] >= size;
+    if (fits_s != fits_best) return fits_s;
+    return fits_s ? slot_size_[s] < slot_size_[best]
+                  : slot_size_[s] > slot_size_[best];
+  }
+
+  void compute_ancestors() {
+    ancestors_.clear();
+    if (ordered_) return;
+    const size_t words = (steps() + 63) / 64;
+    ancestors_.assign(steps(), std::vector<uint64_t>(words, 0));
+    for (size_t step = 0; step < steps(); step++) {
+      for (size_t p : pred_[step]) {
+        for (size_t w = 0; w < words; w++) {
+          ancestors_[step][w] |= ancestors_[p][w];
+        }
+        ancestors_[step][p / 64] |= uint64_t(1) << (p % 64);
+      }
+    }
+  }
+
+  std::vector<buffer> buffers_;
+  std::vector<std::vector<size_t>> pred_;
+  std::vector<std::vector<uint64_t>> ancestors_;
+  std::vector<size_t> slot_of_;
+  std::vector<size_t> slot_size_;
+  bool ordered_;
+  bool planned_;
+};
+
+}  // namespace tiny_dnn
@@ -7,10 +7,12 @@
 */
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <limits>
 #include <string>
+#include <thread>  // NOLINT
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -28,8 +30,7 @@
 #endif
 
 #if !defined(CNN_USE_OMP) && !defined(CNN_SINGLE_THREAD)
-#include <future>  // NOLINT
-#include <thread>  // NOLINT
+#include "tiny_dnn/util/thread_pool.h"
 #endif
 
 #if defined(CNN_USE_GCD) && !defined(CNN_SINGLE_THREAD)
@@ -82,15 +83,21 @@ void xparallel_for(size_t begin, size_t end, const Func &f) {
 #if defined(CNN_USE_OMP)
 
 template <typename Func>
-void parallel_for(size_t begin,
-                  size_t end,
-                  const Func &f,
-                  size_t /*grainsize*/) {
+void parallel_for(size_t begin, size_t end, const Func &f, size_t grainsize) {
   assert(end >= begin);
+  size_t count     = end - begin;
+  size_t blockSize = grainsize;
+  if (count <= blockSize || blockSize == 0) {
+    blockSize = 1;
+  }
+  int blockCount = static_cast<int>((count + blockSize - 1) / blockSize);
 // unsigned index isn't allowed in OpenMP 2.0
 #pragma omp parallel for
-  for (int i = static_cast<int>(begin); i < static_cast<int>(end); ++i)
-    f(blocked_range(i, i + 1));
+  for (int block = 0; block < blockCount; ++block) {
+    size_t blockStart = begin + block * blockSize;
+    size_t blockEnd   = std::min(blockStart + blockSize, end);
+    f(blocked_range(blockStart, blockEnd));
+  }
 }
 
 #elif defined(CNN_USE_GCD)
@@ -131,35 +138,19 @@ void parallel_for(size_t begin,
 
 #else
 
+/**
+ * runs on the persistent work-stealing pool, see thread_pool.h.
+ * use thread_pool::get_instance() to change the number of threads or
+ * their CPU affinity at runtime.
+ **/
 template <typename Func>
-void parallel_for(size_t begin,
-                  size_t end,
-                  const Func &f,
-                  size_t /*grainsize*/) {
+void parallel_for(size_t begin, size_t end, const Func &f, size_t grainsize) {
   assert(end >= begin);
-  size_t nthreads  = std::thread::hardware_concurrency();
-  size_t blockSize = (end - begin) / nthreads;
-  if (blockSize * nthreads < end - begin) blockSize++;
-
-  std::vector<std::future<void> > futures;
-
-  size_t blockBegin            = begin;
-  size_t blockEnd              = blockBegin + blockSize;
-  if (blockEnd > end) blockEnd = end;
-
-  for (size_t i = 0; i < nthreads; i++) {
-    futures.push_back(
-      std::move(std::async(std::launch::async, [blockBegin, blockEnd, &f] {
-        f(blocked_range(blockBegin, blockEnd));
-      })));
-
-    blockBegin += blockSize;
-    blockEnd = blockBegin + blockSize;
-    if (blockBegin >= end) break;
-    if (blockEnd > end) blockEnd = end;
-  }
-
-  for (auto &future : futures) future.wait();
+  thread_pool::get_instance().parallel_for(
+    begin, end, grainsize,
+    [&f](size_t blockBegin, size_t blockEnd) {
+      f(blocked_range(blockBegin, blockEnd));
+    });
 }
 
 #endif
@@ -210,4 +201,50 @@ inline void for_i(T size, Func f, size_t grainsize = 100) {
   for_i(true, size, f, grainsize);
 }
 
+/**
+ * number of threads parallel_for distributes work to
+ **/
+inline size_t parallel_concurrency() {
+#if defined(CNN_SINGLE_THREAD)
+  return 1;
+#elif defined(CNN_USE_TBB) || defined(CNN_USE_OMP) || defined(CNN_USE_GCD)
+  return std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+#else
+  return thread_pool::get_instance().num_threads();
+#endif
+}
+
+/**
+ * index of the partial sum which sample contributes to, when sample_count
+ * samples are split into partial_count contiguous chunks as in for_partials
+ **/
+inline size_t partial_index(size_t sample,
+                            size_t sample_count,
+                            size_t partial_count) {
+  return ((sample + 1) * partial_count - 1) / sample_count;
+}
+
+/**
+ * call f(partial, sample) for every sample in [0, sample_count), split into
+ * partial_count contiguous chunks which run in parallel. the samples of a
+ * chunk are visited in order by one task, so each partial sum is
+ * accumulated without synchronization and in the same order regardless of
+ * the thread count. with partial_count == sample_count this is for_i.
+ **/
+template <typename Func>
+inline void for_partials(bool parallelize,
+                         size_t sample_count,
+                         size_t partial_count,
+                         Func f) {
+  for_i(parallelize, partial_count,
+        [&](size_t partial) {
+          const size_t begin = partial * sample_count / partial_count;
+          const size_t end   = (partial + 1) * sample_count / partial_count;
+          for (size_t sample = begin; sample < end; sample++) {
+            f(partial, sample);
+          }
+        },
+        1u);
+}
+
 }  // namespace tiny_dnn
@@ -7,10 +7,17 @@
 */
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <limits>
 #include <random>
 #include <type_traits>
 
+#ifdef CNN_USE_SSE
+#include <emmintrin.h>
+#endif
+
 #include "tiny_dnn/config.h"
 #include "tiny_dnn/util/nn_error.h"
 
@@ -68,6 +75,176 @@ inline bool bernoulli(float_t p) {
   return uniform_rand(float_t{0}, float_t{1}) <= p;
 }
 
+/**
+ * Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+ * numbers: as easy as 1, 2, 3", SC'11).
+ *
+ * each 128-bit counter is mapped to 4 random 32-bit words under a 64-bit
+ * key, with no state carried from one draw to the next. a stream can thus
+ * be split into independent substreams (e.g. one per sample) and any word
+ * of it drawn directly, from any thread, with the same result as drawing
+ * the words in order on a single thread.
+ **/
+class philox4x32 {
+ public:
+  typedef std::array<uint32_t, 4> counter_type;
+
+  explicit philox4x32(uint64_t key)
+    : k0_(static_cast<uint32_t>(key)), k1_(static_cast<uint32_t>(key >> 32)) {}
+
+  counter_type operator()(counter_type c) const {
+    uint32_t k0 = k0_, k1 = k1_;
+    for (int r = 0; r < kRounds; r++) {
+      const uint64_t p0 = uint64_t(kM0) * c[0];
+      const uint64_t p1 = uint64_t(kM1) * c[2];
+      c = {{static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k0,
+            static_cast<uint32_t>(p1),
+            static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k1,
+            static_cast<uint32_t>(p0)}};
+      k0 += kW0;
+      k1 += kW1;
+    }
+    return c;
+  }
+
+  /**
+   * words [first, first + n) of the substream (c1, c2, c3), i.e. dst[i] is
+   * word (first + i) % 4 of counter ((first + i) / 4, c1, c2, c3).
+   * first must be a multiple of 4.
+   **/
+  void generate(uint32_t c1,
+                uint32_t c2,
+                uint32_t c3,
+                size_t first,
+                uint32_t *dst,
+                size_t n) const {
+    uint32_t block = static_cast<uint32_t>(first / 4);
+    size_t i       = 0;
+#ifdef CNN_USE_SSE
+    for (; i + 16 <= n; i += 16, block += 4) {
+      generate16_sse(block, c1, c2, c3, dst + i);
+    }
+#endif
+    for (; i < n; i += 4, block++) {
+      const counter_type r = (*this)({{block, c1, c2, c3}});
+      std::copy(r.begin(), r.begin() + std::min<size_t>(4, n - i), dst + i);
+    }
+  }
+
+  /**
+   * Bernoulli draws from words [first, first + n) of the substream
+   * (c1, c2, c3), packed in bits: bit i % 32 of bits[i / 32] is set if
+   * word first + i is below threshold, i.e. with probability
+   * threshold / 2^32. the bits past n in the last word are cleared.
+   * first must be a multiple of 4.
+   **/
+  void bernoulli(uint32_t c1,
+                 uint32_t c2,
+                 uint32_t c3,
+                 size_t first,
+                 uint32_t threshold,
+                 uint32_t *bits,
+                 size_t n) const {
+    uint32_t words[16];
+    std::fill(bits, bits + (n + 31) / 32, 0u);
+    size_t i = 0;
+#ifdef CNN_USE_SSE
+    // unsigned comparison through the signed one, with the signs flipped
+    const __m128i sign = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+    const __m128i t =
+      _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(threshold)), sign);
+    const __m128i *w = reinterpret_cast<const __m128i *>(words);
+    for (; i + 16 <= n; i += 16) {
+      generate16_sse(static_cast<uint32_t>((first + i) / 4), c1, c2, c3,
+                     words);
+      __m128i below[4];
+      for (int j = 0; j < 4; j++) {
+        below[j] =
+          _mm_cmplt_epi32(_mm_xor_si128(_mm_loadu_si128(w + j), sign), t);
+      }
+      const __m128i bytes =
+        _mm_packs_epi16(_mm_packs_epi32(below[0], below[1]),
+                        _mm_packs_epi32(below[2], below[3]));
+      bits[i / 32] |= static_cast<uint32_t>(_mm_movemask_epi8(bytes))
+                      << (i % 32);
+    }
+#endif
+    for (; i < n; i += 16) {
+      const size_t len = std::min<size_t>(16, n - i);
+      generate(c1, c2, c3, first + i, words, len);
+      for (size_t j = 0; j < len; j++) {
+        bits[(i + j) / 32] |= uint32_t(words[j] < threshold) << ((i + j) % 32);
+      }
+    }
+  }
+
+ private:
+  static constexpr int kRounds = 10;
+  static constexpr uint32_t kM0 = 0xD2511F53, kM1 = 0xCD9E8D57;
+  static constexpr uint32_t kW0 = 0x9E3779B9, kW1 = 0xBB67AE85;
+
+#ifdef CNN_USE_SSE
+  // counters are processed two at a time: word j of both is held by c[j],
+  // in the low halves of its 64-bit lanes, where _mm_mul_epu32 leaves the
+  // low and high halves of the products
+  static void round_sse(__m128i *c, __m128i k0, __m128i k1) {
+    const __m128i p0 = _mm_mul_epu32(c[0], _mm_set1_epi64x(kM0));
+    const __m128i p1 = _mm_mul_epu32(c[2], _mm_set1_epi64x(kM1));
+    c[0] = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(p1, 32), c[1]), k0);
+    c[1] = p1;
+    c[2] = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(p0, 32), c[3]), k1);
+    c[3] = p0;
+  }
+
+  // stores the words of both counters of c in order
+  static void store_sse(const __m128i *c, uint32_t *dst) {
+    const int low_halves = _MM_SHUFFLE(3, 1, 2, 0);
+    const __m128i w01    = _mm_unpacklo_epi32(
+      _mm_shuffle_epi32(c[0], low_halves), _mm_shuffle_epi32(c[1], low_halves));
+    const __m128i w23 = _mm_unpacklo_epi32(
+      _mm_shuffle_epi32(c[2], low_halves), _mm_shuffle_epi32(c[3], low_halves));
+    __m128i *out = reinterpret_cast<__m128i *>(dst);
+    _mm_storeu_si128(out, _mm_unpacklo_epi64(w01, w23));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi64(w01, w23));
+  }
+
+  // the 4 counters from (block, c1, c2, c3) on, as two independent pairs
+  // to hide the latency of the multiplications
+  void generate16_sse(uint32_t block,
+                      uint32_t c1,
+                      uint32_t c2,
+                      uint32_t c3,
+                      uint32_t *dst) const {
+    __m128i a[4] = {_mm_set_epi64x(block + 1, block), _mm_set1_epi64x(c1),
+                    _mm_set1_epi64x(c2), _mm_set1_epi64x(c3)};
+    __m128i b[4] = {_mm_set_epi64x(block + 3, block + 2), a[1], a[2], a[3]};
+    uint32_t k0 = k0_, k1 = k1_;
+    for (int r = 0; r < kRounds; r++) {
+      const __m128i key0 = _mm_set1_epi64x(k0), key1 = _mm_set1_epi64x(k1);
+      round_sse(a, key0, key1);
+      round_sse(b, key0, key1);
+      k0 += kW0;
+      k1 += kW1;
+    }
+    store_sse(a, dst);
+    store_sse(b, dst + 8);
+  }
+#endif  // CNN_USE_SSE
+
+  uint32_t k0_;
+  uint32_t k1_;
+};
+
+/**
+ * a 64-bit seed drawn from the shared random generator, e.g. the key of a
+ * philox4x32 stream which should follow set_random_seed
+ **/
+inline uint64_t random_seed64() {
+  auto &gen = random_generator::get_instance()();
+  const uint64_t hi = gen();
+  return (hi << 32) | gen();
+}
+
 template <typename Iter>
 void uniform_rand(Iter begin, Iter end, float_t min, float_t max) {
   for (Iter it = begin; it != end; ++it) *it = uniform_rand(min, max);
@@ -39,6 +39,29 @@ void arc(Archive &ar, T &&arg) {
   ar(arg);
 }
 
+/**
+ * read arg, which was added to the layer records in layer::archive_version()
+ * since. binary archives of an older version lack it, json archives are
+ * searched for it by name; if it is missing arg keeps its value.
+ **/
+template <class Archive, typename T>
+void arc_since(Archive &ar,
+               std::uint32_t since,
+               cereal::NameValuePair<T> &&arg) {
+  if (tiny_dnn::layer::loading_archive_version() >= since) ar(arg);
+}
+
+template <typename T>
+void arc_since(cereal::JSONInputArchive &ar,
+               std::uint32_t,
+               cereal::NameValuePair<T> &&arg) {
+  try {
+    ar(arg);
+  } catch (const cereal::Exception &) {
+    // keep the default
+  }
+}
+
 template <class Archive,
           typename std::enable_if<std::is_base_of<cereal::BinaryOutputArchive,
                                                   Archive>::value>::type = 0>
@@ -182,9 +205,12 @@ struct LoadAndConstruct<tiny_dnn::convolutional_layer> {
                   ::detail::make_nvp("has_bias", has_bias),
                   ::detail::make_nvp("w_stride", w_stride),
                   ::detail::make_nvp("h_stride", h_stride));
+    bool fused = false;
+    ::detail::arc_since(ar, 2, ::detail::make_nvp("fused_activation", fused));
 
     construct(in.width_, in.height_, w_width, w_height, in.depth_, out_ch, tbl,
               pad_type, has_bias, w_stride, h_stride);
+    if (fused) construct->fuse(tiny_dnn::layer::load_layer(ar));
   }
 };
 
@@ -243,7 +269,10 @@ struct LoadAndConstruct<tiny_dnn::fully_connected_layer> {
     ::detail::arc(ar, ::detail::make_nvp("in_size", in_dim),
                   ::detail::make_nvp("out_size", out_dim),
                   ::detail::make_nvp("has_bias", has_bias));
+    bool fused = false;
+    ::detail::arc_since(ar, 2, ::detail::make_nvp("fused_activation", fused));
     construct(in_dim, out_dim, has_bias);
+    if (fused) construct->fuse(tiny_dnn::layer::load_layer(ar));
   }
 };
 
@@ -368,6 +397,7 @@ struct LoadAndConstruct<tiny_dnn::quantized_convolutional_layer> {
     tiny_dnn::shape3d in;
     tiny_dnn::padding pad_type;
     tiny_dnn::core::connection_table tbl;
+    tiny_dnn::core::quantization_params quantization;
 
     ::detail::arc(ar, ::detail::make_nvp("in_size", in),
                   ::detail::make_nvp("window_width", w_width),
@@ -378,9 +408,12 @@ struct LoadAndConstruct<tiny_dnn::quantized_convolutional_layer> {
                   ::detail::make_nvp("has_bias", has_bias),
                   ::detail::make_nvp("w_stride", w_stride),
                   ::detail::make_nvp("h_stride", h_stride));
+    ::detail::arc_since(ar, 1,
+                        ::detail::make_nvp("quantization", quantization));
 
     construct(in.width_, in.height_, w_width, w_height, in.depth_, out_ch, tbl,
               pad_type, has_bias, w_stride, h_stride);
+    construct->set_quantization(quantization);
   }
 };
 
@@ -395,6 +428,7 @@ struct LoadAndConstruct<tiny_dnn::quantized_deconvolutional_layer> {
     tiny_dnn::shape3d in;
     tiny_dnn::padding pad_type;
     tiny_dnn::core::connection_table tbl;
+    tiny_dnn::core::quantization_params quantization;
 
     ::detail::arc(ar, ::detail::make_nvp("in_size", in),
                   ::detail::make_nvp("window_width", w_width),
@@ -405,9 +439,12 @@ struct LoadAndConstruct<tiny_dnn::quantized_deconvolutional_layer> {
                   ::detail::make_nvp("has_bias", has_bias),
                   ::detail::make_nvp("w_stride", w_stride),
                   ::detail::make_nvp("h_stride", h_stride));
+    ::detail::arc_since(ar, 1,
+                        ::detail::make_nvp("quantization", quantization));
 
     construct(in.width_, in.height_, w_width, w_height, in.depth_, out_ch, tbl,
               pad_type, has_bias, w_stride, h_stride);
+    construct->set_quantization(quantization);
   }
 };
 
@@ -419,11 +456,15 @@ struct LoadAndConstruct<tiny_dnn::quantized_fully_connected_layer> {
     cereal::construct<tiny_dnn::quantized_fully_connected_layer> &construct) {
     size_t in_dim, out_dim;
     bool has_bias;
+    tiny_dnn::core::quantization_params quantization;
 
     ::detail::arc(ar, ::detail::make_nvp("in_size", in_dim),
                   ::detail::make_nvp("out_size", out_dim),
                   ::detail::make_nvp("has_bias", has_bias));
+    ::detail::arc_since(ar, 1,
+                        ::detail::make_nvp("quantization", quantization));
     construct(in_dim, out_dim, has_bias);
+    construct->set_quantization(quantization);
   }
 };
 
@@ -622,12 +663,13 @@ struct serialization_buddy {
   template <class Archive>
   static inline void serialize(Archive &ar,
                                tiny_dnn::average_pooling_layer &layer) {
-    ::detail::arc(ar, ::detail::make_nvp("in_size", layer.in_),
-                  ::detail::make_nvp("pool_size_x", layer.pool_size_x_),
-                  ::detail::make_nvp("pool_size_y", layer.pool_size_y_),
-                  ::detail::make_nvp("stride_x", layer.stride_x_),
-                  ::detail::make_nvp("stride_y", layer.stride_y_),
-                  ::detail::make_nvp("pad_type", layer.pad_type_));
+    auto &params_ = layer.params_;
+    ::detail::arc(ar, ::detail::make_nvp("in_size", params_.in),
+                  ::detail::make_nvp("pool_size_x", params_.pool_size_x),
+                  ::detail::make_nvp("pool_size_y", params_.pool_size_y),
+                  ::detail::make_nvp("stride_x", params_.stride_x),
+                  ::detail::make_nvp("stride_y", params_.stride_y),
+                  ::detail::make_nvp("pad_type", params_.pad_type));
   }
 
   template <class Archive>
@@ -669,6 +711,9 @@ struct serialization_buddy {
                   ::detail::make_nvp("has_bias", params_.has_bias),
                   ::detail::make_nvp("w_stride", params_.w_stride),
                   ::detail::make_nvp("h_stride", params_.h_stride));
+    bool fused = layer.activation_ != nullptr;
+    ::detail::arc(ar, ::detail::make_nvp("fused_activation", fused));
+    if (fused) tiny_dnn::layer::save_layer(ar, *layer.activation_);
   }
 
   template <class Archive>
@@ -700,6 +745,9 @@ struct serialization_buddy {
     ::detail::arc(ar, ::detail::make_nvp("in_size", params_.in_size_),
                   ::detail::make_nvp("out_size", params_.out_size_),
                   ::detail::make_nvp("has_bias", params_.has_bias_));
+    bool fused = layer.activation_ != nullptr;
+    ::detail::arc(ar, ::detail::make_nvp("fused_activation", fused));
+    if (fused) tiny_dnn::layer::save_layer(ar, *layer.activation_);
   }
 
   template <class Archive>
@@ -769,7 +817,8 @@ struct serialization_buddy {
                   ::detail::make_nvp("pad_type", params_.pad_type),
                   ::detail::make_nvp("has_bias", params_.has_bias),
                   ::detail::make_nvp("w_stride", params_.w_stride),
-                  ::detail::make_nvp("h_stride", params_.h_stride));
+                  ::detail::make_nvp("h_stride", params_.h_stride),
+                  ::detail::make_nvp("quantization", layer.qparams_));
   }
 
   template <class Archive>
@@ -784,7 +833,8 @@ struct serialization_buddy {
                   ::detail::make_nvp("pad_type", params_.pad_type),
                   ::detail::make_nvp("has_bias", params_.has_bias),
                   ::detail::make_nvp("w_stride", params_.w_stride),
-                  ::detail::make_nvp("h_stride", params_.h_stride));
+                  ::detail::make_nvp("h_stride", params_.h_stride),
+                  ::detail::make_nvp("quantization", layer.qparams_));
   }
 
   template <class Archive>
@@ -793,7 +843,8 @@ struct serialization_buddy {
     auto &params_ = layer.params_;
     ::detail::arc(ar, ::detail::make_nvp("in_size", params_.in_size_),
                   ::detail::make_nvp("out_size", params_.out_size_),
-                  ::detail::make_nvp("has_bias", params_.has_bias_));
+                  ::detail::make_nvp("has_bias", params_.has_bias_),
+                  ::detail::make_nvp("quantization", layer.qparams_));
   }
 
   template <class Archive>
@@ -902,6 +953,15 @@ void serialize(Archive &ar, tiny_dnn::core::connection_table &tbl) {
   }
 }
 
+template <class Archive>
+void serialize(Archive &ar, tiny_dnn::core::quantization_params &q) {
+  ::detail::arc(ar, ::detail::make_nvp("min_input", q.min_input),
+                ::detail::make_nvp("max_input", q.max_input),
+                ::detail::make_nvp("min_output", q.min_output),
+                ::detail::make_nvp("max_output", q.max_output),
+                ::detail::make_nvp("per_channel", q.per_channel));
+}
+
 }  // namespace core
 
 }  // namespace tiny_dnn
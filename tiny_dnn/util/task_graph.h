@@ -0,0 +1,127 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "tiny_dnn/util/nn_error.h"
+#include "tiny_dnn/util/thread_pool.h"
+
+namespace tiny_dnn {
+
+/**
+ * static dependency graph of tasks 0 ... size()-1.
+ *
+ * run() dispatches every task whose predecessors have finished to a
+ * thread_pool, so independent branches execute concurrently. A task becomes
+ * ready as soon as its last predecessor completes (dependency counting);
+ * there is no barrier between "levels" of the graph.
+ *
+ *     task_graph g(3);
+ *     g.add_dependency(0, 2);  // 2 runs after 0
+ *     g.add_dependency(1, 2);  // ... and after 1
+ *     g.run([&](size_t task) { ... });  // 0 and 1 may run in parallel
+ **/
+class task_graph {
+ public:
+  explicit task_graph(size_t size = 0) : succ_(size), num_pred_(size, 0) {}
+
+  size_t size() const { return succ_.size(); }
+
+  /**
+   * let task after start only when task before has finished
+   **/
+  void add_dependency(size_t before, size_t after) {
+    if (before >= size() || after >= size() || before == after) {
+      throw nn_error("invalid task dependency");
+    }
+    std::vector<size_t> &succ = succ_[before];
+    if (std::find(succ.begin(), succ.end(), after) != succ.end()) return;
+    succ.push_back(after);
+    num_pred_[after]++;
+  }
+
+  const std::vector<size_t> &successors(size_t task) const {
+    return succ_[task];
+  }
+
+  /**
+   * execute f(task) for every task on the global thread_pool.
+   * single-threaded builds run the tasks in a topological order instead.
+   **/
+  template <typename Func>
+  void run(const Func &f) const {
+#ifdef CNN_SINGLE_THREAD
+    run_serial(f);
+#else
+    run(thread_pool::get_instance(), f);
+#endif
+  }
+
+  template <typename Func>
+  void run(thread_pool &pool, const Func &f) const {
+    if (pool.num_threads() <= 1 || size() <= 1) {
+      run_serial(f);
+      return;
+    }
+
+    std::unique_ptr<std::atomic<size_t>[]> pending(
+      new std::atomic<size_t>[size()]);
+    for (size_t i = 0; i < size(); i++) pending[i] = num_pred_[i];
+
+    // a failing task does not release its successors, so the group drains
+    // and wait() rethrows the exception
+    task_group group;
+    std::function<void(size_t)> launch = [&](size_t task) {
+      pool.run(group, [&, task] {
+        f(task);
+        for (size_t next : succ_[task]) {
+          if (pending[next].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            launch(next);
+          }
+        }
+      });
+    };
+
+    for (size_t i = 0; i < size(); i++) {
+      if (num_pred_[i] == 0) launch(i);
+    }
+    pool.wait(group);
+  }
+
+  /**
+   * execute f(task) for every task on the calling thread (Kahn's algorithm)
+   **/
+  template <typename Func>
+  void run_serial(const Func &f) const {
+    std::vector<size_t> pending(num_pred_);
+    std::deque<size_t> ready;
+    for (size_t i = 0; i < size(); i++) {
+      if (pending[i] == 0) ready.push_back(i);
+    }
+    while (!ready.empty()) {
+      size_t task = ready.front();
+      ready.pop_front();
+      f(task);
+      for (size_t next : succ_[task]) {
+        if (--pending[next] == 0) ready.push_back(next);
+      }
+    }
+  }
+
+ private:
+  std::vector<std::vector<size_t>> succ_;
+  std::vector<size_t> num_pred_;
+};
+
+}  // namespace tiny_dnn
@@ -0,0 +1,355 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace tiny_dnn {
+
+/**
+ * set of tasks submitted to a thread_pool which can be waited for as a whole.
+ * the first exception thrown by a task is rethrown by thread_pool::wait.
+ **/
+class task_group {
+ public:
+  task_group() : pending_(0) {}
+  task_group(const task_group &) = delete;
+  task_group &operator=(const task_group &) = delete;
+
+  bool done() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+ private:
+  friend class thread_pool;
+
+  void capture_exception() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!error_) error_ = std::current_exception();
+  }
+
+  void rethrow() {
+    std::exception_ptr e;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      std::swap(e, error_);
+    }
+    if (e) std::rethrow_exception(e);
+  }
+
+  std::atomic<size_t> pending_;
+  std::mutex mtx_;
+  std::exception_ptr error_;
+};
+
+/**
+ * persistent pool of worker threads with per-worker deques and work stealing.
+ *
+ * A worker pushes and pops its own tasks at the back of its deque (LIFO, so
+ * nested work stays cache-hot) while idle workers steal from the front of
+ * other deques (FIFO, so they take the largest pending pieces of work).
+ * Threads outside of the pool submit to a shared queue. A thread waiting for
+ * a task_group keeps executing queued tasks, therefore nested parallel_for
+ * calls from inside a task never block the pool.
+ *
+ *     thread_pool &pool = thread_pool::get_instance();
+ *     pool.set_num_threads(4);
+ *     pool.parallel_for(0, n, 16, [&](size_t begin, size_t end) { ... });
+ **/
+class thread_pool {
+ public:
+  static thread_pool &get_instance() {
+    static thread_pool instance;
+    return instance;
+  }
+
+  /**
+   * @param num_threads number of threads taking part in parallel work,
+   *                    including the calling thread (0 = hardware concurrency)
+   **/
+  explicit thread_pool(size_t num_threads = 0)
+    : queued_(0), sleepers_(0), stop_(false) {
+    start(resolve_num_threads(num_threads) - 1);
+  }
+
+  ~thread_pool() { stop(); }
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+
+  /**
+   * number of threads taking part in parallel work, including the caller
+   **/
+  size_t num_threads() const { return workers_.size() + 1; }
+
+  /**
+   * restart the pool with the given number of threads (0 = hardware
+   * concurrency). must not be called while tasks are in flight.
+   **/
+  void set_num_threads(size_t num_threads) {
+    stop();
+    start(resolve_num_threads(num_threads) - 1);
+  }
+
+  /**
+   * pin worker i to cpus[i % cpus.size()]. an empty list removes the pinning
+   * for workers started afterwards.
+   * @return false if thread affinity is not supported on this platform
+   **/
+  bool set_affinity(const std::vector<size_t> &cpus) {
+    affinity_ = cpus;
+    bool ok   = true;
+    for (size_t i = 0; i < workers_.size(); i++) {
+      ok = apply_affinity(workers_[i], i) && ok;
+    }
+#if defined(__linux__)
+    return ok;
+#else
+    return cpus.empty();
+#endif
+  }
+
+  /**
+   * queue fn as part of group
+   **/
+  void run(task_group &group, std::function<void()> fn) {
+    group.pending_.fetch_add(1, std::memory_order_relaxed);
+    if (workers_.empty()) {
+      // nobody to hand the task to, run it right away
+      execute(task{std::move(fn), &group});
+      return;
+    }
+    queued_.fetch_add(1);
+    {
+      worker_queue &q = *queues_[local_queue()];
+      std::lock_guard<std::mutex> lock(q.mtx);
+      q.tasks.push_back(task{std::move(fn), &group});
+    }
+    if (sleepers_.load() > 0) {
+      std::lock_guard<std::mutex> lock(sleep_mtx_);
+      sleep_cv_.notify_one();
+    }
+  }
+
+  /**
+   * block until every task of group has finished, executing queued tasks in
+   * the meantime
+   **/
+  void wait(task_group &group) {
+    const size_t self = local_queue();
+    task t;
+    while (!group.done()) {
+      if (find_task(self, t)) {
+        execute(t);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    group.rethrow();
+  }
+
+  /**
+   * call f(first, last) for disjoint sub-ranges covering [begin, end).
+   *
+   * like tbb::blocked_range, a range is split in halves until no chunk is
+   * longer than grainsize. ranges shorter than grainsize are split down to
+   * single elements, matching the TBB and GCD backends. chunks are coarsened
+   * to a few per thread to bound the scheduling overhead.
+   **/
+  template <typename Func>
+  void parallel_for(size_t begin,
+                    size_t end,
+                    size_t grainsize,
+                    const Func &f) {
+    if (begin >= end) return;
+    const size_t count = end - begin;
+    size_t grain = (grainsize == 0 || count <= grainsize) ? 1 : grainsize;
+    grain        = std::max(grain, count / (num_threads() * 4));
+
+    if (workers_.empty() || count <= grain) {
+      f(begin, end);
+      return;
+    }
+
+    task_group group;
+    try {
+      split(group, begin, end, grain, f);
+    } catch (...) {
+      // queued chunks still refer to group and f, let them finish first
+      group.capture_exception();
+    }
+    wait(group);
+  }
+
+ private:
+  struct task {
+    std::function<void()> fn;
+    task_group *group;
+  };
+
+  struct worker_queue {
+    std::mutex mtx;
+    std::deque<task> tasks;
+  };
+
+  struct thread_info {
+    const thread_pool *pool;
+    size_t index;
+  };
+
+  static thread_info &this_thread_info() {
+    static thread_local thread_info info{nullptr, 0};
+    return info;
+  }
+
+  static size_t resolve_num_threads(size_t num_threads) {
+    if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+    return std::max(num_threads, size_t{1});
+  }
+
+  // queue owned by the calling thread; the last queue is shared by all
+  // threads which are not workers of this pool
+  size_t local_queue() const {
+    const thread_info &info = this_thread_info();
+    return info.pool == this ? info.index : workers_.size();
+  }
+
+  template <typename Func>
+  void split(task_group &group,
+             size_t begin,
+             size_t end,
+             size_t grain,
+             const Func &f) {
+    while (end - begin > grain) {
+      // hand the upper half over so that idle threads can steal it
+      size_t mid = begin + (end - begin) / 2;
+      run(group, [this, &group, mid, end, grain, &f] {
+        split(group, mid, end, grain, f);
+      });
+      end = mid;
+    }
+    f(begin, end);
+  }
+
+  static bool pop_back(worker_queue &q, task &t) {
+    std::lock_guard<std::mutex> lock(q.mtx);
+    if (q.tasks.empty()) return false;
+    t = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+  }
+
+  static bool pop_front(worker_queue &q, task &t) {
+    std::lock_guard<std::mutex> lock(q.mtx);
+    if (q.tasks.empty()) return false;
+    t = std::move(q.tasks.front());
+    q.tasks.pop_front();
+    return true;
+  }
+
+  bool find_task(size_t self, task &t) {
+    if (queued_.load() == 0) return false;
+    const size_t n = queues_.size();
+    bool found     = pop_back(*queues_[self], t);
+    for (size_t i = 1; !found && i < n; i++) {
+      found = pop_front(*queues_[(self + i) % n], t);
+    }
+    if (found) queued_.fetch_sub(1);
+    return found;
+  }
+
+  static void execute(const task &t) {
+    try {
+      t.fn();
+    } catch (...) {
+      t.group->capture_exception();
+    }
+    t.group->pending_.fetch_sub(1, std::memory_order_release);
+  }
+
+  void worker_loop(size_t index) {
+    this_thread_info() = thread_info{this, index};
+    task t;
+    for (;;) {
+      if (find_task(index, t)) {
+        execute(t);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mtx_);
+      sleepers_.fetch_add(1);
+      sleep_cv_.wait(lock, [this] { return stop_ || queued_.load() > 0; });
+      sleepers_.fetch_sub(1);
+      if (stop_ && queued_.load() == 0) return;
+    }
+  }
+
+  bool apply_affinity(std::thread &th, size_t index) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (affinity_.empty()) {
+      for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &set);
+    } else {
+      const size_t cpu = affinity_[index % affinity_.size()];
+      if (cpu >= CPU_SETSIZE) return false;
+      CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(th.native_handle(), sizeof(set), &set) == 0;
+#else
+    (void)th;
+    (void)index;
+    return affinity_.empty();
+#endif
+  }
+
+  void start(size_t num_workers) {
+    queues_.clear();
+    for (size_t i = 0; i < num_workers + 1; i++) {
+      queues_.emplace_back(new worker_queue());
+    }
+    for (size_t i = 0; i < num_workers; i++) {
+      workers_.emplace_back([this, i] { worker_loop(i); });
+      if (!affinity_.empty()) apply_affinity(workers_.back(), i);
+    }
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mtx_);
+      stop_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (auto &w : workers_) w.join();
+    workers_.clear();
+    stop_ = false;
+  }
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<worker_queue>> queues_;
+  std::vector<size_t> affinity_;
+  std::atomic<size_t> queued_;    // number of tasks waiting in any queue
+  std::atomic<size_t> sleepers_;  // number of workers waiting on sleep_cv_
+  std::mutex sleep_mtx_;
+  std::condition_variable sleep_cv_;
+  bool stop_;
+};
+
+}  // namespace tiny_dnn